@@ -1,26 +1,29 @@
 #include "api/alpaca.h"
 
 #include <chrono>
+#include <cstdint>
 #include <format>
-#include <memory>
+#include <functional>
+#include <future>
+#include <generator>
 #include <optional>
-#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <utility>
 
 #include "absl/flags/flag.h"
 #include "absl/log/log.h"
 #include "absl/strings/str_cat.h"
+#include "api/alpaca/bars.h"
 #include "boost/beast.hpp"
 #include "boost/url.hpp"
 #include "containers/vector.h"
 #include "data/candle.pb.h"
 #include "data/stock.pb.h"
-#include "google/protobuf/util/time_util.h"
-#include "net/connect.h"
+#include "net/connection_pool.h"
+#include "net/rate_limiter.h"
 #include "net/url.h"
-#include "json/json.h"
 
 ABSL_FLAG(std::string, alpaca_api_key_id, "", "API Key Id for Alpaca");
 ABSL_FLAG(std::string, alpaca_api_key_secret, "", "API secret for Alpaca");
@@ -29,6 +32,11 @@ ABSL_FLAG(
     alpaca_api_host,
     "data.alpaca.markets",
     "Hostname for the Alpaca API");
+ABSL_FLAG(
+    double,
+    alpaca_requests_per_minute,
+    200,
+    "Maximum rate of requests to the Alpaca API across the process.");
 
 namespace howling::alpaca {
 namespace {
@@ -36,9 +44,14 @@ namespace {
 namespace beast = ::boost::beast;
 namespace urls = ::boost::urls;
 
-using ::google::protobuf::util::TimeUtil;
+using ::std::chrono::duration_cast;
+using ::std::chrono::seconds;
+using ::std::chrono::steady_clock;
+
+using http_response = beast::http::response<beast::http::string_body>;
 
-using http_response = beast::http::response<beast::http::dynamic_body>;
+constexpr std::string_view API_BUCKET = "alpaca";
+constexpr int MAX_THROTTLED_ATTEMPTS = 3;
 
 void check_alpaca_flags() {
   if (absl::GetFlag(FLAGS_alpaca_api_host).empty()) {
@@ -83,8 +96,37 @@ make_url(stock::Symbol symbol, const get_stock_bars_parameters& params) {
       .target = absl::StrCat(url.path(), "?", url.query())};
 }
 
-http_response send_request(
-    const std::unique_ptr<net::connection>& conn, const net::url& url) {
+/**
+ * @brief Sends the request within the Alpaca rate limit, retrying up to a few
+ * times if Alpaca responds with 429 Too Many Requests anyway.
+ */
+http_response send_limited(
+    net::connection_pool& pool,
+    const net::url& url,
+    const beast::http::request<beast::http::string_body>& req) {
+  net::rate_limiter& limiter = net::rate_limiter::get_instance();
+  for (int attempt = 1;; ++attempt) {
+    limiter.acquire(
+        {{.bucket = API_BUCKET,
+          .requests_per_minute =
+              absl::GetFlag(FLAGS_alpaca_requests_per_minute),
+          .burst = 10}},
+        net::request_priority::HISTORY);
+    http_response res = pool.send(url, req);
+    if (res.result() != beast::http::status::too_many_requests ||
+        attempt == MAX_THROTTLED_ATTEMPTS) {
+      return res;
+    }
+
+    steady_clock::duration delay = net::parse_retry_after(
+        res[beast::http::field::retry_after], seconds{1});
+    LOG(WARNING) << "Throttled by Alpaca API, retrying in "
+                 << duration_cast<seconds>(delay).count() << "s.";
+    limiter.retry_after(API_BUCKET, delay);
+  }
+}
+
+http_response send_request(net::connection_pool& pool, const net::url& url) {
   LOG(INFO) << "GET " << url.target;
 
   // TODO: Set custom user agent.
@@ -98,10 +140,7 @@ http_response send_request(
   req.set("APCA-API-KEY-ID", absl::GetFlag(FLAGS_alpaca_api_key_id));
   req.set("APCA-API-SECRET-KEY", absl::GetFlag(FLAGS_alpaca_api_key_secret));
 
-  beast::http::write(conn->stream(), req);
-  beast::flat_buffer buffer;
-  http_response res;
-  beast::http::read(conn->stream(), buffer, res);
+  http_response res = send_limited(pool, url, req);
 
   LOG(INFO) << res.result_int() << " " << res.reason() << " : response("
             << res.body().size() << " bytes)";
@@ -118,60 +157,50 @@ http_response send_request(
   return res;
 }
 
-Candle to_candle(const Json::Value& val) {
-  Candle candle;
-  candle.set_open(val["o"].asDouble());
-  candle.set_close(val["c"].asDouble());
-  candle.set_high(val["h"].asDouble());
-  candle.set_low(val["l"].asDouble());
-  candle.set_volume(val["v"].asInt64());
-  if (!TimeUtil::FromString(val["t"].asString(), candle.mutable_opened_at())) {
-    throw std::runtime_error(
-        absl::StrCat(
-            "Invalid timestamp format: ",
-            Json::writeString(Json::StreamWriterBuilder{}, val["t"]),
-            "."));
-  }
-  // TODO: Build duration from params.timeframe instead of assuming.
-  *candle.mutable_duration() = TimeUtil::SecondsToDuration(60);
-  return candle;
-}
-
 } // namespace
 
-vector<Candle>
-get_stock_bars(stock::Symbol symbol, get_stock_bars_parameters params) {
+std::generator<Candle>
+stream_stock_bars(stock::Symbol symbol, get_stock_bars_parameters params) {
   check_alpaca_flags();
 
-  vector<Candle> candles;
-  net::url url = make_url(symbol, params);
-  std::unique_ptr<net::connection> conn = net::make_connection(url);
-  do {
-    http_response res = send_request(conn, url);
-    std::stringstream body_stream{beast::buffers_to_string(res.body().data())};
-
-    Json::Value root;
-    body_stream >> root;
-
-    for (const Json::Value& val : root["bars"][stock::Symbol_Name(symbol)]) {
-      candles.push_back(to_candle(val));
+  net::connection_pool& pool = net::connection_pool::get_instance();
+  std::string symbol_name = stock::Symbol_Name(symbol);
+  std::future<http_response> next_page = std::async(
+      std::launch::async,
+      send_request,
+      std::ref(pool),
+      make_url(symbol, params));
+  int64_t bar_count = 0;
+  while (next_page.valid()) {
+    http_response res = next_page.get();
+
+    // Request the following page before parsing this one so that the round
+    // trip overlaps with parsing and with the caller consuming the candles.
+    params.page_token = find_next_page_token(res.body());
+    if (params.page_token) {
+      next_page = std::async(
+          std::launch::async,
+          send_request,
+          std::ref(pool),
+          make_url(symbol, params));
     }
 
-    const Json::Value* next_page_token = root.find("next_page_token");
-    bool has_next_page = next_page_token && next_page_token->isString();
-    LOG(INFO) << "Loaded " << candles.size() << " results. "
-              << (has_next_page ? "Fetching" : "Not fetching")
-              << " another page.";
-
-    if (has_next_page) {
-      std::string page_token_buffer = next_page_token->asString();
-      params.page_token = page_token_buffer;
-      url = make_url(symbol, params);
-    } else {
-      params.page_token = std::nullopt;
+    for (Candle& candle : read_bars(res.body(), symbol_name)) {
+      ++bar_count;
+      co_yield std::move(candle);
     }
-  } while (params.page_token);
+    LOG(INFO) << "Loaded " << bar_count << " results. "
+              << (params.page_token ? "Fetching" : "Not fetching")
+              << " another page.";
+  }
+}
 
+vector<Candle>
+get_stock_bars(stock::Symbol symbol, get_stock_bars_parameters params) {
+  vector<Candle> candles;
+  for (Candle& candle : stream_stock_bars(symbol, std::move(params))) {
+    candles.push_back(std::move(candle));
+  }
   return candles;
 }
 
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <chrono>
+#include <generator>
 #include <optional>
+#include <string>
 #include <string_view>
 
 #include "containers/vector.h"
@@ -19,9 +21,19 @@ struct get_stock_bars_parameters {
   std::string_view adjustment = "raw";
   std::string_view feed = "iex"; // TODO: Change to "sip" once subscribed.
   std::string_view currency = "USD";
-  std::optional<std::string_view> page_token;
+  std::optional<std::string> page_token;
 };
 
+/**
+ * @brief Streams the bars for the symbol as candles, following pagination.
+ *
+ * Each page is requested as soon as the previous page's token is received, so
+ * later pages download while earlier candles are being consumed.
+ */
+std::generator<Candle>
+stream_stock_bars(stock::Symbol symbol, get_stock_bars_parameters params = {});
+
+/** @brief Fetches every bar for the symbol, following pagination. */
 vector<Candle>
 get_stock_bars(stock::Symbol symbol, get_stock_bars_parameters params = {});
 
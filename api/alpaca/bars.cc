@@ -0,0 +1,231 @@
+#include "api/alpaca/bars.h"
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <generator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "absl/strings/str_cat.h"
+#include "data/candle.pb.h"
+#include "google/protobuf/util/time_util.h"
+
+namespace howling::alpaca {
+namespace {
+
+using ::google::protobuf::util::TimeUtil;
+
+constexpr std::errc NO_ERROR{};
+
+/**
+ * @brief A forward-only scanner over just enough JSON to walk the bars
+ * response.
+ */
+class json_scanner {
+public:
+  explicit json_scanner(std::string_view text) : _text{text} {}
+
+  /** @brief Consumes `c`, throwing if it is not the next token. */
+  void expect(char c) {
+    if (!consume(c)) _fail(absl::StrCat("expected '", std::string_view{&c, 1}));
+  }
+
+  /** @brief Consumes `c` if it is the next token. */
+  bool consume(char c) {
+    _skip_whitespace();
+    if (_pos < _text.size() && _text[_pos] == c) {
+      ++_pos;
+      return true;
+    }
+    return false;
+  }
+
+  /** @brief Consumes the literal `null` if it is the next token. */
+  bool consume_null() {
+    _skip_whitespace();
+    if (_text.substr(_pos, 4) != "null") return false;
+    _pos += 4;
+    return true;
+  }
+
+  /**
+   * @brief Reads a string token without unescaping it.
+   *
+   * Keys, symbols, timestamps and page tokens never contain escapes.
+   */
+  std::string_view read_raw_string() {
+    expect('"');
+    std::size_t start = _pos;
+    while (_pos < _text.size() && _text[_pos] != '"') {
+      if (_text[_pos] == '\\') ++_pos;
+      ++_pos;
+    }
+    if (_pos >= _text.size()) _fail("unterminated string");
+    return _text.substr(start, _pos++ - start);
+  }
+
+  template <typename T>
+  T read_number() {
+    _skip_whitespace();
+    T val{};
+    auto [end, ec] = std::from_chars(
+        _text.data() + _pos, _text.data() + _text.size(), val);
+    if (ec != NO_ERROR) _fail("expected number");
+    _pos = end - _text.data();
+    return val;
+  }
+
+  /** @brief Skips over the next value, whatever its type. */
+  void skip_value() {
+    _skip_whitespace();
+    if (_pos >= _text.size()) _fail("unexpected end of body");
+    char c = _text[_pos];
+    if (c == '"') {
+      read_raw_string();
+      return;
+    }
+    if (c != '{' && c != '[') {
+      while (_pos < _text.size() && _text[_pos] != ',' && _text[_pos] != '}' &&
+             _text[_pos] != ']') {
+        ++_pos;
+      }
+      return;
+    }
+
+    int depth = 0;
+    do {
+      c = _text[_pos];
+      if (c == '"') {
+        read_raw_string();
+        continue;
+      }
+      if (c == '{' || c == '[') ++depth;
+      if (c == '}' || c == ']') --depth;
+      ++_pos;
+    } while (depth > 0 && _pos < _text.size());
+    if (depth > 0) _fail("unexpected end of body");
+  }
+
+private:
+  void _skip_whitespace() {
+    while (_pos < _text.size() &&
+           (_text[_pos] == ' ' || _text[_pos] == '\n' || _text[_pos] == '\r' ||
+            _text[_pos] == '\t')) {
+      ++_pos;
+    }
+  }
+
+  [[noreturn]] void _fail(std::string_view message) const {
+    throw std::runtime_error(
+        absl::StrCat(
+            "Invalid Alpaca bars response at offset ", _pos, ": ", message));
+  }
+
+  std::string_view _text;
+  std::size_t _pos = 0;
+};
+
+/**
+ * @brief Iterates the members of the object starting at the scanner, calling
+ * `on_member(key)` with the scanner positioned at each value.
+ *
+ * `on_member` must consume the value.
+ */
+template <typename OnMember>
+void for_each_member(json_scanner& scanner, OnMember&& on_member) {
+  scanner.expect('{');
+  if (scanner.consume('}')) return;
+  do {
+    std::string_view key = scanner.read_raw_string();
+    scanner.expect(':');
+    on_member(key);
+  } while (scanner.consume(','));
+  scanner.expect('}');
+}
+
+Candle read_bar(json_scanner& scanner) {
+  Candle candle;
+  for_each_member(scanner, [&](std::string_view key) {
+    if (key == "o") {
+      candle.set_open(scanner.read_number<double>());
+    } else if (key == "c") {
+      candle.set_close(scanner.read_number<double>());
+    } else if (key == "h") {
+      candle.set_high(scanner.read_number<double>());
+    } else if (key == "l") {
+      candle.set_low(scanner.read_number<double>());
+    } else if (key == "v") {
+      candle.set_volume(scanner.read_number<int64_t>());
+    } else if (key == "t") {
+      std::string_view opened_at = scanner.read_raw_string();
+      if (!TimeUtil::FromString(
+              std::string{opened_at}, candle.mutable_opened_at())) {
+        throw std::runtime_error(
+            absl::StrCat("Invalid timestamp format: \"", opened_at, "\"."));
+      }
+    } else {
+      scanner.skip_value();
+    }
+  });
+  // TODO: Build duration from params.timeframe instead of assuming.
+  *candle.mutable_duration() = TimeUtil::SecondsToDuration(60);
+  return candle;
+}
+
+} // namespace
+
+std::generator<Candle>
+read_bars(std::string_view body, std::string_view symbol) {
+  json_scanner scanner{body};
+  scanner.expect('{');
+  if (scanner.consume('}')) co_return;
+  do {
+    std::string_view key = scanner.read_raw_string();
+    scanner.expect(':');
+    if (key != "bars") {
+      scanner.skip_value();
+      continue;
+    }
+    if (scanner.consume_null()) co_return;
+
+    scanner.expect('{');
+    if (scanner.consume('}')) co_return;
+    do {
+      std::string_view bars_symbol = scanner.read_raw_string();
+      scanner.expect(':');
+      if (bars_symbol != symbol) {
+        scanner.skip_value();
+        continue;
+      }
+      if (scanner.consume_null()) co_return;
+
+      scanner.expect('[');
+      if (scanner.consume(']')) co_return;
+      do {
+        co_yield read_bar(scanner);
+      } while (scanner.consume(','));
+      scanner.expect(']');
+      co_return;
+    } while (scanner.consume(','));
+    co_return;
+  } while (scanner.consume(','));
+}
+
+std::optional<std::string> find_next_page_token(std::string_view body) {
+  json_scanner scanner{body};
+  std::optional<std::string> token;
+  for_each_member(scanner, [&](std::string_view key) {
+    if (key != "next_page_token") {
+      scanner.skip_value();
+    } else if (!scanner.consume_null()) {
+      token = std::string{scanner.read_raw_string()};
+    }
+  });
+  return token;
+}
+
+} // namespace howling::alpaca
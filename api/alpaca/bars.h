@@ -0,0 +1,38 @@
+#pragma once
+
+#include <generator>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "data/candle.pb.h"
+
+namespace howling::alpaca {
+
+/**
+ * @brief Parses the bars for one symbol out of a `/v2/stocks/bars` response
+ * body.
+ *
+ * Bars are converted to candles one at a time directly from the body, without
+ * first building a document tree, so the first candle is available as soon as
+ * its bar has been scanned.
+ *
+ * @param body The raw JSON response body. Must outlive the generator.
+ * @param symbol The symbol whose bars to read.
+ *
+ * @throws std::runtime_error if the body is not valid JSON or a bar is
+ * malformed.
+ */
+std::generator<Candle>
+read_bars(std::string_view body, std::string_view symbol);
+
+/**
+ * @brief Finds the `next_page_token` in a `/v2/stocks/bars` response body.
+ *
+ * @return The token, or `std::nullopt` if this is the last page.
+ *
+ * @throws std::runtime_error if the body is not valid JSON.
+ */
+std::optional<std::string> find_next_page_token(std::string_view body);
+
+} // namespace howling::alpaca
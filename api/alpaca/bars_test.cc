@@ -0,0 +1,110 @@
+#include "api/alpaca/bars.h"
+
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "data/candle.pb.h"
+#include "gmock/gmock.h"
+#include "google/protobuf/util/time_util.h"
+#include "gtest/gtest.h"
+
+namespace howling::alpaca {
+namespace {
+
+using ::google::protobuf::util::TimeUtil;
+using ::testing::IsEmpty;
+using ::testing::Optional;
+using ::testing::SizeIs;
+
+constexpr std::string_view TWO_SYMBOL_PAGE = R"json({
+  "bars": {
+    "AAPL": [
+      {"c": 1.5, "h": 2.25, "l": 0.5, "n": 7, "o": 1,
+       "t": "2024-01-03T09:00:00Z", "v": 1200, "vw": 1.4},
+      {"c": 2, "h": 2.5, "l": 1.25, "n": 3, "o": 1.5,
+       "t": "2024-01-03T09:01:00Z", "v": 300, "vw": 1.9}
+    ],
+    "MSFT": [
+      {"c": 9, "h": 9, "l": 9, "n": 1, "o": 9, "t": "2024-01-03T09:00:00Z",
+       "v": 1, "vw": 9}
+    ]
+  },
+  "next_page_token": "QUFQTHxNfDIwMjQtMDEtMDNUMDk6MDE6MDAuMDAwMDAwMDAwWg==",
+  "currency": "USD"
+})json";
+
+std::vector<Candle> read_all(std::string_view body, std::string_view symbol) {
+  std::vector<Candle> candles;
+  for (Candle& candle : read_bars(body, symbol)) {
+    candles.push_back(std::move(candle));
+  }
+  return candles;
+}
+
+// MARK: read_bars
+
+TEST(AlpacaReadBars, ReadsEveryFieldOfEachBar) {
+  std::vector<Candle> candles = read_all(TWO_SYMBOL_PAGE, "AAPL");
+  ASSERT_THAT(candles, SizeIs(2));
+
+  EXPECT_EQ(candles[0].open(), 1.0);
+  EXPECT_EQ(candles[0].close(), 1.5);
+  EXPECT_EQ(candles[0].high(), 2.25);
+  EXPECT_EQ(candles[0].low(), 0.5);
+  EXPECT_EQ(candles[0].volume(), 1200);
+  EXPECT_EQ(
+      TimeUtil::ToString(candles[0].opened_at()), "2024-01-03T09:00:00Z");
+  EXPECT_EQ(TimeUtil::DurationToSeconds(candles[0].duration()), 60);
+
+  EXPECT_EQ(candles[1].open(), 1.5);
+  EXPECT_EQ(candles[1].volume(), 300);
+  EXPECT_EQ(
+      TimeUtil::ToString(candles[1].opened_at()), "2024-01-03T09:01:00Z");
+}
+
+TEST(AlpacaReadBars, SkipsOtherSymbols) {
+  std::vector<Candle> candles = read_all(TWO_SYMBOL_PAGE, "MSFT");
+  ASSERT_THAT(candles, SizeIs(1));
+  EXPECT_EQ(candles[0].close(), 9.0);
+}
+
+TEST(AlpacaReadBars, HandlesMissingOrEmptyBars) {
+  EXPECT_THAT(read_all(TWO_SYMBOL_PAGE, "NVDA"), IsEmpty());
+  EXPECT_THAT(read_all(R"json({"bars": {}})json", "AAPL"), IsEmpty());
+  EXPECT_THAT(read_all(R"json({"bars": null})json", "AAPL"), IsEmpty());
+  EXPECT_THAT(read_all(R"json({"bars": {"AAPL": []}})json", "AAPL"), IsEmpty());
+  EXPECT_THAT(read_all("{}", "AAPL"), IsEmpty());
+}
+
+TEST(AlpacaReadBars, ThrowsOnMalformedBody) {
+  EXPECT_THROW(
+      read_all(R"json({"bars": {"AAPL": [)json", "AAPL"), std::runtime_error);
+  EXPECT_THROW(
+      read_all(R"json({"bars": {"AAPL": [{"o": "x"}]}})json", "AAPL"),
+      std::runtime_error);
+  EXPECT_THROW(
+      read_all(R"json({"bars": {"AAPL": [{"t": "yesterday"}]}})json", "AAPL"),
+      std::runtime_error);
+}
+
+// MARK: find_next_page_token
+
+TEST(AlpacaFindNextPageToken, FindsTokenAfterBars) {
+  EXPECT_THAT(
+      find_next_page_token(TWO_SYMBOL_PAGE),
+      Optional(
+          std::string{"QUFQTHxNfDIwMjQtMDEtMDNUMDk6MDE6MDAuMDAwMDAwMDAwWg=="}));
+}
+
+TEST(AlpacaFindNextPageToken, ReturnsNulloptOnLastPage) {
+  EXPECT_EQ(
+      find_next_page_token(R"json({"bars": {}, "next_page_token": null})json"),
+      std::nullopt);
+  EXPECT_EQ(find_next_page_token(R"json({"bars": {}})json"), std::nullopt);
+}
+
+} // namespace
+} // namespace howling::alpaca
@@ -28,6 +28,8 @@
 #include "data/stock.pb.h"
 #include "google/protobuf/util/time_util.h"
 #include "net/connect.h"
+#include "net/connection_pool.h"
+#include "net/rate_limiter.h"
 #include "net/url.h"
 #include "services/authenticate.h"
 #include "strings/json.h"
@@ -103,16 +105,17 @@ http_request make_request(
 }
 
 http_response send_request(
-    const std::unique_ptr<net::connection>& conn, const http_request& req) {
-  beast::http::write(conn->stream(), req);
-  beast::flat_buffer buffer;
-  http_response res;
-  beast::http::read(conn->stream(), buffer, res);
+    net::connection_pool& pool,
+    const net::url& url,
+    const http_request& req,
+    net::request_priority priority) {
+  http_response res = send_limited(pool, url, req, priority);
 
   LOG(INFO) << res.result_int() << " " << res.reason() << " : response("
             << res.body().size() << " bytes)";
 
-  if (res.result_int() != 200) {
+  if (beast::http::to_status_class(res.result()) !=
+      beast::http::status_class::successful) {
     LOG(ERROR) << beast::buffers_to_string(res.body().data());
     throw std::runtime_error(
         absl::StrCat(
@@ -125,31 +128,15 @@ http_response send_request(
 }
 
 Json::Value send_request(
-    const std::unique_ptr<net::connection>& conn,
+    net::connection_pool& pool,
     std::string_view bearer_token,
-    const net::url& url) {
+    const net::url& url,
+    net::request_priority priority) {
   LOG(INFO) << "GET " << url.target;
 
   beast::http::request<beast::http::string_body> req =
       make_request(beast::http::verb::get, url, bearer_token);
-  http_response res = send_request(conn, req);
-  return to_json(beast::buffers_to_string(res.body().data()));
-}
-
-Json::Value send_request(
-    const std::unique_ptr<net::connection>& conn,
-    std::string_view bearer_token,
-    const net::url& url,
-    const Json::Value& body) {
-  LOG(INFO) << "POST " << url.target;
-
-  beast::http::request<beast::http::string_body> req =
-      make_request(beast::http::verb::post, url, bearer_token);
-  std::string body_str = to_string(body);
-  req.set(http_headers::content_length, std::to_string(body_str.size()));
-  req.set(http_headers::content_type, "application/json");
-  req.body() = std::move(body_str);
-  http_response res = send_request(conn, req);
+  http_response res = send_request(pool, url, req, priority);
   return to_json(beast::buffers_to_string(res.body().data()));
 }
 
@@ -193,10 +180,12 @@ net::url make_url(
 
 Json::Value get_streamer_info() {
   net::url user_pref_url = make_net_url("/trader/v1/userPreference");
-  std::unique_ptr<net::connection> api_conn =
-      net::make_connection(user_pref_url);
   std::string bearer_token = token_manager::get_instance().get_bearer_token();
-  Json::Value root = send_request(api_conn, bearer_token, user_pref_url);
+  Json::Value root = send_request(
+      net::connection_pool::get_instance(),
+      bearer_token,
+      user_pref_url,
+      net::request_priority::STREAMING_LOGIN);
   Json::Value streamer_info = Json::nullValue;
 
   check_json(root.isObject());
@@ -235,7 +224,7 @@ Json::Value make_order(
 } // namespace
 
 api_connection::api_connection()
-    : _conn{net::make_connection(make_net_url("/"))} {}
+    : _pool{net::connection_pool::get_instance()} {}
 
 // MARK: get_history
 
@@ -245,7 +234,8 @@ vector<Candle> api_connection::get_history(
   net::url url = make_url(symbol, params);
   std::string bearer_token = token_manager::get_instance().get_bearer_token();
 
-  Json::Value root = send_request(_conn, bearer_token, url);
+  Json::Value root = send_request(
+      _pool, bearer_token, url, net::request_priority::HISTORY);
   for (const Json::Value& val : root["candles"]) {
     Candle& candle = candles.emplace_back();
     candle.set_open(val["open"].asDouble());
@@ -271,7 +261,8 @@ std::vector<Account> api_connection::get_accounts() {
       std::chrono::duration_cast<std::chrono::milliseconds>(
           to_std_chrono(absl::GetFlag(FLAGS_schwab_auth_timeout))));
 
-  Json::Value root = send_request(_conn, bearer_token, url);
+  Json::Value root = send_request(
+      _pool, bearer_token, url, net::request_priority::ACCOUNT);
   check_json(root.isArray());
 
   std::unordered_map<std::string, Account*> accounts_by_number;
@@ -292,7 +283,8 @@ std::vector<Account> api_connection::get_accounts() {
   }
 
   url.target = "/trader/v1/accounts";
-  root = send_request(_conn, bearer_token, url);
+  root = send_request(
+      _pool, bearer_token, url, net::request_priority::ACCOUNT);
   check_json(root.isArray() && root.size() == accounts.size());
   for (const Json::Value& a : root) {
     check_json(a.isObject());
@@ -327,7 +319,8 @@ api_connection::get_account_positions(std::string_view account_id) {
       absl::StrCat("/trader/v1/accounts/", account_id, "?fields=positions"));
   std::string bearer_token = token_manager::get_instance().get_bearer_token();
 
-  Json::Value root = send_request(_conn, bearer_token, url);
+  Json::Value root = send_request(
+      _pool, bearer_token, url, net::request_priority::ACCOUNT);
   check_json(root.isObject());
   const Json::Value* securities = root.find("securitiesAccount");
   check_json(securities && securities->isObject());
@@ -359,30 +352,101 @@ api_connection::get_account_positions(std::string_view account_id) {
   return positions;
 }
 
+// MARK: orders
+
 void api_connection::place_buy(const order_parameters& params) {
-  net::url url = make_net_url(
-      absl::StrCat("/trader/v1/accounts/", params.account_id, "/orders"));
-  Json::Value body = make_order("BUY", params);
+  submit_order(prepare_buy(params));
+}
 
-  LOG(INFO) << to_string(body);
-  LOG(WARNING) << "THIS IS NOT YET TESTED OR VERIFIED!";
-  return;
+void api_connection::place_sell(const order_parameters& params) {
+  submit_order(prepare_sell(params));
+}
 
-  Json::Value res = send_request(
-      _conn, token_manager::get_instance().get_bearer_token(), url, body);
+api_connection::prepared_order
+api_connection::prepare_buy(const order_parameters& params) {
+  return {
+      .account_id = std::string{params.account_id},
+      .body = to_string(make_order("BUY", params))};
 }
 
-void api_connection::place_sell(const order_parameters& params) {
-  net::url url = make_net_url(
-      absl::StrCat("/trader/v1/accounts/", params.account_id, "/orders"));
-  Json::Value body = make_order("SELL", params);
+api_connection::prepared_order
+api_connection::prepare_sell(const order_parameters& params) {
+  return {
+      .account_id = std::string{params.account_id},
+      .body = to_string(make_order("SELL", params))};
+}
 
-  LOG(INFO) << to_string(body);
+std::string api_connection::submit_order(const prepared_order& order) {
+  net::url url = make_net_url(
+      absl::StrCat("/trader/v1/accounts/", order.account_id, "/orders"));
+  LOG(INFO) << "POST " << url.target << " " << order.body;
   LOG(WARNING) << "THIS IS NOT YET TESTED OR VERIFIED!";
-  return;
+  // Orders stay disabled until submission has been verified against Schwab.
+  throw std::runtime_error("Submitting orders is not yet supported.");
+
+  http_request req = make_request(
+      beast::http::verb::post,
+      url,
+      token_manager::get_instance().get_bearer_token());
+  req.set(http_headers::content_length, std::to_string(order.body.size()));
+  req.set(http_headers::content_type, "application/json");
+  req.body() = order.body;
+  http_response res =
+      send_request(_pool, url, req, net::request_priority::ORDER);
+
+  // Schwab responds with an empty body and the new order in the Location
+  // header, e.g. `/trader/v1/accounts/{accountNumber}/orders/{orderId}`.
+  std::string_view location = res[http_headers::location];
+  std::size_t slash = location.rfind('/');
+  if (slash == std::string_view::npos || slash + 1 == location.size()) {
+    throw std::runtime_error(
+        absl::StrCat(
+            "Order accepted without an order id in its location: ", location));
+  }
+  return std::string{location.substr(slash + 1)};
+}
 
-  Json::Value res = send_request(
-      _conn, token_manager::get_instance().get_bearer_token(), url, body);
+api_connection::order_status api_connection::get_order_status(
+    std::string_view account_id, std::string_view order_id) {
+  net::url url = make_net_url(
+      absl::StrCat("/trader/v1/accounts/", account_id, "/orders/", order_id));
+  Json::Value root = send_request(
+      _pool,
+      token_manager::get_instance().get_bearer_token(),
+      url,
+      net::request_priority::ORDER);
+  check_json(root.isObject());
+  const Json::Value* status = root.find("status");
+  check_json(status && status->isString());
+
+  order_status result{.status = status->asString()};
+  if (const Json::Value* filled = root.find("filledQuantity")) {
+    check_json(filled->isNumeric());
+    result.filled_quantity = static_cast<int64_t>(filled->asDouble());
+  }
+
+  double executed_quantity = 0;
+  double executed_cost = 0;
+  if (const Json::Value* activities = root.find("orderActivityCollection")) {
+    check_json(activities->isArray());
+    for (const Json::Value& activity : *activities) {
+      const Json::Value* legs = activity.find("executionLegs");
+      if (!legs) continue;
+      check_json(legs->isArray());
+      for (const Json::Value& leg : *legs) {
+        const Json::Value* quantity = leg.find("quantity");
+        const Json::Value* price = leg.find("price");
+        check_json(quantity && quantity->isNumeric());
+        check_json(price && price->isNumeric());
+        executed_quantity += quantity->asDouble();
+        executed_cost += quantity->asDouble() * price->asDouble();
+      }
+    }
+  }
+  if (executed_quantity > 0) {
+    result.average_fill_price = executed_cost / executed_quantity;
+  }
+  return result;
 }
 
 // MARK: stream
@@ -2,8 +2,10 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <optional>
+#include <string>
 #include <string_view>
 #include <unordered_map>
 #include <vector>
@@ -14,6 +16,7 @@
 #include "data/market.pb.h"
 #include "data/stock.pb.h"
 #include "net/connect.h"
+#include "net/connection_pool.h"
 #include "json/json.h"
 
 namespace howling::schwab {
@@ -59,8 +62,41 @@ public:
   void place_buy(const order_parameters& params);
   void place_sell(const order_parameters& params);
 
+  /** An order request whose body has been serialized ahead of submission. */
+  struct prepared_order {
+    std::string account_id;
+    std::string body;
+  };
+
+  static prepared_order prepare_buy(const order_parameters& params);
+  static prepared_order prepare_sell(const order_parameters& params);
+
+  /**
+   * @brief Sends a prepared order to the broker.
+   *
+   * Not yet verified against Schwab, so for now this always throws without
+   * sending anything.
+   *
+   * @return The broker's id for the newly created order.
+   *
+   * @throws std::runtime_error if the order was not accepted.
+   */
+  std::string submit_order(const prepared_order& order);
+
+  struct order_status {
+    // Schwab order status, e.g. `WORKING`, `FILLED`, or `REJECTED`.
+    std::string status;
+    int64_t filled_quantity = 0;
+    // Quantity-weighted price of every execution so far.
+    double average_fill_price = 0;
+  };
+
+  /** Fetches the current state of an order previously submitted. */
+  order_status
+  get_order_status(std::string_view account_id, std::string_view order_id);
+
 private:
-  std::unique_ptr<net::connection> _conn;
+  net::connection_pool& _pool;
 };
 
 class stream {
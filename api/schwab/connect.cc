@@ -1,18 +1,69 @@
 #include "api/schwab/connect.h"
 
+#include <chrono>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <utility>
 
 #include "absl/flags/flag.h"
+#include "absl/log/log.h"
+#include "boost/beast/http/dynamic_body.hpp"
+#include "boost/beast/http/field.hpp"
+#include "boost/beast/http/message.hpp"
+#include "boost/beast/http/status.hpp"
+#include "boost/beast/http/string_body.hpp"
+#include "net/connection_pool.h"
+#include "net/rate_limiter.h"
+#include "net/url.h"
 
 ABSL_FLAG(
     std::string,
     schwab_api_host,
     "api.schwabapi.com",
     "Hostname for the Schwab API.");
+ABSL_FLAG(
+    double,
+    schwab_requests_per_minute,
+    120,
+    "Maximum rate of requests to the Schwab API across the process.");
+ABSL_FLAG(
+    double,
+    schwab_orders_per_minute,
+    60,
+    "Maximum rate of order placement requests to the Schwab API.");
 
 namespace howling::schwab {
+namespace {
+
+namespace http = ::boost::beast::http;
+
+using ::std::chrono::duration_cast;
+using ::std::chrono::seconds;
+using ::std::chrono::steady_clock;
+
+constexpr std::string_view API_BUCKET = "schwab";
+constexpr std::string_view ORDER_BUCKET = "schwab/orders";
+constexpr int MAX_THROTTLED_ATTEMPTS = 3;
+
+void acquire(net::rate_limiter& limiter, net::request_priority priority) {
+  net::rate_limit api_limit{
+      .bucket = API_BUCKET,
+      .requests_per_minute = absl::GetFlag(FLAGS_schwab_requests_per_minute),
+      .burst = 10};
+  if (priority != net::request_priority::ORDER) {
+    limiter.acquire({api_limit}, priority);
+    return;
+  }
+  limiter.acquire(
+      {api_limit,
+       {.bucket = ORDER_BUCKET,
+        .requests_per_minute = absl::GetFlag(FLAGS_schwab_orders_per_minute),
+        .burst = 5}},
+      priority);
+}
+
+} // namespace
 
 std::string get_schwab_host() {
   [[maybe_unused]] static const bool _checked = ([]() {
@@ -29,4 +80,27 @@ net::url make_net_url(std::string target) {
       .service = "443", .host = get_schwab_host(), .target = std::move(target)};
 }
 
+http::response<http::dynamic_body> send_limited(
+    net::connection_pool& pool,
+    const net::url& url,
+    const http::request<http::string_body>& req,
+    net::request_priority priority) {
+  net::rate_limiter& limiter = net::rate_limiter::get_instance();
+  for (int attempt = 1;; ++attempt) {
+    acquire(limiter, priority);
+    http::response<http::dynamic_body> res =
+        pool.send<http::dynamic_body>(url, req);
+    if (res.result() != http::status::too_many_requests ||
+        attempt == MAX_THROTTLED_ATTEMPTS) {
+      return res;
+    }
+
+    steady_clock::duration delay =
+        net::parse_retry_after(res[http::field::retry_after], seconds{1});
+    LOG(WARNING) << "Throttled by Schwab API, retrying in "
+                 << duration_cast<seconds>(delay).count() << "s.";
+    limiter.retry_after(API_BUCKET, delay);
+  }
+}
+
 } // namespace howling::schwab
@@ -2,6 +2,11 @@
 
 #include <string>
 
+#include "boost/beast/http/dynamic_body.hpp"
+#include "boost/beast/http/message.hpp"
+#include "boost/beast/http/string_body.hpp"
+#include "net/connection_pool.h"
+#include "net/rate_limiter.h"
 #include "net/url.h"
 
 namespace howling::schwab {
@@ -10,4 +15,18 @@ std::string get_schwab_host();
 
 net::url make_net_url(std::string target);
 
+/**
+ * @brief Sends a request to the Schwab API within its published rate limits.
+ *
+ * Requests with `ORDER` priority also draw from the order placement budget. If
+ * Schwab still responds with 429 Too Many Requests, the shared budget is paused
+ * for the `Retry-After` period and the request is sent again, a few times at
+ * most. Any other response, including a final 429, is returned as is.
+ */
+boost::beast::http::response<boost::beast::http::dynamic_body> send_limited(
+    net::connection_pool& pool,
+    const net::url& url,
+    const boost::beast::http::request<boost::beast::http::string_body>& req,
+    net::request_priority priority);
+
 } // namespace howling::schwab
@@ -12,12 +12,12 @@
 #include "api/schwab/connect.h"
 #include "boost/beast/core/buffers_to_string.hpp"
 #include "boost/beast/http/field.hpp"
-#include "boost/beast/http/read.hpp"
+#include "boost/beast/http/dynamic_body.hpp"
 #include "boost/beast/http/string_body.hpp"
 #include "boost/beast/http/verb.hpp"
-#include "boost/beast/http/write.hpp"
 #include "boost/url/url.hpp"
-#include "net/connect.h"
+#include "net/connection_pool.h"
+#include "net/rate_limiter.h"
 #include "strings/json.h"
 #include "json/json.h"
 
@@ -46,7 +46,7 @@ std::string make_schwab_authorize_url(
 }
 
 oauth_tokens
-exchange_code_for_tokens(net::connection& conn, std::string_view code) {
+exchange_code_for_tokens(net::connection_pool& pool, std::string_view code) {
   check_schwab_flags();
 
   net::url oauth_url = make_net_url("/v1/oauth/token");
@@ -76,10 +76,8 @@ exchange_code_for_tokens(net::connection& conn, std::string_view code) {
   req.set(http_headers::content_type, "application/x-www-form-urlencoded");
   req.body() = body.query();
 
-  http::write(conn.stream(), req);
-  beast::flat_buffer buffer;
-  http::response<http::dynamic_body> res;
-  http::read(conn.stream(), buffer, res);
+  http::response<http::dynamic_body> res = send_limited(
+      pool, oauth_url, req, net::request_priority::AUTHENTICATION);
 
   if (res.result_int() != 200) {
     LOG(ERROR) << "Schwab API responded with " << res.result_int();
@@ -98,7 +96,7 @@ exchange_code_for_tokens(net::connection& conn, std::string_view code) {
 }
 
 oauth_tokens
-refresh_tokens(net::connection& conn, std::string_view refresh_token) {
+refresh_tokens(net::connection_pool& pool, std::string_view refresh_token) {
   check_schwab_flags();
 
   net::url oauth_url = make_net_url("/v1/oauth/token");
@@ -126,10 +124,8 @@ refresh_tokens(net::connection& conn, std::string_view refresh_token) {
   req.set(http_headers::content_type, "application/x-www-form-urlencoded");
   req.body() = body.query();
 
-  http::write(conn.stream(), req);
-  beast::flat_buffer buffer;
-  http::response<http::dynamic_body> res;
-  http::read(conn.stream(), buffer, res);
+  http::response<http::dynamic_body> res = send_limited(
+      pool, oauth_url, req, net::request_priority::AUTHENTICATION);
 
   if (res.result_int() != 200) {
     LOG(ERROR) << beast::buffers_to_string(res.body().data());
@@ -3,7 +3,7 @@
 #include <string>
 #include <string_view>
 
-#include "net/connect.h"
+#include "net/connection_pool.h"
 
 namespace howling::schwab {
 
@@ -22,10 +22,10 @@ std::string make_schwab_authorize_url(
 
 // Exchanges an authorization code for access and refresh tokens.
 oauth_tokens
-exchange_code_for_tokens(net::connection& conn, std::string_view code);
+exchange_code_for_tokens(net::connection_pool& pool, std::string_view code);
 
 // Refreshes the access token using a refresh token.
 oauth_tokens
-refresh_tokens(net::connection& conn, std::string_view refresh_token);
+refresh_tokens(net::connection_pool& pool, std::string_view refresh_token);
 
 } // namespace howling::schwab
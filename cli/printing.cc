@@ -3,10 +3,12 @@
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstddef>
 #include <exception>
 #include <numeric>
 #include <optional>
 #include <ranges>
+#include <span>
 #include <string>
 #include <string_view>
 #include <sys/ioctl.h>
@@ -15,6 +17,7 @@
 
 #include "absl/strings/str_cat.h"
 #include "cli/colorize.h"
+#include "containers/vector.h"
 #include "data/candle.pb.h"
 #include "time/conversion.h"
 #include "trading/metrics.h"
@@ -36,6 +39,18 @@ int get_terminal_width() {
 
 } // namespace
 
+std::size_t visible_width(std::string_view line) {
+  std::size_t width = 0;
+  for (std::size_t i = 0; i < line.size(); ++i) {
+    if (line[i] == '\x1b') {
+      while (i < line.size() && line[i] != 'm') ++i;
+    } else if ((static_cast<unsigned char>(line[i]) & 0xC0) != 0x80) {
+      ++width;
+    }
+  }
+  return width;
+}
+
 std::string print_candle(
     const decision& d,
     const std::optional<trading_state::position>& trade,
@@ -161,4 +176,38 @@ std::string print_metrics(const metrics& m) {
   return result;
 }
 
+std::string print_columns(std::span<const std::string> blocks) {
+  constexpr std::size_t GAP = 4;
+  vector<vector<std::string_view>> columns;
+  vector<std::size_t> widths;
+  std::size_t rows = 0;
+  for (const std::string& block : blocks) {
+    vector<std::string_view>& lines = columns.emplace_back();
+    std::size_t width = 0;
+    for (auto line : std::views::split(block, '\n')) {
+      lines.emplace_back(line.begin(), line.end());
+      width = std::max(width, visible_width(lines.back()));
+    }
+    widths.push_back(width);
+    rows = std::max(rows, lines.size());
+  }
+
+  std::string result;
+  for (std::size_t row = 0; row < rows; ++row) {
+    if (row > 0) result += '\n';
+    std::size_t padding = 0;
+    for (std::size_t col = 0; col < columns.size(); ++col) {
+      if (row >= columns[col].size()) {
+        padding += widths[col] + GAP;
+        continue;
+      }
+      std::string_view line = columns[col][row];
+      result.append(padding, ' ');
+      result += line;
+      padding = widths[col] - visible_width(line) + GAP;
+    }
+  }
+  return result;
+}
+
 } // namespace howling
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cstddef>
 #include <format>
 #include <optional>
+#include <span>
+#include <string>
+#include <string_view>
 
 #include "data/analyzer.h"
 #include "data/candle.pb.h"
@@ -31,4 +35,16 @@ inline std::string print_price(double price) {
 
 std::string print_metrics(const metrics& m);
 
+/**
+ * Counts the terminal columns of `line`, skipping color escape sequences and
+ * counting each UTF-8 code point once.
+ */
+std::size_t visible_width(std::string_view line);
+
+/**
+ * Lays out multi-line blocks of text side by side, each in a column as wide as
+ * its longest line.
+ */
+std::string print_columns(std::span<const std::string> blocks);
+
 } // namespace howling
@@ -0,0 +1,63 @@
+#include "cli/printing.h"
+
+#include <string>
+
+#include "cli/colorize.h"
+#include "containers/vector.h"
+#include "gtest/gtest.h"
+
+namespace howling {
+namespace {
+
+TEST(VisibleWidth, CountsPlainCharacters) {
+  EXPECT_EQ(visible_width(""), 0);
+  EXPECT_EQ(visible_width("Sales: 12"), 9);
+}
+
+TEST(VisibleWidth, SkipsColorEscapes) {
+  EXPECT_EQ(visible_width(colorize("123.45", color::GREEN)), 6);
+  std::string digits =
+      colorize("1", color::RED) + colorize("2", color::BLUE);
+  EXPECT_EQ(visible_width("$" + digits), 3);
+}
+
+TEST(VisibleWidth, CountsEachCodePointOnce) {
+  EXPECT_EQ(visible_width("Mean $Δ"), 7);
+  EXPECT_EQ(visible_width("€→€"), 3);
+}
+
+TEST(PrintColumns, PadsEachColumnToItsWidestLine) {
+  vector<std::string> blocks{"a\nlonger", "b\nc"};
+
+  EXPECT_EQ(print_columns(blocks), "a         b\nlonger    c");
+}
+
+TEST(PrintColumns, PadsPastMissingLines) {
+  vector<std::string> blocks{"a\nbb\nccc", "d", "e\nf"};
+
+  EXPECT_EQ(
+      print_columns(blocks),
+      "a      d    e\n"
+      "bb          f\n"
+      "ccc");
+}
+
+TEST(PrintColumns, AlignsColoredAndUnicodeText) {
+  std::string green = colorize("+1.00", color::GREEN);
+  vector<std::string> blocks{green + "\nΔ", "x\ny"};
+
+  EXPECT_EQ(print_columns(blocks), green + "    x\nΔ        y");
+}
+
+TEST(PrintColumns, SingleBlockIsUnchanged) {
+  vector<std::string> blocks{"one\ntwo"};
+
+  EXPECT_EQ(print_columns(blocks), "one\ntwo");
+}
+
+TEST(PrintColumns, NoBlocksIsEmpty) {
+  EXPECT_EQ(print_columns({}), "");
+}
+
+} // namespace
+} // namespace howling
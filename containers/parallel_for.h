@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace howling {
+namespace internal {
+
+// The indices [next, end) not yet taken from one worker's share.
+struct task_range {
+  std::mutex mutex;
+  std::size_t next = 0;
+  std::size_t end = 0;
+};
+
+} // namespace internal
+
+/**
+ * @brief A fixed set of threads, including the calling one, which run batches
+ * of indexed tasks with work stealing.
+ *
+ * Each thread starts a batch with an even contiguous share of the indices. A
+ * thread that runs out of work steals the back half of the largest share still
+ * remaining, so uneven task costs still keep every thread busy. Keeping the
+ * threads between batches makes small, frequent batches affordable.
+ *
+ * Batches must be run from one thread at a time.
+ */
+class parallel_pool {
+public:
+  /** @param threads Number of threads to run tasks on, at least 1. */
+  explicit parallel_pool(std::size_t threads)
+      : _ranges(std::max<std::size_t>(threads, 1)) {
+    _workers.reserve(_ranges.size() - 1);
+    for (std::size_t i = 1; i < _ranges.size(); ++i) {
+      _workers.emplace_back([this, i](std::stop_token stop) {
+        _serve(stop, _ranges[i]);
+      });
+    }
+  }
+
+  parallel_pool(const parallel_pool&) = delete;
+  parallel_pool& operator=(const parallel_pool&) = delete;
+
+  std::size_t size() const { return _ranges.size(); }
+
+  /**
+   * @brief Calls `task(i)` for every `i` in [0, count) and returns once every
+   * call has finished.
+   *
+   * If a task throws, no further tasks are started and the first exception is
+   * rethrown.
+   */
+  void
+  for_each(std::size_t count, const std::function<void(std::size_t)>& task) {
+    if (count == 0) return;
+    if (_ranges.size() == 1 || count == 1) {
+      for (std::size_t i = 0; i < count; ++i) task(i);
+      return;
+    }
+    {
+      std::lock_guard lock{_mutex};
+      for (std::size_t i = 0; i < _ranges.size(); ++i) {
+        std::lock_guard range_lock{_ranges[i].mutex};
+        _ranges[i].next = count * i / _ranges.size();
+        _ranges[i].end = count * (i + 1) / _ranges.size();
+      }
+      _task = &task;
+      _error = nullptr;
+      _failed = false;
+      _running = _workers.size();
+      ++_batch;
+    }
+    _batch_started.notify_all();
+
+    _work(_ranges[0]);
+    std::unique_lock lock{_mutex};
+    _batch_finished.wait(lock, [&]() { return _running == 0; });
+    _task = nullptr;
+    if (_error) std::rethrow_exception(std::exchange(_error, nullptr));
+  }
+
+private:
+  void _serve(std::stop_token stop, internal::task_range& own) {
+    uint64_t seen = 0;
+    while (true) {
+      {
+        std::unique_lock lock{_mutex};
+        if (!_batch_started.wait(
+                lock, stop, [&]() { return _batch != seen; })) {
+          return;
+        }
+        seen = _batch;
+      }
+      _work(own);
+      {
+        std::lock_guard lock{_mutex};
+        --_running;
+      }
+      _batch_finished.notify_one();
+    }
+  }
+
+  void _work(internal::task_range& own) {
+    std::size_t index;
+    while (!_failed && (_take_own(own, index) || _steal(own, index))) {
+      try {
+        (*_task)(index);
+      } catch (...) {
+        std::lock_guard lock{_mutex};
+        if (!_error) _error = std::current_exception();
+        _failed = true;
+      }
+    }
+  }
+
+  bool _take_own(internal::task_range& own, std::size_t& index) {
+    std::lock_guard lock{own.mutex};
+    if (own.next == own.end) return false;
+    index = own.next++;
+    return true;
+  }
+
+  bool _steal(internal::task_range& own, std::size_t& index) {
+    while (true) {
+      internal::task_range* victim = nullptr;
+      std::size_t most = 0;
+      for (internal::task_range& range : _ranges) {
+        if (&range == &own) continue;
+        std::lock_guard lock{range.mutex};
+        if (range.end - range.next > most) {
+          most = range.end - range.next;
+          victim = &range;
+        }
+      }
+      if (!victim) return false;
+
+      std::scoped_lock lock{victim->mutex, own.mutex};
+      std::size_t remaining = victim->end - victim->next;
+      // Taken by its owner or another thief since it was chosen.
+      if (remaining == 0) continue;
+      std::size_t stolen = (remaining + 1) / 2;
+      own.end = victim->end;
+      victim->end -= stolen;
+      own.next = victim->end;
+      index = own.next++;
+      return true;
+    }
+  }
+
+  std::vector<internal::task_range> _ranges;
+
+  std::mutex _mutex;
+  std::condition_variable_any _batch_started;
+  std::condition_variable _batch_finished;
+  uint64_t _batch = 0;
+  std::size_t _running = 0;
+  const std::function<void(std::size_t)>* _task = nullptr;
+  std::atomic_bool _failed = false;
+  std::exception_ptr _error;
+
+  // Declared last so they are stopped and joined before anything they use is
+  // destroyed.
+  std::vector<std::jthread> _workers;
+};
+
+/**
+ * @brief Calls `task(i)` for every `i` in [0, count) across `threads` threads,
+ * including the calling one, as one batch of a `parallel_pool`.
+ *
+ * Returns once every task has finished. If a task throws, no further tasks are
+ * started and the first exception is rethrown.
+ */
+inline void parallel_for(
+    std::size_t count,
+    std::size_t threads,
+    const std::function<void(std::size_t)>& task) {
+  if (count == 0) return;
+  parallel_pool pool{std::clamp<std::size_t>(threads, 1, count)};
+  pool.for_each(count, task);
+}
+
+} // namespace howling
@@ -0,0 +1,94 @@
+#include "containers/parallel_for.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace howling {
+namespace {
+
+using namespace std::chrono_literals;
+
+TEST(ParallelFor, RunsEveryTaskOnce) {
+  std::vector<std::atomic_int> runs(1000);
+  parallel_for(runs.size(), 8, [&](std::size_t i) { ++runs[i]; });
+  for (const std::atomic_int& r : runs) EXPECT_EQ(r, 1);
+}
+
+TEST(ParallelFor, NothingToRun) {
+  bool ran = false;
+  parallel_for(0, 4, [&](std::size_t) { ran = true; });
+  EXPECT_FALSE(ran);
+}
+
+TEST(ParallelFor, StealsFromSlowThreads) {
+  // The first thread starts with tasks 0-3, which are slow, and the second
+  // with tasks 4-7, which are not. The second should take over some of the
+  // first's share once its own is done.
+  std::vector<std::thread::id> ran_on(8);
+  parallel_for(ran_on.size(), 2, [&](std::size_t i) {
+    if (i < 4) std::this_thread::sleep_for(20ms);
+    ran_on[i] = std::this_thread::get_id();
+  });
+  int stolen = 0;
+  for (std::size_t i = 1; i < 4; ++i) {
+    if (ran_on[i] != ran_on[0]) ++stolen;
+  }
+  EXPECT_GT(stolen, 0);
+}
+
+TEST(ParallelFor, RethrowsTaskErrors) {
+  std::atomic_bool failed = false;
+  std::atomic_int runs = 0;
+  std::atomic_int started_after_failure = 0;
+  EXPECT_THROW(
+      parallel_for(
+          100,
+          4,
+          [&](std::size_t i) {
+            if (failed) ++started_after_failure;
+            ++runs;
+            if (i == 0) {
+              failed = true;
+              throw std::runtime_error("Task failed.");
+            }
+            std::this_thread::sleep_for(1ms);
+          }),
+      std::runtime_error);
+  // Other threads only finish the task they were running when it failed,
+  // plus any they took before the pool saw the error.
+  EXPECT_LE(started_after_failure, 3);
+  EXPECT_LT(runs, 100);
+}
+
+TEST(ParallelPool, RunsManyBatches) {
+  parallel_pool pool{4};
+  std::vector<std::atomic_int> runs(10);
+  for (int batch = 0; batch < 1000; ++batch) {
+    pool.for_each(runs.size(), [&](std::size_t i) { ++runs[i]; });
+  }
+  for (const std::atomic_int& r : runs) EXPECT_EQ(r, 1000);
+}
+
+TEST(ParallelPool, RunsAfterTaskErrors) {
+  parallel_pool pool{4};
+  EXPECT_THROW(
+      pool.for_each(
+          100,
+          [](std::size_t i) {
+            if (i == 10) throw std::runtime_error("Task failed.");
+          }),
+      std::runtime_error);
+
+  std::atomic_int runs = 0;
+  pool.for_each(100, [&](std::size_t) { ++runs; });
+  EXPECT_EQ(runs, 100);
+}
+
+} // namespace
+} // namespace howling
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <generator>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+namespace howling {
+
+/**
+ * @brief Iterates `source` on a background thread, keeping up to `depth` of
+ * its values ready ahead of the consumer.
+ *
+ * Values are yielded in the order `source` produced them, so work done while
+ * producing each value overlaps with work done by the consumer on the values
+ * before it. An exception thrown by `source` is rethrown to the consumer after
+ * every value produced before it. If the consumer stops early, `source` is
+ * abandoned once it next produces a value.
+ *
+ * @param depth The most values to hold ahead of the consumer, at least 1.
+ */
+template <typename T>
+std::generator<T> prefetch(std::generator<T> source, std::size_t depth) {
+  depth = std::max<std::size_t>(depth, 1);
+  std::mutex mutex;
+  std::condition_variable_any changed;
+  std::deque<T> ready;
+  bool done = false;
+  std::exception_ptr error;
+
+  // Declared last so it is stopped and joined before anything it uses is
+  // destroyed.
+  std::jthread producer{[&](std::stop_token stop) {
+    try {
+      for (T value : source) {
+        std::unique_lock lock{mutex};
+        if (!changed.wait(
+                lock, stop, [&]() { return ready.size() < depth; })) {
+          return;
+        }
+        ready.push_back(std::move(value));
+        lock.unlock();
+        changed.notify_all();
+      }
+    } catch (...) {
+      std::lock_guard lock{mutex};
+      error = std::current_exception();
+    }
+    {
+      std::lock_guard lock{mutex};
+      done = true;
+    }
+    changed.notify_all();
+  }};
+
+  while (true) {
+    std::unique_lock lock{mutex};
+    changed.wait(lock, [&]() { return !ready.empty() || done; });
+    if (ready.empty()) break;
+    T value = std::move(ready.front());
+    ready.pop_front();
+    lock.unlock();
+    changed.notify_all();
+    co_yield std::move(value);
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+} // namespace howling
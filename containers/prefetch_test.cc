@@ -0,0 +1,72 @@
+#include "containers/prefetch.h"
+
+#include <atomic>
+#include <chrono>
+#include <generator>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace howling {
+namespace {
+
+using namespace std::chrono_literals;
+using ::testing::ElementsAre;
+
+std::generator<int> count_to(int last, std::atomic_int& produced) {
+  for (int i = 1; i <= last; ++i) {
+    ++produced;
+    co_yield i;
+  }
+}
+
+std::generator<int> fail_after(int last) {
+  for (int i = 1; i <= last; ++i) co_yield i;
+  throw std::runtime_error("Source failed.");
+}
+
+TEST(Prefetch, YieldsInOrder) {
+  std::atomic_int produced = 0;
+  std::vector<int> values;
+  for (int i : prefetch(count_to(1000, produced), 3)) values.push_back(i);
+
+  ASSERT_EQ(values.size(), 1000);
+  for (int i = 0; i < 1000; ++i) EXPECT_EQ(values[i], i + 1);
+}
+
+TEST(Prefetch, ProducesAheadUpToDepth) {
+  std::atomic_int produced = 0;
+  std::generator<int> values = prefetch(count_to(10, produced), 2);
+  auto itr = values.begin();
+  EXPECT_EQ(*itr, 1);
+
+  // One value is with the consumer, two are ready, and the producer holds a
+  // third while it waits for space.
+  while (produced < 4) std::this_thread::yield();
+  std::this_thread::sleep_for(10ms);
+  EXPECT_EQ(produced, 4);
+}
+
+TEST(Prefetch, RethrowsAfterEarlierValues) {
+  std::vector<int> values;
+  EXPECT_THROW(
+      {
+        for (int i : prefetch(fail_after(3), 1)) values.push_back(i);
+      },
+      std::runtime_error);
+  EXPECT_THAT(values, ElementsAre(1, 2, 3));
+}
+
+TEST(Prefetch, StopsEarly) {
+  std::atomic_int produced = 0;
+  for (int i : prefetch(count_to(1'000'000, produced), 2)) {
+    if (i == 5) break;
+  }
+  EXPECT_LT(produced, 10);
+}
+
+} // namespace
+} // namespace howling
@@ -11,14 +11,18 @@
 ABSL_FLAG(
     int,
     fast_exponential_average_period,
-    12,
+    howling::aggregation_options{}.fast_exponential_average_period,
     "Period for the fast moving average.");
 ABSL_FLAG(
     int,
     slow_exponential_average_period,
-    26,
+    howling::aggregation_options{}.slow_exponential_average_period,
     "Period for the slow moving average.");
-ABSL_FLAG(int, macd_signal_line, 9, "Period for the MACD signal line.");
+ABSL_FLAG(
+    int,
+    macd_signal_line,
+    howling::aggregation_options{}.macd_signal_line,
+    "Period for the MACD signal line.");
 
 namespace howling {
 namespace {
@@ -56,21 +60,20 @@ exponential_moving_average(double price, double previous_ema, int period) {
   return (price * k) + (previous_ema * (1.0 - k));
 }
 
-void calculate_macd(window& w, const window* previous) {
+void calculate_macd(
+    window& w, const window* previous, const aggregation_options& options) {
   if (previous) {
     w.fast_exponential_average = exponential_moving_average(
         w.candle.close(),
         previous->fast_exponential_average,
-        absl::GetFlag(FLAGS_fast_exponential_average_period));
+        options.fast_exponential_average_period);
     w.slow_exponential_average = exponential_moving_average(
         w.candle.close(),
         previous->slow_exponential_average,
-        absl::GetFlag(FLAGS_slow_exponential_average_period));
+        options.slow_exponential_average_period);
     w.macd_fast_line = w.fast_exponential_average - w.slow_exponential_average;
     w.macd_signal_line = exponential_moving_average(
-        w.macd_fast_line,
-        previous->macd_signal_line,
-        absl::GetFlag(FLAGS_macd_signal_line));
+        w.macd_fast_line, previous->macd_signal_line, options.macd_signal_line);
   } else {
     w.fast_exponential_average = w.moving_average;
     w.slow_exponential_average = w.moving_average;
@@ -79,7 +82,10 @@ void calculate_macd(window& w, const window* previous) {
   }
 }
 
-window to_window(const Candle& candle, const window* previous) {
+window to_window(
+    const Candle& candle,
+    const window* previous,
+    const aggregation_options& options) {
   double body_high = std::max(candle.open(), candle.close());
   double body_low = std::min(candle.open(), candle.close());
   window w{
@@ -102,7 +108,7 @@ window to_window(const Candle& candle, const window* previous) {
   w.total_wick_length = w.upper_wick_length + w.lower_wick_length;
   w.wick_body_ratio = w.total_wick_length / w.price_delta;
 
-  calculate_macd(w, previous);
+  calculate_macd(w, previous, options);
 
   return w;
 }
@@ -115,7 +121,8 @@ void add_next_window(window& a, const window& b) {
   a.candle.set_volume(a.candle.volume() + b.candle.volume());
   // TODO: Add b.duration to a.duration
 
-  window combined = to_window(a.candle, nullptr);
+  // Without a previous window, no options are needed.
+  window combined = to_window(a.candle, nullptr, {});
   a.green_body = combined.green_body;
   a.body_high = combined.body_high;
   a.body_low = combined.body_low;
@@ -130,7 +137,9 @@ void add_next_window(window& a, const window& b) {
 }
 
 window do_aggregate(
-    std::span<const window> one_minute_windows, const window* previous) {
+    std::span<const window> one_minute_windows,
+    const window* previous,
+    const aggregation_options& options) {
   window w = blank_window();
   for (const window& new_window : one_minute_windows) {
     add_next_window(w, new_window);
@@ -145,25 +154,40 @@ window do_aggregate(
   w.upper_bollinger_band = w.moving_average + (2.0 * w.stddev);
   w.lower_bollinger_band = w.moving_average - (2.0 * w.stddev);
 
-  calculate_macd(w, previous);
+  calculate_macd(w, previous, options);
 
   return w;
 }
 
 } // namespace
 
-aggregations aggregate(const vector<Candle>& one_minute_candles) {
-  aggregations aggr;
+aggregation_options aggregation_options_from_flags() {
+  return {
+      .fast_exponential_average_period =
+          absl::GetFlag(FLAGS_fast_exponential_average_period),
+      .slow_exponential_average_period =
+          absl::GetFlag(FLAGS_slow_exponential_average_period),
+      .macd_signal_line = absl::GetFlag(FLAGS_macd_signal_line)};
+}
+
+aggregations aggregate(
+    const vector<Candle>& one_minute_candles,
+    const aggregation_options& options) {
+  aggregations aggr{.options = options};
   for (const Candle& candle : one_minute_candles) {
     add_next_minute(aggr, candle);
   }
   return aggr;
 }
 
+aggregations aggregate(const vector<Candle>& one_minute_candles) {
+  return aggregate(one_minute_candles, aggregation_options_from_flags());
+}
+
 void add_next_minute(aggregations& aggr, const Candle& candle) {
   // TODO: Calculate sequence counters.
-  aggr.one_minute.push_back(
-      to_window(candle, maybe_get_previous(aggr.one_minute, 1)));
+  aggr.one_minute.push_back(to_window(
+      candle, maybe_get_previous(aggr.one_minute, 1), aggr.options));
 
   // For multi-minute aggregations, we use an offset equal to the window size
   // (e.g., 5 or 20) when retrieving the previous window for EMA/MACD
@@ -171,9 +195,13 @@ void add_next_minute(aggregations& aggr, const Candle& candle) {
   // "full" window of data, preventing the same minutes from being counted
   // multiple times in the exponential moving average sequence.
   aggr.five_minute.push_back(do_aggregate(
-      aggr.one_minute.last_n(5), maybe_get_previous(aggr.five_minute, 5)));
+      aggr.one_minute.last_n(5),
+      maybe_get_previous(aggr.five_minute, 5),
+      aggr.options));
   aggr.twenty_minute.push_back(do_aggregate(
-      aggr.one_minute.last_n(20), maybe_get_previous(aggr.twenty_minute, 20)));
+      aggr.one_minute.last_n(20),
+      maybe_get_previous(aggr.twenty_minute, 20),
+      aggr.options));
 }
 
 } // namespace howling
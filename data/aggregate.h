@@ -36,17 +36,38 @@ struct window {
   int countdown_counter;
 };
 
+/**
+ * Periods of the moving averages calculated for each window.
+ */
+struct aggregation_options {
+  int fast_exponential_average_period = 12;
+  int slow_exponential_average_period = 26;
+  int macd_signal_line = 9;
+};
+
+/**
+ * Options set by the --fast_exponential_average_period,
+ * --slow_exponential_average_period and --macd_signal_line flags.
+ */
+aggregation_options aggregation_options_from_flags();
+
 /**
  * Moving data aggregations over different window sizes.
  *
  * All lists of aggregations step forward by 1 minute for each contained window.
+ * The options default to the standard periods rather than the flags, so
+ * callers which honor the flags pass `aggregation_options_from_flags()`.
  */
 struct aggregations {
+  aggregation_options options;
   vector<window> one_minute;
   vector<window> five_minute;
   vector<window> twenty_minute;
 };
 
+aggregations aggregate(
+    const vector<Candle>& one_minute_candles,
+    const aggregation_options& options);
 aggregations aggregate(const vector<Candle>& one_minute_candles);
 
 void add_next_minute(aggregations& aggr, const Candle& candle);
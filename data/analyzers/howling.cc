@@ -54,8 +54,10 @@ decision get_top_decision(const circular_buffer<decision>& decisions) {
 
 } // namespace
 
-howling_analyzer::howling_analyzer()
-    : _macd1(&aggregations::one_minute), _macd5(&aggregations::five_minute),
+howling_analyzer::howling_analyzer(options opts)
+    : _market_hours(opts.market_hours),
+      _macd1(&aggregations::one_minute, opts.macd),
+      _macd5(&aggregations::five_minute, opts.macd), _profit(opts.profit),
       _macd1_decisions{5}, _macd5_decisions{5} {}
 
 decision
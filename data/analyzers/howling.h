@@ -16,7 +16,13 @@ namespace howling {
  */
 class howling_analyzer : public analyzer {
 public:
-  howling_analyzer();
+  struct options {
+    market_hours_analyzer::options market_hours;
+    macd_crossover_analyzer::options macd;
+    profit_analyzer::options profit;
+  };
+
+  explicit howling_analyzer(options opts);
 
   decision analyze(stock::Symbol symbol, const trading_state& data) override;
 
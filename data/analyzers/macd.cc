@@ -2,7 +2,6 @@
 
 #include <algorithm>
 
-#include "absl/flags/flag.h"
 #include "absl/log/log.h"
 #include "containers/vector.h"
 #include "data/aggregate.h"
@@ -10,12 +9,6 @@
 #include "data/stock.pb.h"
 #include "trading/trading_state.h"
 
-ABSL_FLAG(
-    double,
-    macd_crossover_scaler,
-    5.0, // 5x scaler means 0.20 shift is 1.0 confidence.
-    "Multiplier on crossover slope to calculate confidence.");
-
 namespace howling {
 
 decision macd_crossover_analyzer::analyze(
@@ -43,8 +36,8 @@ decision macd_crossover_analyzer::analyze(
     //           << delta_slope;
     return {
         .act = can_sell(symbol, data) ? action::SELL : action::HOLD,
-        .confidence = std::min(
-            1.0, -delta_slope * absl::GetFlag(FLAGS_macd_crossover_scaler))};
+        .confidence =
+            std::min(1.0, -delta_slope * _options.crossover_scaler)};
   }
   // Cross over.
   if (current_delta > 0.0 && previous_delta <= 0.0) {
@@ -55,8 +48,7 @@ decision macd_crossover_analyzer::analyze(
     //           << delta_slope;
     return {
         .act = can_buy(symbol, data) ? action::BUY : action::HOLD,
-        .confidence = std::min(
-            1.0, delta_slope * absl::GetFlag(FLAGS_macd_crossover_scaler))};
+        .confidence = std::min(1.0, delta_slope * _options.crossover_scaler)};
   }
   // Building upward momentum.
   if (current_delta > 0.0 && previous_delta > 0.0 && delta_slope > 0.0) {
@@ -67,7 +59,7 @@ decision macd_crossover_analyzer::analyze(
     //           << delta_slope;
     return {
         .act = action::HOLD,
-        .confidence = delta_slope * absl::GetFlag(FLAGS_macd_crossover_scaler)};
+        .confidence = delta_slope * _options.crossover_scaler};
   }
   // Not enough signal to advise.
   return NO_ACTION;
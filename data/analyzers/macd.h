@@ -12,13 +12,20 @@ namespace howling {
  */
 class macd_crossover_analyzer : public analyzer {
 public:
-  macd_crossover_analyzer(vector<window> aggregations::* period)
-      : _period{period} {}
+  struct options {
+    // Multiplier on crossover slope to calculate confidence. 5x means a 0.20
+    // shift is 1.0 confidence.
+    double crossover_scaler = 5.0;
+  };
+
+  macd_crossover_analyzer(vector<window> aggregations::* period, options opts)
+      : _period{period}, _options{opts} {}
 
   decision analyze(stock::Symbol symbol, const trading_state& data) override;
 
 private:
   vector<window> aggregations::* _period;
+  options _options;
 };
 
 } // namespace howling
@@ -2,13 +2,10 @@
 
 #include <algorithm>
 
-#include "absl/flags/flag.h"
 #include "data/analyzer.h"
 #include "data/stock.pb.h"
 #include "trading/trading_state.h"
 
-ABSL_FLAG(int, market_hours_exit, 14, "Hour of day to call it quits and dump.");
-
 namespace howling {
 
 constexpr double EJECT_TIME = 15.5; // 3:30.
@@ -24,14 +21,14 @@ decision market_hours_analyzer::analyze(
   }
 
   // No influence during business hours.
-  if (hour < absl::GetFlag(FLAGS_market_hours_exit)) {
+  if (hour < _options.exit_hour) {
     return {.act = action::NO_ACTION, .confidence = 0.0};
   }
 
   // Nearing market close. Decide how urgently shares should be sold.
-  double exit_window = EJECT_TIME - absl::GetFlag(FLAGS_market_hours_exit);
-  double time_since_exit = static_cast<double>(hour) + (minute / 60.0) -
-      absl::GetFlag(FLAGS_market_hours_exit);
+  double exit_window = EJECT_TIME - _options.exit_hour;
+  double time_since_exit =
+      static_cast<double>(hour) + (minute / 60.0) - _options.exit_hour;
   double confidence = std::min(1.0, time_since_exit / exit_window);
 
   // If we can sell shares, then sell. Otherwise, hold off on doing anything.
@@ -14,7 +14,17 @@ namespace howling {
  */
 class market_hours_analyzer : public analyzer {
 public:
+  struct options {
+    // Hour of day to call it quits and dump.
+    int exit_hour = 14;
+  };
+
+  explicit market_hours_analyzer(options opts) : _options{opts} {}
+
   decision analyze(stock::Symbol symbol, const trading_state& data) override;
+
+private:
+  options _options;
 };
 
 } // namespace howling
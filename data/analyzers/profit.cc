@@ -2,21 +2,17 @@
 
 #include <algorithm>
 
-#include "absl/flags/flag.h"
 #include "data/analyzer.h"
 #include "data/stock.pb.h"
 #include "trading/pricing.h"
 #include "trading/trading_state.h"
 
-ABSL_FLAG(double, profit_minimum, 0.1, "Minimum profit potential to look for.");
-ABSL_FLAG(double, profit_confidence_scaler, 1.0, "");
-
 namespace howling {
 
 decision
 profit_analyzer::analyze(stock::Symbol symbol, const trading_state& data) {
   double current = sale_price(symbol, data);
-  double profit_minimum = absl::GetFlag(FLAGS_profit_minimum);
+  double profit_minimum = _options.minimum;
   auto itr = data.positions.find(symbol);
   if (itr == data.positions.end()) return NO_ACTION;
 
@@ -35,7 +31,7 @@ profit_analyzer::analyze(stock::Symbol symbol, const trading_state& data) {
       .confidence = std::min(
           1.0,
           (((profit - profit_minimum) / profit_minimum) + 0.01) *
-              absl::GetFlag(FLAGS_profit_confidence_scaler))};
+              _options.confidence_scaler)};
 }
 
 } // namespace howling
@@ -12,7 +12,18 @@ namespace howling {
  */
 class profit_analyzer : public analyzer {
 public:
+  struct options {
+    // Minimum profit potential to look for.
+    double minimum = 0.1;
+    double confidence_scaler = 1.0;
+  };
+
+  explicit profit_analyzer(options opts) : _options{opts} {}
+
   decision analyze(stock::Symbol symbol, const trading_state& data) override;
+
+private:
+  options _options;
 };
 
 } // namespace howling
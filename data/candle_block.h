@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace howling {
+
+/**
+ * @brief A block of consecutive candles stored column by column.
+ *
+ * Row `i` of the block is made up of element `i` of every column. Reusing a
+ * block across reads keeps its allocations.
+ */
+struct candle_block {
+  std::vector<double> open;
+  std::vector<double> close;
+  std::vector<double> high;
+  std::vector<double> low;
+  std::vector<int64_t> volume;
+  std::vector<std::chrono::system_clock::time_point> opened_at;
+  std::vector<std::chrono::microseconds> duration;
+
+  std::size_t size() const { return open.size(); }
+  bool empty() const { return open.empty(); }
+
+  void clear() {
+    open.clear();
+    close.clear();
+    high.clear();
+    low.clear();
+    volume.clear();
+    opened_at.clear();
+    duration.clear();
+  }
+
+  void reserve(std::size_t rows) {
+    open.reserve(rows);
+    close.reserve(rows);
+    high.reserve(rows);
+    low.reserve(rows);
+    volume.reserve(rows);
+    opened_at.reserve(rows);
+    duration.reserve(rows);
+  }
+};
+
+} // namespace howling
@@ -0,0 +1,236 @@
+#include "data/history_file.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "data/candle.pb.h"
+#include "data/stock.pb.h"
+#include "files/files.h"
+#include "time/conversion.h"
+
+namespace howling {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+using ::std::chrono::duration_cast;
+using ::std::chrono::microseconds;
+using ::std::chrono::system_clock;
+
+// Columns are used in place, so the file's byte order must be the machine's.
+static_assert(std::endian::native == std::endian::little);
+
+constexpr char MAGIC[8] = {'H', 'O', 'W', 'L', 'H', 'I', 'S', 'T'};
+constexpr uint32_t FORMAT_VERSION = 1;
+constexpr std::size_t COLUMN_COUNT = 7;
+
+struct history_header {
+  char magic[8];
+  uint32_t version;
+  int32_t symbol;
+  int64_t started_at_us;
+  int64_t duration_us;
+  uint64_t candle_count;
+};
+static_assert(sizeof(history_header) == 40);
+
+int64_t to_us(system_clock::time_point time) {
+  return duration_cast<microseconds>(time.time_since_epoch()).count();
+}
+
+template <typename T>
+void append_column(
+    std::string& out,
+    const stock::History& history,
+    T (*field)(const Candle&)) {
+  for (const Candle& candle : history.candles()) {
+    T value = field(candle);
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+}
+
+const history_header& header_of(const std::byte* data) {
+  if (!data) throw std::logic_error("History file is not mapped.");
+  return *reinterpret_cast<const history_header*>(data);
+}
+
+} // namespace
+
+std::string encode_history(const stock::History& history) {
+  history_header header{
+      .version = FORMAT_VERSION,
+      .symbol = history.symbol(),
+      .started_at_us = to_us(to_std_chrono(history.started_at())),
+      .duration_us = to_std_chrono(history.duration()).count(),
+      .candle_count = static_cast<uint64_t>(history.candles_size())};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+
+  std::string out;
+  out.reserve(sizeof(header) + history.candles_size() * COLUMN_COUNT * 8);
+  out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  append_column<double>(out, history, [](const Candle& c) { return c.open(); });
+  append_column<double>(
+      out, history, [](const Candle& c) { return c.close(); });
+  append_column<double>(out, history, [](const Candle& c) { return c.high(); });
+  append_column<double>(out, history, [](const Candle& c) { return c.low(); });
+  append_column<int64_t>(
+      out, history, [](const Candle& c) { return c.volume(); });
+  append_column<int64_t>(out, history, [](const Candle& c) {
+    return to_us(to_std_chrono(c.opened_at()));
+  });
+  append_column<int64_t>(out, history, [](const Candle& c) {
+    return static_cast<int64_t>(to_std_chrono(c.duration()).count());
+  });
+  return out;
+}
+
+void write_history_file(const fs::path& path, const stock::History& history) {
+  files::write_file(path, encode_history(history));
+}
+
+// MARK: mapped_history
+
+mapped_history::mapped_history(const fs::path& path) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error(
+        absl::StrCat(
+            "Failed to open ", path.string(), ": ", std::strerror(errno)));
+  }
+  struct stat status;
+  if (::fstat(fd, &status) != 0) {
+    int error = errno;
+    ::close(fd);
+    throw std::runtime_error(
+        absl::StrCat(
+            "Failed to stat ", path.string(), ": ", std::strerror(error)));
+  }
+  _length = static_cast<std::size_t>(status.st_size);
+  if (_length < sizeof(history_header)) {
+    ::close(fd);
+    throw std::runtime_error(
+        absl::StrCat(path.string(), " is too short to be a history file."));
+  }
+  void* mapped = ::mmap(nullptr, _length, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file open.
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    throw std::runtime_error(
+        absl::StrCat(
+            "Failed to map ", path.string(), ": ", std::strerror(errno)));
+  }
+  _data = static_cast<const std::byte*>(mapped);
+
+  const history_header& header = header_of(_data);
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version != FORMAT_VERSION) {
+    _unmap();
+    throw std::runtime_error(
+        absl::StrCat(path.string(), " is not a known history file format."));
+  }
+  // Checked by division so a corrupt count cannot overflow.
+  std::size_t column_bytes = _length - sizeof(history_header);
+  if (column_bytes % (COLUMN_COUNT * 8) != 0 ||
+      column_bytes / (COLUMN_COUNT * 8) != header.candle_count) {
+    _unmap();
+    throw std::runtime_error(
+        absl::StrCat(path.string(), " does not match its candle count."));
+  }
+  _size = static_cast<std::size_t>(header.candle_count);
+}
+
+mapped_history::~mapped_history() {
+  _unmap();
+}
+
+mapped_history::mapped_history(mapped_history&& other) noexcept
+    : _data{std::exchange(other._data, nullptr)},
+      _length{std::exchange(other._length, 0)},
+      _size{std::exchange(other._size, 0)} {}
+
+mapped_history& mapped_history::operator=(mapped_history&& other) noexcept {
+  if (this != &other) {
+    _unmap();
+    _data = std::exchange(other._data, nullptr);
+    _length = std::exchange(other._length, 0);
+    _size = std::exchange(other._size, 0);
+  }
+  return *this;
+}
+
+stock::Symbol mapped_history::symbol() const {
+  return static_cast<stock::Symbol>(header_of(_data).symbol);
+}
+
+system_clock::time_point mapped_history::started_at() const {
+  return system_clock::time_point{
+      microseconds{header_of(_data).started_at_us}};
+}
+
+microseconds mapped_history::duration() const {
+  return microseconds{header_of(_data).duration_us};
+}
+
+Candle mapped_history::candle(std::size_t i) const {
+  Candle candle;
+  candle.set_open(open()[i]);
+  candle.set_close(close()[i]);
+  candle.set_high(high()[i]);
+  candle.set_low(low()[i]);
+  candle.set_volume(volume()[i]);
+  *candle.mutable_opened_at() =
+      to_proto(system_clock::time_point{microseconds{opened_at_us()[i]}});
+  *candle.mutable_duration() = to_proto(microseconds{duration_us()[i]});
+  return candle;
+}
+
+stock::History mapped_history::to_history() const {
+  stock::History history;
+  history.set_symbol(symbol());
+  *history.mutable_started_at() = to_proto(started_at());
+  *history.mutable_duration() = to_proto(duration());
+  history.mutable_candles()->Reserve(static_cast<int>(_size));
+  for (std::size_t i = 0; i < _size; ++i) {
+    *history.add_candles() = candle(i);
+  }
+  return history;
+}
+
+const std::byte* mapped_history::_column(std::size_t index) const {
+  return _data + sizeof(history_header) + index * _size * 8;
+}
+
+std::span<const double> mapped_history::_doubles(std::size_t index) const {
+  if (!_data) return {};
+  return {reinterpret_cast<const double*>(_column(index)), _size};
+}
+
+std::span<const int64_t> mapped_history::_integers(std::size_t index) const {
+  if (!_data) return {};
+  return {reinterpret_cast<const int64_t*>(_column(index)), _size};
+}
+
+void mapped_history::_unmap() {
+  if (_data) {
+    ::munmap(const_cast<std::byte*>(_data), _length);
+    _data = nullptr;
+  }
+}
+
+} // namespace howling
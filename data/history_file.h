@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+
+#include "data/candle.pb.h"
+#include "data/stock.pb.h"
+
+namespace howling {
+
+/**
+ * @brief Packs a history into the binary history file layout.
+ *
+ * The file is a fixed 40 byte header followed by one packed little-endian
+ * column per candle field: `open`, `close`, `high` and `low` as doubles, then
+ * `volume`, `opened_at` and `duration` as 64-bit integers, the times in
+ * microseconds since the Unix epoch. Every column holds one value per candle,
+ * so each starts at a fixed offset and can be used where it lies.
+ */
+std::string encode_history(const stock::History& history);
+
+/** @brief Writes `history` to `path` in the binary history file layout. */
+void write_history_file(
+    const std::filesystem::path& path, const stock::History& history);
+
+/**
+ * @brief A binary history file mapped into memory.
+ *
+ * The columns are views of the mapped file, so nothing is parsed or copied
+ * when opening it, and they stay valid until the file is unmapped on
+ * destruction.
+ *
+ * A moved-from history has no columns, and reading its header fields throws
+ * std::logic_error.
+ */
+class mapped_history {
+public:
+  /**
+   * @brief Maps the file at `path`.
+   *
+   * @throws std::runtime_error if the file cannot be mapped or is not a
+   * binary history file.
+   */
+  explicit mapped_history(const std::filesystem::path& path);
+  ~mapped_history();
+
+  mapped_history(mapped_history&& other) noexcept;
+  mapped_history& operator=(mapped_history&& other) noexcept;
+  mapped_history(const mapped_history&) = delete;
+  mapped_history& operator=(const mapped_history&) = delete;
+
+  stock::Symbol symbol() const;
+  std::chrono::system_clock::time_point started_at() const;
+  std::chrono::microseconds duration() const;
+  std::size_t size() const { return _size; }
+
+  std::span<const double> open() const { return _doubles(0); }
+  std::span<const double> close() const { return _doubles(1); }
+  std::span<const double> high() const { return _doubles(2); }
+  std::span<const double> low() const { return _doubles(3); }
+  std::span<const int64_t> volume() const { return _integers(4); }
+  std::span<const int64_t> opened_at_us() const { return _integers(5); }
+  std::span<const int64_t> duration_us() const { return _integers(6); }
+
+  /** @brief Builds the candle at row `i`. */
+  Candle candle(std::size_t i) const;
+
+  /** @brief Builds the whole history as a message. */
+  stock::History to_history() const;
+
+private:
+  const std::byte* _column(std::size_t index) const;
+  std::span<const double> _doubles(std::size_t index) const;
+  std::span<const int64_t> _integers(std::size_t index) const;
+  void _unmap();
+
+  const std::byte* _data = nullptr;
+  std::size_t _length = 0;
+  std::size_t _size = 0;
+};
+
+} // namespace howling
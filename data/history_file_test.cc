@@ -0,0 +1,145 @@
+#include "data/history_file.h"
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "data/candle.pb.h"
+#include "data/stock.pb.h"
+#include "files/files.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "time/conversion.h"
+
+namespace howling {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+using ::std::chrono::microseconds;
+using ::std::chrono::minutes;
+using ::std::chrono::sys_days;
+using ::std::chrono::system_clock;
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+constexpr sys_days DAY{std::chrono::year_month_day{
+    std::chrono::year{2025}, std::chrono::October, std::chrono::day{15}}};
+// Where the version and candle count lie within the header.
+constexpr std::size_t VERSION_OFFSET = 8;
+constexpr std::size_t CANDLE_COUNT_OFFSET = 32;
+
+stock::History make_history() {
+  stock::History history;
+  history.set_symbol(stock::NVDA);
+  *history.mutable_started_at() = to_proto(system_clock::time_point{DAY});
+  *history.mutable_duration() = to_proto(std::chrono::hours(24));
+  for (int i = 0; i < 3; ++i) {
+    Candle* candle = history.add_candles();
+    candle->set_open(180.25 + i);
+    candle->set_close(180.5 + i);
+    candle->set_high(181 + i);
+    candle->set_low(1.0 / 3 + i);
+    candle->set_volume(1000 * (i + 1));
+    *candle->mutable_opened_at() = to_proto(DAY + minutes(i));
+    *candle->mutable_duration() = to_proto(minutes(1));
+  }
+  return history;
+}
+
+class MappedHistoryTest : public testing::Test {
+protected:
+  void SetUp() override {
+    _path = fs::path{testing::TempDir()} / "history_file_test.hist";
+  }
+
+  void TearDown() override { fs::remove(_path); }
+
+  mapped_history map(const std::string& bytes) {
+    files::write_file(_path, bytes);
+    return mapped_history{_path};
+  }
+
+  fs::path _path;
+};
+
+TEST_F(MappedHistoryTest, RoundTripsHistory) {
+  stock::History history = make_history();
+
+  mapped_history mapped = map(encode_history(history));
+
+  EXPECT_EQ(mapped.symbol(), stock::NVDA);
+  EXPECT_EQ(mapped.started_at(), DAY);
+  EXPECT_EQ(mapped.duration(), std::chrono::hours(24));
+  EXPECT_EQ(mapped.size(), 3);
+  EXPECT_THAT(mapped.close(), ElementsAre(180.5, 181.5, 182.5));
+  EXPECT_THAT(mapped.volume(), ElementsAre(1000, 2000, 3000));
+  EXPECT_EQ(
+      mapped.opened_at_us()[1],
+      std::chrono::duration_cast<microseconds>(
+          (DAY + minutes(1)).time_since_epoch())
+          .count());
+  EXPECT_EQ(
+      mapped.to_history().SerializeAsString(), history.SerializeAsString());
+}
+
+TEST_F(MappedHistoryTest, RoundTripsEmptyHistory) {
+  stock::History history = make_history();
+  history.clear_candles();
+
+  mapped_history mapped = map(encode_history(history));
+
+  EXPECT_EQ(mapped.size(), 0);
+  EXPECT_THAT(mapped.open(), IsEmpty());
+  EXPECT_EQ(
+      mapped.to_history().SerializeAsString(), history.SerializeAsString());
+}
+
+TEST_F(MappedHistoryTest, RejectsBadMagic) {
+  std::string bytes = encode_history(make_history());
+  bytes[0] = 'X';
+
+  EXPECT_THROW(map(bytes), std::runtime_error);
+}
+
+TEST_F(MappedHistoryTest, RejectsUnknownVersion) {
+  std::string bytes = encode_history(make_history());
+  bytes[VERSION_OFFSET] = 2;
+
+  EXPECT_THROW(map(bytes), std::runtime_error);
+}
+
+TEST_F(MappedHistoryTest, RejectsLengthNotMatchingCandleCount) {
+  std::string bytes = encode_history(make_history());
+
+  EXPECT_THROW(map(bytes + std::string(8, '\0')), std::runtime_error);
+  EXPECT_THROW(map(bytes.substr(0, bytes.size() - 8)), std::runtime_error);
+  // A count which would overflow when multiplied out.
+  bytes[CANDLE_COUNT_OFFSET + 7] = '\x80';
+  EXPECT_THROW(map(bytes), std::runtime_error);
+}
+
+TEST_F(MappedHistoryTest, RejectsFileShorterThanHeader) {
+  EXPECT_THROW(
+      map(encode_history(make_history()).substr(0, 16)), std::runtime_error);
+}
+
+TEST_F(MappedHistoryTest, MovedFromHistoryIsEmpty) {
+  mapped_history mapped = map(encode_history(make_history()));
+
+  mapped_history moved = std::move(mapped);
+
+  EXPECT_EQ(moved.symbol(), stock::NVDA);
+  EXPECT_EQ(moved.size(), 3);
+  EXPECT_EQ(mapped.size(), 0);
+  EXPECT_THAT(mapped.open(), IsEmpty());
+  EXPECT_THROW(mapped.symbol(), std::logic_error);
+  EXPECT_THROW(mapped.started_at(), std::logic_error);
+  EXPECT_THROW(mapped.duration(), std::logic_error);
+}
+
+} // namespace
+} // namespace howling
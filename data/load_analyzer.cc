@@ -1,8 +1,13 @@
 #include "data/load_analyzer.h"
 
 #include <memory>
+#include <stdexcept>
+#include <string>
 #include <string_view>
 
+#include "absl/flags/flag.h"
+#include "absl/flags/marshalling.h"
+#include "absl/strings/str_cat.h"
 #include "data/aggregate.h"
 #include "data/analyzer.h"
 #include "data/analyzers/bollinger.h"
@@ -14,30 +19,107 @@
 #include "data/analyzers/zig_zag.h"
 #include "data/stock.pb.h"
 
+ABSL_FLAG(
+    double,
+    macd_crossover_scaler,
+    howling::macd_crossover_analyzer::options{}.crossover_scaler,
+    "Multiplier on crossover slope to calculate confidence.");
+ABSL_FLAG(
+    double,
+    profit_minimum,
+    howling::profit_analyzer::options{}.minimum,
+    "Minimum profit potential to look for.");
+ABSL_FLAG(
+    double,
+    profit_confidence_scaler,
+    howling::profit_analyzer::options{}.confidence_scaler,
+    "");
+ABSL_FLAG(
+    int,
+    market_hours_exit,
+    howling::market_hours_analyzer::options{}.exit_hour,
+    "Hour of day to call it quits and dump.");
+
 namespace howling {
+namespace {
 
-std::unique_ptr<analyzer>
-load_analyzer(std::string_view name, const stock::History& history) {
+template <typename T>
+void parse_option(std::string_view name, std::string_view value, T& option) {
+  std::string error;
+  if (!absl::ParseFlag(value, &option, &error)) {
+    throw std::runtime_error(
+        absl::StrCat("Invalid value for ", name, ": ", value, ". ", error));
+  }
+}
+
+} // namespace
+
+analyzer_options analyzer_options_from_flags() {
+  return {
+      .aggregation = aggregation_options_from_flags(),
+      .macd = {.crossover_scaler = absl::GetFlag(FLAGS_macd_crossover_scaler)},
+      .profit =
+          {.minimum = absl::GetFlag(FLAGS_profit_minimum),
+           .confidence_scaler = absl::GetFlag(FLAGS_profit_confidence_scaler)},
+      .market_hours = {.exit_hour = absl::GetFlag(FLAGS_market_hours_exit)}};
+}
+
+void set_analyzer_option(
+    analyzer_options& options, std::string_view name, std::string_view value) {
+  if (name == "fast_exponential_average_period") {
+    parse_option(
+        name, value, options.aggregation.fast_exponential_average_period);
+  } else if (name == "slow_exponential_average_period") {
+    parse_option(
+        name, value, options.aggregation.slow_exponential_average_period);
+  } else if (name == "macd_signal_line") {
+    parse_option(name, value, options.aggregation.macd_signal_line);
+  } else if (name == "macd_crossover_scaler") {
+    parse_option(name, value, options.macd.crossover_scaler);
+  } else if (name == "profit_minimum") {
+    parse_option(name, value, options.profit.minimum);
+  } else if (name == "profit_confidence_scaler") {
+    parse_option(name, value, options.profit.confidence_scaler);
+  } else if (name == "market_hours_exit") {
+    parse_option(name, value, options.market_hours.exit_hour);
+  } else {
+    throw std::runtime_error(absl::StrCat("Unknown analyzer option: ", name));
+  }
+}
+
+std::unique_ptr<analyzer> load_analyzer(
+    std::string_view name,
+    const stock::History& history,
+    const analyzer_options& options) {
   if (name.empty() || name == "noop") {
     return std::make_unique<noop_analyzer>();
   }
   if (name == "bollinger") return std::make_unique<bollinger_analyzer>();
-  if (name == "howling") return std::make_unique<howling_analyzer>();
+  if (name == "howling") {
+    return std::make_unique<howling_analyzer>(
+        howling_analyzer::options{
+            .market_hours = options.market_hours,
+            .macd = options.macd,
+            .profit = options.profit});
+  }
   if (name == "macd" || name == "macd1") {
-    return std::make_unique<macd_crossover_analyzer>(&aggregations::one_minute);
+    return std::make_unique<macd_crossover_analyzer>(
+        &aggregations::one_minute, options.macd);
   }
   if (name == "macd5") {
     return std::make_unique<macd_crossover_analyzer>(
-        &aggregations::five_minute);
+        &aggregations::five_minute, options.macd);
   }
   if (name == "macd20") {
     return std::make_unique<macd_crossover_analyzer>(
-        &aggregations::twenty_minute);
+        &aggregations::twenty_minute, options.macd);
   }
   if (name == "market_hours") {
-    return std::make_unique<market_hours_analyzer>();
+    return std::make_unique<market_hours_analyzer>(options.market_hours);
+  }
+  if (name == "profit") {
+    return std::make_unique<profit_analyzer>(options.profit);
   }
-  if (name == "profit") return std::make_unique<profit_analyzer>();
   if (name == "zig_zag" || name == "optimal") {
     if (history.candles().empty()) {
       throw std::runtime_error(
@@ -49,6 +131,11 @@ load_analyzer(std::string_view name, const stock::History& history) {
   throw std::runtime_error(absl::StrCat("Unknown analyzer: ", name));
 }
 
+std::unique_ptr<analyzer>
+load_analyzer(std::string_view name, const stock::History& history) {
+  return load_analyzer(name, history, analyzer_options_from_flags());
+}
+
 std::unique_ptr<analyzer> load_analyzer(std::string_view name) {
   return load_analyzer(name, stock::History::default_instance());
 }
@@ -3,11 +3,45 @@
 #include <memory>
 #include <string_view>
 
+#include "data/aggregate.h"
 #include "data/analyzer.h"
+#include "data/analyzers/macd.h"
+#include "data/analyzers/market_hours.h"
+#include "data/analyzers/profit.h"
 #include "data/stock.pb.h"
 
 namespace howling {
 
+/**
+ * Tunable parameters of the analyzers and of the aggregations they analyze.
+ */
+struct analyzer_options {
+  aggregation_options aggregation;
+  macd_crossover_analyzer::options macd;
+  profit_analyzer::options profit;
+  market_hours_analyzer::options market_hours;
+};
+
+/**
+ * Options set by the analyzer and aggregation flags, such as
+ * --macd_crossover_scaler and --fast_exponential_average_period.
+ */
+analyzer_options analyzer_options_from_flags();
+
+/**
+ * @brief Sets the option that the flag `name` would set to `value`.
+ *
+ * @throws std::runtime_error if `name` is not an analyzer or aggregation flag
+ * or `value` is not valid for it.
+ */
+void set_analyzer_option(
+    analyzer_options& options, std::string_view name, std::string_view value);
+
+std::unique_ptr<analyzer> load_analyzer(
+    std::string_view name,
+    const stock::History& history,
+    const analyzer_options& options);
+
 std::unique_ptr<analyzer>
 load_analyzer(std::string_view name, const stock::History& history);
 
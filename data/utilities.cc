@@ -64,6 +64,13 @@ fs::path get_history_file_path(stock::Symbol symbol, std::string_view date) {
   return path;
 }
 
+fs::path
+get_binary_history_file_path(stock::Symbol symbol, std::string_view date) {
+  fs::path path = HISTORY_DIR / stock::Symbol_Name(symbol) / date;
+  path += BINARY_HISTORY_EXTENSION;
+  return path;
+}
+
 stock::History read_history(const fs::path& path) {
   if (!fs::exists(path)) {
     throw std::runtime_error(absl::StrCat("No data found at ", path.string()));
@@ -23,8 +23,17 @@ std::string AbslUnparseFlag(const std::vector<Symbol>& symbols);
 
 namespace howling {
 
+/** @brief The extension of binary history files, see `history_file.h`. */
+inline constexpr std::string_view BINARY_HISTORY_EXTENSION = ".hist";
+
 std::filesystem::path
 get_history_file_path(stock::Symbol symbol, std::string_view date);
+/**
+ * @brief Returns the path of the binary history file converted from the
+ * textproto at `get_history_file_path`.
+ */
+std::filesystem::path
+get_binary_history_file_path(stock::Symbol symbol, std::string_view date);
 stock::History read_history(const std::filesystem::path& path);
 
 std::generator<stock::Symbol> list_stock_symbols();
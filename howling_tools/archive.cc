@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <format>
+#include <generator>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/log/log.h"
+#include "absl/time/time.h"
+#include "data/candle.pb.h"
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+#include "data/utilities.h"
+#include "environment/init.h"
+#include "services/database.h"
+#include "services/db/archive.h"
+#include "services/db/environment.h"
+#include "services/db/register.h"
+#include "services/registry/registry.h"
+#include "services/security/register.h"
+#include "time/conversion.h"
+
+ABSL_FLAG(
+    std::vector<howling::stock::Symbol>,
+    stocks,
+    {},
+    "Comma-separated list of stock symbols to archive.");
+ABSL_FLAG(
+    absl::Time,
+    start,
+    absl::UniversalEpoch(),
+    "Oldest data to archive. Default is the oldest available.");
+ABSL_FLAG(
+    absl::Time,
+    end,
+    absl::UniversalEpoch(),
+    "Newest data to archive, exclusive. Default and latest is the start of "
+    "today, UTC, since only closed days are archived.");
+ABSL_FLAG(
+    bool,
+    overwrite,
+    false,
+    "Archive days again even if they are already in the archive.");
+
+namespace howling {
+namespace {
+
+using ::std::chrono::sys_days;
+using ::std::chrono::system_clock;
+
+system_clock::time_point get_end() {
+  system_clock::time_point today =
+      std::chrono::floor<std::chrono::days>(system_clock::now());
+  if (absl::GetFlag(FLAGS_end) == absl::UniversalEpoch()) return today;
+  return std::min(today, to_std_chrono(absl::GetFlag(FLAGS_end)));
+}
+
+std::chrono::year_month_day utc_day(const Market& tick) {
+  return std::chrono::year_month_day{
+      std::chrono::floor<std::chrono::days>(to_std_chrono(tick.emitted_at()))};
+}
+
+/**
+ * Reads the symbol's candles and market ticks within `[from, to)`, grouped by
+ * UTC day. Days with either are included, so market ticks are kept on days
+ * without candles.
+ */
+std::generator<archive_day> read_days(
+    database& db,
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  std::generator<candle_day> candle_days =
+      db.read_candle_days(symbol, from, to);
+  std::generator<Market> ticks = db.read_market(symbol, from, to);
+  auto candle_it = candle_days.begin();
+  auto tick_it = ticks.begin();
+  while (candle_it != candle_days.end() || tick_it != ticks.end()) {
+    std::optional<std::chrono::year_month_day> candle_date;
+    if (candle_it != candle_days.end()) candle_date = (*candle_it).date;
+    std::optional<std::chrono::year_month_day> tick_date;
+    if (tick_it != ticks.end()) tick_date = utc_day(*tick_it);
+
+    archive_day day{.symbol = symbol};
+    if (!tick_date) {
+      day.date = *candle_date;
+    } else if (!candle_date) {
+      day.date = *tick_date;
+    } else {
+      day.date = std::min(*candle_date, *tick_date);
+    }
+    if (candle_date == day.date) {
+      day.candles = std::move((*candle_it).candles);
+      ++candle_it;
+    }
+    while (tick_it != ticks.end() && utc_day(*tick_it) == day.date) {
+      day.market.push_back(std::move(*tick_it));
+      ++tick_it;
+    }
+    co_yield std::move(day);
+  }
+}
+
+/** Writes each of the symbol's days with any data, returning how many. */
+std::size_t archive_symbol(
+    database& db, const market_archive& archive, stock::Symbol symbol) {
+  std::size_t archived = 0;
+  for (archive_day day : read_days(
+           db, symbol, to_std_chrono(absl::GetFlag(FLAGS_start)), get_end())) {
+    if (!absl::GetFlag(FLAGS_overwrite) && archive.contains(symbol, day.date)) {
+      continue;
+    }
+    archive.write(day);
+    ++archived;
+    LOG(INFO) << stock::Symbol_Name(symbol) << " "
+              << std::format("{:%F}", sys_days{day.date}) << ": archived "
+              << day.candles.size() << " candles and " << day.market.size()
+              << " market updates.";
+  }
+  return archived;
+}
+
+void run() {
+  std::vector<stock::Symbol> symbols = absl::GetFlag(FLAGS_stocks);
+  if (symbols.empty()) {
+    throw std::runtime_error("Must specify at least one stock in --stocks.");
+  }
+  std::string archive_dir = absl::GetFlag(FLAGS_db_archive_dir);
+  if (archive_dir.empty()) {
+    throw std::runtime_error("Must specify --db_archive_dir.");
+  }
+  market_archive archive{archive_dir};
+  // Days are exported from the database itself, never read back from the
+  // archive being written.
+  absl::SetFlag(&FLAGS_db_archive_dir, "");
+
+  security::register_security_client();
+  register_database_client();
+  database& db = registry::get_service<database>();
+
+  std::size_t archived = 0;
+  for (stock::Symbol symbol : symbols) {
+    archived += archive_symbol(db, archive, symbol);
+  }
+  std::cout << "Archived " << archived << " days to " << archive_dir << "."
+            << std::endl;
+}
+
+} // namespace
+} // namespace howling
+
+int main(int argc, char** argv) {
+  howling::init(argc, argv);
+
+  try {
+    howling::run();
+    return 0;
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  } catch (...) { std::cerr << "!!!! UNKNOWN ERROR THROWN !!!!" << std::endl; }
+  return 1;
+}
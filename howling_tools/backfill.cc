@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "api/alpaca.h"
+#include "api/schwab.h"
+#include "api/schwab/configuration.h"
+#include "containers/vector.h"
+#include "data/candle.pb.h"
+#include "data/stock.pb.h"
+#include "data/utilities.h"
+#include "environment/init.h"
+#include "services/database.h"
+#include "services/db/register.h"
+#include "services/registry/registry.h"
+#include "services/security/register.h"
+#include "strings/format.h"
+#include "time/conversion.h"
+
+ABSL_FLAG(
+    std::vector<howling::stock::Symbol>,
+    stocks,
+    {},
+    "Comma-separated list of stock symbols to backfill.");
+ABSL_FLAG(
+    absl::Time,
+    start,
+    absl::UniversalEpoch(),
+    "Oldest data to backfill. Required.");
+ABSL_FLAG(
+    absl::Time,
+    end,
+    absl::UniversalEpoch(),
+    "Newest data to backfill, exclusive. Default is now.");
+ABSL_FLAG(
+    std::string,
+    api,
+    "alpaca",
+    "The API to use for fetching stocks. Either 'alpaca' or 'schwab'");
+ABSL_FLAG(
+    absl::Duration,
+    chunk,
+    absl::Hours(24),
+    "Length of the window of history requested from the API at a time.");
+ABSL_FLAG(
+    int,
+    backfill_concurrency,
+    8,
+    "Maximum number of chunks fetched from the API at once.");
+
+namespace howling {
+namespace {
+
+using ::std::chrono::system_clock;
+
+struct backfill_chunk {
+  stock::Symbol symbol;
+  system_clock::time_point start;
+  system_clock::time_point end;
+};
+
+struct fetched_chunk {
+  backfill_chunk chunk;
+  vector<Candle> candles;
+};
+
+system_clock::time_point get_start() {
+  if (absl::GetFlag(FLAGS_start) == absl::UniversalEpoch()) {
+    throw std::runtime_error("Must specify --start.");
+  }
+  return to_std_chrono(absl::GetFlag(FLAGS_start));
+}
+
+system_clock::time_point get_end() {
+  if (absl::GetFlag(FLAGS_end) == absl::UniversalEpoch()) {
+    return system_clock::now();
+  }
+  return to_std_chrono(absl::GetFlag(FLAGS_end));
+}
+
+/**
+ * @brief Returns the indices of the chunks within `[start, end)` which already
+ * have data saved.
+ *
+ * A chunk is only considered complete if data has also been saved after it
+ * within the range. The chunk holding the newest saved candle may have been
+ * fetched while the market was still open, so it is fetched again.
+ */
+std::unordered_set<int64_t> find_saved_chunks(
+    database& db,
+    stock::Symbol symbol,
+    system_clock::time_point start,
+    system_clock::time_point end,
+    system_clock::duration chunk_length) {
+  std::unordered_set<int64_t> saved;
+  int64_t newest = -1;
+  for (const Candle& candle : db.read_candles(symbol, start, end)) {
+    system_clock::time_point opened_at = to_std_chrono(candle.opened_at());
+    int64_t index = (opened_at - start) / chunk_length;
+    saved.insert(index);
+    newest = std::max(newest, index);
+  }
+  saved.erase(newest);
+  return saved;
+}
+
+std::vector<backfill_chunk> plan_chunks(database& db) {
+  std::vector<stock::Symbol> symbols = absl::GetFlag(FLAGS_stocks);
+  if (symbols.empty()) {
+    throw std::runtime_error("Must specify at least one stock in --stocks.");
+  }
+  system_clock::time_point start = get_start();
+  system_clock::time_point end = get_end();
+  if (end <= start) throw std::runtime_error("--end must be after --start.");
+  system_clock::duration chunk_length =
+      to_std_chrono(absl::GetFlag(FLAGS_chunk));
+  if (chunk_length <= system_clock::duration::zero()) {
+    throw std::runtime_error("--chunk must be positive.");
+  }
+
+  std::vector<backfill_chunk> chunks;
+  for (stock::Symbol symbol : symbols) {
+    std::unordered_set<int64_t> saved =
+        find_saved_chunks(db, symbol, start, end, chunk_length);
+    int64_t index = 0;
+    for (system_clock::time_point chunk_start = start; chunk_start < end;
+         chunk_start += chunk_length, ++index) {
+      if (saved.contains(index)) continue;
+      chunks.push_back(
+          {.symbol = symbol,
+           .start = chunk_start,
+           .end = std::min(chunk_start + chunk_length, end)});
+    }
+    LOG(INFO) << stock::Symbol_Name(symbol) << ": " << saved.size()
+              << " chunks already saved.";
+  }
+  return chunks;
+}
+
+vector<Candle> fetch_chunk(const backfill_chunk& chunk) {
+  // Both APIs treat the end of the range as inclusive.
+  system_clock::time_point last = chunk.end - std::chrono::milliseconds(1);
+  if (absl::GetFlag(FLAGS_api) == "alpaca") {
+    return alpaca::get_stock_bars(
+        chunk.symbol, {.start = chunk.start, .end = last});
+  }
+  return schwab::api_connection{}.get_history(
+      chunk.symbol, {.start_date = chunk.start, .end_date = last});
+}
+
+void save_chunk(database& db, const fetched_chunk& fetched) {
+  // Saves are upserts, so re-fetching a partially saved chunk is harmless.
+  db.save_batch(fetched.chunk.symbol, fetched.candles).get();
+}
+
+void run() {
+  std::string api = absl::GetFlag(FLAGS_api);
+  if (api != "alpaca" && api != "schwab") {
+    throw std::runtime_error(absl::StrCat("Unknown api: ", api));
+  }
+
+  security::register_security_client();
+  register_database_client();
+  if (api == "schwab") schwab::fetch_schwab_secrets();
+  database& db = registry::get_service<database>();
+
+  std::vector<backfill_chunk> chunks = plan_chunks(db);
+  LOG(INFO) << "Fetching " << chunks.size() << " chunks.";
+
+  // Chunks are fetched concurrently, paced by the API clients' rate limits,
+  // but saved from this thread in the order they were requested so only one
+  // thread uses the database connection.
+  std::size_t concurrency =
+      std::max(1, absl::GetFlag(FLAGS_backfill_concurrency));
+  std::deque<std::future<fetched_chunk>> in_flight;
+  std::size_t next_chunk = 0;
+  std::size_t saved_candles = 0;
+  while (next_chunk < chunks.size() || !in_flight.empty()) {
+    while (next_chunk < chunks.size() && in_flight.size() < concurrency) {
+      in_flight.push_back(
+          std::async(
+              std::launch::async,
+              [](const backfill_chunk& chunk) {
+                return fetched_chunk{
+                    .chunk = chunk, .candles = fetch_chunk(chunk)};
+              },
+              chunks[next_chunk++]));
+    }
+
+    fetched_chunk fetched = in_flight.front().get();
+    in_flight.pop_front();
+    save_chunk(db, fetched);
+    saved_candles += fetched.candles.size();
+    LOG(INFO) << stock::Symbol_Name(fetched.chunk.symbol) << " "
+              << to_string(fetched.chunk.start) << ": saved "
+              << fetched.candles.size() << " candles.";
+  }
+  std::cout << "Saved " << saved_candles << " candles from " << chunks.size()
+            << " chunks." << std::endl;
+}
+
+} // namespace
+} // namespace howling
+
+int main(int argc, char** argv) {
+  howling::init(argc, argv);
+
+  try {
+    howling::run();
+    return 0;
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  } catch (...) { std::cerr << "!!!! UNKNOWN ERROR THROWN !!!!" << std::endl; }
+  return 1;
+}
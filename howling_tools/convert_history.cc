@@ -0,0 +1,78 @@
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "absl/flags/flag.h"
+#include "absl/log/log.h"
+#include "data/history_file.h"
+#include "data/stock.pb.h"
+#include "data/utilities.h"
+#include "environment/init.h"
+
+ABSL_FLAG(
+    std::string,
+    history_dir,
+    "",
+    "Directory of textproto history files to convert, such as the "
+    "data/history directory of the source tree. Each is converted to a binary "
+    "history file beside it.");
+ABSL_FLAG(
+    bool,
+    force,
+    false,
+    "Convert files even if their binary history file is already up to date.");
+
+namespace howling {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+bool is_up_to_date(const fs::path& source, const fs::path& target) {
+  return fs::exists(target) &&
+      fs::last_write_time(target) >= fs::last_write_time(source);
+}
+
+void run() {
+  fs::path history_dir = absl::GetFlag(FLAGS_history_dir);
+  if (history_dir.empty()) {
+    throw std::runtime_error("Must specify --history_dir.");
+  }
+
+  int converted = 0;
+  int skipped = 0;
+  for (const fs::directory_entry& entry :
+       fs::recursive_directory_iterator(history_dir)) {
+    const fs::path& source = entry.path();
+    if (!entry.is_regular_file() || source.extension() != ".textproto") {
+      continue;
+    }
+    fs::path target = source;
+    target.replace_extension(BINARY_HISTORY_EXTENSION);
+    if (!absl::GetFlag(FLAGS_force) && is_up_to_date(source, target)) {
+      ++skipped;
+      continue;
+    }
+    write_history_file(target, read_history(source));
+    ++converted;
+    LOG(INFO) << "Converted " << source.string();
+  }
+  std::cout << "Converted " << converted << " history files, " << skipped
+            << " already up to date." << std::endl;
+}
+
+} // namespace
+} // namespace howling
+
+int main(int argc, char** argv) {
+  howling::init(argc, argv);
+
+  try {
+    howling::run();
+    return 0;
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  } catch (...) { std::cerr << "!!!! UNKNOWN ERROR THROWN !!!!" << std::endl; }
+  return 1;
+}
@@ -1,44 +1,120 @@
+#include <algorithm>
 #include <chrono>
+#include <cstddef>
 #include <cstdio>
 #include <exception>
 #include <filesystem>
 #include <format>
+#include <functional>
 #include <generator>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <ranges>
+#include <set>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include "absl/flags/flag.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/time.h"
 #include "cli/printing.h"
+#include "containers/parallel_for.h"
+#include "containers/prefetch.h"
 #include "containers/vector.h"
-#include "data/aggregate.h"
 #include "data/analyzer.h"
+#include "data/history_file.h"
 #include "data/load_analyzer.h"
 #include "data/stock.pb.h"
 #include "data/utilities.h"
 #include "environment/init.h"
 #include "environment/runfiles.h"
 #include "services/database.h"
+#include "services/db/archive.h"
+#include "services/db/environment.h"
 #include "services/db/register.h"
 #include "services/registry/registry.h"
 #include "services/security/register.h"
 #include "time/conversion.h"
+#include "trading/backtest.h"
 #include "trading/metrics.h"
-#include "trading/trading_state.h"
+#include "trading/sweep.h"
 
 ABSL_FLAG(
     howling::stock::Symbol,
     stock,
     howling::stock::SYMBOL_UNSPECIFIED,
     "Stock symbol to evaluate against.");
-ABSL_FLAG(std::string, analyzer, "", "Name of an analyzer to evaluate.");
+ABSL_FLAG(
+    std::vector<howling::stock::Symbol>,
+    stocks,
+    {},
+    "Comma-separated list of stock symbols to backtest together as one "
+    "portfolio with shared funds, instead of a single --stock.");
+ABSL_FLAG(
+    int,
+    portfolio_threads,
+    0,
+    "Number of threads to analyze the stocks of a portfolio on. Default is one "
+    "per core.");
+ABSL_FLAG(
+    std::string,
+    analyzer,
+    "",
+    "Comma separated names of analyzers to evaluate. Several analyzers share "
+    "one pass over the market data, each trading its own account, and their "
+    "results are printed side by side.");
 ABSL_FLAG(
     double,
     initial_funds,
     200'000,
     "Available funds at begining of evaluation.");
-ABSL_FLAG(bool, use_database, false, "Use database for evaluation.");
+ABSL_FLAG(
+    bool,
+    use_database,
+    false,
+    "Use database for evaluation. Archived days are read from --db_archive_dir "
+    "if it is set.");
+ABSL_FLAG(
+    int,
+    prefetch_days,
+    2,
+    "Number of days to load ahead on a background thread while evaluating.");
+ABSL_FLAG(
+    absl::Time,
+    start,
+    absl::UniversalEpoch(),
+    "Oldest data to evaluate. Default is the oldest available.");
+ABSL_FLAG(
+    absl::Time,
+    end,
+    absl::UniversalEpoch(),
+    "Newest data to evaluate, exclusive. Default is now.");
+
+ABSL_FLAG(
+    std::string,
+    sweep,
+    "",
+    "Parameter grid to sweep instead of running a single evaluation, such as "
+    "\"analyzer=macd,macd5;profit_minimum=0.05,0.1\". Every combination of "
+    "values is evaluated and the results are ranked by --sweep_rank_by. Names "
+    "are \"analyzer\" or any analyzer or aggregation flag.");
+ABSL_FLAG(
+    std::string,
+    sweep_rank_by,
+    "profit",
+    "Metric to rank sweep results by: profit, win_rate, sales or mean_delta.");
+ABSL_FLAG(
+    int,
+    sweep_threads,
+    0,
+    "Number of threads to run sweep configurations on. Default is one per "
+    "core.");
 
 namespace howling {
 namespace {
@@ -57,140 +133,377 @@ year_month_day parse_date(std::string date) {
   return {};
 }
 
-year_month_day get_date(system_clock::time_point time) {
-  return year_month_day{std::chrono::floor<std::chrono::days>(time)};
-}
-
-std::string print_date(year_month_day ymd) {
-  return std::format("{:%B %Y}", ymd);
+system_clock::time_point get_end() {
+  if (absl::GetFlag(FLAGS_end) == absl::UniversalEpoch()) {
+    return system_clock::now();
+  }
+  return to_std_chrono(absl::GetFlag(FLAGS_end));
 }
 
-struct day_data {
-  std::string name;
-  vector<Candle> candles;
-};
-
-std::generator<day_data> get_days(stock::Symbol symbol) {
+std::generator<backtest_day> get_days(stock::Symbol symbol) {
+  system_clock::time_point start = to_std_chrono(absl::GetFlag(FLAGS_start));
+  system_clock::time_point end = get_end();
   if (absl::GetFlag(FLAGS_use_database)) {
-    security::register_security_client();
-    register_database_client();
-    vector<Candle> day_candles;
-    std::string day_name;
-    for (const Candle& candle :
-         registry::get_service<database>().read_candles(symbol)) {
-      std::string current_day = std::format(
-          "{:%F}",
-          std::chrono::floor<std::chrono::days>(
-              to_std_chrono(candle.opened_at())));
-      if (day_candles.empty()) {
-        day_name = current_day;
-      } else if (current_day != day_name) {
-        co_yield {day_name, std::move(day_candles)};
-        day_candles.clear();
-        day_name = current_day;
+    for (candle_day day :
+         registry::get_service<database>().read_candle_days(
+             symbol, start, end)) {
+      co_yield {std::format("{:%F}", day.date), std::move(day.candles)};
+    }
+  } else if (!absl::GetFlag(FLAGS_db_archive_dir).empty()) {
+    market_archive archive{absl::GetFlag(FLAGS_db_archive_dir)};
+    for (year_month_day date : archive.list_days(symbol)) {
+      std::chrono::sys_days day_start{date};
+      system_clock::time_point from =
+          std::max<system_clock::time_point>(start, day_start);
+      system_clock::time_point to = std::min<system_clock::time_point>(
+          end, day_start + std::chrono::days{1});
+      if (from >= to) continue;
+      vector<Candle> day_candles;
+      for (Candle candle : archive.read_candles(symbol, from, to)) {
+        day_candles.push_back(std::move(candle));
       }
-      day_candles.push_back(candle);
+      if (day_candles.empty()) continue;
+      co_yield {std::format("{:%F}", date), std::move(day_candles)};
     }
-    if (!day_candles.empty()) co_yield {day_name, std::move(day_candles)};
   } else {
     fs::path data_directory = runfile(
         get_history_file_path(symbol, /*date=*/"").parent_path().string());
-    vector<fs::directory_entry> files;
+    // Keyed by date, preferring binary history files over the textprotos
+    // they were converted from.
+    std::map<std::string, fs::path> files;
     for (const auto& entry : fs::directory_iterator(data_directory)) {
-      files.push_back(entry);
+      std::string stem = entry.path().stem().string();
+      std::chrono::sys_days date{parse_date(stem)};
+      if (date < std::chrono::floor<std::chrono::days>(start) || date >= end) {
+        continue;
+      }
+      if (entry.path().extension() == BINARY_HISTORY_EXTENSION) {
+        files[stem] = entry.path();
+      } else {
+        files.try_emplace(stem, entry.path());
+      }
     }
-    std::ranges::sort(
-        files, [](const fs::directory_entry& a, const fs::directory_entry& b) {
-          return std::ranges::lexicographical_compare(
-              a.path().filename(), b.path().filename());
-        });
-    for (const fs::directory_entry& file : files) {
-      stock::History history = read_history(file.path());
+    for (const auto& [name, path] : files) {
       vector<Candle> day_candles;
-      day_candles.reserve(history.candles_size());
-      for (const Candle& c : history.candles()) day_candles.push_back(c);
-      co_yield {file.path().stem().string(), std::move(day_candles)};
+      if (path.extension() == BINARY_HISTORY_EXTENSION) {
+        mapped_history history{path};
+        day_candles.reserve(history.size());
+        for (std::size_t i = 0; i < history.size(); ++i) {
+          day_candles.push_back(history.candle(i));
+        }
+      } else {
+        stock::History history = read_history(path);
+        day_candles.reserve(history.candles_size());
+        for (const Candle& c : history.candles()) day_candles.push_back(c);
+      }
+      co_yield {name, std::move(day_candles)};
     }
   }
 }
 
-void run() {
-  if (absl::GetFlag(FLAGS_analyzer).empty()) {
-    throw std::runtime_error("Must specify an analyzer.");
+/**
+ * Reads the days of every stock from the database, one stock at a time.
+ *
+ * Each database read holds a pooled connection until it finishes, so reading
+ * the stocks side by side would need a connection for every stock.
+ */
+std::generator<portfolio_day>
+read_portfolio_days(const vector<stock::Symbol>& symbols) {
+  system_clock::time_point start = to_std_chrono(absl::GetFlag(FLAGS_start));
+  system_clock::time_point end = get_end();
+  database& db = registry::get_service<database>();
+  // The daily rollups list the days which have any candles.
+  std::set<std::chrono::sys_days> dates;
+  for (stock::Symbol symbol : symbols) {
+    for (const Candle& candle : db.read_candles(
+             symbol,
+             candle_resolution::ONE_DAY,
+             std::chrono::floor<std::chrono::days>(start),
+             end)) {
+      dates.insert(
+          std::chrono::floor<std::chrono::days>(
+              to_std_chrono(candle.opened_at())));
+    }
   }
-  stock::Symbol symbol = absl::GetFlag(FLAGS_stock);
-  if (symbol == stock::SYMBOL_UNSPECIFIED) {
-    throw std::runtime_error("Must specify a stock symbol.");
+
+  for (std::chrono::sys_days date : dates) {
+    system_clock::time_point from =
+        std::max<system_clock::time_point>(start, date);
+    system_clock::time_point to = std::min<system_clock::time_point>(
+        end, date + std::chrono::days{1});
+    portfolio_day day{.name = std::format("{:%F}", year_month_day{date})};
+    day.candles.resize(symbols.size());
+    bool traded = false;
+    for (std::size_t i = 0; i < symbols.size(); ++i) {
+      for (Candle candle : db.read_candles(symbols[i], from, to)) {
+        day.candles[i].push_back(std::move(candle));
+      }
+      traded = traded || !day.candles[i].empty();
+    }
+    if (traded) co_yield std::move(day);
   }
-  auto anal = load_analyzer(absl::GetFlag(FLAGS_analyzer));
+}
 
-  trading_state state{
-      .available_stocks = vector<stock::Symbol>{{symbol}},
-      .initial_funds = absl::GetFlag(FLAGS_initial_funds),
-      .available_funds = absl::GetFlag(FLAGS_initial_funds)};
+/**
+ * Reads the days of every stock, grouping each date's candles together.
+ */
+std::generator<portfolio_day>
+get_portfolio_days(const vector<stock::Symbol>& symbols) {
+  if (absl::GetFlag(FLAGS_use_database)) {
+    for (portfolio_day day : read_portfolio_days(symbols)) {
+      co_yield std::move(day);
+    }
+    co_return;
+  }
 
-  vector<metrics> months;
-  year_month_day previous_date;
-  bool first_day = true;
+  using iterator = std::ranges::iterator_t<std::generator<backtest_day>>;
+  vector<std::generator<backtest_day>> streams;
+  vector<iterator> heads;
+  streams.reserve(symbols.size());
+  heads.reserve(symbols.size());
+  for (stock::Symbol symbol : symbols) {
+    streams.push_back(get_days(symbol));
+    heads.push_back(streams.back().begin());
+  }
 
-  for (day_data day : get_days(symbol)) {
-    if (first_day) {
-      previous_date = parse_date(day.name);
-      months.push_back(
-          {.name = print_date(previous_date),
-           .initial_funds = state.initial_funds});
-      first_day = false;
+  while (true) {
+    // Dates are formatted as YYYY-MM-DD, so they order as strings.
+    std::string name;
+    for (std::size_t i = 0; i < streams.size(); ++i) {
+      if (heads[i] == streams[i].end()) continue;
+      backtest_day&& head = *heads[i];
+      if (name.empty() || head.name < name) name = head.name;
     }
+    if (name.empty()) break;
 
-    state.time_now = to_std_chrono(day.candles.front().opened_at());
-    year_month_day current_date = get_date(state.time_now);
-    if (current_date.month() != previous_date.month()) {
-      months.back().assets_value = state.total_positions_value();
-      months.push_back(
-          {.name = print_date(current_date),
-           .initial_funds = state.available_funds});
-      previous_date = current_date;
+    portfolio_day day{.name = name};
+    day.candles.resize(symbols.size());
+    for (std::size_t i = 0; i < streams.size(); ++i) {
+      if (heads[i] == streams[i].end()) continue;
+      backtest_day&& head = *heads[i];
+      if (head.name != name) continue;
+      day.candles[i] = std::move(head.candles);
+      ++heads[i];
     }
-    metrics day_metrics{
-        .name = day.name, .initial_funds = state.available_funds};
-
-    for (const Candle& candle : day.candles) {
-      state.time_now =
-          to_std_chrono(candle.opened_at()) + to_std_chrono(candle.duration());
-
-      add_next_minute(state.market[symbol], candle);
-      decision d = anal->analyze(symbol, state);
-      if (d.act == action::BUY) {
-        state.available_funds -= candle.close();
-        state.positions[symbol].push_back(
-            {.symbol = symbol, .price = candle.close(), .quantity = 1});
-      } else if (d.act == action::SELL && !state.positions[symbol].empty()) {
-        for (const trading_state::position& p : state.positions[symbol]) {
-          ++day_metrics.sales;
-          double delta = candle.close() - p.price;
-          day_metrics.deltas.push_back(delta);
-          if (p.price < candle.close()) ++day_metrics.profitable_sales;
-          state.available_funds += candle.close() * p.quantity;
-        }
-        state.positions[symbol].clear();
+    co_yield std::move(day);
+  }
+}
+
+vector<std::string> get_analyzer_names() {
+  vector<std::string> names;
+  for (absl::string_view name :
+       absl::StrSplit(absl::GetFlag(FLAGS_analyzer), ',', absl::SkipEmpty())) {
+    names.emplace_back(name);
+  }
+  return names;
+}
+
+std::string print_side_by_side(const vector<metrics>& results) {
+  vector<std::string> blocks;
+  for (const metrics& m : results) blocks.push_back(print_metrics(m));
+  return print_columns(blocks);
+}
+
+// MARK: Portfolio
+
+/**
+ * Backtests every --stocks together as one portfolio, with one analyzer for
+ * each stock trading from shared funds.
+ */
+void run_portfolio(const vector<stock::Symbol>& symbols) {
+  vector<std::string> names = get_analyzer_names();
+  if (names.size() != 1) {
+    throw std::runtime_error("Portfolio backtests take exactly one analyzer.");
+  }
+  analyzer_options options = analyzer_options_from_flags();
+  vector<std::unique_ptr<analyzer>> analyzers;
+  for (std::size_t i = 0; i < symbols.size(); ++i) {
+    analyzers.push_back(load_analyzer(
+        names.front(), stock::History::default_instance(), options));
+  }
+  std::size_t threads = absl::GetFlag(FLAGS_portfolio_threads) > 0
+      ? absl::GetFlag(FLAGS_portfolio_threads)
+      : std::max(1u, std::thread::hardware_concurrency());
+  portfolio_backtester tester{
+      symbols,
+      std::move(analyzers),
+      absl::GetFlag(FLAGS_initial_funds),
+      options.aggregation,
+      threads};
+
+  for (portfolio_day day : prefetch(
+           get_portfolio_days(symbols),
+           std::max(1, absl::GetFlag(FLAGS_prefetch_days)))) {
+    std::cout << print_metrics(tester.run_day(day)) << "\n";
+  }
+  if (tester.months().empty()) return;
+
+  std::cout << "\n";
+  for (const metrics& m : tester.months()) {
+    std::cout << print_metrics(m) << "\n";
+  }
+  vector<metrics> stocks;
+  for (std::size_t i = 0; i < symbols.size(); ++i) {
+    stocks.push_back(tester.stock_totals(i));
+  }
+  std::cout << "\n" << print_side_by_side(stocks) << "\n";
+  std::cout << "\n" << print_metrics(tester.totals()) << "\n";
+}
+
+// MARK: Sweep
+
+struct sweep_result {
+  std::string label;
+  metrics totals;
+};
+
+void print_sweep(vector<sweep_result>& results, std::string_view rank_by) {
+  std::ranges::stable_sort(
+      results, std::ranges::greater{}, [&](const sweep_result& r) {
+        return rank_value(r.totals, rank_by);
+      });
+  std::cout << std::format(
+      "{:>4}  {:>12}  {:>6}  {:>6}  {:>8}  {}\n",
+      "Rank",
+      "Profit",
+      "Sales",
+      "Win%",
+      "MeanΔ",
+      "Configuration");
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const metrics& m = results[i].totals;
+    std::cout << std::format(
+        "{:>4}  {:>12.2f}  {:>6}  {:>6.1f}  {:>8.3f}  {}\n",
+        i + 1,
+        rank_value(m, "profit"),
+        m.sales,
+        rank_value(m, "win_rate") * 100.0,
+        rank_value(m, "mean_delta"),
+        results[i].label);
+  }
+}
+
+/**
+ * Evaluates every configuration of the --sweep grid in parallel against the
+ * same days, which are loaded only once.
+ */
+void run_sweep(stock::Symbol symbol) {
+  std::string rank_by = absl::GetFlag(FLAGS_sweep_rank_by);
+  rank_value({}, rank_by); // Fail on an unknown metric before loading.
+  vector<sweep_dimension> dimensions =
+      parse_sweep(absl::GetFlag(FLAGS_sweep));
+  if (std::ranges::none_of(dimensions, [](const sweep_dimension& d) {
+        return d.name == "analyzer";
+      })) {
+    // Without an analyzer dimension, every --analyzer is swept.
+    vector<std::string> names = get_analyzer_names();
+    if (names.empty()) {
+      throw std::runtime_error("Must specify an analyzer to sweep.");
+    }
+    dimensions.insert(
+        dimensions.begin(), {.name = "analyzer", .values = std::move(names)});
+  }
+  vector<vector<sweep_setting>> configurations = expand_sweep(dimensions);
+
+  vector<backtest_day> days;
+  for (backtest_day day : prefetch(
+           get_days(symbol),
+           std::max(1, absl::GetFlag(FLAGS_prefetch_days)))) {
+    days.push_back(std::move(day));
+  }
+  const vector<backtest_day>& shared_days = days;
+  const analyzer_options default_options = analyzer_options_from_flags();
+  const double initial_funds = absl::GetFlag(FLAGS_initial_funds);
+
+  std::size_t threads = absl::GetFlag(FLAGS_sweep_threads) > 0
+      ? absl::GetFlag(FLAGS_sweep_threads)
+      : std::max(1u, std::thread::hardware_concurrency());
+  vector<sweep_result> results(configurations.size());
+  parallel_for(configurations.size(), threads, [&](std::size_t i) {
+    std::string analyzer_name;
+    analyzer_options options = default_options;
+    vector<std::string> label;
+    for (const sweep_setting& setting : configurations[i]) {
+      if (setting.name == "analyzer") {
+        analyzer_name = setting.value;
+      } else {
+        set_analyzer_option(options, setting.name, setting.value);
       }
+      label.push_back(absl::StrCat(setting.name, "=", setting.value));
+    }
+    backtester tester{
+        load_analyzer(
+            analyzer_name, stock::History::default_instance(), options),
+        symbol,
+        initial_funds,
+        options.aggregation};
+    for (const backtest_day& day : shared_days) tester.run_day(day);
+    results[i] = {
+        .label = absl::StrJoin(label, " "), .totals = tester.totals()};
+  });
+  print_sweep(results, rank_by);
+}
+
+// MARK: Main
+
+void run() {
+  if (absl::GetFlag(FLAGS_use_database)) {
+    security::register_security_client();
+    register_database_client();
+  }
+  vector<stock::Symbol> symbols = absl::GetFlag(FLAGS_stocks);
+  if (!symbols.empty()) {
+    if (!absl::GetFlag(FLAGS_sweep).empty()) {
+      throw std::runtime_error("Sweeps evaluate a single --stock.");
     }
-    day_metrics.available_funds = state.available_funds;
-    day_metrics.assets_value = state.total_positions_value();
-    std::cout << print_metrics(day_metrics) << "\n";
-    add_metrics(months.back(), day_metrics);
+    run_portfolio(symbols);
+    return;
   }
+  stock::Symbol symbol = absl::GetFlag(FLAGS_stock);
+  if (symbol == stock::SYMBOL_UNSPECIFIED) {
+    throw std::runtime_error("Must specify a stock symbol.");
+  }
+  if (!absl::GetFlag(FLAGS_sweep).empty()) {
+    run_sweep(symbol);
+    return;
+  }
+  vector<std::string> names = get_analyzer_names();
+  if (names.empty()) throw std::runtime_error("Must specify an analyzer.");
 
-  if (months.empty()) return;
+  analyzer_options options = analyzer_options_from_flags();
+  vector<std::unique_ptr<analyzer>> analyzers;
+  for (const std::string& name : names) {
+    analyzers.push_back(
+        load_analyzer(name, stock::History::default_instance(), options));
+  }
+  backtester tester{
+      std::move(analyzers),
+      symbol,
+      absl::GetFlag(FLAGS_initial_funds),
+      options.aggregation};
+  if (names.size() > 1) std::cout << print_columns(names) << "\n\n";
+
+  // Loading days overlaps with evaluating them.
+  for (backtest_day day : prefetch(
+           get_days(symbol),
+           std::max(1, absl::GetFlag(FLAGS_prefetch_days)))) {
+    std::cout << print_side_by_side(tester.run_day(day)) << "\n";
+  }
+  if (tester.months().empty()) return;
 
-  metrics totals{.name = "Total", .initial_funds = state.initial_funds};
   std::cout << "\n";
-  for (const metrics& m : months) {
-    std::cout << print_metrics(m) << "\n";
-    add_metrics(totals, m);
+  for (std::size_t month = 0; month < tester.months().size(); ++month) {
+    vector<metrics> months;
+    for (std::size_t i = 0; i < tester.size(); ++i) {
+      months.push_back(tester.months(i)[month]);
+    }
+    std::cout << print_side_by_side(months) << "\n";
+  }
+  vector<metrics> totals;
+  for (std::size_t i = 0; i < tester.size(); ++i) {
+    totals.push_back(tester.totals(i));
   }
-  totals.assets_value = state.total_positions_value();
-  std::cout << "\n" << print_metrics(totals) << "\n";
+  std::cout << "\n" << print_side_by_side(totals) << "\n";
 }
 
 } // namespace
@@ -1,8 +1,10 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <deque>
 #include <exception>
 #include <filesystem>
+#include <future>
 #include <iostream>
 #include <limits>
 #include <memory>
@@ -18,10 +20,12 @@
 #include "cli/printing.h"
 #include "containers/vector.h"
 #include "data/account.pb.h"
+#include "data/aggregate.h"
 #include "data/candle.pb.h"
 #include "data/load_analyzer.h"
 #include "data/market.pb.h"
 #include "data/stock.pb.h"
+#include "data/trade.pb.h"
 #include "data/utilities.h"
 #include "environment/configuration.h"
 #include "environment/init.h"
@@ -56,6 +60,16 @@ using ::std::chrono::system_clock;
 const std::filesystem::path CANDLE_BEAT_PATH = "/tmp/howling/candle-beat";
 const std::filesystem::path MARKET_BEAT_PATH = "/tmp/howling/market-beat";
 
+// Collects the results of finished saves, rethrowing any failures, without
+// waiting on those still in flight.
+void collect_finished_saves(std::deque<std::future<void>>& saves) {
+  while (!saves.empty() &&
+         saves.front().wait_for(0s) == std::future_status::ready) {
+    saves.front().get();
+    saves.pop_front();
+  }
+}
+
 class execution_printer {
 public:
   execution_printer() {}
@@ -167,6 +181,10 @@ trading_state load_trading_state(vector<stock::Symbol> symbols) {
       .account_id = account.account_id(),
       .initial_funds = 20'000,
       .available_funds = 20'000};
+  aggregation_options aggregation = aggregation_options_from_flags();
+  for (stock::Symbol symbol : state.available_stocks) {
+    state.market.try_emplace(symbol, aggregations{.options = aggregation});
+  }
   load_positions(api, state, account.account_id());
 
   return state;
@@ -191,10 +209,13 @@ void run() {
   execution_printer printer;
   trading_state state = load_trading_state(std::move(symbols));
   metrics m{.name = "Summary", .initial_funds = state.initial_funds};
-  executor e{state};
+  database& db = registry::get_service<database>();
+  // Real-money trades are recorded once the broker reports their fills.
+  executor e{state, [&db](const trading::TradeRecord& trade) {
+               db.save_trade(trade);
+             }};
 
   auto watcher = std::make_unique<market_watch>();
-  database& db = registry::get_service<database>();
 
   std::jthread pre_market_beats([&](std::stop_token stop) {
     while (!state.market_is_open() && !stop.stop_requested()) {
@@ -217,28 +238,14 @@ void run() {
       }
       state.time_now = to_std_chrono(candle.opened_at()) + candle_duration;
       add_next_minute(state.market[symbol], candle);
+      e.apply_order_updates();
       decision d = anal->analyze(symbol, state);
 
       std::optional<trading_state::position> trade = std::nullopt;
-      trading::Action trade_act = trading::ACTION_UNSPECIFIED;
       if (d.act == action::BUY) {
-        trade = e.buy(symbol, m);
-        trade_act = trading::BUY;
+        trade = e.buy(symbol, d.confidence, m);
       } else if (d.act == action::SELL) {
-        trade = e.sell(symbol, m);
-        trade_act = trading::SELL;
-      }
-
-      if (trade) {
-        trading::TradeRecord record;
-        record.set_symbol(symbol);
-        *record.mutable_executed_at() = to_proto(system_clock::now());
-        record.set_action(trade_act);
-        record.set_price(trade->price);
-        record.set_quantity(trade->quantity);
-        record.set_confidence(d.confidence);
-        record.set_dry_run(!absl::GetFlag(FLAGS_use_real_money));
-        db.save_trade(record);
+        trade = e.sell(symbol, d.confidence, m);
       }
 
       if (absl::GetFlag(FLAGS_headless)) {
@@ -269,15 +276,21 @@ void run() {
   });
 
   std::jthread candle_saver([&]() {
+    std::deque<std::future<void>> saves;
     for (const auto& [symbol, candle] : watcher->candle_stream()) {
-      db.save(symbol, candle).get();
+      saves.push_back(db.save(symbol, candle));
+      collect_finished_saves(saves);
     }
+    for (std::future<void>& save : saves) save.get();
   });
 
   std::jthread market_saver([&]() {
+    std::deque<std::future<void>> saves;
     for (const Market& market : watcher->market_stream()) {
-      db.save(market).get();
+      saves.push_back(db.save(market));
+      collect_finished_saves(saves);
     }
+    for (std::future<void>& save : saves) save.get();
   });
 
   std::jthread watcher_thread([&]() {
@@ -1,14 +1,18 @@
 #include <algorithm>
 #include <chrono>
 #include <exception>
+#include <filesystem>
 #include <iostream>
 #include <limits>
 #include <string>
+#include <string_view>
 
 #include "absl/flags/flag.h"
 #include "cli/printing.h"
+#include "data/aggregate.h"
 #include "data/analyzer.h"
 #include "data/candle.pb.h"
+#include "data/history_file.h"
 #include "data/load_analyzer.h"
 #include "data/stock.pb.h"
 #include "data/utilities.h"
@@ -34,15 +38,24 @@ ABSL_FLAG(
 namespace howling {
 namespace {
 
+namespace fs = ::std::filesystem;
+
 using ::std::chrono::system_clock;
 
+/** Reads the day's binary history file if it has been converted. */
+stock::History read_day(stock::Symbol symbol, std::string_view date) {
+  fs::path binary =
+      runfile(get_binary_history_file_path(symbol, date).string());
+  if (fs::exists(binary)) return mapped_history{binary}.to_history();
+  return read_history(runfile(get_history_file_path(symbol, date).string()));
+}
+
 void run() {
   howling::stock::Symbol symbol = absl::GetFlag(FLAGS_stock);
   if (symbol == stock::SYMBOL_UNSPECIFIED) {
     throw std::runtime_error("Must specify a stock symbol.");
   }
-  stock::History history = read_history(runfile(
-      get_history_file_path(symbol, absl::GetFlag(FLAGS_date)).string()));
+  stock::History history = read_day(symbol, absl::GetFlag(FLAGS_date));
   auto anal = load_analyzer(absl::GetFlag(FLAGS_analyzer), history);
 
   print_candle_parameters print_params{
@@ -59,6 +72,9 @@ void run() {
   }
 
   trading_state state{
+      .market =
+          {{symbol,
+            aggregations{.options = aggregation_options_from_flags()}}},
       .available_stocks = vector<stock::Symbol>{{symbol}},
       .initial_funds = absl::GetFlag(FLAGS_initial_funds),
       .available_funds = absl::GetFlag(FLAGS_initial_funds)};
@@ -94,3 +94,66 @@ resource "kubernetes_job" "db_bootstrap" {
     update = "10m"
   }
 }
+
+# MARK: DB Maintenance
+
+# Reruns the schema upgrade weekly so time partitions are created ahead of the
+# rows written into them and expired ones are dropped.
+resource "kubernetes_cron_job_v1" "db_maintenance" {
+  metadata {
+    name      = "howling-db-maintenance"
+    namespace = var.namespace
+  }
+  spec {
+    schedule           = "0 3 * * 0" # Sundays at 3am Eastern.
+    timezone           = "America/New_York"
+    concurrency_policy = "Forbid"
+
+    successful_jobs_history_limit = 4
+    failed_jobs_history_limit     = 4
+
+    job_template {
+      metadata {}
+      spec {
+        backoff_limit              = 4
+        ttl_seconds_after_finished = 3600 * 24 # 24 hours in seconds.
+
+        template {
+          metadata {
+            annotations = {
+              "vault.hashicorp.com/agent-inject"                    = "true"
+              "vault.hashicorp.com/role"                            = "howling-ci-role"
+              "vault.hashicorp.com/agent-cache-enable"              = "true"
+              "vault.hashicorp.com/agent-cache-use-auto-auth-token" = "force"
+              "vault.hashicorp.com/agent-image"                     = var.openbao_agent_image
+              "vault.hashicorp.com/agent-enable-quit"               = "true"
+            }
+          }
+          spec {
+            image_pull_secrets {
+              name = var.registry_credentials
+            }
+
+            container {
+              name  = "maintenance"
+              image = "${var.image_repository}:${var.image_tag}"
+              args = [
+                "--bao_shutdown_on_destroy",
+                "--database=postgres",
+                "--pg_host=${ovh_cloud_project_database.postgres.endpoints[0].domain}",
+                "--pg_port=${ovh_cloud_project_database.postgres.endpoints[0].port}",
+                "--pg_database=howling",
+                "--pg_enable_encryption=true",
+                "--app_db_user=${ovh_cloud_project_database_postgresql_user.app_user.name}",
+                "--logging_mode=json",
+              ]
+            }
+            restart_policy = "OnFailure"
+          }
+        }
+      }
+    }
+  }
+
+  depends_on = [kubernetes_job.db_bootstrap]
+}
@@ -1,5 +1,8 @@
 #include "net/connect.h"
 
+#include <memory>
+#include <utility>
+
 #include "boost/asio/ssl.hpp"
 #include "boost/beast.hpp"
 #include "boost/beast/core/stream_traits.hpp"
@@ -15,9 +18,9 @@ namespace beast = ::boost::beast;
 
 } // namespace
 
-connection::connection()
-    : _io_context{}, _ssl_context{asio::ssl::context::tls_client},
-      _stream{_io_context, _ssl_context} {}
+connection::connection(std::shared_ptr<asio::ssl::context> ssl_context)
+    : _io_context{}, _ssl_context{std::move(ssl_context)},
+      _stream{_io_context, *_ssl_context} {}
 
 insecure_connection::insecure_connection()
     : _io_context{}, _stream{_io_context} {}
@@ -26,10 +29,23 @@ websocket::websocket()
     : _io_context{}, _ssl_context{asio::ssl::context::tls_client},
       _stream{_io_context, _ssl_context} {}
 
+std::shared_ptr<asio::ssl::context> make_ssl_context() {
+  auto ssl_context =
+      std::make_shared<asio::ssl::context>(asio::ssl::context::tls_client);
+  ssl_context->set_default_verify_paths();
+  ssl_context->set_verify_mode(asio::ssl::verify_peer);
+  return ssl_context;
+}
+
 std::unique_ptr<connection> make_connection(const url& u) {
-  std::unique_ptr<connection> conn{new connection()};
-  conn->_ssl_context.set_default_verify_paths();
-  conn->_ssl_context.set_verify_mode(asio::ssl::verify_peer);
+  return make_connection(u, make_ssl_context());
+}
+
+std::unique_ptr<connection> make_connection(
+    const url& u,
+    std::shared_ptr<asio::ssl::context> ssl_context,
+    SSL_SESSION* session) {
+  std::unique_ptr<connection> conn{new connection(std::move(ssl_context))};
 
   asio::ip::tcp::resolver tcp_resolver(conn->_io_context);
   asio::ip::tcp::resolver::results_type host_resolution =
@@ -40,6 +56,10 @@ std::unique_ptr<connection> make_connection(const url& u) {
     throw beast::system_error{beast::error_code{
         static_cast<int>(::ERR_get_error()), asio::error::get_ssl_category()}};
   }
+  if (session && !::SSL_set_session(conn->_stream.native_handle(), session)) {
+    throw beast::system_error{beast::error_code{
+        static_cast<int>(::ERR_get_error()), asio::error::get_ssl_category()}};
+  }
 
   beast::get_lowest_layer(conn->_stream).connect(host_resolution);
   conn->_stream.handshake(asio::ssl::stream_base::client);
@@ -8,6 +8,7 @@
 #include "boost/beast/core/tcp_stream.hpp"
 #include "boost/beast/websocket/ssl.hpp"
 #include "net/url.h"
+#include "openssl/ssl.h"
 
 namespace howling::net {
 
@@ -18,12 +19,13 @@ public:
   stream_type& stream() { return _stream; }
 
 private:
-  friend std::unique_ptr<connection> make_connection(const url&);
+  friend std::unique_ptr<connection> make_connection(
+      const url&, std::shared_ptr<boost::asio::ssl::context>, SSL_SESSION*);
 
-  connection();
+  explicit connection(std::shared_ptr<boost::asio::ssl::context> ssl_context);
 
   boost::asio::io_context _io_context;
-  boost::asio::ssl::context _ssl_context;
+  std::shared_ptr<boost::asio::ssl::context> _ssl_context;
   stream_type _stream;
 };
 
@@ -60,7 +62,26 @@ private:
   stream_type _stream;
 };
 
+/**
+ * @brief Creates a TLS client context which verifies peers against the default
+ * certificate paths.
+ */
+std::shared_ptr<boost::asio::ssl::context> make_ssl_context();
+
 std::unique_ptr<connection> make_connection(const url& u);
+
+/**
+ * @brief Opens a TLS connection using a shared SSL context.
+ *
+ * @param u           The host and service to connect to.
+ * @param ssl_context The client context to share with other connections.
+ * @param session     A previous session with the same host to resume, or
+ *                    `nullptr` to perform a full handshake.
+ */
+std::unique_ptr<connection> make_connection(
+    const url& u,
+    std::shared_ptr<boost::asio::ssl::context> ssl_context,
+    SSL_SESSION* session = nullptr);
 std::unique_ptr<insecure_connection> make_insecure_connection(const url& u);
 std::unique_ptr<websocket> make_websocket(const url& u);
 
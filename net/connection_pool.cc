@@ -0,0 +1,223 @@
+#include "net/connection_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/flags/flag.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "boost/asio/error.hpp"
+#include "boost/asio/ssl.hpp"
+#include "boost/beast/http/error.hpp"
+#include "boost/beast/http/verb.hpp"
+#include "net/connect.h"
+#include "net/url.h"
+#include "openssl/ssl.h"
+#include "time/conversion.h"
+
+ABSL_FLAG(
+    absl::Duration,
+    http_pool_idle_timeout,
+    absl::Seconds(50),
+    "Maximum time a kept-alive HTTP connection may sit idle in the pool.");
+ABSL_FLAG(
+    int,
+    http_pool_max_idle_per_host,
+    4,
+    "Maximum number of idle HTTP connections kept open to any one host.");
+
+namespace howling::net {
+namespace {
+
+namespace asio = ::boost::asio;
+namespace http = ::boost::beast::http;
+
+using ::std::chrono::steady_clock;
+
+std::string_view normalize_service(std::string_view service) {
+  if (service == "https") return "443";
+  if (service == "http") return "80";
+  return service;
+}
+
+std::string make_key(const url& u) {
+  return absl::StrCat(u.host, ":", normalize_service(u.service));
+}
+
+} // namespace
+
+bool is_stale_connection_error(const boost::system::error_code& code) {
+  return code == http::error::end_of_stream || code == asio::error::eof ||
+      code == asio::error::connection_reset ||
+      code == asio::error::connection_aborted ||
+      code == asio::error::broken_pipe ||
+      code == asio::ssl::error::stream_truncated;
+}
+
+bool is_idempotent(http::verb method) {
+  switch (method) {
+    case http::verb::get:
+    case http::verb::head:
+    case http::verb::put:
+    case http::verb::delete_:
+    case http::verb::options:
+    case http::verb::trace:
+      return true;
+    default:
+      return false;
+  }
+}
+
+connection_pool& connection_pool::get_instance() {
+  static connection_pool instance{
+      {.idle_timeout = std::chrono::duration_cast<steady_clock::duration>(
+           to_std_chrono(absl::GetFlag(FLAGS_http_pool_idle_timeout))),
+       .max_idle_per_host = static_cast<std::size_t>(
+           std::max(0, absl::GetFlag(FLAGS_http_pool_max_idle_per_host)))}};
+  return instance;
+}
+
+connection_pool::connection_pool(options opts)
+    : _options{std::move(opts)}, _ssl_context{make_ssl_context()} {
+  // Sessions are tracked by the pool per host, so the client cache only needs
+  // to keep tickets issued after the handshake attached to their sessions.
+  SSL_CTX_set_session_cache_mode(
+      _ssl_context->native_handle(), SSL_SESS_CACHE_CLIENT);
+}
+
+connection_pool::~connection_pool() = default;
+
+pooled_connection<connection> connection_pool::acquire(const url& u) {
+  std::string key = make_key(u);
+  SSL_SESSION* session = nullptr;
+  {
+    std::lock_guard lock{_mutex};
+    _evict_expired_locked(_idle);
+    if (std::unique_ptr<connection> conn = _take_idle_locked(_idle, key)) {
+      return {this, std::move(key), std::move(conn), /*reused=*/true};
+    }
+    auto session_itr = _sessions.find(key);
+    if (session_itr != _sessions.end()) {
+      // Hold a reference so the session outlives a concurrent replacement.
+      session = session_itr->second.get();
+      SSL_SESSION_up_ref(session);
+    }
+  }
+
+  session_ptr session_ref{session};
+  std::unique_ptr<connection> conn =
+      make_connection(u, _ssl_context, session_ref.get());
+  if (session && !SSL_session_reused(conn->stream().native_handle())) {
+    LOG(INFO) << "TLS session for " << key << " was not resumed.";
+  }
+
+  std::lock_guard lock{_mutex};
+  _save_session_locked(key, *conn);
+  return {this, std::move(key), std::move(conn), /*reused=*/false};
+}
+
+pooled_connection<insecure_connection>
+connection_pool::acquire_insecure(const url& u) {
+  std::string key = make_key(u);
+  {
+    std::lock_guard lock{_mutex};
+    _evict_expired_locked(_idle_insecure);
+    if (std::unique_ptr<insecure_connection> conn =
+            _take_idle_locked(_idle_insecure, key)) {
+      return {this, std::move(key), std::move(conn), /*reused=*/true};
+    }
+  }
+  return {
+      this,
+      std::move(key),
+      make_insecure_connection(u),
+      /*reused=*/false};
+}
+
+void connection_pool::drop_idle(const url& u) {
+  std::string key = make_key(u);
+  std::lock_guard lock{_mutex};
+  _idle.erase(key);
+  _idle_insecure.erase(key);
+}
+
+std::size_t connection_pool::idle_count() const {
+  std::lock_guard lock{_mutex};
+  std::size_t count = 0;
+  for (const auto& [key, conns] : _idle) count += conns.size();
+  for (const auto& [key, conns] : _idle_insecure) count += conns.size();
+  return count;
+}
+
+void connection_pool::_release(
+    std::string key, std::unique_ptr<connection> conn) {
+  std::lock_guard lock{_mutex};
+  // Servers frequently issue session tickets after the first response rather
+  // than during the handshake, so refresh the saved session on every release.
+  _save_session_locked(key, *conn);
+  _return_idle_locked(_idle, std::move(key), std::move(conn));
+}
+
+void connection_pool::_release(
+    std::string key, std::unique_ptr<insecure_connection> conn) {
+  std::lock_guard lock{_mutex};
+  _return_idle_locked(_idle_insecure, std::move(key), std::move(conn));
+}
+
+template <typename Connection>
+std::unique_ptr<Connection> connection_pool::_take_idle_locked(
+    idle_map<Connection>& idle, const std::string& key) {
+  auto itr = idle.find(key);
+  if (itr == idle.end() || itr->second.empty()) return nullptr;
+
+  // Most recently released connections are at the back and least likely to
+  // have been closed by the server.
+  std::unique_ptr<Connection> conn = std::move(itr->second.back().conn);
+  itr->second.pop_back();
+  return conn;
+}
+
+template <typename Connection>
+void connection_pool::_evict_expired_locked(idle_map<Connection>& idle) {
+  steady_clock::time_point expired_before =
+      steady_clock::now() - _options.idle_timeout;
+  for (auto itr = idle.begin(); itr != idle.end();) {
+    auto& conns = itr->second;
+    while (!conns.empty() && conns.front().released_at < expired_before) {
+      conns.pop_front();
+    }
+    itr = conns.empty() ? idle.erase(itr) : std::next(itr);
+  }
+}
+
+template <typename Connection>
+void connection_pool::_return_idle_locked(
+    idle_map<Connection>& idle,
+    std::string key,
+    std::unique_ptr<Connection> conn) {
+  auto& conns = idle[std::move(key)];
+  conns.push_back(
+      {.conn = std::move(conn), .released_at = steady_clock::now()});
+  while (conns.size() > _options.max_idle_per_host) conns.pop_front();
+}
+
+void connection_pool::_save_session_locked(
+    const std::string& key, connection& conn) {
+  SSL_SESSION* session = SSL_get1_session(conn.stream().native_handle());
+  if (!session) return;
+  if (!SSL_SESSION_is_resumable(session)) {
+    SSL_SESSION_free(session);
+    return;
+  }
+  _sessions[key].reset(session);
+}
+
+} // namespace howling::net
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "boost/asio/ssl.hpp"
+#include "boost/beast/core/flat_buffer.hpp"
+#include "boost/beast/http/message.hpp"
+#include "boost/beast/http/read.hpp"
+#include "boost/beast/http/string_body.hpp"
+#include "boost/beast/http/verb.hpp"
+#include "boost/beast/http/write.hpp"
+#include "boost/system/error_code.hpp"
+#include "boost/system/system_error.hpp"
+#include "net/connect.h"
+#include "net/url.h"
+#include "openssl/ssl.h"
+
+namespace howling::net {
+
+class connection_pool;
+
+/**
+ * @brief A connection borrowed from a `connection_pool`.
+ *
+ * The connection is handed back to the pool when this handle is destroyed
+ * unless it has been discarded first. Handles are movable but not copyable.
+ */
+template <typename Connection>
+class pooled_connection {
+public:
+  pooled_connection(pooled_connection&& other) noexcept
+      : _pool{other._pool}, _key{std::move(other._key)},
+        _conn{std::move(other._conn)}, _reused{other._reused} {}
+  pooled_connection& operator=(pooled_connection&&) = delete;
+  pooled_connection(const pooled_connection&) = delete;
+  pooled_connection& operator=(const pooled_connection&) = delete;
+  ~pooled_connection();
+
+  Connection& operator*() const { return *_conn; }
+  Connection* operator->() const { return _conn.get(); }
+
+  /**
+   * @brief True if this connection was taken from the idle set instead of
+   * being freshly established.
+   */
+  [[nodiscard]] bool reused() const { return _reused; }
+
+  /**
+   * @brief Closes the connection instead of returning it to the pool.
+   *
+   * Must be called whenever the connection is left in an unknown state, such
+   * as after an I/O error or a partially read response.
+   */
+  void discard() { _conn = nullptr; }
+
+private:
+  friend class connection_pool;
+
+  pooled_connection(
+      connection_pool* pool,
+      std::string key,
+      std::unique_ptr<Connection> conn,
+      bool reused)
+      : _pool{pool}, _key{std::move(key)}, _conn{std::move(conn)},
+        _reused{reused} {}
+
+  connection_pool* _pool;
+  std::string _key;
+  std::unique_ptr<Connection> _conn;
+  bool _reused;
+};
+
+/**
+ * @brief Returns true if the error indicates the peer closed a kept-alive
+ * connection, meaning the request may be safely retried on a new connection.
+ */
+bool is_stale_connection_error(const boost::system::error_code& code);
+
+/**
+ * @brief Returns true if repeating a request with this method has the same
+ * effect as sending it once.
+ */
+bool is_idempotent(boost::beast::http::verb method);
+
+/**
+ * @brief A pool of HTTP/1.1 keep-alive connections keyed by host and service.
+ *
+ * TLS connections to the same host share one SSL context and resume the most
+ * recent session, so reconnects skip the full handshake. Connections idle for
+ * longer than `options::idle_timeout` are evicted when the pool is next used.
+ *
+ * This class is internally synchronized. Borrowed connections are exclusively
+ * owned by their borrower until returned.
+ */
+class connection_pool {
+public:
+  struct options {
+    std::chrono::steady_clock::duration idle_timeout = std::chrono::seconds(50);
+    std::size_t max_idle_per_host = 4;
+  };
+
+  /**
+   * @brief Returns the process-wide pool configured from command line flags.
+   */
+  static connection_pool& get_instance();
+
+  explicit connection_pool(options opts);
+  ~connection_pool();
+
+  connection_pool(const connection_pool&) = delete;
+  connection_pool& operator=(const connection_pool&) = delete;
+
+  /**
+   * @brief Borrows an idle TLS connection to the host, or opens a new one.
+   */
+  pooled_connection<connection> acquire(const url& u);
+
+  /**
+   * @brief Borrows an idle plain TCP connection to the host, or opens a new
+   * one.
+   */
+  pooled_connection<insecure_connection> acquire_insecure(const url& u);
+
+  /**
+   * @brief Sends the request over a pooled TLS connection and reads the full
+   * response.
+   *
+   * If a reused connection turns out to have been closed by the server, the
+   * request is transparently retried once on a fresh connection. Requests with
+   * non-idempotent methods are only retried if none of the request was
+   * written, so an order is never submitted twice.
+   *
+   * @throws boost::system::system_error on network failure.
+   */
+  template <
+      typename ResponseBody = boost::beast::http::string_body,
+      typename RequestBody>
+  boost::beast::http::response<ResponseBody>
+  send(const url& u, const boost::beast::http::request<RequestBody>& req) {
+    return _send<ResponseBody>([&]() { return acquire(u); }, u, req);
+  }
+
+  /**
+   * @brief Same as `send`, but over a plain TCP connection.
+   */
+  template <
+      typename ResponseBody = boost::beast::http::string_body,
+      typename RequestBody>
+  boost::beast::http::response<ResponseBody> send_insecure(
+      const url& u, const boost::beast::http::request<RequestBody>& req) {
+    return _send<ResponseBody>([&]() { return acquire_insecure(u); }, u, req);
+  }
+
+  /**
+   * @brief Closes every idle connection to the given host.
+   */
+  void drop_idle(const url& u);
+
+  [[nodiscard]] std::size_t idle_count() const;
+
+private:
+  template <typename Connection>
+  friend class pooled_connection;
+
+  template <typename Connection>
+  struct idle_connection {
+    std::unique_ptr<Connection> conn;
+    std::chrono::steady_clock::time_point released_at;
+  };
+
+  template <typename Connection>
+  using idle_map =
+      std::unordered_map<std::string, std::list<idle_connection<Connection>>>;
+
+  struct session_deleter {
+    void operator()(SSL_SESSION* session) const { SSL_SESSION_free(session); }
+  };
+  using session_ptr = std::unique_ptr<SSL_SESSION, session_deleter>;
+
+  template <typename ResponseBody, typename Acquire, typename RequestBody>
+  boost::beast::http::response<ResponseBody> _send(
+      Acquire acquire,
+      const url& u,
+      const boost::beast::http::request<RequestBody>& req);
+
+  template <typename ResponseBody, typename Connection, typename RequestBody>
+  static boost::beast::http::response<ResponseBody> _round_trip(
+      pooled_connection<Connection>& conn,
+      const boost::beast::http::request<RequestBody>& req,
+      bool& written);
+
+  void _release(std::string key, std::unique_ptr<connection> conn);
+  void _release(std::string key, std::unique_ptr<insecure_connection> conn);
+
+  template <typename Connection>
+  std::unique_ptr<Connection>
+  _take_idle_locked(idle_map<Connection>& idle, const std::string& key);
+
+  template <typename Connection>
+  void _evict_expired_locked(idle_map<Connection>& idle);
+
+  template <typename Connection>
+  void _return_idle_locked(
+      idle_map<Connection>& idle,
+      std::string key,
+      std::unique_ptr<Connection> conn);
+
+  void _save_session_locked(const std::string& key, connection& conn);
+
+  const options _options;
+  std::shared_ptr<boost::asio::ssl::context> _ssl_context;
+
+  mutable std::mutex _mutex;
+  idle_map<connection> _idle;
+  idle_map<insecure_connection> _idle_insecure;
+  std::unordered_map<std::string, session_ptr> _sessions;
+};
+
+// MARK: Template implementations
+
+template <typename Connection>
+pooled_connection<Connection>::~pooled_connection() {
+  if (_pool && _conn) _pool->_release(std::move(_key), std::move(_conn));
+}
+
+template <typename ResponseBody, typename Acquire, typename RequestBody>
+boost::beast::http::response<ResponseBody> connection_pool::_send(
+    Acquire acquire,
+    const url& u,
+    const boost::beast::http::request<RequestBody>& req) {
+  {
+    auto conn = acquire();
+    bool written = false;
+    try {
+      return _round_trip<ResponseBody>(conn, req, written);
+    } catch (const boost::system::system_error& err) {
+      conn.discard();
+      if (!conn.reused() || !is_stale_connection_error(err.code())) throw;
+      if (written && !is_idempotent(req.method())) throw;
+    }
+  }
+
+  // The server closed the kept-alive connection while it sat idle. Any other
+  // idle connections to the host are likely stale too, so drop them all before
+  // retrying on a fresh connection.
+  drop_idle(u);
+  auto conn = acquire();
+  bool written = false;
+  try {
+    return _round_trip<ResponseBody>(conn, req, written);
+  } catch (...) {
+    conn.discard();
+    throw;
+  }
+}
+
+template <typename ResponseBody, typename Connection, typename RequestBody>
+boost::beast::http::response<ResponseBody> connection_pool::_round_trip(
+    pooled_connection<Connection>& conn,
+    const boost::beast::http::request<RequestBody>& req,
+    bool& written) {
+  boost::system::error_code code;
+  std::size_t sent = boost::beast::http::write(conn->stream(), req, code);
+  // Part of a request may still reach the server before the connection fails.
+  written = sent > 0;
+  if (code) throw boost::system::system_error{code};
+  boost::beast::flat_buffer buffer;
+  boost::beast::http::response<ResponseBody> res;
+  boost::beast::http::read(conn->stream(), buffer, res);
+  if (!res.keep_alive()) conn.discard();
+  return res;
+}
+
+} // namespace howling::net
@@ -0,0 +1,239 @@
+#include "net/connection_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "boost/asio/ip/address.hpp"
+#include "boost/asio/ip/tcp.hpp"
+#include "boost/beast/core/error.hpp"
+#include "boost/beast/core/flat_buffer.hpp"
+#include "boost/beast/http/message.hpp"
+#include "boost/beast/http/read.hpp"
+#include "boost/beast/http/string_body.hpp"
+#include "boost/beast/http/verb.hpp"
+#include "boost/beast/http/write.hpp"
+#include "boost/system/system_error.hpp"
+#include "gtest/gtest.h"
+#include "net/url.h"
+
+namespace howling::net {
+namespace {
+
+namespace asio = ::boost::asio;
+namespace beast = ::boost::beast;
+namespace http = ::boost::beast::http;
+
+using namespace std::chrono_literals;
+
+/**
+ * A plain HTTP server on a local port which answers every request with "ok"
+ * and counts the connections and requests it sees.
+ *
+ * Connections are served one at a time, so a test must not hold one connection
+ * while opening another.
+ */
+class test_server {
+public:
+  test_server()
+      : _acceptor{_io_context, {asio::ip::make_address("127.0.0.1"), 0}},
+        _thread{[this]() { _run(); }} {}
+
+  ~test_server() {
+    _stopping = true;
+    // Wakes the accept call so the thread sees it is stopping.
+    asio::ip::tcp::socket socket{_io_context};
+    socket.connect(_acceptor.local_endpoint());
+  }
+
+  url target() const {
+    return {
+        .service = std::to_string(_acceptor.local_endpoint().port()),
+        .host = "127.0.0.1",
+        .target = "/"};
+  }
+
+  int connections() const { return _connections; }
+  int requests() const { return _requests; }
+
+  /**
+   * @brief Closes every connection after this many responses, without telling
+   * the client it will.
+   */
+  void close_after(int responses) { _close_after = responses; }
+
+  /** @brief Closes every connection after reading a request. */
+  void drop_requests() { _drop_requests = true; }
+
+  /** @brief Blocks until the server has closed `count` connections. */
+  void wait_for_closed(int count) const {
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + 5s;
+    while (_closed < count && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_GE(_closed, count);
+  }
+
+private:
+  void _run() {
+    while (true) {
+      asio::ip::tcp::socket socket{_io_context};
+      _acceptor.accept(socket);
+      if (_stopping) return;
+      ++_connections;
+      _serve(socket);
+      ++_closed;
+    }
+  }
+
+  void _serve(asio::ip::tcp::socket& socket) {
+    beast::flat_buffer buffer;
+    for (int responses = 1;; ++responses) {
+      beast::error_code code;
+      http::request<http::string_body> req;
+      http::read(socket, buffer, req, code);
+      if (code) return;
+      ++_requests;
+      if (_drop_requests) return;
+
+      http::response<http::string_body> res{http::status::ok, req.version()};
+      res.keep_alive(req.keep_alive());
+      res.body() = "ok";
+      res.prepare_payload();
+      http::write(socket, res, code);
+      if (code || responses == _close_after) return;
+    }
+  }
+
+  asio::io_context _io_context;
+  asio::ip::tcp::acceptor _acceptor;
+  std::atomic_bool _stopping = false;
+  std::atomic_int _close_after = 0;
+  std::atomic_bool _drop_requests = false;
+  std::atomic_int _connections = 0;
+  std::atomic_int _requests = 0;
+  std::atomic_int _closed = 0;
+  std::jthread _thread;
+};
+
+http::request<http::string_body> make_request(http::verb method) {
+  http::request<http::string_body> req{method, "/", 11};
+  req.set(http::field::host, "127.0.0.1");
+  req.prepare_payload();
+  return req;
+}
+
+// MARK: acquire
+
+TEST(ConnectionPool, ReusesReturnedConnections) {
+  test_server server;
+  connection_pool pool{{}};
+
+  http::response<http::string_body> res =
+      pool.send_insecure(server.target(), make_request(http::verb::get));
+  EXPECT_EQ(res.body(), "ok");
+  EXPECT_EQ(pool.idle_count(), 1);
+
+  {
+    pooled_connection<insecure_connection> conn =
+        pool.acquire_insecure(server.target());
+    EXPECT_TRUE(conn.reused());
+    EXPECT_EQ(pool.idle_count(), 0);
+  }
+  res = pool.send_insecure(server.target(), make_request(http::verb::get));
+  EXPECT_EQ(res.body(), "ok");
+  EXPECT_EQ(server.connections(), 1);
+  EXPECT_EQ(server.requests(), 2);
+}
+
+TEST(ConnectionPool, EvictsIdleConnections) {
+  test_server server;
+  connection_pool pool{{.idle_timeout = 1ms}};
+
+  pool.send_insecure(server.target(), make_request(http::verb::get));
+  EXPECT_EQ(pool.idle_count(), 1);
+  std::this_thread::sleep_for(10ms);
+
+  pooled_connection<insecure_connection> conn =
+      pool.acquire_insecure(server.target());
+  EXPECT_FALSE(conn.reused());
+  EXPECT_EQ(pool.idle_count(), 0);
+}
+
+TEST(ConnectionPool, KeepsAtMostMaxIdlePerHost) {
+  test_server server;
+  connection_pool pool{{.max_idle_per_host = 0}};
+
+  pool.send_insecure(server.target(), make_request(http::verb::get));
+  EXPECT_EQ(pool.idle_count(), 0);
+}
+
+// MARK: send
+
+TEST(ConnectionPool, RetriesStaleConnectionOnce) {
+  test_server server;
+  server.close_after(1);
+  connection_pool pool{{}};
+
+  pool.send_insecure(server.target(), make_request(http::verb::get));
+  server.wait_for_closed(1);
+
+  http::response<http::string_body> res =
+      pool.send_insecure(server.target(), make_request(http::verb::get));
+  EXPECT_EQ(res.body(), "ok");
+  EXPECT_EQ(server.connections(), 2);
+  EXPECT_EQ(server.requests(), 2);
+}
+
+TEST(ConnectionPool, DoesNotRetryFailedRetry) {
+  test_server server;
+  server.close_after(1);
+  connection_pool pool{{}};
+
+  pool.send_insecure(server.target(), make_request(http::verb::get));
+  server.wait_for_closed(1);
+  server.drop_requests();
+
+  EXPECT_THROW(
+      pool.send_insecure(server.target(), make_request(http::verb::get)),
+      boost::system::system_error);
+  EXPECT_EQ(server.connections(), 2);
+  EXPECT_EQ(pool.idle_count(), 0);
+}
+
+TEST(ConnectionPool, DoesNotRetryWrittenNonIdempotentRequest) {
+  test_server server;
+  server.close_after(1);
+  connection_pool pool{{}};
+
+  pool.send_insecure(server.target(), make_request(http::verb::get));
+  server.wait_for_closed(1);
+
+  EXPECT_THROW(
+      pool.send_insecure(server.target(), make_request(http::verb::post)),
+      boost::system::system_error);
+  EXPECT_EQ(server.connections(), 1);
+}
+
+TEST(ConnectionPool, DoesNotRetryPartlyWrittenNonIdempotentRequest) {
+  test_server server;
+  server.close_after(1);
+  connection_pool pool{{}};
+
+  pool.send_insecure(server.target(), make_request(http::verb::get));
+  server.wait_for_closed(1);
+
+  // Too large for the socket's buffers, so the write fails partway through
+  // once the closed connection is reset.
+  http::request<http::string_body> req = make_request(http::verb::post);
+  req.body().assign(64 << 20, 'x');
+  req.prepare_payload();
+  EXPECT_THROW(
+      pool.send_insecure(server.target(), req), boost::system::system_error);
+  EXPECT_EQ(server.connections(), 1);
+}
+
+} // namespace
+} // namespace howling::net
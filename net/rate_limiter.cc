@@ -0,0 +1,155 @@
+#include "net/rate_limiter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+
+#include "absl/strings/str_cat.h"
+
+namespace howling::net {
+namespace {
+
+using ::std::chrono::steady_clock;
+
+constexpr std::errc NO_ERROR{};
+
+} // namespace
+
+rate_limiter& rate_limiter::get_instance() {
+  static rate_limiter instance;
+  return instance;
+}
+
+void rate_limiter::acquire(
+    std::initializer_list<rate_limit> limits, request_priority priority) {
+  std::unique_lock lock{_mutex};
+  waiter self{.priority = priority, .ticket = _next_ticket++};
+  for (const rate_limit& limit : limits) {
+    _configure_locked(limit);
+    self.buckets.emplace_back(limit.bucket);
+  }
+  auto self_itr = _waiters.insert(_waiters.end(), std::move(self));
+
+  while (true) {
+    if (!_is_next_locked(*self_itr)) {
+      _changed.wait(lock);
+      continue;
+    }
+    steady_clock::time_point now = steady_clock::now();
+    steady_clock::time_point ready_at = _ready_at_locked(*self_itr, now);
+    if (ready_at <= now) break;
+    _changed.wait_until(lock, ready_at);
+  }
+
+  for (const std::string& name : self_itr->buckets) {
+    _buckets.at(name).tokens -= 1;
+  }
+  _waiters.erase(self_itr);
+  lock.unlock();
+  _changed.notify_all();
+}
+
+void rate_limiter::retry_after(
+    std::string_view bucket, steady_clock::duration delay) {
+  {
+    std::lock_guard lock{_mutex};
+    bucket_state& state = _buckets[std::string{bucket}];
+    steady_clock::time_point until = steady_clock::now() + delay;
+    if (until <= state.blocked_until) return;
+
+    // Let a single request through to probe once the pause is over.
+    state.blocked_until = until;
+    state.refilled_at = until;
+    state.tokens = std::min(state.tokens, 1.0);
+  }
+  _changed.notify_all();
+}
+
+rate_limiter::bucket_state&
+rate_limiter::_configure_locked(const rate_limit& limit) {
+  if (limit.requests_per_minute <= 0 || limit.burst < 1) {
+    throw std::invalid_argument(
+        absl::StrCat(
+            "Invalid rate limit for bucket ",
+            limit.bucket,
+            ": ",
+            limit.requests_per_minute,
+            " requests per minute with a burst of ",
+            limit.burst));
+  }
+
+  auto [itr, inserted] = _buckets.try_emplace(std::string{limit.bucket});
+  bucket_state& state = itr->second;
+  if (inserted) {
+    state.tokens = limit.burst;
+    state.refilled_at = steady_clock::now();
+  }
+  state.tokens_per_second = limit.requests_per_minute / 60.0;
+  state.burst = limit.burst;
+  return state;
+}
+
+bool rate_limiter::_is_next_locked(const waiter& w) const {
+  for (const waiter& other : _waiters) {
+    if (&other == &w) continue;
+    if (std::tie(other.priority, other.ticket) >
+        std::tie(w.priority, w.ticket)) {
+      continue;
+    }
+    for (const std::string& name : other.buckets) {
+      if (std::ranges::find(w.buckets, name) != w.buckets.end()) return false;
+    }
+  }
+  return true;
+}
+
+steady_clock::time_point
+rate_limiter::_ready_at_locked(const waiter& w, steady_clock::time_point now) {
+  steady_clock::time_point ready_at = now;
+  for (const std::string& name : w.buckets) {
+    bucket_state& state = _buckets.at(name);
+    if (now > state.refilled_at) {
+      std::chrono::duration<double> elapsed = now - state.refilled_at;
+      state.tokens = std::min<double>(
+          state.burst,
+          state.tokens + elapsed.count() * state.tokens_per_second);
+      state.refilled_at = now;
+    }
+
+    ready_at = std::max(ready_at, state.blocked_until);
+    if (state.tokens < 1) {
+      std::chrono::duration<double> refill_time{
+          (1 - state.tokens) / state.tokens_per_second};
+      ready_at = std::max(
+          ready_at,
+          std::max(now, state.refilled_at) +
+              std::chrono::duration_cast<steady_clock::duration>(refill_time));
+    }
+  }
+  return ready_at;
+}
+
+steady_clock::duration parse_retry_after(
+    std::string_view header, steady_clock::duration fallback) {
+  while (!header.empty() && header.front() == ' ') header.remove_prefix(1);
+  while (!header.empty() && header.back() == ' ') header.remove_suffix(1);
+
+  int64_t seconds = 0;
+  auto [end, ec] =
+      std::from_chars(header.data(), header.data() + header.size(), seconds);
+  if (header.empty() || ec != NO_ERROR ||
+      end != header.data() + header.size() || seconds < 0) {
+    return fallback;
+  }
+  return std::chrono::seconds{seconds};
+}
+
+} // namespace howling::net
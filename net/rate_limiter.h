@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <initializer_list>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace howling::net {
+
+/**
+ * @brief Relative importance of a request when a rate limit is contended.
+ *
+ * Lower values are served first.
+ */
+enum class request_priority : int {
+  ORDER = 0,
+  AUTHENTICATION = 1,
+  STREAMING_LOGIN = 2,
+  ACCOUNT = 3,
+  HISTORY = 4,
+};
+
+/**
+ * @brief A request budget for one bucket.
+ *
+ * Buckets refill continuously at `requests_per_minute` and hold at most
+ * `burst` unused requests.
+ */
+struct rate_limit {
+  std::string_view bucket;
+  double requests_per_minute;
+  int burst = 1;
+};
+
+/**
+ * @brief A token-bucket scheduler shared by every API client in the process.
+ *
+ * A request names each bucket it draws from, typically one for the provider
+ * and optionally one for the endpoint, and waits until all of them have a
+ * token. When requests queue on a bucket, tokens go to the highest priority
+ * request first, then in arrival order.
+ *
+ * This class is internally synchronized.
+ */
+class rate_limiter {
+public:
+  /** @brief Returns the process-wide rate limiter. */
+  static rate_limiter& get_instance();
+
+  rate_limiter() = default;
+  rate_limiter(const rate_limiter&) = delete;
+  rate_limiter& operator=(const rate_limiter&) = delete;
+
+  /**
+   * @brief Blocks until a request may be sent under every one of the limits.
+   *
+   * Buckets are created on first use. Later calls update the bucket's rate and
+   * burst if they differ, so limits may be driven by flags.
+   */
+  void acquire(
+      std::initializer_list<rate_limit> limits, request_priority priority);
+
+  /**
+   * @brief Pauses the bucket after the server asked clients to back off, for
+   * instance with a 429 response.
+   */
+  void retry_after(
+      std::string_view bucket, std::chrono::steady_clock::duration delay);
+
+private:
+  struct bucket_state {
+    double tokens = 0;
+    double tokens_per_second = 0;
+    int burst = 1;
+    std::chrono::steady_clock::time_point refilled_at;
+    std::chrono::steady_clock::time_point blocked_until;
+  };
+
+  struct waiter {
+    request_priority priority;
+    uint64_t ticket;
+    std::vector<std::string> buckets;
+  };
+
+  bucket_state& _configure_locked(const rate_limit& limit);
+  bool _is_next_locked(const waiter& w) const;
+  std::chrono::steady_clock::time_point
+  _ready_at_locked(const waiter& w, std::chrono::steady_clock::time_point now);
+
+  std::mutex _mutex;
+  std::condition_variable _changed;
+  std::unordered_map<std::string, bucket_state> _buckets;
+  std::list<waiter> _waiters;
+  uint64_t _next_ticket = 0;
+};
+
+/**
+ * @brief Parses the delay from a `Retry-After` header given in seconds.
+ *
+ * @return The delay, or `fallback` if the header is missing or is not a number
+ * of seconds.
+ */
+std::chrono::steady_clock::duration parse_retry_after(
+    std::string_view header, std::chrono::steady_clock::duration fallback);
+
+} // namespace howling::net
@@ -0,0 +1,122 @@
+#include "net/rate_limiter.h"
+
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace howling::net {
+namespace {
+
+using ::std::chrono::milliseconds;
+using ::std::chrono::steady_clock;
+using ::testing::ElementsAre;
+
+// 600 requests per minute refills one token every 100ms.
+constexpr rate_limit TEN_PER_SECOND{
+    .bucket = "test", .requests_per_minute = 600};
+
+// MARK: acquire
+
+TEST(RateLimiter, BurstIsAvailableImmediately) {
+  rate_limiter limiter;
+  steady_clock::time_point start = steady_clock::now();
+  for (int i = 0; i < 5; ++i) {
+    limiter.acquire(
+        {{.bucket = "test", .requests_per_minute = 60, .burst = 5}},
+        request_priority::HISTORY);
+  }
+  EXPECT_LT(steady_clock::now() - start, milliseconds(50));
+}
+
+TEST(RateLimiter, PacesRequestsAfterBurst) {
+  rate_limiter limiter;
+  limiter.acquire({TEN_PER_SECOND}, request_priority::HISTORY);
+  steady_clock::time_point start = steady_clock::now();
+  limiter.acquire({TEN_PER_SECOND}, request_priority::HISTORY);
+  limiter.acquire({TEN_PER_SECOND}, request_priority::HISTORY);
+  EXPECT_GE(steady_clock::now() - start, milliseconds(150));
+}
+
+TEST(RateLimiter, WaitsForEveryBucket) {
+  rate_limiter limiter;
+  rate_limit endpoint{.bucket = "endpoint", .requests_per_minute = 600};
+  rate_limit provider{
+      .bucket = "provider", .requests_per_minute = 6000, .burst = 10};
+  limiter.acquire({provider, endpoint}, request_priority::ORDER);
+  steady_clock::time_point start = steady_clock::now();
+  limiter.acquire({provider, endpoint}, request_priority::ORDER);
+  EXPECT_GE(steady_clock::now() - start, milliseconds(80));
+
+  // The provider bucket alone still has burst remaining.
+  start = steady_clock::now();
+  limiter.acquire({provider}, request_priority::HISTORY);
+  EXPECT_LT(steady_clock::now() - start, milliseconds(50));
+}
+
+TEST(RateLimiter, ServesHigherPriorityFirst) {
+  rate_limiter limiter;
+  limiter.acquire({TEN_PER_SECOND}, request_priority::HISTORY);
+
+  std::mutex order_mutex;
+  std::vector<request_priority> order;
+  auto request = [&](request_priority priority) {
+    limiter.acquire({TEN_PER_SECOND}, priority);
+    std::lock_guard lock{order_mutex};
+    order.push_back(priority);
+  };
+
+  std::thread history{request, request_priority::HISTORY};
+  std::this_thread::sleep_for(milliseconds(20));
+  std::thread order_request{request, request_priority::ORDER};
+  history.join();
+  order_request.join();
+
+  EXPECT_THAT(
+      order, ElementsAre(request_priority::ORDER, request_priority::HISTORY));
+}
+
+TEST(RateLimiter, RejectsInvalidLimits) {
+  rate_limiter limiter;
+  EXPECT_THROW(
+      limiter.acquire(
+          {{.bucket = "test", .requests_per_minute = 0}},
+          request_priority::HISTORY),
+      std::invalid_argument);
+}
+
+// MARK: retry_after
+
+TEST(RateLimiter, RetryAfterPausesBucket) {
+  rate_limiter limiter;
+  rate_limit limit{.bucket = "test", .requests_per_minute = 6000, .burst = 10};
+  limiter.acquire({limit}, request_priority::HISTORY);
+  limiter.retry_after("test", milliseconds(150));
+
+  steady_clock::time_point start = steady_clock::now();
+  limiter.acquire({limit}, request_priority::ORDER);
+  EXPECT_GE(steady_clock::now() - start, milliseconds(140));
+}
+
+// MARK: parse_retry_after
+
+TEST(ParseRetryAfter, ParsesSeconds) {
+  EXPECT_EQ(parse_retry_after("5", milliseconds(1)), std::chrono::seconds(5));
+  EXPECT_EQ(
+      parse_retry_after(" 12 ", milliseconds(1)), std::chrono::seconds(12));
+}
+
+TEST(ParseRetryAfter, FallsBackOnOtherFormats) {
+  EXPECT_EQ(parse_retry_after("", milliseconds(7)), milliseconds(7));
+  EXPECT_EQ(
+      parse_retry_after("Wed, 21 Oct 2015 07:28:00 GMT", milliseconds(7)),
+      milliseconds(7));
+  EXPECT_EQ(parse_retry_after("-3", milliseconds(7)), milliseconds(7));
+}
+
+} // namespace
+} // namespace howling::net
@@ -13,6 +13,8 @@
 #include "boost/beast/http/write.hpp"
 #include "boost/beast/version.hpp"
 #include "net/connect.h"
+#include "net/connection_pool.h"
+#include "net/url.h"
 #include "strings/json.h"
 #include "json/value.h"
 
@@ -22,20 +24,32 @@ namespace {
 namespace beast = ::boost::beast;
 namespace http = ::boost::beast::http;
 
-template <typename Stream>
-http::response<http::string_body> do_post(
-    Stream& stream,
-    std::string_view host,
-    std::string_view target,
-    const Json::Value& body) {
+http::request<http::string_body> make_post(
+    std::string_view host, std::string_view target, const Json::Value& body) {
   http::request<http::string_body> req{http::verb::post, target, 11};
   req.set(http::field::host, host);
   req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
   req.set(http::field::content_type, "application/json");
   req.body() = howling::to_string(body);
   req.prepare_payload();
+  return req;
+}
 
-  http::write(stream, req);
+http::request<http::empty_body>
+make_get(std::string_view host, std::string_view target) {
+  http::request<http::empty_body> req{http::verb::get, target, 11};
+  req.set(http::field::host, host);
+  req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+  return req;
+}
+
+template <typename Stream>
+http::response<http::string_body> do_post(
+    Stream& stream,
+    std::string_view host,
+    std::string_view target,
+    const Json::Value& body) {
+  http::write(stream, make_post(host, target, body));
 
   beast::flat_buffer buffer;
   http::response<http::string_body> res;
@@ -64,11 +78,7 @@ http::response<http::string_body> post(
 
 http::response<http::string_body>
 get(insecure_connection& conn, std::string_view host, std::string_view target) {
-  http::request<http::empty_body> req{http::verb::get, target, 11};
-  req.set(http::field::host, host);
-  req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-
-  http::write(conn.stream(), req);
+  http::write(conn.stream(), make_get(host, target));
 
   beast::flat_buffer buffer;
   http::response<http::string_body> res;
@@ -77,4 +87,14 @@ get(insecure_connection& conn, std::string_view host, std::string_view target) {
   return res;
 }
 
+http::response<http::string_body>
+get_insecure(connection_pool& pool, const url& u) {
+  return pool.send_insecure(u, make_get(u.host, u.target));
+}
+
+http::response<http::string_body>
+post_insecure(connection_pool& pool, const url& u, const Json::Value& body) {
+  return pool.send_insecure(u, make_post(u.host, u.target, body));
+}
+
 } // namespace howling::net
@@ -5,6 +5,8 @@
 #include "boost/beast/http/message_fwd.hpp"
 #include "boost/beast/http/string_body_fwd.hpp"
 #include "net/connect.h"
+#include "net/connection_pool.h"
+#include "net/url.h"
 #include "json/value.h"
 
 namespace howling::net {
@@ -57,4 +59,30 @@ boost::beast::http::response<boost::beast::http::string_body> post(
 boost::beast::http::response<boost::beast::http::string_body>
 get(insecure_connection& conn, std::string_view host, std::string_view target);
 
+/**
+ * @brief Sends an HTTP GET request over a pooled insecure connection.
+ *
+ * @param pool The pool to borrow the connection from.
+ * @param u The host, service and target to request.
+ * @return The HTTP response.
+ *
+ * @throws std::runtime_error on failure.
+ */
+boost::beast::http::response<boost::beast::http::string_body>
+get_insecure(connection_pool& pool, const url& u);
+
+/**
+ * @brief Sends an HTTP POST request with a JSON body over a pooled insecure
+ * connection.
+ *
+ * @param pool The pool to borrow the connection from.
+ * @param u The host, service and target to request.
+ * @param body The JSON body to send.
+ * @return The HTTP response.
+ *
+ * @throws std::runtime_error on failure.
+ */
+boost::beast::http::response<boost::beast::http::string_body>
+post_insecure(connection_pool& pool, const url& u, const Json::Value& body);
+
 } // namespace howling::net
@@ -13,13 +13,12 @@
 #include "absl/flags/flag.h"
 #include "absl/log/log.h"
 #include "absl/time/time.h"
-#include "api/schwab/connect.h"
 #include "api/schwab/oauth.h"
 #include "google/protobuf/empty.pb.h"
 #include "grpcpp/grpcpp.h"
 #include "grpcpp/security/credentials.h"
 #include "grpcpp/support/status.h"
-#include "net/connect.h"
+#include "net/connection_pool.h"
 #include "services/database.h"
 #include "services/db/schema/auth_token.h"
 #include "services/oauth/auth_client.h"
@@ -61,9 +60,8 @@ auto auth_token_pump_period() {
 class real_token_refresher : public token_refresher {
 public:
   schwab::oauth_tokens refresh_tokens(std::string_view refresh_token) override {
-    std::unique_ptr<net::connection> conn =
-        net::make_connection(schwab::make_net_url("/"));
-    return schwab::refresh_tokens(*conn, refresh_token);
+    return schwab::refresh_tokens(
+        net::connection_pool::get_instance(), refresh_token);
   }
 };
 
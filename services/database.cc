@@ -0,0 +1,107 @@
+#include "services/database.h"
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <generator>
+#include <queue>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+#include "data/candle.pb.h"
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+#include "time/conversion.h"
+
+namespace howling {
+namespace {
+
+using ::std::chrono::system_clock;
+
+/**
+ * Merges streams which are each ordered by time into one stream ordered by
+ * time, yielding each row with the index of the stream it came from.
+ *
+ * Rows with equal times are yielded in the order of their streams.
+ */
+template <typename T, typename TimeOf>
+std::generator<std::pair<std::size_t, T>>
+merge_by_time(std::vector<std::generator<T>> streams, TimeOf time_of) {
+  using iterator = std::ranges::iterator_t<std::generator<T>>;
+  using entry = std::pair<system_clock::time_point, std::size_t>;
+
+  std::vector<iterator> heads;
+  heads.reserve(streams.size());
+  std::priority_queue<entry, std::vector<entry>, std::greater<entry>> next;
+  for (std::size_t i = 0; i < streams.size(); ++i) {
+    heads.push_back(streams[i].begin());
+    if (heads[i] != streams[i].end()) next.emplace(time_of(*heads[i]), i);
+  }
+
+  while (!next.empty()) {
+    std::size_t i = next.top().second;
+    next.pop();
+    co_yield std::pair<std::size_t, T>{i, std::move(*heads[i])};
+    if (++heads[i] != streams[i].end()) next.emplace(time_of(*heads[i]), i);
+  }
+}
+
+} // namespace
+
+std::generator<symbol_candle> database::read_merged_candles(
+    std::vector<stock::Symbol> symbols,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  std::vector<std::generator<Candle>> streams;
+  streams.reserve(symbols.size());
+  for (stock::Symbol symbol : symbols) {
+    streams.push_back(read_candles(symbol, from, to));
+  }
+  auto opened_at = [](const Candle& candle) {
+    return to_std_chrono(candle.opened_at());
+  };
+  for (auto&& [i, candle] : merge_by_time(std::move(streams), opened_at)) {
+    symbol_candle row{.symbol = symbols[i], .candle = std::move(candle)};
+    co_yield std::move(row);
+  }
+}
+
+std::generator<Market> database::read_merged_market(
+    std::vector<stock::Symbol> symbols,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  std::vector<std::generator<Market>> streams;
+  streams.reserve(symbols.size());
+  for (stock::Symbol symbol : symbols) {
+    streams.push_back(read_market(symbol, from, to));
+  }
+  auto emitted_at = [](const Market& market) {
+    return to_std_chrono(market.emitted_at());
+  };
+  for (auto&& [i, market] : merge_by_time(std::move(streams), emitted_at)) {
+    co_yield std::move(market);
+  }
+}
+
+std::generator<candle_day> database::read_candle_days(
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  candle_day day;
+  system_clock::time_point day_end = system_clock::time_point::min();
+  for (Candle candle : read_candles(symbol, from, to)) {
+    system_clock::time_point opened_at = to_std_chrono(candle.opened_at());
+    if (opened_at >= day_end) {
+      if (!day.candles.empty()) co_yield std::exchange(day, {});
+      std::chrono::sys_days date =
+          std::chrono::floor<std::chrono::days>(opened_at);
+      day.date = std::chrono::year_month_day{date};
+      day_end = date + std::chrono::days{1};
+    }
+    day.candles.push_back(std::move(candle));
+  }
+  if (!day.candles.empty()) co_yield std::move(day);
+}
+
+} // namespace howling
@@ -1,13 +1,18 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
 #include <future>
 #include <generator>
 #include <memory>
+#include <span>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "data/analyzer.h"
 #include "data/candle.pb.h"
+#include "data/candle_block.h"
 #include "data/market.pb.h"
 #include "data/stock.pb.h"
 #include "data/trade.pb.h"
@@ -16,6 +21,45 @@
 
 namespace howling {
 
+/**
+ * @brief Lengths of candle which the database keeps.
+ *
+ * Saved candles are one minute long. The longer resolutions are rolled up from
+ * them as they are saved.
+ */
+enum class candle_resolution {
+  ONE_MINUTE,
+  FIVE_MINUTES,
+  ONE_HOUR,
+  ONE_DAY,
+};
+
+struct symbol_candle {
+  stock::Symbol symbol;
+  Candle candle;
+};
+
+/** @brief The candles opened on one UTC calendar day. */
+struct candle_day {
+  std::chrono::year_month_day date;
+  std::vector<Candle> candles;
+};
+
+/** @brief Reads candles into columnar blocks, many rows at a time. */
+class candle_block_reader {
+public:
+  virtual ~candle_block_reader() = default;
+
+  /**
+   * @brief Replaces the contents of `block` with up to `max_rows` of the next
+   * candles.
+   *
+   * @return The number of rows read, which is 0 once every candle has been
+   * read.
+   */
+  virtual std::size_t read(candle_block& block, std::size_t max_rows) = 0;
+};
+
 class database : public service {
 public:
   virtual ~database() = default;
@@ -40,12 +84,101 @@ public:
   virtual std::future<void>
   save(stock::Symbol symbol, const Candle& candle) = 0;
   virtual std::future<void> save(const Market& market) = 0;
+
+  /**
+   * @brief Saves many candles for one symbol in a single bulk write.
+   *
+   * Equivalent to saving each candle individually. The candles are copied
+   * before this returns.
+   */
+  virtual std::future<void>
+  save_batch(stock::Symbol symbol, std::span<const Candle> candles) = 0;
+  /**
+   * @brief Saves many market updates in a single bulk write.
+   *
+   * Equivalent to saving each update individually. The updates are copied
+   * before this returns.
+   */
+  virtual std::future<void> save_batch(std::span<const Market> markets) = 0;
   virtual std::future<void> save_trade(const trading::TradeRecord& trade) = 0;
   virtual std::future<void>
   save_refresh_token(std::string_view service_name, std::string_view token) = 0;
 
   virtual std::generator<Candle> read_candles(stock::Symbol symbol) = 0;
   virtual std::generator<Market> read_market(stock::Symbol symbol) = 0;
+
+  /**
+   * @brief Reads the symbol's candles opened within `[from, to)`, oldest
+   * first.
+   */
+  virtual std::generator<Candle> read_candles(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) = 0;
+  /**
+   * @brief Reads the symbol's candles of the given resolution opened within
+   * `[from, to)`, oldest first.
+   *
+   * Rolled up candles start on multiples of their length since the Unix
+   * epoch, so daily candles cover UTC days. Each one is updated as the candles
+   * within it are saved, and its duration is the sum of theirs.
+   */
+  virtual std::generator<Candle> read_candles(
+      stock::Symbol symbol,
+      candle_resolution resolution,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) = 0;
+  /**
+   * @brief Reads the symbol's market updates emitted within `[from, to)`,
+   * oldest first.
+   */
+  virtual std::generator<Market> read_market(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) = 0;
+
+  /**
+   * @brief Opens a reader over the symbol's candles opened within `[from, to)`,
+   * oldest first.
+   *
+   * Unlike `read_candles`, no `Candle` message is built for each row. The
+   * reader must not outlive the database.
+   */
+  virtual std::unique_ptr<candle_block_reader> read_candle_blocks(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) = 0;
+
+  /**
+   * @brief Reads the candles of several symbols opened within `[from, to)`,
+   * merged into a single stream ordered by time.
+   *
+   * Candles opened at the same time are ordered as their symbols are in
+   * `symbols`.
+   */
+  std::generator<symbol_candle> read_merged_candles(
+      std::vector<stock::Symbol> symbols,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to);
+  /**
+   * @brief Reads the market updates of several symbols emitted within
+   * `[from, to)`, merged into a single stream ordered by time.
+   */
+  std::generator<Market> read_merged_market(
+      std::vector<stock::Symbol> symbols,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to);
+
+  /**
+   * @brief Reads the symbol's candles opened within `[from, to)`, grouped by
+   * the UTC day they were opened on.
+   *
+   * Days without any candles are skipped.
+   */
+  std::generator<candle_day> read_candle_days(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to);
   virtual std::generator<trading::TradeRecord>
   read_trades(stock::Symbol symbol) = 0;
 
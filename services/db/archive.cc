@@ -0,0 +1,754 @@
+#include "services/db/archive.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <generator>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "data/candle.pb.h"
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+#include "files/files.h"
+#include "services/db/varint.h"
+#include "time/conversion.h"
+
+namespace howling {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+using ::howling::db_internal::append_fixed;
+using ::howling::db_internal::append_varint;
+using ::howling::db_internal::byte_cursor;
+using ::howling::db_internal::unzigzag;
+using ::howling::db_internal::wrapping_delta;
+using ::howling::db_internal::wrapping_sum;
+using ::howling::db_internal::zigzag;
+using ::std::chrono::duration_cast;
+using ::std::chrono::microseconds;
+using ::std::chrono::sys_days;
+using ::std::chrono::system_clock;
+using ::std::chrono::year_month_day;
+
+constexpr std::string_view MAGIC = "HOWL";
+constexpr char FORMAT_VERSION = 1;
+constexpr std::string_view FILE_EXTENSION = ".howl";
+constexpr int64_t DAY_US = 86'400'000'000;
+constexpr std::size_t CANDLE_COLUMNS = 7;
+constexpr std::size_t MARKET_COLUMNS = 7;
+// Magic and version up front, footer size and magic at the end.
+constexpr std::size_t HEADER_SIZE = MAGIC.size() + 1;
+constexpr std::size_t TRAILER_SIZE = 4 + MAGIC.size();
+
+int64_t epoch_us(system_clock::time_point time) {
+  return duration_cast<microseconds>(time.time_since_epoch()).count();
+}
+
+int64_t day_start_us(year_month_day date) {
+  return epoch_us(sys_days{date});
+}
+
+// MARK: Encoding
+
+/** Writes values most significant bit first, padding the last byte. */
+class bit_writer {
+public:
+  explicit bit_writer(std::string& out) : _out{out} {}
+
+  /** Writes the low `bits` bits of `value`. */
+  void write(uint64_t value, int bits) {
+    for (int i = bits - 1; i >= 0; --i) {
+      _byte = static_cast<uint8_t>((_byte << 1) | ((value >> i) & 1));
+      if (++_used == 8) {
+        _out.push_back(static_cast<char>(_byte));
+        _byte = 0;
+        _used = 0;
+      }
+    }
+  }
+
+  void flush() {
+    if (_used == 0) return;
+    _out.push_back(static_cast<char>(_byte << (8 - _used)));
+    _byte = 0;
+    _used = 0;
+  }
+
+private:
+  std::string& _out;
+  uint8_t _byte = 0;
+  int _used = 0;
+};
+
+/** The smallest and largest value of a column, as their raw 64 bits. */
+struct column_stats {
+  uint64_t min = 0;
+  uint64_t max = 0;
+};
+
+/** An encoded column and the footer entry describing it. */
+struct encoded_column {
+  std::string data;
+  column_stats stats;
+};
+
+column_stats int_stats(std::span<const int64_t> values) {
+  if (values.empty()) return {};
+  auto [min, max] = std::ranges::minmax(values);
+  return {
+      .min = static_cast<uint64_t>(min), .max = static_cast<uint64_t>(max)};
+}
+
+/** Not-a-number is left out, so a column of only NaN ranges over zero. */
+column_stats float_stats(std::span<const double> values) {
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+  for (double value : values) {
+    if (std::isnan(value)) continue;
+    min = std::min(min, value);
+    max = std::max(max, value);
+  }
+  if (min > max) return {};
+  return {
+      .min = std::bit_cast<uint64_t>(min), .max = std::bit_cast<uint64_t>(max)};
+}
+
+/**
+ * Encodes times as varints of the microseconds since the previous time, the
+ * first counting from the start of the day.
+ */
+encoded_column encode_times(std::span<const int64_t> times, int64_t day_us) {
+  encoded_column column{.stats = int_stats(times)};
+  int64_t previous = day_us;
+  for (int64_t time : times) {
+    if (time < previous || time >= day_us + DAY_US) {
+      throw std::invalid_argument(
+          std::format(
+              "Row at {}us is out of order or outside of the day starting at "
+              "{}us.",
+              time,
+              day_us));
+    }
+    append_varint(column.data, static_cast<uint64_t>(time - previous));
+    previous = time;
+  }
+  return column;
+}
+
+/**
+ * Encodes values as a table of the distinct values, in order of first use,
+ * followed by the index of each value in that table.
+ */
+encoded_column encode_dictionary(std::span<const int64_t> values) {
+  std::vector<int64_t> dictionary;
+  std::vector<uint64_t> indices;
+  indices.reserve(values.size());
+  for (int64_t value : values) {
+    auto entry = std::ranges::find(dictionary, value);
+    if (entry == dictionary.end()) {
+      entry = dictionary.insert(dictionary.end(), value);
+    }
+    indices.push_back(entry - dictionary.begin());
+  }
+
+  encoded_column column{.stats = int_stats(values)};
+  append_varint(column.data, dictionary.size());
+  for (int64_t value : dictionary) append_varint(column.data, zigzag(value));
+  for (uint64_t index : indices) append_varint(column.data, index);
+  return column;
+}
+
+/** Encodes values as zigzag varints of the change from the previous value. */
+encoded_column encode_deltas(std::span<const int64_t> values) {
+  encoded_column column{.stats = int_stats(values)};
+  int64_t previous = 0;
+  for (int64_t value : values) {
+    append_varint(column.data, zigzag(wrapping_delta(value, previous)));
+    previous = value;
+  }
+  return column;
+}
+
+/**
+ * Encodes doubles by XORing the bits of each with those of the previous one.
+ *
+ * The first value is written whole. After that a single 0 bit means the value
+ * repeated. Otherwise a 1 bit is followed by a 0 bit and the changed bits when
+ * they fit within the window of the previous change, or by a 1 bit, 5 bits of
+ * leading zero count, 6 bits of changed bit count less one, and the changed
+ * bits, which then become the window.
+ */
+encoded_column encode_xor_floats(std::span<const double> values) {
+  encoded_column column{.stats = float_stats(values)};
+  bit_writer writer{column.data};
+  uint64_t previous = 0;
+  int window_leading = -1;
+  int window_trailing = 0;
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    uint64_t bits = std::bit_cast<uint64_t>(values[i]);
+    if (i == 0) {
+      writer.write(bits, 64);
+      previous = bits;
+      continue;
+    }
+    uint64_t changed = bits ^ previous;
+    previous = bits;
+    if (changed == 0) {
+      writer.write(0, 1);
+      continue;
+    }
+    writer.write(1, 1);
+    int leading = std::min(std::countl_zero(changed), 31);
+    int trailing = std::countr_zero(changed);
+    if (window_leading >= 0 && leading >= window_leading &&
+        trailing >= window_trailing) {
+      writer.write(0, 1);
+      writer.write(
+          changed >> window_trailing, 64 - window_leading - window_trailing);
+      continue;
+    }
+    int significant = 64 - leading - trailing;
+    writer.write(1, 1);
+    writer.write(leading, 5);
+    writer.write(significant - 1, 6);
+    writer.write(changed >> trailing, significant);
+    window_leading = leading;
+    window_trailing = trailing;
+  }
+  writer.flush();
+  return column;
+}
+
+std::vector<int64_t> candle_times(std::span<const Candle> candles) {
+  std::vector<int64_t> times;
+  times.reserve(candles.size());
+  for (const Candle& candle : candles) {
+    times.push_back(epoch_us(to_std_chrono(candle.opened_at())));
+  }
+  return times;
+}
+
+std::vector<int64_t> market_times(std::span<const Market> market) {
+  std::vector<int64_t> times;
+  times.reserve(market.size());
+  for (const Market& tick : market) {
+    times.push_back(epoch_us(to_std_chrono(tick.emitted_at())));
+  }
+  return times;
+}
+
+template <typename Row, typename T, typename Field>
+std::vector<T> column_of(std::span<const Row> rows, Field field) {
+  std::vector<T> values;
+  values.reserve(rows.size());
+  for (const Row& row : rows) values.push_back(field(row));
+  return values;
+}
+
+std::vector<encoded_column>
+encode_candles(std::span<const Candle> candles, int64_t day_us) {
+  auto floats = [&](double (Candle::*field)() const) {
+    return encode_xor_floats(
+        column_of<Candle, double>(
+            candles, [&](const Candle& c) { return (c.*field)(); }));
+  };
+  std::vector<encoded_column> columns;
+  columns.reserve(CANDLE_COLUMNS);
+  columns.push_back(encode_times(candle_times(candles), day_us));
+  columns.push_back(
+      encode_dictionary(
+          column_of<Candle, int64_t>(candles, [](const Candle& c) {
+            return to_std_chrono(c.duration()).count();
+          })));
+  columns.push_back(floats(&Candle::open));
+  columns.push_back(floats(&Candle::close));
+  columns.push_back(floats(&Candle::high));
+  columns.push_back(floats(&Candle::low));
+  columns.push_back(
+      encode_deltas(
+          column_of<Candle, int64_t>(
+              candles, [](const Candle& c) { return c.volume(); })));
+  return columns;
+}
+
+std::vector<encoded_column>
+encode_market(std::span<const Market> market, int64_t day_us) {
+  auto floats = [&](double (Market::*field)() const) {
+    return encode_xor_floats(
+        column_of<Market, double>(
+            market, [&](const Market& m) { return (m.*field)(); }));
+  };
+  auto lots = [&](int64_t (Market::*field)() const) {
+    return encode_deltas(
+        column_of<Market, int64_t>(
+            market, [&](const Market& m) { return (m.*field)(); }));
+  };
+  std::vector<encoded_column> columns;
+  columns.reserve(MARKET_COLUMNS);
+  columns.push_back(encode_times(market_times(market), day_us));
+  columns.push_back(floats(&Market::bid));
+  columns.push_back(floats(&Market::ask));
+  columns.push_back(floats(&Market::last));
+  columns.push_back(lots(&Market::bid_lots));
+  columns.push_back(lots(&Market::ask_lots));
+  columns.push_back(lots(&Market::last_lots));
+  return columns;
+}
+
+void append_part_footer(
+    std::string& footer,
+    std::size_t rows,
+    std::span<const encoded_column> columns) {
+  append_varint(footer, rows);
+  append_varint(footer, columns.size());
+  for (const encoded_column& column : columns) {
+    append_varint(footer, column.data.size());
+    append_fixed(footer, column.stats.min, 8);
+    append_fixed(footer, column.stats.max, 8);
+  }
+}
+
+// MARK: Decoding
+
+/** Checks that a column held nothing beyond its values. */
+void expect_column_done(const byte_cursor& cursor) {
+  if (!cursor.done()) {
+    throw std::runtime_error("Archive column has bytes after its values.");
+  }
+}
+
+/** Reads values written by `bit_writer`. */
+class bit_reader {
+public:
+  explicit bit_reader(std::string_view data) : _data{data} {}
+
+  uint64_t read(int bits) {
+    uint64_t value = 0;
+    for (int i = 0; i < bits; ++i) {
+      if (_position / 8 >= _data.size()) {
+        throw std::runtime_error("Archive float column is truncated.");
+      }
+      uint8_t byte = static_cast<uint8_t>(_data[_position / 8]);
+      value = (value << 1) | ((byte >> (7 - _position % 8)) & 1);
+      ++_position;
+    }
+    return value;
+  }
+
+  /** Checks that only the padding of the last byte was left unread. */
+  void expect_done() const {
+    if ((_position + 7) / 8 != _data.size()) {
+      throw std::runtime_error("Archive column has bytes after its values.");
+    }
+  }
+
+private:
+  std::string_view _data;
+  std::size_t _position = 0;
+};
+
+struct column_entry {
+  std::string_view data;
+  column_stats stats;
+};
+
+struct part_entry {
+  std::size_t rows = 0;
+  std::vector<column_entry> columns;
+};
+
+struct footer {
+  stock::Symbol symbol;
+  year_month_day date;
+  part_entry candles;
+  part_entry market;
+};
+
+part_entry read_part_entry(
+    byte_cursor& cursor,
+    std::size_t expected_columns,
+    std::string_view& column_data) {
+  part_entry part;
+  part.rows = cursor.read_varint();
+  if (cursor.read_varint() != expected_columns) {
+    throw std::runtime_error("Archive part has an unexpected column count.");
+  }
+  for (std::size_t i = 0; i < expected_columns; ++i) {
+    uint64_t size = cursor.read_varint();
+    if (size > column_data.size()) {
+      throw std::runtime_error("Archive column extends past the data.");
+    }
+    column_entry& column = part.columns.emplace_back();
+    column.data = column_data.substr(0, size);
+    column_data.remove_prefix(size);
+    column.stats.min = cursor.read_fixed(8);
+    column.stats.max = cursor.read_fixed(8);
+  }
+  return part;
+}
+
+footer read_footer(std::string_view data) {
+  if (data.size() < HEADER_SIZE + TRAILER_SIZE ||
+      data.substr(0, MAGIC.size()) != MAGIC ||
+      data.substr(data.size() - MAGIC.size()) != MAGIC) {
+    throw std::runtime_error("Data is not an archive file.");
+  }
+  if (char version = data[MAGIC.size()]; version != FORMAT_VERSION) {
+    throw std::runtime_error(
+        std::format("Unknown archive format version {}.", int{version}));
+  }
+  byte_cursor trailer{data.substr(data.size() - TRAILER_SIZE, 4), "Archive"};
+  uint64_t footer_size = trailer.read_fixed(4);
+  if (footer_size > data.size() - HEADER_SIZE - TRAILER_SIZE) {
+    throw std::runtime_error("Archive footer extends past the data.");
+  }
+  std::size_t footer_start = data.size() - TRAILER_SIZE - footer_size;
+  std::string_view column_data =
+      data.substr(HEADER_SIZE, footer_start - HEADER_SIZE);
+
+  byte_cursor cursor{data.substr(footer_start, footer_size), "Archive"};
+  footer result;
+  result.symbol = static_cast<stock::Symbol>(cursor.read_varint());
+  result.date = year_month_day{
+      sys_days{std::chrono::days{unzigzag(cursor.read_varint())}}};
+  result.candles = read_part_entry(cursor, CANDLE_COLUMNS, column_data);
+  result.market = read_part_entry(cursor, MARKET_COLUMNS, column_data);
+  if (!cursor.done() || !column_data.empty()) {
+    throw std::runtime_error("Archive footer does not match its columns.");
+  }
+  return result;
+}
+
+std::vector<int64_t>
+decode_times(const column_entry& column, std::size_t rows, int64_t day_us) {
+  byte_cursor cursor{column.data, "Archive"};
+  std::vector<int64_t> times;
+  times.reserve(rows);
+  int64_t previous = day_us;
+  for (std::size_t i = 0; i < rows; ++i) {
+    previous = wrapping_sum(previous, cursor.read_varint());
+    times.push_back(previous);
+  }
+  expect_column_done(cursor);
+  return times;
+}
+
+std::vector<int64_t>
+decode_dictionary(const column_entry& column, std::size_t rows) {
+  byte_cursor cursor{column.data, "Archive"};
+  uint64_t size = cursor.read_varint();
+  std::vector<int64_t> dictionary;
+  // Every entry takes at least a byte, so a corrupt size cannot reserve more
+  // than the column could hold.
+  dictionary.reserve(std::min<uint64_t>(size, column.data.size()));
+  for (uint64_t i = 0; i < size; ++i) {
+    dictionary.push_back(unzigzag(cursor.read_varint()));
+  }
+  std::vector<int64_t> values;
+  values.reserve(rows);
+  for (std::size_t i = 0; i < rows; ++i) {
+    uint64_t index = cursor.read_varint();
+    if (index >= dictionary.size()) {
+      throw std::runtime_error("Archive dictionary index is out of range.");
+    }
+    values.push_back(dictionary[index]);
+  }
+  expect_column_done(cursor);
+  return values;
+}
+
+std::vector<int64_t>
+decode_deltas(const column_entry& column, std::size_t rows) {
+  byte_cursor cursor{column.data, "Archive"};
+  std::vector<int64_t> values;
+  values.reserve(rows);
+  int64_t previous = 0;
+  for (std::size_t i = 0; i < rows; ++i) {
+    previous = wrapping_sum(
+        previous, static_cast<uint64_t>(unzigzag(cursor.read_varint())));
+    values.push_back(previous);
+  }
+  expect_column_done(cursor);
+  return values;
+}
+
+std::vector<double>
+decode_xor_floats(const column_entry& column, std::size_t rows) {
+  bit_reader reader{column.data};
+  std::vector<double> values;
+  values.reserve(rows);
+  uint64_t previous = 0;
+  int window_leading = -1;
+  int window_trailing = 0;
+  for (std::size_t i = 0; i < rows; ++i) {
+    if (i == 0) {
+      previous = reader.read(64);
+    } else if (reader.read(1) == 1) {
+      if (reader.read(1) == 0) {
+        if (window_leading < 0) {
+          throw std::runtime_error("Archive float column reuses no window.");
+        }
+        previous ^= reader.read(64 - window_leading - window_trailing)
+            << window_trailing;
+      } else {
+        int leading = static_cast<int>(reader.read(5));
+        int significant = static_cast<int>(reader.read(6)) + 1;
+        if (leading + significant > 64) {
+          throw std::runtime_error("Archive float column window is too wide.");
+        }
+        window_leading = leading;
+        window_trailing = 64 - leading - significant;
+        previous ^= reader.read(significant) << window_trailing;
+      }
+    }
+    values.push_back(std::bit_cast<double>(previous));
+  }
+  reader.expect_done();
+  return values;
+}
+
+std::vector<Candle> decode_candles(const footer& file) {
+  const part_entry& part = file.candles;
+  std::vector<int64_t> opened_at =
+      decode_times(part.columns[0], part.rows, day_start_us(file.date));
+  std::vector<int64_t> duration = decode_dictionary(part.columns[1], part.rows);
+  std::vector<double> open = decode_xor_floats(part.columns[2], part.rows);
+  std::vector<double> close = decode_xor_floats(part.columns[3], part.rows);
+  std::vector<double> high = decode_xor_floats(part.columns[4], part.rows);
+  std::vector<double> low = decode_xor_floats(part.columns[5], part.rows);
+  std::vector<int64_t> volume = decode_deltas(part.columns[6], part.rows);
+
+  std::vector<Candle> candles(part.rows);
+  for (std::size_t i = 0; i < part.rows; ++i) {
+    Candle& candle = candles[i];
+    *candle.mutable_opened_at() =
+        to_proto(system_clock::time_point{microseconds{opened_at[i]}});
+    *candle.mutable_duration() = to_proto(microseconds{duration[i]});
+    candle.set_open(open[i]);
+    candle.set_close(close[i]);
+    candle.set_high(high[i]);
+    candle.set_low(low[i]);
+    candle.set_volume(volume[i]);
+  }
+  return candles;
+}
+
+std::vector<Market> decode_market(const footer& file) {
+  const part_entry& part = file.market;
+  std::vector<int64_t> emitted_at =
+      decode_times(part.columns[0], part.rows, day_start_us(file.date));
+  std::vector<double> bid = decode_xor_floats(part.columns[1], part.rows);
+  std::vector<double> ask = decode_xor_floats(part.columns[2], part.rows);
+  std::vector<double> last = decode_xor_floats(part.columns[3], part.rows);
+  std::vector<int64_t> bid_lots = decode_deltas(part.columns[4], part.rows);
+  std::vector<int64_t> ask_lots = decode_deltas(part.columns[5], part.rows);
+  std::vector<int64_t> last_lots = decode_deltas(part.columns[6], part.rows);
+
+  std::vector<Market> market(part.rows);
+  for (std::size_t i = 0; i < part.rows; ++i) {
+    Market& tick = market[i];
+    tick.set_symbol(file.symbol);
+    *tick.mutable_emitted_at() =
+        to_proto(system_clock::time_point{microseconds{emitted_at[i]}});
+    tick.set_bid(bid[i]);
+    tick.set_ask(ask[i]);
+    tick.set_last(last[i]);
+    tick.set_bid_lots(bid_lots[i]);
+    tick.set_ask_lots(ask_lots[i]);
+    tick.set_last_lots(last_lots[i]);
+  }
+  return market;
+}
+
+/** Summarizes a part whose first column holds times and `prices` prices. */
+archive_range summarize(const part_entry& part, std::span<const int> prices) {
+  if (part.rows == 0) return {};
+  auto time = [](uint64_t bits) {
+    return system_clock::time_point{microseconds{static_cast<int64_t>(bits)}};
+  };
+  archive_range range{
+      .rows = part.rows,
+      .first = time(part.columns[0].stats.min),
+      .last = time(part.columns[0].stats.max),
+      .low = std::numeric_limits<double>::infinity(),
+      .high = -std::numeric_limits<double>::infinity()};
+  for (int i : prices) {
+    range.low = std::min(
+        range.low, std::bit_cast<double>(part.columns[i].stats.min));
+    range.high = std::max(
+        range.high, std::bit_cast<double>(part.columns[i].stats.max));
+  }
+  return range;
+}
+
+constexpr int CANDLE_PRICE_COLUMNS[] = {2, 3, 4, 5};
+constexpr int MARKET_PRICE_COLUMNS[] = {1, 2, 3};
+
+/** Returns if any row of the range could fall within `[from, to)`. */
+bool overlaps(
+    const archive_range& range,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  return range.rows > 0 && range.last >= from && range.first < to;
+}
+
+} // namespace
+
+std::string encode_archive_day(const archive_day& day) {
+  int64_t day_us = day_start_us(day.date);
+  std::vector<encoded_column> candles = encode_candles(day.candles, day_us);
+  std::vector<encoded_column> market = encode_market(day.market, day_us);
+
+  std::string out{MAGIC};
+  out.push_back(FORMAT_VERSION);
+  for (const auto& column : candles) out += column.data;
+  for (const auto& column : market) out += column.data;
+
+  std::string footer;
+  append_varint(footer, static_cast<uint64_t>(day.symbol));
+  append_varint(
+      footer, zigzag(sys_days{day.date}.time_since_epoch().count()));
+  append_part_footer(footer, day.candles.size(), candles);
+  append_part_footer(footer, day.market.size(), market);
+  out += footer;
+  append_fixed(out, footer.size(), 4);
+  out += MAGIC;
+  return out;
+}
+
+archive_summary read_archive_summary(std::string_view data) {
+  footer file = read_footer(data);
+  return {
+      .symbol = file.symbol,
+      .date = file.date,
+      .candles = summarize(file.candles, CANDLE_PRICE_COLUMNS),
+      .market = summarize(file.market, MARKET_PRICE_COLUMNS)};
+}
+
+std::vector<Candle> decode_archive_candles(std::string_view data) {
+  return decode_candles(read_footer(data));
+}
+
+std::vector<Market> decode_archive_market(std::string_view data) {
+  return decode_market(read_footer(data));
+}
+
+archive_day decode_archive_day(std::string_view data) {
+  footer file = read_footer(data);
+  return {
+      .symbol = file.symbol,
+      .date = file.date,
+      .candles = decode_candles(file),
+      .market = decode_market(file)};
+}
+
+// MARK: market_archive
+
+market_archive::market_archive(fs::path directory)
+    : _directory{std::move(directory)} {}
+
+fs::path
+market_archive::day_path(stock::Symbol symbol, year_month_day date) const {
+  return _directory / stock::Symbol_Name(symbol) /
+      std::format("{:%F}{}", sys_days{date}, FILE_EXTENSION);
+}
+
+bool market_archive::contains(stock::Symbol symbol, year_month_day date) const {
+  return fs::exists(day_path(symbol, date));
+}
+
+std::vector<year_month_day>
+market_archive::list_days(stock::Symbol symbol) const {
+  std::vector<year_month_day> days;
+  fs::path symbol_directory = _directory / stock::Symbol_Name(symbol);
+  std::error_code error;
+  for (const fs::directory_entry& entry :
+       fs::directory_iterator(symbol_directory, error)) {
+    if (entry.path().extension() != FILE_EXTENSION) continue;
+    int year, month, day;
+    char rest;
+    std::string stem = entry.path().stem().string();
+    if (std::sscanf(stem.c_str(), "%d-%d-%d%c", &year, &month, &day, &rest) !=
+        3) {
+      continue;
+    }
+    year_month_day date{
+        std::chrono::year{year},
+        std::chrono::month{static_cast<unsigned>(month)},
+        std::chrono::day{static_cast<unsigned>(day)}};
+    if (date.ok()) days.push_back(date);
+  }
+  // A missing directory means nothing has been archived yet.
+  if (error && error != std::errc::no_such_file_or_directory) {
+    throw std::runtime_error(
+        std::format(
+            "Failed to list {}: {}", symbol_directory.string(),
+            error.message()));
+  }
+  std::ranges::sort(days);
+  return days;
+}
+
+void market_archive::write(const archive_day& day) const {
+  fs::path path = day_path(day.symbol, day.date);
+  fs::create_directories(path.parent_path());
+  fs::path temporary = path;
+  temporary += ".tmp";
+  files::write_file(temporary, encode_archive_day(day));
+  fs::rename(temporary, path);
+}
+
+archive_summary market_archive::read_summary(
+    stock::Symbol symbol, year_month_day date) const {
+  return read_archive_summary(files::read_file(day_path(symbol, date)));
+}
+
+std::generator<Candle> market_archive::read_candles(
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) const {
+  for (year_month_day date : list_days(symbol)) {
+    sys_days day_start{date};
+    if (day_start >= to || day_start + std::chrono::days{1} <= from) continue;
+    std::string data = files::read_file(day_path(symbol, date));
+    footer file = read_footer(data);
+    if (!overlaps(summarize(file.candles, {}), from, to)) continue;
+    for (Candle& candle : decode_candles(file)) {
+      system_clock::time_point opened_at = to_std_chrono(candle.opened_at());
+      if (opened_at >= from && opened_at < to) co_yield std::move(candle);
+    }
+  }
+}
+
+std::generator<Market> market_archive::read_market(
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) const {
+  for (year_month_day date : list_days(symbol)) {
+    sys_days day_start{date};
+    if (day_start >= to || day_start + std::chrono::days{1} <= from) continue;
+    std::string data = files::read_file(day_path(symbol, date));
+    footer file = read_footer(data);
+    if (!overlaps(summarize(file.market, {}), from, to)) continue;
+    for (Market& tick : decode_market(file)) {
+      system_clock::time_point emitted_at = to_std_chrono(tick.emitted_at());
+      if (emitted_at >= from && emitted_at < to) co_yield std::move(tick);
+    }
+  }
+}
+
+} // namespace howling
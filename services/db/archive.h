@@ -0,0 +1,160 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <generator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "data/candle.pb.h"
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+
+namespace howling {
+
+/**
+ * @brief The candles and market ticks of one symbol opened or emitted on one
+ * UTC day, as kept in a single archive file.
+ *
+ * Both are ordered by time.
+ */
+struct archive_day {
+  stock::Symbol symbol;
+  std::chrono::year_month_day date;
+  std::vector<Candle> candles;
+  std::vector<Market> market;
+};
+
+/**
+ * @brief The range of values held by one part of an archive file, as read
+ * from its footer without decoding any rows.
+ *
+ * Prices range over every price column of the part. All fields are zero when
+ * there are no rows.
+ */
+struct archive_range {
+  std::size_t rows = 0;
+  std::chrono::system_clock::time_point first;
+  std::chrono::system_clock::time_point last;
+  double low = 0;
+  double high = 0;
+};
+
+/** @brief The footer of an archive file. */
+struct archive_summary {
+  stock::Symbol symbol;
+  std::chrono::year_month_day date;
+  archive_range candles;
+  archive_range market;
+};
+
+/**
+ * @brief Packs a day into the bytes of an archive file.
+ *
+ * Each field is stored as its own column. Times are varint deltas, candle
+ * durations are indices into a dictionary of the distinct durations, lots and
+ * volumes are zigzag varint deltas, and prices are XORed with the previous
+ * price of their column so that unchanged leading and trailing bits are
+ * dropped. The footer records where each column is and the range of its
+ * values. Every row decodes to exactly what was encoded.
+ *
+ * @throws std::invalid_argument if the candles or ticks are out of order or
+ * not on the day.
+ */
+std::string encode_archive_day(const archive_day& day);
+
+/**
+ * @brief Reads the footer of bytes produced by `encode_archive_day`.
+ *
+ * @throws std::runtime_error if the bytes are not a valid archive file.
+ */
+archive_summary read_archive_summary(std::string_view data);
+
+/**
+ * @brief Unpacks the candles of bytes produced by `encode_archive_day`
+ * without decoding the market columns.
+ *
+ * @throws std::runtime_error if the bytes are not a valid archive file.
+ */
+std::vector<Candle> decode_archive_candles(std::string_view data);
+
+/**
+ * @brief Unpacks the market ticks of bytes produced by `encode_archive_day`
+ * without decoding the candle columns.
+ *
+ * @throws std::runtime_error if the bytes are not a valid archive file.
+ */
+std::vector<Market> decode_archive_market(std::string_view data);
+
+/** @brief Unpacks every row of bytes produced by `encode_archive_day`. */
+archive_day decode_archive_day(std::string_view data);
+
+/**
+ * @brief A directory of archive files, one per symbol and day, laid out as
+ * `<directory>/<SYMBOL>/<YYYY-MM-DD>.howl`.
+ *
+ * Archived days are closed: once written, a day is only ever replaced as a
+ * whole. This class is safe to use from many threads and processes as long as
+ * no two write the same day at once.
+ */
+class market_archive {
+public:
+  explicit market_archive(std::filesystem::path directory);
+
+  const std::filesystem::path& directory() const { return _directory; }
+
+  /** @brief Returns the path of the file holding the symbol's day. */
+  std::filesystem::path
+  day_path(stock::Symbol symbol, std::chrono::year_month_day date) const;
+
+  /** @brief Returns if the symbol's day has been archived. */
+  bool contains(stock::Symbol symbol, std::chrono::year_month_day date) const;
+
+  /**
+   * @brief Lists the symbol's archived days, oldest first.
+   *
+   * Files which are not named for a day are ignored.
+   */
+  std::vector<std::chrono::year_month_day>
+  list_days(stock::Symbol symbol) const;
+
+  /**
+   * @brief Writes the day to its file, replacing any earlier archive of it.
+   *
+   * The file is written under a temporary name and then renamed, so readers
+   * never see a partial file.
+   */
+  void write(const archive_day& day) const;
+
+  /** @brief Reads the footer of the symbol's archived day. */
+  archive_summary
+  read_summary(stock::Symbol symbol, std::chrono::year_month_day date) const;
+
+  /**
+   * @brief Reads the symbol's archived candles opened within `[from, to)`,
+   * oldest first.
+   *
+   * Only the files of days overlapping the range are opened, and only the
+   * candle columns of those whose footer overlaps it are decoded.
+   */
+  std::generator<Candle> read_candles(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) const;
+
+  /**
+   * @brief Reads the symbol's archived market ticks emitted within
+   * `[from, to)`, oldest first.
+   */
+  std::generator<Market> read_market(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) const;
+
+private:
+  std::filesystem::path _directory;
+};
+
+} // namespace howling
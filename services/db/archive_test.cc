@@ -0,0 +1,233 @@
+#include "services/db/archive.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <generator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "data/candle.pb.h"
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+#include "files/files.h"
+#include "time/conversion.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace howling {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+using ::std::chrono::days;
+using ::std::chrono::microseconds;
+using ::std::chrono::minutes;
+using ::std::chrono::seconds;
+using ::std::chrono::sys_days;
+using ::std::chrono::system_clock;
+using ::std::chrono::year_month_day;
+using ::testing::ElementsAre;
+using ::testing::SizeIs;
+
+constexpr year_month_day DAY{
+    std::chrono::year{2025}, std::chrono::October, std::chrono::day{15}};
+
+Candle make_candle(system_clock::time_point opened_at, double close) {
+  Candle candle;
+  candle.set_open(close - 0.05);
+  candle.set_close(close);
+  candle.set_high(close + 0.1);
+  candle.set_low(close - 0.1);
+  candle.set_volume(1000 + static_cast<int64_t>(close));
+  *candle.mutable_opened_at() = to_proto(opened_at);
+  *candle.mutable_duration() = to_proto(std::chrono::minutes(1));
+  return candle;
+}
+
+Market make_tick(system_clock::time_point emitted_at, double last) {
+  Market tick;
+  tick.set_symbol(stock::NVDA);
+  tick.set_bid(last - 0.01);
+  tick.set_bid_lots(3);
+  tick.set_ask(last + 0.01);
+  tick.set_ask_lots(4);
+  tick.set_last(last);
+  tick.set_last_lots(5);
+  *tick.mutable_emitted_at() = to_proto(emitted_at);
+  return tick;
+}
+
+archive_day make_day(year_month_day date, double price) {
+  archive_day day{.symbol = stock::NVDA, .date = date};
+  sys_days start{date};
+  for (int i = 0; i < 3; ++i) {
+    day.candles.push_back(make_candle(start + minutes(i), price + i));
+    day.market.push_back(make_tick(start + seconds(i), price + i));
+  }
+  return day;
+}
+
+std::vector<double> closes(std::generator<Candle> candles) {
+  std::vector<double> values;
+  for (const Candle& candle : candles) values.push_back(candle.close());
+  return values;
+}
+
+class MarketArchiveTest : public testing::Test {
+protected:
+  void SetUp() override {
+    _directory = fs::path{testing::TempDir()} / "market_archive_test";
+    fs::remove_all(_directory);
+  }
+
+  void TearDown() override { fs::remove_all(_directory); }
+
+  fs::path _directory;
+};
+
+TEST(ArchiveFormat, RoundTripsRowsExactly) {
+  archive_day day = make_day(DAY, 187.33);
+  day.candles[1].set_high(std::numeric_limits<double>::infinity());
+  day.candles[2].set_low(1.0 / 3);
+  *day.candles[2].mutable_duration() = to_proto(std::chrono::seconds(17));
+  day.market[1].set_bid(std::numeric_limits<double>::quiet_NaN());
+  day.market[2].set_ask_lots(std::numeric_limits<int64_t>::min());
+  *day.market[2].mutable_emitted_at() =
+      to_proto(sys_days{DAY} + days(1) - microseconds(1));
+
+  archive_day decoded = decode_archive_day(encode_archive_day(day));
+
+  EXPECT_EQ(decoded.symbol, stock::NVDA);
+  EXPECT_EQ(decoded.date, DAY);
+  ASSERT_THAT(decoded.candles, SizeIs(day.candles.size()));
+  for (std::size_t i = 0; i < day.candles.size(); ++i) {
+    EXPECT_EQ(
+        decoded.candles[i].SerializeAsString(),
+        day.candles[i].SerializeAsString());
+  }
+  ASSERT_THAT(decoded.market, SizeIs(day.market.size()));
+  for (std::size_t i = 0; i < day.market.size(); ++i) {
+    EXPECT_EQ(
+        decoded.market[i].SerializeAsString(),
+        day.market[i].SerializeAsString());
+  }
+}
+
+TEST(ArchiveFormat, PacksQuotedPricesCompactly) {
+  archive_day day{.symbol = stock::NVDA, .date = DAY};
+  for (int i = 0; i < 390; ++i) {
+    // As parsed from quotes, rather than accumulating rounding errors.
+    double price = (18'000 + i % 9) / 100.0;
+    day.candles.push_back(make_candle(sys_days{DAY} + minutes(i), price));
+  }
+  // Each candle holds 56 bytes of values alone.
+  EXPECT_LT(encode_archive_day(day).size(), day.candles.size() * 32);
+}
+
+TEST(ArchiveFormat, SummarizesFromTheFooter) {
+  archive_day day = make_day(DAY, 10);
+
+  archive_summary summary = read_archive_summary(encode_archive_day(day));
+
+  EXPECT_EQ(summary.symbol, stock::NVDA);
+  EXPECT_EQ(summary.date, DAY);
+  EXPECT_EQ(summary.candles.rows, 3);
+  EXPECT_EQ(summary.candles.first, sys_days{DAY});
+  EXPECT_EQ(summary.candles.last, sys_days{DAY} + minutes(2));
+  EXPECT_DOUBLE_EQ(summary.candles.low, 9.9);
+  EXPECT_DOUBLE_EQ(summary.candles.high, 12.1);
+  EXPECT_EQ(summary.market.rows, 3);
+  EXPECT_DOUBLE_EQ(summary.market.low, 9.99);
+  EXPECT_DOUBLE_EQ(summary.market.high, 12.01);
+}
+
+TEST(ArchiveFormat, RejectsRowsOutsideTheDay) {
+  archive_day day = make_day(DAY, 10);
+  *day.candles[2].mutable_opened_at() = to_proto(sys_days{DAY} + days(1));
+  EXPECT_THROW(encode_archive_day(day), std::invalid_argument);
+
+  day = make_day(DAY, 10);
+  std::swap(day.market[0], day.market[1]);
+  EXPECT_THROW(encode_archive_day(day), std::invalid_argument);
+}
+
+TEST(ArchiveFormat, RejectsCorruptData) {
+  std::string data = encode_archive_day(make_day(DAY, 10));
+
+  EXPECT_THROW(
+      decode_archive_day(data.substr(0, data.size() - 1)), std::runtime_error);
+  EXPECT_THROW(decode_archive_day(data.substr(1)), std::runtime_error);
+  std::string bad_version = data;
+  bad_version[4] = 2;
+  EXPECT_THROW(decode_archive_day(bad_version), std::runtime_error);
+  std::string bad_footer = data;
+  // The footer size, so that the footer no longer matches the columns.
+  ++bad_footer[data.size() - 8];
+  EXPECT_THROW(read_archive_summary(bad_footer), std::runtime_error);
+}
+
+TEST_F(MarketArchiveTest, ListsWrittenDays) {
+  market_archive archive{_directory};
+  year_month_day next_day{sys_days{DAY} + days(1)};
+  archive.write(make_day(next_day, 20));
+  archive.write(make_day(DAY, 10));
+  fs::create_directories(_directory / "NVDA");
+  files::write_file(_directory / "NVDA" / "notes.txt", "");
+
+  EXPECT_THAT(archive.list_days(stock::NVDA), ElementsAre(DAY, next_day));
+  EXPECT_TRUE(archive.contains(stock::NVDA, DAY));
+  EXPECT_FALSE(archive.contains(stock::AMD, DAY));
+  EXPECT_THAT(archive.list_days(stock::AMD), SizeIs(0));
+  EXPECT_EQ(archive.read_summary(stock::NVDA, next_day).candles.rows, 3);
+}
+
+TEST_F(MarketArchiveTest, ReadsRangesAcrossDays) {
+  market_archive archive{_directory};
+  year_month_day next_day{sys_days{DAY} + days(1)};
+  archive.write(make_day(DAY, 10));
+  archive.write(make_day(next_day, 20));
+
+  EXPECT_THAT(
+      closes(
+          archive.read_candles(
+              stock::NVDA,
+              sys_days{DAY} + minutes(1),
+              sys_days{next_day} + minutes(2))),
+      ElementsAre(11, 12, 20, 21));
+  EXPECT_THAT(
+      closes(
+          archive.read_candles(
+              stock::NVDA,
+              system_clock::time_point::min(),
+              system_clock::time_point::max())),
+      SizeIs(6));
+
+  std::vector<double> lasts;
+  for (const Market& tick : archive.read_market(
+           stock::NVDA, sys_days{next_day}, sys_days{next_day} + seconds(1))) {
+    lasts.push_back(tick.last());
+  }
+  EXPECT_THAT(lasts, ElementsAre(20));
+}
+
+TEST_F(MarketArchiveTest, ReplacesRewrittenDays) {
+  market_archive archive{_directory};
+  archive.write(make_day(DAY, 10));
+  archive.write(make_day(DAY, 30));
+
+  EXPECT_THAT(
+      closes(
+          archive.read_candles(
+              stock::NVDA,
+              system_clock::time_point::min(),
+              system_clock::time_point::max())),
+      ElementsAre(30, 31, 32));
+}
+
+} // namespace
+} // namespace howling
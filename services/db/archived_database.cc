@@ -0,0 +1,272 @@
+#include "services/db/archived_database.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <generator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "data/candle.pb.h"
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+#include "data/trade.pb.h"
+#include "services/database.h"
+#include "services/db/archive.h"
+#include "services/db/schema/auth_token.h"
+#include "time/conversion.h"
+
+namespace howling {
+namespace {
+
+using ::std::chrono::sys_days;
+using ::std::chrono::system_clock;
+
+using time_point = system_clock::time_point;
+
+/** A part of a read range served entirely by the archive or the database. */
+struct segment {
+  bool archived;
+  system_clock::time_point from;
+  system_clock::time_point to;
+};
+
+/**
+ * Splits `[from, to)` into the archived days within it and the time between
+ * them, oldest first.
+ */
+std::vector<segment> plan_segments(
+    const market_archive& archive,
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  std::vector<segment> segments;
+  system_clock::time_point next = from;
+  for (std::chrono::year_month_day date : archive.list_days(symbol)) {
+    system_clock::time_point day_start = sys_days{date};
+    system_clock::time_point day_end = sys_days{date} + std::chrono::days{1};
+    if (day_end <= from || day_start >= to) continue;
+    if (next < day_start) {
+      segments.push_back({.archived = false, .from = next, .to = day_start});
+    }
+    segments.push_back(
+        {.archived = true,
+         .from = std::max(from, day_start),
+         .to = std::min(to, day_end)});
+    next = day_end;
+  }
+  if (next < to) {
+    segments.push_back({.archived = false, .from = next, .to = to});
+  }
+  return segments;
+}
+
+/**
+ * Reads each segment from the archive or the database in turn. The reads are
+ * generated lazily, so each segment is only opened once the ones before it
+ * are exhausted.
+ */
+template <typename T, typename ReadArchive, typename ReadDatabase>
+std::generator<T> read_segments(
+    std::vector<segment> segments,
+    ReadArchive read_archive,
+    ReadDatabase read_database) {
+  for (const segment& part : segments) {
+    if (part.archived) {
+      for (T row : read_archive(part.from, part.to)) co_yield std::move(row);
+    } else {
+      for (T row : read_database(part.from, part.to)) co_yield std::move(row);
+    }
+  }
+}
+
+/** Reads the candle blocks of each segment in turn. */
+class segment_block_reader : public candle_block_reader {
+public:
+  segment_block_reader(
+      database& db,
+      const market_archive& archive,
+      stock::Symbol symbol,
+      std::vector<segment> segments)
+      : _db{db},
+        _archive{archive},
+        _symbol{symbol},
+        _segments{std::move(segments)} {}
+
+  std::size_t read(candle_block& block, std::size_t max_rows) override {
+    block.clear();
+    while (true) {
+      if (_live) {
+        if (_live->read(block, max_rows) > 0) return block.size();
+        _live.reset();
+      } else if (_archived_row < _archived.size()) {
+        return _read_archived(block, max_rows);
+      }
+      if (_next_segment == _segments.size()) break;
+      _open(_segments[_next_segment++]);
+    }
+    return 0;
+  }
+
+private:
+  void _open(const segment& part) {
+    _archived.clear();
+    _archived_row = 0;
+    if (!part.archived) {
+      _live = _db.read_candle_blocks(_symbol, part.from, part.to);
+      return;
+    }
+    for (Candle candle : _archive.read_candles(_symbol, part.from, part.to)) {
+      _archived.push_back(std::move(candle));
+    }
+  }
+
+  std::size_t _read_archived(candle_block& block, std::size_t max_rows) {
+    std::size_t rows = std::min(max_rows, _archived.size() - _archived_row);
+    block.reserve(rows);
+    for (std::size_t i = 0; i < rows; ++i) {
+      const Candle& candle = _archived[_archived_row++];
+      block.open.push_back(candle.open());
+      block.close.push_back(candle.close());
+      block.high.push_back(candle.high());
+      block.low.push_back(candle.low());
+      block.volume.push_back(candle.volume());
+      block.opened_at.push_back(to_std_chrono(candle.opened_at()));
+      block.duration.push_back(to_std_chrono(candle.duration()));
+    }
+    return block.size();
+  }
+
+  database& _db;
+  const market_archive& _archive;
+  stock::Symbol _symbol;
+  std::vector<segment> _segments;
+  std::size_t _next_segment = 0;
+  std::unique_ptr<candle_block_reader> _live;
+  std::vector<Candle> _archived;
+  std::size_t _archived_row = 0;
+};
+
+} // namespace
+
+archived_database::archived_database(
+    std::unique_ptr<database> db, market_archive archive)
+    : _db{std::move(db)}, _archive{std::move(archive)} {}
+
+// MARK: Archived
+
+std::generator<Candle> archived_database::read_candles(stock::Symbol symbol) {
+  return read_candles(
+      symbol, system_clock::time_point::min(), system_clock::time_point::max());
+}
+
+std::generator<Market> archived_database::read_market(stock::Symbol symbol) {
+  return read_market(
+      symbol, system_clock::time_point::min(), system_clock::time_point::max());
+}
+
+std::generator<Candle> archived_database::read_candles(
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  return read_segments<Candle>(
+      plan_segments(_archive, symbol, from, to),
+      [this, symbol](time_point start, time_point end) {
+        return _archive.read_candles(symbol, start, end);
+      },
+      [this, symbol](time_point start, time_point end) {
+        return _db->read_candles(symbol, start, end);
+      });
+}
+
+std::generator<Market> archived_database::read_market(
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  return read_segments<Market>(
+      plan_segments(_archive, symbol, from, to),
+      [this, symbol](time_point start, time_point end) {
+        return _archive.read_market(symbol, start, end);
+      },
+      [this, symbol](time_point start, time_point end) {
+        return _db->read_market(symbol, start, end);
+      });
+}
+
+std::unique_ptr<candle_block_reader> archived_database::read_candle_blocks(
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  return std::make_unique<segment_block_reader>(
+      *_db, _archive, symbol, plan_segments(_archive, symbol, from, to));
+}
+
+// MARK: Forwarded
+
+std::future<void>
+archived_database::upgrade_schema(std::string_view app_db_user) {
+  return _db->upgrade_schema(app_db_user);
+}
+
+std::future<void> archived_database::check_schema_version() {
+  return _db->check_schema_version();
+}
+
+std::future<void>
+archived_database::save(stock::Symbol symbol, const Candle& candle) {
+  return _db->save(symbol, candle);
+}
+
+std::future<void> archived_database::save(const Market& market) {
+  return _db->save(market);
+}
+
+std::future<void> archived_database::save_batch(
+    stock::Symbol symbol, std::span<const Candle> candles) {
+  return _db->save_batch(symbol, candles);
+}
+
+std::future<void>
+archived_database::save_batch(std::span<const Market> markets) {
+  return _db->save_batch(markets);
+}
+
+std::future<void>
+archived_database::save_trade(const trading::TradeRecord& trade) {
+  return _db->save_trade(trade);
+}
+
+std::future<void> archived_database::save_refresh_token(
+    std::string_view service_name, std::string_view token) {
+  return _db->save_refresh_token(service_name, token);
+}
+
+std::generator<Candle> archived_database::read_candles(
+    stock::Symbol symbol,
+    candle_resolution resolution,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  return _db->read_candles(symbol, resolution, from, to);
+}
+
+std::generator<trading::TradeRecord>
+archived_database::read_trades(stock::Symbol symbol) {
+  return _db->read_trades(symbol);
+}
+
+std::future<std::optional<storage::auth_token>>
+archived_database::get_auth_token(std::string_view service_name) {
+  return _db->get_auth_token(service_name);
+}
+
+std::future<void> archived_database::save_notice_token(
+    std::string_view service_name, std::string_view notice_token) {
+  return _db->save_notice_token(service_name, notice_token);
+}
+
+} // namespace howling
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <future>
+#include <generator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "data/candle.pb.h"
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+#include "data/trade.pb.h"
+#include "services/database.h"
+#include "services/db/archive.h"
+#include "services/db/schema/auth_token.h"
+
+namespace howling {
+
+/**
+ * @brief Wraps a database so that range reads of one minute candles and
+ * market ticks come from an archive for the days it holds.
+ *
+ * Archived days are read from their files, and the time between them from the
+ * wrapped database, so days archived and then dropped from the database stay
+ * readable. Rolled up candles are always read from the wrapped database, as
+ * the archive holds only one minute candles.
+ *
+ * Saves and every other operation are forwarded directly to the wrapped
+ * database.
+ */
+class archived_database : public database {
+public:
+  archived_database(std::unique_ptr<database> db, market_archive archive);
+
+  std::future<void> upgrade_schema(std::string_view app_db_user) override;
+  std::future<void> check_schema_version() override;
+
+  std::future<void> save(stock::Symbol symbol, const Candle& candle) override;
+  std::future<void> save(const Market& market) override;
+  std::future<void>
+  save_batch(stock::Symbol symbol, std::span<const Candle> candles) override;
+  std::future<void> save_batch(std::span<const Market> markets) override;
+  std::future<void> save_trade(const trading::TradeRecord& trade) override;
+  std::future<void> save_refresh_token(
+      std::string_view service_name, std::string_view token) override;
+
+  std::generator<Candle> read_candles(stock::Symbol symbol) override;
+  std::generator<Market> read_market(stock::Symbol symbol) override;
+  std::generator<Candle> read_candles(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
+  std::generator<Candle> read_candles(
+      stock::Symbol symbol,
+      candle_resolution resolution,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
+  std::generator<Market> read_market(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
+  std::unique_ptr<candle_block_reader> read_candle_blocks(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
+  std::generator<trading::TradeRecord>
+  read_trades(stock::Symbol symbol) override;
+
+  std::future<std::optional<storage::auth_token>>
+  get_auth_token(std::string_view service_name) override;
+  std::future<void> save_notice_token(
+      std::string_view service_name, std::string_view notice_token) override;
+
+private:
+  std::unique_ptr<database> _db;
+  market_archive _archive;
+};
+
+} // namespace howling
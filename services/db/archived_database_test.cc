@@ -0,0 +1,153 @@
+#include "services/db/archived_database.h"
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <generator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
+#include "data/candle.pb.h"
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+#include "services/db/archive.h"
+#include "services/db/database_test_interface.h"
+#include "services/db/sqlite_database.h"
+#include "time/conversion.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+ABSL_DECLARE_FLAG(std::string, sqlite_db_path);
+
+namespace howling {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+using ::std::chrono::days;
+using ::std::chrono::minutes;
+using ::std::chrono::sys_days;
+using ::std::chrono::system_clock;
+using ::std::chrono::year_month_day;
+using ::testing::ElementsAre;
+
+constexpr year_month_day DAY{
+    std::chrono::year{2025}, std::chrono::October, std::chrono::day{15}};
+
+Candle make_candle(system_clock::time_point opened_at, double close) {
+  Candle candle;
+  candle.set_open(close);
+  candle.set_close(close);
+  candle.set_high(close);
+  candle.set_low(close);
+  candle.set_volume(100);
+  *candle.mutable_opened_at() = to_proto(opened_at);
+  *candle.mutable_duration() = to_proto(minutes(1));
+  return candle;
+}
+
+Market make_tick(system_clock::time_point emitted_at, double last) {
+  Market tick;
+  tick.set_symbol(stock::NVDA);
+  tick.set_last(last);
+  *tick.mutable_emitted_at() = to_proto(emitted_at);
+  return tick;
+}
+
+fs::path archive_directory() {
+  return fs::path{testing::TempDir()} / "archived_database_test";
+}
+
+class ArchivedDatabaseTest : public DatabaseTest {
+protected:
+  void SetUp() override {
+    absl::SetFlag(&FLAGS_sqlite_db_path, ":memory:");
+    fs::remove_all(archive_directory());
+    _db = std::make_unique<archived_database>(
+        std::make_unique<sqlite_database>(_mock_security),
+        market_archive{archive_directory()});
+    DatabaseTest::SetUp();
+  }
+
+  void TearDown() override { fs::remove_all(archive_directory()); }
+
+  database& db() override { return *_db; }
+
+  // Every test uses a fresh in-memory database and an empty archive.
+  void clear_database() override {}
+
+  /**
+   * Saves a candle and tick on each of three days to the database, and
+   * archives the middle day with prices which tell the two apart.
+   */
+  void save_three_days() {
+    for (int i = 0; i < 3; ++i) {
+      sys_days day = sys_days{DAY} + days(i);
+      save_candle(stock::NVDA, make_candle(day + minutes(1), i));
+      save_market(make_tick(day + minutes(1), i));
+    }
+    year_month_day archived{sys_days{DAY} + days(1)};
+    market_archive{archive_directory()}.write(
+        {.symbol = stock::NVDA,
+         .date = archived,
+         .candles = {make_candle(sys_days{archived} + minutes(2), 10)},
+         .market = {make_tick(sys_days{archived} + minutes(2), 10)}});
+  }
+
+  std::unique_ptr<archived_database> _db;
+};
+
+DATABASE_TEST(ArchivedDatabaseTest);
+
+TEST_F(ArchivedDatabaseTest, ReadsArchivedDaysFromTheArchive) {
+  upgrade_schema();
+  save_three_days();
+
+  std::vector<double> closes;
+  for (const Candle& candle : read_candles(stock::NVDA)) {
+    closes.push_back(candle.close());
+  }
+  EXPECT_THAT(closes, ElementsAre(0, 10, 2));
+
+  std::vector<double> lasts;
+  for (const Market& tick : db().read_market(
+           stock::NVDA, sys_days{DAY} + days(1), sys_days{DAY} + days(3))) {
+    lasts.push_back(tick.last());
+  }
+  EXPECT_THAT(lasts, ElementsAre(10, 2));
+}
+
+TEST_F(ArchivedDatabaseTest, ReadsCandleBlocksAcrossTheArchive) {
+  upgrade_schema();
+  save_three_days();
+
+  std::unique_ptr<candle_block_reader> reader = db().read_candle_blocks(
+      stock::NVDA, system_clock::time_point::min(), sys_days{DAY} + days(3));
+  std::vector<double> closes;
+  candle_block block;
+  while (reader->read(block, 2) > 0) {
+    closes.insert(closes.end(), block.close.begin(), block.close.end());
+  }
+  EXPECT_THAT(closes, ElementsAre(0, 10, 2));
+}
+
+TEST_F(ArchivedDatabaseTest, ReadsRollupsFromTheDatabase) {
+  upgrade_schema();
+  save_three_days();
+
+  std::vector<double> closes;
+  for (const Candle& candle : db().read_candles(
+           stock::NVDA,
+           candle_resolution::ONE_DAY,
+           sys_days{DAY},
+           sys_days{DAY} + days(3))) {
+    closes.push_back(candle.close());
+  }
+  EXPECT_THAT(closes, ElementsAre(0, 1, 2));
+}
+
+} // namespace
+} // namespace howling
@@ -1,8 +1,13 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
+#include <future>
 #include <memory>
+#include <thread>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/flags/flag.h"
 #include "data/candle.pb.h"
@@ -35,6 +40,12 @@ protected:
     db().save(symbol, candle).get();
   }
   void save_market(const Market& market) { db().save(market).get(); }
+  void save_batch(stock::Symbol symbol, const std::vector<Candle>& candles) {
+    db().save_batch(symbol, candles).get();
+  }
+  void save_batch(const std::vector<Market>& markets) {
+    db().save_batch(markets).get();
+  }
   void save_trade(const trading::TradeRecord& trade) {
     db().save_trade(trade).get();
   }
@@ -62,6 +73,18 @@ protected:
     db().save_notice_token(service_name, notice_token).get();
   }
 
+  /** @brief Polls `done` without blocking until it is ready or times out. */
+  static std::future_status poll_until_ready(std::future<void>& done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    std::future_status status = done.wait_for(std::chrono::seconds(0));
+    while (status != std::future_status::ready &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      status = done.wait_for(std::chrono::seconds(0));
+    }
+    return status;
+  }
+
   mock_security_client _mock_security;
 };
 
@@ -73,6 +96,13 @@ protected:
     upgrade_schema();                                                          \
     EXPECT_NO_THROW(save_candle(stock::NVDA, Candle::default_instance()));     \
   }                                                                            \
+  TEST_F(FIXTURE_CLASS, CandleSaveBecomesReadyWithoutWaiting) {                \
+    upgrade_schema();                                                          \
+    std::future<void> saved =                                                  \
+        db().save(stock::NVDA, Candle::default_instance());                    \
+    EXPECT_EQ(poll_until_ready(saved), std::future_status::ready);             \
+    EXPECT_NO_THROW(saved.get());                                              \
+  }                                                                            \
   TEST_F(FIXTURE_CLASS, SavedCandlesAreReadable) {                             \
     upgrade_schema();                                                          \
     Candle candle;                                                             \
@@ -153,6 +183,250 @@ protected:
     }                                                                          \
     EXPECT_EQ(count, 1);                                                       \
   }                                                                            \
+  TEST_F(FIXTURE_CLASS, SavedCandleBatchesAreReadable) {                       \
+    upgrade_schema();                                                          \
+    std::vector<Candle> candles(3);                                            \
+    for (int i = 0; i < 3; ++i) {                                              \
+      candles[i].set_close(10.0 + i);                                          \
+      candles[i].mutable_opened_at()->set_seconds(60 * i);                     \
+      candles[i].mutable_duration()->set_seconds(60);                          \
+    }                                                                          \
+    save_batch(stock::NVDA, candles);                                          \
+    std::vector<double> closes;                                                \
+    for (const Candle& found_candle : read_candles(stock::NVDA)) {             \
+      closes.push_back(found_candle.close());                                  \
+    }                                                                          \
+    EXPECT_THAT(closes, testing::ElementsAre(10.0, 11.0, 12.0));               \
+  }                                                                            \
+  TEST_F(FIXTURE_CLASS, MarketBatchesReplaceExistingRows) {                    \
+    upgrade_schema();                                                          \
+    std::vector<Market> markets(2);                                            \
+    for (int i = 0; i < 2; ++i) {                                              \
+      markets[i].set_symbol(stock::NVDA);                                      \
+      markets[i].set_last(1.0 + i);                                            \
+      markets[i].mutable_emitted_at()->set_seconds(i);                         \
+    }                                                                          \
+    save_batch(markets);                                                       \
+    markets[1].set_last(5.0);                                                  \
+    markets[0].mutable_emitted_at()->set_seconds(2);                           \
+    save_batch(markets);                                                       \
+    std::vector<double> lasts;                                                 \
+    for (const Market& found_market : read_market(stock::NVDA)) {              \
+      lasts.push_back(found_market.last());                                    \
+    }                                                                          \
+    EXPECT_THAT(lasts, testing::ElementsAre(1.0, 5.0, 1.0));                   \
+  }                                                                            \
+  TEST_F(FIXTURE_CLASS, BatchesKeepTheLastOfDuplicateRows) {                   \
+    upgrade_schema();                                                          \
+    std::vector<Candle> candles(3);                                            \
+    std::vector<Market> markets(3);                                            \
+    for (int i = 0; i < 3; ++i) {                                              \
+      candles[i].set_close(10.0 + i);                                          \
+      candles[i].mutable_duration()->set_seconds(60);                          \
+      markets[i].set_symbol(stock::NVDA);                                      \
+      markets[i].set_last(1.0 + i);                                            \
+    }                                                                          \
+    save_batch(stock::NVDA, candles);                                          \
+    save_batch(markets);                                                       \
+    std::vector<double> closes;                                                \
+    for (const Candle& found_candle : read_candles(stock::NVDA)) {             \
+      closes.push_back(found_candle.close());                                  \
+    }                                                                          \
+    EXPECT_THAT(closes, testing::ElementsAre(12.0));                           \
+    std::vector<double> lasts;                                                 \
+    for (const Market& found_market : read_market(stock::NVDA)) {              \
+      lasts.push_back(found_market.last());                                    \
+    }                                                                          \
+    EXPECT_THAT(lasts, testing::ElementsAre(3.0));                             \
+  }                                                                            \
+  TEST_F(FIXTURE_CLASS, ReadsCandlesWithinTimeRange) {                         \
+    upgrade_schema();                                                          \
+    for (int i = 0; i < 4; ++i) {                                              \
+      Candle candle;                                                           \
+      candle.set_close(i);                                                     \
+      candle.mutable_opened_at()->set_seconds(60 * i);                         \
+      save_candle(stock::NVDA, candle);                                        \
+      save_candle(stock::AMD, candle);                                         \
+    }                                                                          \
+    std::chrono::system_clock::time_point from{std::chrono::seconds(60)};      \
+    std::chrono::system_clock::time_point to{std::chrono::seconds(180)};       \
+    std::vector<double> closes;                                                \
+    for (const Candle& found_candle :                                          \
+         db().read_candles(stock::NVDA, from, to)) {                           \
+      closes.push_back(found_candle.close());                                  \
+    }                                                                          \
+    EXPECT_THAT(closes, testing::ElementsAre(1.0, 2.0));                       \
+  }                                                                            \
+  TEST_F(FIXTURE_CLASS, ReadsMarketWithinTimeRange) {                          \
+    upgrade_schema();                                                          \
+    for (int i = 0; i < 4; ++i) {                                              \
+      Market market;                                                           \
+      market.set_symbol(stock::NVDA);                                          \
+      market.set_last(i);                                                      \
+      market.mutable_emitted_at()->set_seconds(i);                             \
+      save_market(market);                                                     \
+    }                                                                          \
+    std::chrono::system_clock::time_point from{std::chrono::seconds(2)};       \
+    std::chrono::system_clock::time_point to{std::chrono::seconds(10)};        \
+    std::vector<double> lasts;                                                 \
+    for (const Market& found_market :                                          \
+         db().read_market(stock::NVDA, from, to)) {                            \
+      lasts.push_back(found_market.last());                                    \
+    }                                                                          \
+    EXPECT_THAT(lasts, testing::ElementsAre(2.0, 3.0));                        \
+  }                                                                            \
+  TEST_F(FIXTURE_CLASS, MergesCandlesOfSeveralSymbolsByTime) {                 \
+    upgrade_schema();                                                          \
+    Candle candle;                                                             \
+    candle.mutable_opened_at()->set_seconds(120);                              \
+    save_candle(stock::NVDA, candle);                                          \
+    save_candle(stock::AMD, candle);                                           \
+    candle.mutable_opened_at()->set_seconds(60);                               \
+    save_candle(stock::AMD, candle);                                           \
+    candle.mutable_opened_at()->set_seconds(0);                                \
+    save_candle(stock::NVDA, candle);                                          \
+    std::vector<std::pair<stock::Symbol, int64_t>> found;                      \
+    for (const symbol_candle& found_candle : db().read_merged_candles(         \
+             {stock::NVDA, stock::AMD},                                        \
+             std::chrono::system_clock::time_point{},                          \
+             std::chrono::system_clock::time_point{std::chrono::hours(1)})) {  \
+      found.emplace_back(                                                      \
+          found_candle.symbol, found_candle.candle.opened_at().seconds());     \
+    }                                                                          \
+    EXPECT_THAT(                                                               \
+        found,                                                                 \
+        testing::ElementsAre(                                                  \
+            testing::Pair(stock::NVDA, 0),                                     \
+            testing::Pair(stock::AMD, 60),                                     \
+            testing::Pair(stock::NVDA, 120),                                   \
+            testing::Pair(stock::AMD, 120)));                                  \
+  }                                                                            \
+  TEST_F(FIXTURE_CLASS, GroupsCandlesByDay) {                                  \
+    upgrade_schema();                                                          \
+    for (int hour : {10, 20, 25}) {                                            \
+      Candle candle;                                                           \
+      candle.mutable_opened_at()->set_seconds(hour * 3600);                    \
+      save_candle(stock::NVDA, candle);                                        \
+    }                                                                          \
+    std::vector<std::pair<std::chrono::year_month_day, std::size_t>> days;     \
+    for (const candle_day& day : db().read_candle_days(                        \
+             stock::NVDA,                                                      \
+             std::chrono::system_clock::time_point{},                          \
+             std::chrono::system_clock::time_point{std::chrono::days(7)})) {   \
+      days.emplace_back(day.date, day.candles.size());                         \
+    }                                                                          \
+    using namespace std::chrono_literals;                                      \
+    EXPECT_THAT(                                                               \
+        days,                                                                  \
+        testing::ElementsAre(                                                  \
+            testing::Pair(1970y / 1 / 1, 2),                                   \
+            testing::Pair(1970y / 1 / 2, 1)));                                 \
+  }                                                                            \
+  TEST_F(FIXTURE_CLASS, ReadsCandlesInBlocks) {                                \
+    upgrade_schema();                                                          \
+    for (int i = 0; i < 5; ++i) {                                              \
+      Candle candle;                                                           \
+      candle.set_close(i);                                                     \
+      candle.mutable_opened_at()->set_seconds(60 * i);                         \
+      save_candle(stock::NVDA, candle);                                        \
+    }                                                                          \
+    std::unique_ptr<candle_block_reader> reader = db().read_candle_blocks(     \
+        stock::NVDA,                                                           \
+        std::chrono::system_clock::time_point{},                               \
+        std::chrono::system_clock::time_point{std::chrono::hours(1)});         \
+    candle_block block;                                                        \
+    std::vector<std::size_t> sizes;                                            \
+    std::vector<double> closes;                                                \
+    std::vector<int64_t> opened_at;                                            \
+    while (std::size_t rows = reader->read(block, 2)) {                        \
+      sizes.push_back(rows);                                                   \
+      closes.insert(closes.end(), block.close.begin(), block.close.end());     \
+      for (std::chrono::system_clock::time_point time : block.opened_at) {     \
+        opened_at.push_back(                                                   \
+            std::chrono::duration_cast<std::chrono::seconds>(                  \
+                time.time_since_epoch())                                       \
+                .count());                                                     \
+      }                                                                        \
+    }                                                                          \
+    EXPECT_THAT(sizes, testing::ElementsAre(2, 2, 1));                         \
+    EXPECT_TRUE(block.empty());                                                \
+    EXPECT_EQ(reader->read(block, 2), 0);                                      \
+    EXPECT_THAT(closes, testing::ElementsAre(0.0, 1.0, 2.0, 3.0, 4.0));        \
+    EXPECT_THAT(opened_at, testing::ElementsAre(0, 60, 120, 180, 240));        \
+  }                                                                            \
+  TEST_F(FIXTURE_CLASS, RollsUpSavedCandles) {                                 \
+    upgrade_schema();                                                          \
+    for (int i = 0; i < 7; ++i) {                                              \
+      Candle candle;                                                           \
+      candle.set_open(i);                                                      \
+      candle.set_close(i + 0.5);                                               \
+      candle.set_high(i + 1);                                                  \
+      candle.set_low(i - 1);                                                   \
+      candle.set_volume(10);                                                   \
+      candle.mutable_opened_at()->set_seconds(60 * i);                         \
+      candle.mutable_duration()->set_seconds(60);                              \
+      save_candle(stock::NVDA, candle);                                        \
+    }                                                                          \
+    auto read = [&](candle_resolution resolution) {                            \
+      std::vector<Candle> candles;                                             \
+      for (Candle candle : db().read_candles(                                  \
+               stock::NVDA,                                                    \
+               resolution,                                                     \
+               std::chrono::system_clock::time_point{},                        \
+               std::chrono::system_clock::time_point{std::chrono::days(2)})) { \
+        candles.push_back(std::move(candle));                                  \
+      }                                                                        \
+      return candles;                                                          \
+    };                                                                         \
+    std::vector<Candle> five_minute = read(candle_resolution::FIVE_MINUTES);   \
+    ASSERT_EQ(five_minute.size(), 2);                                          \
+    EXPECT_EQ(five_minute[0].open(), 0.0);                                     \
+    EXPECT_EQ(five_minute[0].close(), 4.5);                                    \
+    EXPECT_EQ(five_minute[0].high(), 5.0);                                     \
+    EXPECT_EQ(five_minute[0].low(), -1.0);                                     \
+    EXPECT_EQ(five_minute[0].volume(), 50);                                    \
+    EXPECT_EQ(five_minute[0].opened_at().seconds(), 0);                        \
+    EXPECT_EQ(five_minute[0].duration().seconds(), 300);                       \
+    EXPECT_EQ(five_minute[1].open(), 5.0);                                     \
+    EXPECT_EQ(five_minute[1].close(), 6.5);                                    \
+    EXPECT_EQ(five_minute[1].volume(), 20);                                    \
+    EXPECT_EQ(five_minute[1].opened_at().seconds(), 300);                      \
+    for (candle_resolution resolution :                                        \
+         {candle_resolution::ONE_HOUR, candle_resolution::ONE_DAY}) {          \
+      std::vector<Candle> rolled_up = read(resolution);                        \
+      ASSERT_EQ(rolled_up.size(), 1);                                          \
+      EXPECT_EQ(rolled_up[0].open(), 0.0);                                     \
+      EXPECT_EQ(rolled_up[0].close(), 6.5);                                    \
+      EXPECT_EQ(rolled_up[0].high(), 7.0);                                     \
+      EXPECT_EQ(rolled_up[0].low(), -1.0);                                     \
+      EXPECT_EQ(rolled_up[0].volume(), 70);                                    \
+      EXPECT_EQ(rolled_up[0].duration().seconds(), 420);                       \
+    }                                                                          \
+    EXPECT_EQ(read(candle_resolution::ONE_MINUTE).size(), 7);                  \
+  }                                                                            \
+  TEST_F(FIXTURE_CLASS, RollsUpCandleBatches) {                                \
+    upgrade_schema();                                                          \
+    std::vector<Candle> candles(3);                                            \
+    for (int i = 0; i < 3; ++i) {                                              \
+      candles[i].set_close(i);                                                 \
+      candles[i].set_volume(10);                                               \
+      candles[i].mutable_opened_at()->set_seconds(3540 + 60 * i);              \
+    }                                                                          \
+    save_batch(stock::NVDA, candles);                                          \
+    candles[0].set_volume(40);                                                 \
+    save_batch(stock::NVDA, {candles[0]});                                     \
+    std::vector<std::pair<int64_t, int64_t>> hours;                            \
+    for (const Candle& candle : db().read_candles(                             \
+             stock::NVDA,                                                      \
+             candle_resolution::ONE_HOUR,                                      \
+             std::chrono::system_clock::time_point{},                          \
+             std::chrono::system_clock::time_point{std::chrono::days(1)})) {   \
+      hours.emplace_back(candle.opened_at().seconds(), candle.volume());       \
+    }                                                                          \
+    EXPECT_THAT(                                                               \
+        hours,                                                                 \
+        testing::ElementsAre(testing::Pair(0, 40), testing::Pair(3600, 20)));  \
+  }                                                                            \
   TEST_F(FIXTURE_CLASS, CanSaveTrade) {                                        \
     upgrade_schema();                                                          \
     trading::TradeRecord trade;                                                \
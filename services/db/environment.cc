@@ -9,3 +9,15 @@ ABSL_FLAG(
     db_encryption_key_name,
     "",
     "The name of the encryption key to be used by the database.");
+ABSL_FLAG(
+    bool,
+    db_market_blocks,
+    false,
+    "Save market ticks packed into one row per symbol and minute instead of "
+    "one row per tick.");
+ABSL_FLAG(
+    std::string,
+    db_archive_dir,
+    "",
+    "Directory of archived market data. When set, candles and market ticks of "
+    "archived days are read from it instead of the database.");
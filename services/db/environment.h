@@ -5,3 +5,5 @@
 #include "absl/flags/declare.h"
 
 ABSL_DECLARE_FLAG(std::string, db_encryption_key_name);
+ABSL_DECLARE_FLAG(bool, db_market_blocks);
+ABSL_DECLARE_FLAG(std::string, db_archive_dir);
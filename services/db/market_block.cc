@@ -0,0 +1,236 @@
+#include "services/db/market_block.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <generator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+#include "services/db/varint.h"
+#include "time/conversion.h"
+
+namespace howling::db_internal {
+namespace {
+
+using ::std::chrono::duration_cast;
+using ::std::chrono::microseconds;
+using ::std::chrono::system_clock;
+
+constexpr char FORMAT_VERSION = 1;
+constexpr int64_t MINUTE_US = 60'000'000;
+// Quoted prices are whole numbers of ten-thousandths of a dollar.
+constexpr double PRICE_SCALE = 10'000;
+// Keeps scaled prices, and the deltas between them, well within 64 bits.
+constexpr double MAX_SCALED_PRICE = 1e12;
+
+int64_t epoch_us(system_clock::time_point time) {
+  return duration_cast<microseconds>(time.time_since_epoch()).count();
+}
+
+int64_t emitted_us(const Market& tick) {
+  return epoch_us(to_std_chrono(tick.emitted_at()));
+}
+
+/**
+ * Sorts ticks by symbol and emission time, keeping only the last of the ticks
+ * which share both.
+ */
+void sort_unique_ticks(std::vector<Market>& ticks) {
+  auto key = [](const Market& tick) {
+    return std::pair<int, int64_t>{tick.symbol(), emitted_us(tick)};
+  };
+  std::ranges::stable_sort(ticks, {}, key);
+  auto out = ticks.begin();
+  for (auto it = ticks.begin(); it != ticks.end(); ++it) {
+    auto next = it + 1;
+    if (next != ticks.end() && key(*next) == key(*it)) continue;
+    if (out != it) *out = std::move(*it);
+    ++out;
+  }
+  ticks.erase(out, ticks.end());
+}
+
+// MARK: Encoding
+
+/** Appends `value` as a zigzag varint delta from `previous`. */
+void append_delta(std::string& out, int64_t value, int64_t& previous) {
+  append_varint(out, zigzag(wrapping_delta(value, previous)));
+  previous = value;
+}
+
+/** Returns the price in ten-thousandths if that represents it exactly. */
+std::optional<int64_t> to_price_units(double price) {
+  if (!(std::abs(price) < MAX_SCALED_PRICE)) return std::nullopt;
+  int64_t units = std::llround(price * PRICE_SCALE);
+  if (std::bit_cast<uint64_t>(units / PRICE_SCALE) !=
+      std::bit_cast<uint64_t>(price)) {
+    return std::nullopt;
+  }
+  return units;
+}
+
+/**
+ * Appends a price. The low bit of the leading varint is clear for a delta of
+ * ten-thousandths from `previous_units`, and set when the 8 bytes of the
+ * double follow instead.
+ */
+void append_price(std::string& out, double price, int64_t& previous_units) {
+  if (std::optional<int64_t> units = to_price_units(price)) {
+    append_varint(out, zigzag(*units - previous_units) << 1);
+    previous_units = *units;
+    return;
+  }
+  append_varint(out, 1);
+  append_fixed(out, std::bit_cast<uint64_t>(price), 8);
+}
+
+// MARK: Decoding
+
+/** Reads the deltas and prices appended above. */
+class block_cursor : public byte_cursor {
+public:
+  explicit block_cursor(std::string_view data)
+      : byte_cursor{data, "Market block"} {}
+
+  int64_t read_delta(int64_t& previous) {
+    previous = wrapping_sum(
+        previous, static_cast<uint64_t>(unzigzag(read_varint())));
+    return previous;
+  }
+
+  double read_price(int64_t& previous_units) {
+    uint64_t tagged = read_varint();
+    if (!(tagged & 1)) {
+      previous_units = wrapping_sum(
+          previous_units, static_cast<uint64_t>(unzigzag(tagged >> 1)));
+      return previous_units / PRICE_SCALE;
+    }
+    return std::bit_cast<double>(read_fixed(8));
+  }
+};
+
+} // namespace
+
+system_clock::time_point market_block_start(system_clock::time_point time) {
+  return std::chrono::floor<std::chrono::minutes>(time);
+}
+
+std::vector<market_block> group_market_blocks(std::span<const Market> ticks) {
+  std::vector<Market> sorted(ticks.begin(), ticks.end());
+  sort_unique_ticks(sorted);
+
+  std::vector<market_block> blocks;
+  for (Market& tick : sorted) {
+    system_clock::time_point minute_start =
+        market_block_start(to_std_chrono(tick.emitted_at()));
+    if (blocks.empty() || blocks.back().symbol != tick.symbol() ||
+        blocks.back().minute_start != minute_start) {
+      blocks.push_back(
+          {.symbol = tick.symbol(), .minute_start = minute_start, .ticks = {}});
+    }
+    blocks.back().ticks.push_back(std::move(tick));
+  }
+  return blocks;
+}
+
+void merge_market_blocks(market_block& into, const market_block& from) {
+  into.ticks.insert(into.ticks.end(), from.ticks.begin(), from.ticks.end());
+  sort_unique_ticks(into.ticks);
+}
+
+std::string encode_market_block(const market_block& block) {
+  std::string out;
+  out.reserve(2 + block.ticks.size() * 16);
+  out.push_back(FORMAT_VERSION);
+  append_varint(out, block.ticks.size());
+
+  int64_t minute_us = epoch_us(block.minute_start);
+  int64_t time = minute_us;
+  int64_t bid = 0, ask = 0, last = 0;
+  int64_t bid_lots = 0, ask_lots = 0, last_lots = 0;
+  for (const Market& tick : block.ticks) {
+    int64_t emitted = emitted_us(tick);
+    if (emitted < time || emitted >= minute_us + MINUTE_US) {
+      throw std::invalid_argument(
+          std::format(
+              "Tick emitted at {}us is out of order or outside of the block "
+              "starting at {}us.",
+              emitted,
+              minute_us));
+    }
+    append_delta(out, emitted, time);
+    append_price(out, tick.bid(), bid);
+    append_delta(out, tick.bid_lots(), bid_lots);
+    append_price(out, tick.ask(), ask);
+    append_delta(out, tick.ask_lots(), ask_lots);
+    append_price(out, tick.last(), last);
+    append_delta(out, tick.last_lots(), last_lots);
+  }
+  return out;
+}
+
+market_block decode_market_block(
+    stock::Symbol symbol,
+    system_clock::time_point minute_start,
+    std::string_view data) {
+  block_cursor cursor{data};
+  if (uint8_t version = cursor.read_byte(); version != FORMAT_VERSION) {
+    throw std::runtime_error(
+        std::format("Unknown market block format version {}.", version));
+  }
+  uint64_t count = cursor.read_varint();
+
+  market_block block{.symbol = symbol, .minute_start = minute_start};
+  // Every tick takes at least 7 bytes, so a corrupt count cannot reserve more
+  // than the data could hold.
+  block.ticks.reserve(std::min<uint64_t>(count, data.size() / 7));
+  int64_t time = epoch_us(minute_start);
+  int64_t bid = 0, ask = 0, last = 0;
+  int64_t bid_lots = 0, ask_lots = 0, last_lots = 0;
+  for (uint64_t i = 0; i < count; ++i) {
+    Market& tick = block.ticks.emplace_back();
+    tick.set_symbol(symbol);
+    *tick.mutable_emitted_at() = to_proto(
+        system_clock::time_point{microseconds{cursor.read_delta(time)}});
+    tick.set_bid(cursor.read_price(bid));
+    tick.set_bid_lots(cursor.read_delta(bid_lots));
+    tick.set_ask(cursor.read_price(ask));
+    tick.set_ask_lots(cursor.read_delta(ask_lots));
+    tick.set_last(cursor.read_price(last));
+    tick.set_last_lots(cursor.read_delta(last_lots));
+  }
+  if (!cursor.done()) {
+    throw std::runtime_error("Market block has bytes after its last tick.");
+  }
+  return block;
+}
+
+std::generator<Market>
+merge_market_ticks(std::generator<Market> rows, std::generator<Market> blocks) {
+  auto row = rows.begin();
+  auto block = blocks.begin();
+  while (row != rows.end() && block != blocks.end()) {
+    if (emitted_us(*block) < emitted_us(*row)) {
+      co_yield std::move(*block);
+      ++block;
+    } else {
+      co_yield std::move(*row);
+      ++row;
+    }
+  }
+  for (; row != rows.end(); ++row) co_yield std::move(*row);
+  for (; block != blocks.end(); ++block) co_yield std::move(*block);
+}
+
+} // namespace howling::db_internal
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <generator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+
+namespace howling::db_internal {
+
+/**
+ * The market ticks of one symbol within one minute, as stored in a single row
+ * of `market_blocks`.
+ *
+ * Ticks are ordered by emission time, with at most one tick per time.
+ */
+struct market_block {
+  stock::Symbol symbol;
+  std::chrono::system_clock::time_point minute_start;
+  std::vector<Market> ticks;
+};
+
+/** Returns the start of the block which holds ticks emitted at `time`. */
+std::chrono::system_clock::time_point
+market_block_start(std::chrono::system_clock::time_point time);
+
+/**
+ * Groups ticks into blocks, ordered by symbol and then by minute.
+ *
+ * When several ticks of a symbol share an emission time, the last of them is
+ * kept.
+ */
+std::vector<market_block> group_market_blocks(std::span<const Market> ticks);
+
+/**
+ * Adds the ticks of `from` to `into`, replacing ticks of `into` which have
+ * the same emission time.
+ */
+void merge_market_blocks(market_block& into, const market_block& from);
+
+/**
+ * Packs the ticks of a block into bytes.
+ *
+ * Emission times are stored as varint deltas from the previous tick, and lots
+ * as zigzag varint deltas. Prices which are a whole number of ten-thousandths
+ * are stored as deltas of that count, and any other price verbatim, so every
+ * tick decodes to exactly what was encoded.
+ *
+ * @throws std::invalid_argument if the ticks are out of order or outside the
+ * block's minute.
+ */
+std::string encode_market_block(const market_block& block);
+
+/**
+ * Unpacks bytes produced by `encode_market_block`.
+ *
+ * @throws std::runtime_error if the bytes are not a valid block.
+ */
+market_block decode_market_block(
+    stock::Symbol symbol,
+    std::chrono::system_clock::time_point minute_start,
+    std::string_view data);
+
+/**
+ * Merges ticks read from the `market` table with ticks unpacked from
+ * `market_blocks`, both ordered by emission time, into one ordered stream.
+ *
+ * Rows come before block ticks emitted at the same time.
+ */
+std::generator<Market>
+merge_market_ticks(std::generator<Market> rows, std::generator<Market> blocks);
+
+} // namespace howling::db_internal
@@ -0,0 +1,188 @@
+#include "services/db/market_block.h"
+
+#include <chrono>
+#include <cmath>
+#include <generator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+#include "time/conversion.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace howling::db_internal {
+namespace {
+
+using ::std::chrono::microseconds;
+using ::std::chrono::minutes;
+using ::std::chrono::system_clock;
+using ::testing::ElementsAre;
+using ::testing::SizeIs;
+
+Market make_tick(
+    stock::Symbol symbol, microseconds emitted_at, double last, int64_t lots) {
+  Market tick;
+  tick.set_symbol(symbol);
+  tick.set_bid(last - 0.01);
+  tick.set_bid_lots(lots + 1);
+  tick.set_ask(last + 0.01);
+  tick.set_ask_lots(lots + 2);
+  tick.set_last(last);
+  tick.set_last_lots(lots);
+  *tick.mutable_emitted_at() = to_proto(system_clock::time_point{emitted_at});
+  return tick;
+}
+
+std::vector<int64_t> emitted_us(const market_block& block) {
+  std::vector<int64_t> times;
+  for (const Market& tick : block.ticks) {
+    times.push_back(
+        std::chrono::duration_cast<microseconds>(
+            to_std_chrono(tick.emitted_at()).time_since_epoch())
+            .count());
+  }
+  return times;
+}
+
+std::generator<Market> yield_all(std::vector<Market> ticks) {
+  for (Market& tick : ticks) co_yield std::move(tick);
+}
+
+TEST(MarketBlock, StartsOnTheMinute) {
+  system_clock::time_point time{minutes(7) + microseconds(59'999'999)};
+  EXPECT_EQ(market_block_start(time), system_clock::time_point{minutes(7)});
+}
+
+TEST(MarketBlock, RoundTripsTicksExactly) {
+  market_block block{
+      .symbol = stock::NVDA,
+      .minute_start = system_clock::time_point{minutes(10)},
+      .ticks = {
+          make_tick(stock::NVDA, minutes(10), 187.33, 100),
+          make_tick(stock::NVDA, minutes(10) + microseconds(250), 187.3, 5),
+          make_tick(stock::NVDA, minutes(10) + microseconds(900), 1.0 / 3, 0),
+          make_tick(stock::NVDA, minutes(11) - microseconds(1), -2.5, -7)}};
+  block.ticks[3].set_ask(std::numeric_limits<double>::infinity());
+  block.ticks[3].set_bid_lots(std::numeric_limits<int64_t>::min());
+
+  market_block decoded = decode_market_block(
+      stock::NVDA, block.minute_start, encode_market_block(block));
+
+  ASSERT_THAT(decoded.ticks, SizeIs(block.ticks.size()));
+  EXPECT_EQ(emitted_us(decoded), emitted_us(block));
+  for (std::size_t i = 0; i < block.ticks.size(); ++i) {
+    EXPECT_EQ(decoded.ticks[i].symbol(), stock::NVDA);
+    EXPECT_EQ(decoded.ticks[i].bid(), block.ticks[i].bid());
+    EXPECT_EQ(decoded.ticks[i].bid_lots(), block.ticks[i].bid_lots());
+    EXPECT_EQ(decoded.ticks[i].ask(), block.ticks[i].ask());
+    EXPECT_EQ(decoded.ticks[i].ask_lots(), block.ticks[i].ask_lots());
+    EXPECT_EQ(decoded.ticks[i].last(), block.ticks[i].last());
+    EXPECT_EQ(decoded.ticks[i].last_lots(), block.ticks[i].last_lots());
+  }
+}
+
+TEST(MarketBlock, PacksQuotedPricesCompactly) {
+  market_block block{
+      .symbol = stock::NVDA, .minute_start = system_clock::time_point{}};
+  for (int i = 0; i < 600; ++i) {
+    // As parsed from quotes, rather than accumulating rounding errors.
+    double price = (12'000 + i % 7) / 100.0;
+    Market& tick = block.ticks.emplace_back(
+        make_tick(stock::NVDA, microseconds(i * 100'000), price, i % 300));
+    tick.set_bid(price);
+    tick.set_ask(price);
+  }
+  // One row of `market` holds 60 bytes of values alone.
+  EXPECT_LT(encode_market_block(block).size(), block.ticks.size() * 16);
+}
+
+TEST(MarketBlock, RejectsTicksOutsideTheMinute) {
+  market_block block{
+      .symbol = stock::NVDA,
+      .minute_start = system_clock::time_point{minutes(1)},
+      .ticks = {make_tick(stock::NVDA, minutes(2), 1, 1)}};
+  EXPECT_THROW(encode_market_block(block), std::invalid_argument);
+}
+
+TEST(MarketBlock, RejectsCorruptData) {
+  market_block block{
+      .symbol = stock::NVDA,
+      .minute_start = system_clock::time_point{},
+      .ticks = {make_tick(stock::NVDA, microseconds(5), 1, 1)}};
+  std::string data = encode_market_block(block);
+
+  EXPECT_THROW(
+      decode_market_block(
+          stock::NVDA, block.minute_start, data.substr(0, data.size() - 1)),
+      std::runtime_error);
+  EXPECT_THROW(
+      decode_market_block(stock::NVDA, block.minute_start, data + '\0'),
+      std::runtime_error);
+  data[0] = 2;
+  EXPECT_THROW(
+      decode_market_block(stock::NVDA, block.minute_start, data),
+      std::runtime_error);
+}
+
+TEST(MarketBlock, GroupsTicksBySymbolAndMinute) {
+  std::vector<Market> ticks{
+      make_tick(stock::NVDA, minutes(1) + microseconds(5), 3, 0),
+      make_tick(stock::AMD, microseconds(1), 1, 0),
+      make_tick(stock::NVDA, microseconds(2), 1, 0),
+      make_tick(stock::NVDA, microseconds(1), 1, 0),
+      make_tick(stock::NVDA, microseconds(2), 2, 0)};
+
+  std::vector<market_block> blocks = group_market_blocks(ticks);
+
+  ASSERT_THAT(blocks, SizeIs(3));
+  EXPECT_EQ(blocks[0].symbol, stock::NVDA);
+  EXPECT_EQ(blocks[0].minute_start, system_clock::time_point{});
+  EXPECT_THAT(emitted_us(blocks[0]), ElementsAre(1, 2));
+  // The later of the two ticks at the same time is kept.
+  EXPECT_EQ(blocks[0].ticks[1].last(), 2);
+  EXPECT_EQ(blocks[1].symbol, stock::NVDA);
+  EXPECT_EQ(blocks[1].minute_start, system_clock::time_point{minutes(1)});
+  EXPECT_EQ(blocks[2].symbol, stock::AMD);
+}
+
+TEST(MarketBlock, MergeReplacesTicksAtTheSameTime) {
+  market_block saved{
+      .symbol = stock::NVDA,
+      .minute_start = system_clock::time_point{},
+      .ticks = {
+          make_tick(stock::NVDA, microseconds(1), 1, 0),
+          make_tick(stock::NVDA, microseconds(3), 3, 0)}};
+  market_block added{
+      .symbol = stock::NVDA,
+      .minute_start = system_clock::time_point{},
+      .ticks = {
+          make_tick(stock::NVDA, microseconds(2), 2, 0),
+          make_tick(stock::NVDA, microseconds(3), 4, 0)}};
+
+  merge_market_blocks(saved, added);
+
+  EXPECT_THAT(emitted_us(saved), ElementsAre(1, 2, 3));
+  EXPECT_EQ(saved.ticks[2].last(), 4);
+}
+
+TEST(MarketBlock, MergesRowsAndBlockTicksByTime) {
+  std::vector<double> merged;
+  for (const Market& tick : merge_market_ticks(
+           yield_all(
+               {make_tick(stock::NVDA, microseconds(1), 1, 0),
+                make_tick(stock::NVDA, microseconds(4), 4, 0)}),
+           yield_all(
+               {make_tick(stock::NVDA, microseconds(2), 2, 0),
+                make_tick(stock::NVDA, microseconds(3), 3, 0),
+                make_tick(stock::NVDA, microseconds(5), 5, 0)}))) {
+    merged.push_back(tick.last());
+  }
+  EXPECT_THAT(merged, ElementsAre(1, 2, 3, 4, 5));
+}
+
+} // namespace
+} // namespace howling::db_internal
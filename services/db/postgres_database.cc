@@ -1,34 +1,101 @@
 #include "services/db/postgres_database.h"
 
+#include <algorithm>
 #include <array>
 #include <bit>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
 #include <deque>
 #include <endian.h>
 #include <exception>
 #include <format>
+#include <functional>
 #include <future>
+#include <iterator>
 #include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <poll.h>
 #include <source_location>
+#include <span>
 #include <string>
+#include <stop_token>
 #include <string_view>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
 #include <utility>
 #include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/log/log.h"
+#include "absl/time/time.h"
 #include "data/candle.pb.h"
 #include "data/stock.pb.h"
 #include "google/protobuf/util/time_util.h"
 #include "libpq/libpq-fe.h"
 #include "services/db/environment.h"
+#include "services/db/market_block.h"
 #include "services/db/schema/auth_token.h"
+#include "services/db/schema/rollups.h"
 #include "services/db/schema/schema.h"
 #include "time/conversion.h"
 
+ABSL_FLAG(
+    int,
+    pg_pipeline_depth,
+    1000,
+    "Maximum number of saves sent to Postgres before waiting on their "
+    "results.");
+ABSL_FLAG(
+    int,
+    pg_fetch_batch_rows,
+    10000,
+    "Number of rows fetched from Postgres at a time when reading history.");
+ABSL_FLAG(
+    int,
+    pg_pool_size,
+    16,
+    "Maximum number of pooled Postgres connections open at once. Reads hold a "
+    "connection until they finish.");
+ABSL_FLAG(
+    absl::Duration,
+    pg_pool_borrow_timeout,
+    absl::Seconds(30),
+    "How long to wait for a pooled Postgres connection to be returned once "
+    "`pg_pool_size` are open, before failing.");
+ABSL_FLAG(
+    absl::Duration,
+    pg_pool_idle_check_interval,
+    absl::Seconds(30),
+    "How long a pooled Postgres connection may sit idle before it is checked "
+    "again before reuse.");
+ABSL_FLAG(
+    absl::Duration,
+    pg_market_block_flush_interval,
+    absl::Seconds(1),
+    "How long market ticks saved one at a time are buffered before being "
+    "packed into their Postgres market blocks, unless a later minute starts "
+    "first.");
+ABSL_FLAG(
+    absl::Duration,
+    pg_partition_premake,
+    absl::Hours(90 * 24),
+    "How far ahead of now time partitions are created when upgrading the "
+    "schema. The upgrade must be rerun before this runs out, which the "
+    "database maintenance job does weekly. Rows past the last partition are "
+    "kept in the default partition until then.");
+ABSL_FLAG(
+    absl::Duration,
+    pg_partition_retention,
+    absl::InfiniteDuration(),
+    "How long partitioned candle and market history is kept. Older partitions "
+    "are dropped when upgrading the schema.");
+
 namespace howling {
 namespace {
 
@@ -39,6 +106,37 @@ using ::std::chrono::system_clock;
 constexpr std::string_view PREPARED_PREFIX = "prepared_";
 constexpr int BINARY_FORMAT = 1;
 constexpr microseconds PG_EPOCH{946684800000000}; // 2000-01-01.
+constexpr std::string_view COPY_SIGNATURE{"PGCOPY\n\377\r\n\0", 11};
+constexpr std::size_t COPY_FLUSH_BYTES = 1 << 20;
+constexpr std::string_view CURSOR_NAME = "howling_cursor";
+
+// Schema version from which the time series tables are partitioned by time.
+constexpr int PARTITIONED_TABLES_VERSION = 8;
+
+/**
+ * A table partitioned into ranges of `span` days of `time_column`, starting
+ * from the Unix epoch. Its primary key is `(symbol, time_column)`.
+ *
+ * Partitions are named `<table>_p<YYYYMMDD>` after the day they start. Rows
+ * outside of every partition go to `<table>_default`.
+ */
+struct partitioned_table {
+  std::string_view table;
+  std::string_view time_column;
+  std::chrono::days span;
+};
+
+constexpr partitioned_table PARTITIONED_TABLES[] = {
+    {.table = "candles",
+     .time_column = "opened_at",
+     .span = std::chrono::days(7)},
+    {.table = "market",
+     .time_column = "emitted_at",
+     .span = std::chrono::days(1)},
+    {.table = "market_blocks",
+     .time_column = "minute_start",
+     .span = std::chrono::days(1)},
+};
 
 struct bytes {
   std::string value;
@@ -71,6 +169,39 @@ void check_not_null(PGresult* res, int row, int col) {
   }
 }
 
+// MARK: Binary Encoding
+
+void append_binary(std::string& out, int16_t val) {
+  val = htobe16(val);
+  out.append(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+void append_binary(std::string& out, int32_t val) {
+  val = htobe32(val);
+  out.append(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+void append_binary(std::string& out, int64_t val) {
+  val = htobe64(val);
+  out.append(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+void append_binary(std::string& out, double val) {
+  append_binary(out, std::bit_cast<int64_t>(val));
+}
+
+void append_binary(std::string& out, bool val) { out.push_back(val ? 1 : 0); }
+
+void append_binary(std::string& out, std::string_view val) { out.append(val); }
+
+void append_binary(std::string& out, const bytes& b) { out.append(b.value); }
+
+void append_binary(std::string& out, system_clock::time_point val) {
+  microseconds duration =
+      duration_cast<microseconds>(val.time_since_epoch() - PG_EPOCH);
+  append_binary(out, static_cast<int64_t>(duration.count()));
+}
+
 template <typename T>
 unsigned int pg_type_id();
 
@@ -109,6 +240,163 @@ unsigned int pg_type_id<system_clock::time_point>() {
   return 1114;
 }
 
+// MARK: Statement Parameters
+
+/** Owns the binary-encoded parameters for one execution of a statement. */
+class statement_params {
+public:
+  template <typename... Args>
+  void bind_all(const Args&... args) {
+    _buffers.clear();
+    _values.clear();
+    _lengths.clear();
+    _formats.clear();
+    if constexpr (sizeof...(Args) > 0) {
+      _values.reserve(sizeof...(Args));
+      _lengths.reserve(sizeof...(Args));
+      _formats.reserve(sizeof...(Args));
+    }
+    (_bind_arg(args), ...);
+  }
+
+  int size() const { return static_cast<int>(_values.size()); }
+  const char* const* values() const { return _values.data(); }
+  const int* lengths() const { return _lengths.data(); }
+  const int* formats() const { return _formats.data(); }
+
+private:
+  template <typename T>
+  void _bind_arg(const T& val) {
+    std::string& buffer = _buffers.emplace_back();
+    append_binary(buffer, val);
+    _values.push_back(buffer.data());
+    _lengths.push_back(static_cast<int>(buffer.size()));
+    _formats.push_back(BINARY_FORMAT);
+  }
+
+  template <typename T>
+  void _bind_arg(const std::optional<T>& val) {
+    if (val) {
+      _bind_arg(*val);
+    } else {
+      _values.push_back(nullptr);
+      _lengths.push_back(0);
+      _formats.push_back(BINARY_FORMAT);
+    }
+  }
+
+  // A deque so that moving the parameters keeps `_values` pointing at them.
+  std::deque<std::string> _buffers;
+  std::vector<const char*> _values;
+  std::vector<int> _lengths;
+  std::vector<int> _formats;
+};
+
+// MARK: Result Rows
+
+/** Owns a query result and steps through its rows. */
+class result_rows {
+public:
+  result_rows() = default;
+  explicit result_rows(PGresult* res)
+      : _res{res}, _total_rows{PQntuples(res)} {}
+
+  ~result_rows() {
+    if (_res) PQclear(_res);
+  }
+
+  result_rows(result_rows&& other) noexcept
+      : _res{std::exchange(other._res, nullptr)},
+        _current_row{other._current_row},
+        _total_rows{other._total_rows} {}
+
+  result_rows& operator=(result_rows&& other) noexcept {
+    std::swap(_res, other._res);
+    std::swap(_current_row, other._current_row);
+    std::swap(_total_rows, other._total_rows);
+    return *this;
+  }
+
+  bool has_result() const { return _res != nullptr; }
+  int size() const { return _total_rows; }
+
+  /** Advances to the next row, returning false once there are none left. */
+  bool next() { return ++_current_row < _total_rows; }
+
+  template <typename... Outputs>
+  void read_all(Outputs&... outs) {
+    if (_current_row < 0 || _current_row >= _total_rows) {
+      throw std::out_of_range("Current row is out of range.");
+    }
+    int col = 0;
+    (this->_read_column(_current_row, col++, outs), ...);
+  }
+
+private:
+  // MARK: Read Column
+
+  void _read_column(int row, int col, std::string_view& out) {
+    check_not_null(_res, row, col);
+    out = std::string_view{
+        PQgetvalue(_res, /*tup_num=*/row, /*field_num=*/col),
+        static_cast<size_t>(
+            PQgetlength(_res, /*tup_num=*/row, /*field_num=*/col))};
+  }
+
+  void _read_column(int row, int col, std::string& out) {
+    std::string_view out_view;
+    _read_column(row, col, out_view);
+    out = std::string{out_view};
+  }
+
+  void _read_column(int row, int col, int32_t& out) {
+    check_not_null(_res, row, col);
+    int32_t net_val;
+    memcpy(&net_val, PQgetvalue(_res, row, col), sizeof(net_val));
+    out = be32toh(net_val);
+  }
+
+  void _read_column(int row, int col, int64_t& out) {
+    check_not_null(_res, row, col);
+    int64_t net_val;
+    memcpy(&net_val, PQgetvalue(_res, row, col), sizeof(net_val));
+    // Postgres sends int64 in network byte order
+    out = be64toh(net_val);
+  }
+
+  void _read_column(int row, int col, double& out) {
+    check_not_null(_res, row, col);
+    // Postgres sends float8 as IEEE 754 binary, usually big-endian.
+    uint64_t net_int;
+    memcpy(&net_int, PQgetvalue(_res, row, col), sizeof(net_int));
+    out = std::bit_cast<double>(be64toh(net_int));
+  }
+
+  void _read_column(int row, int col, bool& out) {
+    check_not_null(_res, row, col);
+    out = *PQgetvalue(_res, row, col) != 0;
+  }
+
+  void _read_column(int row, int col, system_clock::time_point& time) {
+    int64_t wire_val;
+    _read_column(row, col, wire_val);
+    time = system_clock::time_point{PG_EPOCH + microseconds{wire_val}};
+  }
+
+  template <typename T>
+  void _read_column(int row, int col, std::optional<T>& out) {
+    if (PQgetisnull(_res, row, col)) {
+      out = std::nullopt;
+      return;
+    }
+    _read_column(row, col, out.emplace());
+  }
+
+  PGresult* _res = nullptr;
+  int _current_row = -1;
+  int _total_rows = 0;
+};
+
 // MARK: Query Class
 
 class query {
@@ -137,9 +425,9 @@ public:
   query(already_prepared_t, PGconn* conn, std::string name)
       : _conn{conn}, _name{std::move(name)} {}
 
-  // Fallback for ad-hoc queries
-  query(PGconn* conn, const std::string& query_str)
-      : _conn{conn}, _name{_to_prepared_name(query_str)} {
+  // Fallback for ad-hoc queries, which use the unnamed statement so that the
+  // same query can run again on the same connection.
+  query(PGconn* conn, const std::string& query_str) : _conn{conn} {
     inline_check_command_result(
         PQprepare(
             conn,
@@ -150,59 +438,39 @@ public:
         *conn);
   }
 
-  ~query() {
-    if (_res) PQclear(_res);
-  }
-
   void execute() {
-    if (_res) PQclear(_res);
-    _res = PQexecPrepared(
+    PGresult* res = PQexecPrepared(
         _conn,
         _name.c_str(),
-        /*nParams=*/static_cast<int>(_param_values.size()),
-        _param_values.data(),
-        _param_lengths.data(),
-        _param_formats.data(),
+        /*nParams=*/_params.size(),
+        _params.values(),
+        _params.lengths(),
+        _params.formats(),
         /*resultFormat=*/BINARY_FORMAT);
 
-    int code = PQresultStatus(_res);
+    int code = PQresultStatus(res);
     if (code != PGRES_COMMAND_OK && code != PGRES_TUPLES_OK) {
-      inline_check_command_result(_res, *_conn);
+      inline_check_command_result(res, *_conn);
     }
-    _current_row = -1;
-    _total_rows = PQntuples(_res);
+    _rows = result_rows{res};
   }
 
+  const std::string& name() const { return _name; }
+
   bool step() {
-    if (!_res) execute();
-    return ++_current_row < _total_rows;
+    if (!_rows.has_result()) execute();
+    return _rows.next();
   }
 
   template <typename... Args>
   void bind_all(Args&&... args) {
-    if (_res) {
-      PQclear(_res);
-      _res = nullptr;
-    }
-    _param_buffers.clear();
-    _param_values.clear();
-    _param_lengths.clear();
-    _param_formats.clear();
-    if constexpr (sizeof...(Args) > 0) {
-      _param_values.reserve(sizeof...(Args));
-      _param_lengths.reserve(sizeof...(Args));
-      _param_formats.reserve(sizeof...(Args));
-    }
-    (_bind_arg(args), ...);
+    _rows = result_rows{};
+    _params.bind_all(args...);
   }
 
   template <typename... Outputs>
   void read_all(Outputs&... outs) {
-    if (_current_row < 0 || _current_row >= _total_rows) {
-      throw std::out_of_range("Current row is out of range.");
-    }
-    int col = 0;
-    (this->_read_column(_current_row, col++, outs), ...);
+    _rows.read_all(outs...);
   }
 
 private:
@@ -211,130 +479,664 @@ private:
         std::to_string(std::hash<std::string_view>{}(query_str));
   }
 
-  void _store_param(const void* data, size_t len) {
-    std::string& buffer =
-        _param_buffers.emplace_back(reinterpret_cast<const char*>(data), len);
-    _param_values.push_back(buffer.data());
-    _param_lengths.push_back(static_cast<int>(len));
-    _param_formats.push_back(BINARY_FORMAT);
+  PGconn* _conn;
+  const std::string _name;
+  result_rows _rows;
+  statement_params _params;
+};
+
+void execute(PGconn& db, const std::string& query_str) {
+  inline_check_command_result(PQexec(/*conn=*/&db, query_str.c_str()), db);
+}
+
+template <typename F>
+void in_transaction(PGconn& conn, F&& body) {
+  execute(conn, "BEGIN");
+  try {
+    body();
+    execute(conn, "COMMIT");
+  } catch (...) {
+    PQclear(PQexec(&conn, "ROLLBACK"));
+    throw;
   }
+}
+
+// MARK: Binary Copy
 
-  void _bind_arg(int32_t val) {
-    val = htobe32(val);
-    _store_param(&val, sizeof(val));
+/**
+ * Streams rows into a `COPY ... FROM STDIN (FORMAT binary)` statement.
+ *
+ * The copy is aborted if the writer is destroyed before `finish` is called.
+ */
+class copy_writer {
+public:
+  copy_writer(PGconn& conn, const std::string& copy_str) : _conn{conn} {
+    PGresult* res = PQexec(&_conn, copy_str.c_str());
+    if (PQresultStatus(res) != PGRES_COPY_IN) {
+      inline_check_command_result(res, _conn);
+      throw std::runtime_error("Statement did not start a COPY FROM STDIN.");
+    }
+    PQclear(res);
+    _active = true;
+
+    _buffer.append(COPY_SIGNATURE);
+    append_binary(_buffer, int32_t{0}); // Flags.
+    append_binary(_buffer, int32_t{0}); // Header extension length.
   }
 
-  void _bind_arg(int64_t val) {
-    val = htobe64(val);
-    _store_param(&val, sizeof(val));
+  ~copy_writer() {
+    if (!_active) return;
+    PQputCopyEnd(&_conn, "Copy aborted by client.");
+    while (PGresult* res = PQgetResult(&_conn)) PQclear(res);
   }
 
-  void _bind_arg(double val) {
-    uint64_t int_val = htobe64(std::bit_cast<uint64_t>(val));
-    _store_param(&int_val, sizeof(int_val));
+  copy_writer(const copy_writer&) = delete;
+  copy_writer& operator=(const copy_writer&) = delete;
+
+  template <typename... Fields>
+  void write_row(const Fields&... fields) {
+    append_binary(_buffer, static_cast<int16_t>(sizeof...(Fields)));
+    (_append_field(fields), ...);
+    if (_buffer.size() >= COPY_FLUSH_BYTES) _flush();
   }
 
-  void _bind_arg(bool val) {
-    val = val ? 1 : 0;
-    _store_param(&val, 1);
+  void finish() {
+    append_binary(_buffer, int16_t{-1}); // File trailer.
+    _flush();
+    _active = false;
+    if (PQputCopyEnd(&_conn, /*errormsg=*/nullptr) != 1) {
+      throw std::runtime_error(
+          std::format("Failed to end COPY: {}", PQerrorMessage(&_conn)));
+    }
+    PGresult* res = PQgetResult(&_conn);
+    while (PGresult* extra = PQgetResult(&_conn)) PQclear(extra);
+    inline_check_command_result(res, _conn);
   }
 
-  void _bind_arg(std::string_view val) { _store_param(val.data(), val.size()); }
+private:
+  template <typename T>
+  void _append_field(const T& val) {
+    std::size_t length_at = _buffer.size();
+    _buffer.append(sizeof(int32_t), '\0');
+    append_binary(_buffer, val);
+    int32_t length = htobe32(
+        static_cast<int32_t>(_buffer.size() - length_at - sizeof(int32_t)));
+    std::memcpy(_buffer.data() + length_at, &length, sizeof(length));
+  }
 
-  void _bind_arg(const bytes& b) {
-    _store_param(b.value.data(), b.value.size());
+  void _flush() {
+    if (PQputCopyData(&_conn, _buffer.data(), _buffer.size()) != 1) {
+      throw std::runtime_error(
+          std::format("Failed to send COPY data: {}", PQerrorMessage(&_conn)));
+    }
+    _buffer.clear();
   }
 
-  void _bind_arg(system_clock::time_point val) {
-    microseconds duration =
-        duration_cast<microseconds>(val.time_since_epoch() - PG_EPOCH);
-    _bind_arg(duration.count());
+  PGconn& _conn;
+  std::string _buffer;
+  bool _active = false;
+};
+
+// MARK: Connection Pool
+
+PGconn* connect(const std::string& connection_parameters) {
+  PGconn* conn = PQconnectdb(connection_parameters.c_str());
+  try {
+    check_pgconn_err(*conn);
+  } catch (...) {
+    PQfinish(conn);
+    throw;
   }
+  return conn;
+}
 
-  template <typename T>
-  void _bind_arg(const std::optional<T>& val) {
-    if (val) {
-      _bind_arg(*val);
+/** A connection owned by a `connection_pool`. */
+struct pooled_connection {
+  explicit pooled_connection(PGconn* conn) : conn{conn} {}
+  ~pooled_connection() { PQfinish(conn); }
+
+  pooled_connection(const pooled_connection&) = delete;
+  pooled_connection& operator=(const pooled_connection&) = delete;
+
+  PGconn* conn;
+  std::map<std::string, std::unique_ptr<query>> prepared_queries;
+  // The pool setup last applied to the connection, or 0 for none.
+  uint64_t setup_generation = 0;
+  std::chrono::steady_clock::time_point idle_since =
+      std::chrono::steady_clock::now();
+};
+
+/**
+ * Lends out Postgres connections so that each borrower has a connection, and
+ * the statements prepared on it, to itself.
+ *
+ * At most `pg_pool_size` connections are open at once. Connections are opened
+ * as they are first needed and kept open for reuse once returned. When all of
+ * them are lent out, borrowers wait up to `pg_pool_borrow_timeout` for one to
+ * be returned before failing. Connections are checked
+ * before being lent: broken ones are reset, and those idle for longer than
+ * `pg_pool_idle_check_interval` are pinged first. Connections returned broken
+ * or within a transaction are closed.
+ *
+ * This class is internally synchronized.
+ */
+class connection_pool {
+public:
+  using setup_function = std::function<void(pooled_connection&)>;
+
+  /** A borrowed connection, which is returned to its pool on destruction. */
+  class lease {
+  public:
+    lease(connection_pool& pool, std::unique_ptr<pooled_connection> connection)
+        : _pool{&pool}, _connection{std::move(connection)} {}
+
+    lease(lease&&) = default;
+    lease& operator=(lease&&) = delete;
+
+    ~lease() {
+      if (_connection) _pool->_give_back(std::move(_connection));
+    }
+
+    PGconn& conn() const { return *_connection->conn; }
+
+    /** Returns a statement prepared by the pool's setup. */
+    query& prepared(const std::string& name) const {
+      return *_connection->prepared_queries.at(name);
+    }
+
+  private:
+    connection_pool* _pool;
+    std::unique_ptr<pooled_connection> _connection;
+  };
+
+  explicit connection_pool(std::string connection_parameters)
+      : _connection_parameters{std::move(connection_parameters)},
+        _size{static_cast<std::size_t>(
+            std::max(1, absl::GetFlag(FLAGS_pg_pool_size)))},
+        _idle_check_interval{
+            to_std_chrono(absl::GetFlag(FLAGS_pg_pool_idle_check_interval))},
+        _borrow_timeout{
+            to_std_chrono(absl::GetFlag(FLAGS_pg_pool_borrow_timeout))} {
+    // Connecting up front surfaces bad connection parameters immediately.
+    _idle.push_back(_open());
+    _open_count = 1;
+  }
+
+  connection_pool(const connection_pool&) = delete;
+  connection_pool& operator=(const connection_pool&) = delete;
+
+  /**
+   * @brief Lends out a connection, waiting for one to be returned if
+   * `pg_pool_size` are already open.
+   *
+   * @throws A runtime error if no connection is returned within
+   * `pg_pool_borrow_timeout`.
+   */
+  lease borrow() {
+    std::unique_ptr<pooled_connection> connection;
+    setup_function setup;
+    uint64_t generation;
+    {
+      std::unique_lock lock{_mutex};
+      if (!_returned.wait_for(lock, _borrow_timeout, [&]() {
+            return !_idle.empty() || _open_count < _size;
+          })) {
+        throw std::runtime_error(
+            std::format(
+                "Timed out waiting for one of {} pooled Postgres connections.",
+                _size));
+      }
+      if (!_idle.empty()) {
+        connection = std::move(_idle.back());
+        _idle.pop_back();
+      } else {
+        // Counted before connecting so other borrowers cannot overshoot.
+        ++_open_count;
+      }
+      setup = _setup;
+      generation = _generation;
+    }
+
+    try {
+      if (connection && !_make_healthy(*connection)) connection.reset();
+      if (!connection) connection = _open();
+
+      if (connection->setup_generation != generation) {
+        // Statements from an earlier setup would clash by name with new ones.
+        if (!connection->prepared_queries.empty()) {
+          execute(*connection->conn, "DEALLOCATE ALL");
+          connection->prepared_queries.clear();
+        }
+        setup(*connection);
+        connection->setup_generation = generation;
+      }
+    } catch (...) {
+      connection.reset();
+      _close_one();
+      throw;
+    }
+    return lease{*this, std::move(connection)};
+  }
+
+  /**
+   * @brief Applies `setup` to every connection before it is next lent out,
+   * replacing any earlier setup.
+   */
+  void set_setup(setup_function setup) {
+    std::lock_guard lock{_mutex};
+    _setup = std::move(setup);
+    ++_generation;
+  }
+
+private:
+  std::unique_ptr<pooled_connection> _open() const {
+    return std::make_unique<pooled_connection>(connect(_connection_parameters));
+  }
+
+  /** Resets the connection if it is broken, returning false if that fails. */
+  bool _make_healthy(pooled_connection& connection) const {
+    bool check_due = std::chrono::steady_clock::now() - connection.idle_since >
+        _idle_check_interval;
+    if (PQstatus(connection.conn) == CONNECTION_OK &&
+        (!check_due || _ping(*connection.conn))) {
+      return true;
+    }
+
+    LOG(WARNING) << "Resetting broken Postgres connection: "
+                 << PQerrorMessage(connection.conn);
+    PQreset(connection.conn);
+    // Prepared statements and temporary tables do not survive a reset.
+    connection.prepared_queries.clear();
+    connection.setup_generation = 0;
+    return PQstatus(connection.conn) == CONNECTION_OK;
+  }
+
+  static bool _ping(PGconn& conn) {
+    PGresult* res = PQexec(&conn, "SELECT 1");
+    bool ok = PQresultStatus(res) == PGRES_TUPLES_OK;
+    PQclear(res);
+    return ok;
+  }
+
+  void _give_back(std::unique_ptr<pooled_connection> connection) {
+    if (PQstatus(connection->conn) != CONNECTION_OK ||
+        PQtransactionStatus(connection->conn) != PQTRANS_IDLE) {
+      connection.reset();
+      _close_one();
+      return;
+    }
+    connection->idle_since = std::chrono::steady_clock::now();
+    {
+      std::lock_guard lock{_mutex};
+      _idle.push_back(std::move(connection));
+    }
+    _returned.notify_one();
+  }
+
+  /** Frees the place of a connection which has been closed. */
+  void _close_one() {
+    {
+      std::lock_guard lock{_mutex};
+      --_open_count;
+    }
+    _returned.notify_one();
+  }
+
+  const std::string _connection_parameters;
+  const std::size_t _size;
+  const microseconds _idle_check_interval;
+  const microseconds _borrow_timeout;
+
+  std::mutex _mutex;
+  std::condition_variable _returned;
+  // Connections lent out or idle.
+  std::size_t _open_count = 0;
+  std::vector<std::unique_ptr<pooled_connection>> _idle;
+  setup_function _setup = [](pooled_connection&) {};
+  uint64_t _generation = 0;
+};
+
+// MARK: Cursor
+
+/**
+ * Reads a query's results through a server-side cursor, fetching
+ * `pg_fetch_batch_rows` rows at a time so that client memory stays bounded no
+ * matter how many rows the query returns.
+ *
+ * The cursor keeps its borrowed connection, and a read transaction on it, for
+ * as long as it lives.
+ */
+class cursor {
+public:
+  template <typename... Args>
+  cursor(
+      connection_pool::lease lease,
+      std::string_view query_str,
+      const Args&... args)
+      : _lease{std::move(lease)},
+        _batch_rows{std::max(1, absl::GetFlag(FLAGS_pg_fetch_batch_rows))},
+        _fetch_str{
+            std::format("FETCH FORWARD {} FROM {}", _batch_rows, CURSOR_NAME)} {
+    PGconn& conn = _lease.conn();
+    execute(conn, "BEGIN READ ONLY");
+    try {
+      statement_params params;
+      params.bind_all(args...);
+      std::array<unsigned int, sizeof...(Args)> type_ids{
+          pg_type_id<Args>()...};
+      std::string declare_str = std::format(
+          "DECLARE {} NO SCROLL CURSOR FOR {}", CURSOR_NAME, query_str);
+      inline_check_command_result(
+          PQexecParams(
+              &conn,
+              declare_str.c_str(),
+              params.size(),
+              type_ids.data(),
+              params.values(),
+              params.lengths(),
+              params.formats(),
+              /*resultFormat=*/BINARY_FORMAT),
+          conn);
+    } catch (...) {
+      PQclear(PQexec(&conn, "ROLLBACK"));
+      throw;
+    }
+  }
+
+  ~cursor() {
+    // Ending the transaction closes the cursor too. Committing a failed
+    // transaction rolls it back instead.
+    PQclear(PQexec(&_lease.conn(), "COMMIT"));
+  }
+
+  cursor(const cursor&) = delete;
+  cursor& operator=(const cursor&) = delete;
+
+  /** Advances to the next row, fetching another batch when needed. */
+  bool step() {
+    if (_rows.next()) return true;
+    if (_exhausted) return false;
+
+    PGconn& conn = _lease.conn();
+    PGresult* res = PQexecParams(
+        &conn,
+        _fetch_str.c_str(),
+        /*nParams=*/0,
+        /*paramTypes=*/nullptr,
+        /*paramValues=*/nullptr,
+        /*paramLengths=*/nullptr,
+        /*paramFormats=*/nullptr,
+        /*resultFormat=*/BINARY_FORMAT);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+      inline_check_command_result(res, conn);
+    }
+    _rows = result_rows{res};
+    // A short batch means the cursor has no rows left to fetch.
+    _exhausted = _rows.size() < _batch_rows;
+    return _rows.next();
+  }
+
+  template <typename... Outputs>
+  void read_all(Outputs&... outs) {
+    _rows.read_all(outs...);
+  }
+
+private:
+  connection_pool::lease _lease;
+  const int _batch_rows;
+  const std::string _fetch_str;
+  result_rows _rows;
+  bool _exhausted = false;
+};
+
+// MARK: Pipeline
+
+/**
+ * A promise completed once each of its parts has finished, with the first
+ * error reported by any of them.
+ *
+ * This class is internally synchronized.
+ */
+class joined_promise {
+public:
+  explicit joined_promise(std::size_t parts) : _remaining{parts} {}
+
+  std::future<void> get_future() { return _promise.get_future(); }
+
+  /** @brief Finishes one part, failed if `error` is set. */
+  void finish(std::exception_ptr error = nullptr) {
+    std::lock_guard lock{_mutex};
+    if (error && !_error) _error = error;
+    if (--_remaining > 0) return;
+    if (_error) {
+      _promise.set_exception(_error);
     } else {
-      _param_values.push_back(nullptr);
-      _param_lengths.push_back(0);
-      _param_formats.push_back(BINARY_FORMAT);
+      _promise.set_value();
     }
   }
 
-  // MARK: Read Column
+private:
+  std::mutex _mutex;
+  std::size_t _remaining;
+  std::exception_ptr _error;
+  std::promise<void> _promise;
+};
 
-  void _read_column(int row, int col, std::string_view& out) {
-    check_not_null(_res, row, col);
-    out = std::string_view{
-        PQgetvalue(_res, /*tup_num=*/row, /*field_num=*/col),
-        static_cast<size_t>(
-            PQgetlength(_res, /*tup_num=*/row, /*field_num=*/col))};
+/**
+ * Executes prepared statements on a dedicated connection in pipeline mode.
+ *
+ * Statements are queued by `send` and written to the connection by a sender
+ * thread without waiting on the results of earlier statements, so up to
+ * `pg_pipeline_depth` statements are in flight at once. Each statement is
+ * followed by its own sync point so that one failing statement does not abort
+ * those after it. Futures are completed in order as results arrive.
+ *
+ * Statements still queued on destruction are executed before the destructor
+ * returns.
+ *
+ * This class is internally synchronized.
+ */
+class pipeline {
+public:
+  explicit pipeline(PGconn& conn)
+      : _conn{conn},
+        _max_in_flight{static_cast<std::size_t>(
+            std::max(1, absl::GetFlag(FLAGS_pg_pipeline_depth)))},
+        _wake_fd{eventfd(/*initval=*/0, EFD_NONBLOCK | EFD_CLOEXEC)} {
+    if (_wake_fd < 0) {
+      throw std::runtime_error("Failed to create pipeline wake event.");
+    }
+    if (PQenterPipelineMode(&_conn) != 1 || PQsetnonblocking(&_conn, 1) != 0) {
+      close(_wake_fd);
+      throw std::runtime_error(
+          std::format(
+              "Failed to enter pipeline mode: {}", PQerrorMessage(&_conn)));
+    }
+    _sender = std::jthread([this](std::stop_token stop) { _run(stop); });
   }
 
-  void _read_column(int row, int col, std::string& out) {
-    std::string_view out_view;
-    _read_column(row, col, out_view);
-    out = std::string{out_view};
+  ~pipeline() {
+    _sender.request_stop();
+    _sender.join();
+    close(_wake_fd);
+  }
+
+  pipeline(const pipeline&) = delete;
+  pipeline& operator=(const pipeline&) = delete;
+
+  /**
+   * @brief Queues an execution of `statement`, which must have been prepared
+   * on the pipeline's connection.
+   */
+  template <typename... Args>
+  std::future<void> send(const query& statement, const Args&... args) {
+    auto done = std::make_shared<joined_promise>(1);
+    std::future<void> future = done->get_future();
+    send_part(std::move(done), statement, args...);
+    return future;
+  }
+
+  /**
+   * @brief Queues an execution of `statement` as one part of `done`, so that
+   * several statements can complete a single future.
+   */
+  template <typename... Args>
+  void send_part(
+      std::shared_ptr<joined_promise> done,
+      const query& statement,
+      const Args&... args) {
+    pending_statement pending{
+        .name = statement.name(), .done = std::move(done)};
+    pending.params.bind_all(args...);
+    {
+      std::lock_guard lock{_mutex};
+      _queue.push_back(std::move(pending));
+    }
+    _wake();
   }
 
-  void _read_column(int row, int col, int32_t& out) {
-    check_not_null(_res, row, col);
-    int32_t net_val;
-    memcpy(&net_val, PQgetvalue(_res, row, col), sizeof(net_val));
-    out = be32toh(net_val);
+private:
+  struct pending_statement {
+    std::string name;
+    statement_params params;
+    std::shared_ptr<joined_promise> done;
+  };
+
+  struct in_flight_statement {
+    std::shared_ptr<joined_promise> done;
+    std::optional<std::string> error;
+  };
+
+  void _wake() {
+    uint64_t one = 1;
+    // A failed write means the counter is already set and a wake is pending.
+    [[maybe_unused]] ssize_t written = write(_wake_fd, &one, sizeof(one));
   }
 
-  void _read_column(int row, int col, int64_t& out) {
-    check_not_null(_res, row, col);
-    int64_t net_val;
-    memcpy(&net_val, PQgetvalue(_res, row, col), sizeof(net_val));
-    // Postgres sends int64 in network byte order
-    out = be64toh(net_val);
+  void _run(std::stop_token stop) {
+    std::stop_callback wake_on_stop{stop, [this]() { _wake(); }};
+    std::deque<in_flight_statement> in_flight;
+    std::vector<pending_statement> sending;
+    while (true) {
+      {
+        std::lock_guard lock{_mutex};
+        // Once stopped, queued statements are still executed before exiting.
+        if (stop.stop_requested() && _queue.empty() && in_flight.empty()) {
+          return;
+        }
+        while (!_queue.empty() &&
+               in_flight.size() + sending.size() < _max_in_flight) {
+          sending.push_back(std::move(_queue.front()));
+          _queue.pop_front();
+        }
+      }
+      for (pending_statement& pending : sending) _send(pending, in_flight);
+      sending.clear();
+      _exchange(in_flight);
+    }
   }
 
-  void _read_column(int row, int col, double& out) {
-    check_not_null(_res, row, col);
-    // Postgres sends float8 as IEEE 754 binary, usually big-endian.
-    uint64_t net_int;
-    memcpy(&net_int, PQgetvalue(_res, row, col), sizeof(net_int));
-    out = std::bit_cast<double>(be64toh(net_int));
+  void _send(
+      pending_statement& pending, std::deque<in_flight_statement>& in_flight) {
+    int sent = PQsendQueryPrepared(
+        &_conn,
+        pending.name.c_str(),
+        pending.params.size(),
+        pending.params.values(),
+        pending.params.lengths(),
+        pending.params.formats(),
+        /*resultFormat=*/BINARY_FORMAT);
+    if (sent != 1) {
+      pending.done->finish(
+          std::make_exception_ptr(std::runtime_error(
+              std::format(
+                  "Failed to send statement: {}", PQerrorMessage(&_conn)))));
+      return;
+    }
+    in_flight.push_back({.done = std::move(pending.done)});
+    if (PQpipelineSync(&_conn) != 1) _fail_all(in_flight);
   }
 
-  void _read_column(int row, int col, bool& out) {
-    check_not_null(_res, row, col);
-    out = *PQgetvalue(_res, row, col) != 0;
+  /**
+   * Flushes sent statements and then waits until the connection has results to
+   * read, can accept more data, or more statements are queued.
+   */
+  void _exchange(std::deque<in_flight_statement>& in_flight) {
+    int unflushed = PQflush(&_conn);
+    if (unflushed < 0) return _fail_all(in_flight);
+
+    std::array<pollfd, 2> fds{
+        pollfd{.fd = _wake_fd, .events = POLLIN},
+        pollfd{
+            // Negative descriptors are ignored, so an idle connection does not
+            // wake the sender.
+            .fd = in_flight.empty() && !unflushed ? -1 : PQsocket(&_conn),
+            .events = static_cast<short>(
+                (in_flight.empty() ? 0 : POLLIN) | (unflushed ? POLLOUT : 0))}};
+    if (poll(fds.data(), fds.size(), /*timeout=*/-1) < 0) return;
+
+    if (fds[0].revents & POLLIN) {
+      uint64_t count;
+      [[maybe_unused]] ssize_t read_bytes =
+          read(_wake_fd, &count, sizeof(count));
+    }
+    if (fds[1].revents & (POLLIN | POLLERR | POLLHUP)) {
+      if (PQconsumeInput(&_conn) != 1) return _fail_all(in_flight);
+      _read_results(in_flight);
+    }
   }
 
-  void _read_column(int row, int col, system_clock::time_point& time) {
-    int64_t wire_val;
-    _read_column(row, col, wire_val);
-    time = system_clock::time_point{PG_EPOCH + microseconds{wire_val}};
+  void _read_results(std::deque<in_flight_statement>& in_flight) {
+    while (!in_flight.empty() && !PQisBusy(&_conn)) {
+      // A null result marks the end of one statement's results.
+      PGresult* res = PQgetResult(&_conn);
+      if (!res) continue;
+
+      in_flight_statement& front = in_flight.front();
+      switch (PQresultStatus(res)) {
+        case PGRES_COMMAND_OK:
+        case PGRES_TUPLES_OK:
+          break;
+        case PGRES_PIPELINE_SYNC:
+          if (front.error) {
+            front.done->finish(
+                std::make_exception_ptr(std::runtime_error(*front.error)));
+          } else {
+            front.done->finish();
+          }
+          in_flight.pop_front();
+          break;
+        default:
+          if (!front.error) {
+            front.error = std::format(
+                "Postgres result error ({}) {}",
+                static_cast<int>(PQresultStatus(res)),
+                PQresultErrorMessage(res));
+          }
+          break;
+      }
+      PQclear(res);
+    }
   }
 
-  template <typename T>
-  void _read_column(int row, int col, std::optional<T>& out) {
-    if (PQgetisnull(_res, row, col)) {
-      out = std::nullopt;
-      return;
+  void _fail_all(std::deque<in_flight_statement>& in_flight) {
+    std::string message =
+        std::format("Postgres pipeline error: {}", PQerrorMessage(&_conn));
+    for (in_flight_statement& statement : in_flight) {
+      statement.done->finish(
+          std::make_exception_ptr(std::runtime_error(message)));
     }
-    _read_column(row, col, out.emplace());
+    in_flight.clear();
   }
 
-  PGconn* _conn;
-  const std::string _name;
-  PGresult* _res = nullptr;
-  int _current_row = -1;
-  int _total_rows = 0;
-  std::deque<std::string> _param_buffers;
-  std::vector<const char*> _param_values;
-  std::vector<int> _param_lengths;
-  std::vector<int> _param_formats;
-};
+  PGconn& _conn;
+  const std::size_t _max_in_flight;
+  const int _wake_fd;
 
-void execute(PGconn& db, const std::string& query_str) {
-  inline_check_command_result(PQexec(/*conn=*/&db, query_str.c_str()), db);
-}
+  std::mutex _mutex;
+  std::deque<pending_statement> _queue;
+  std::jthread _sender;
+};
 
 template <typename... Outputs>
 void execute_read(query& q, Outputs&&... outs) {
@@ -387,6 +1189,247 @@ int get_schema_version(PGconn& conn) {
   return version;
 }
 
+/** Fills the rollup tables from the candles saved before they existed. */
+void backfill_rollups(PGconn& conn) {
+  for (const db_internal::candle_rollup& rollup : db_internal::CANDLE_ROLLUPS) {
+    execute(
+        conn,
+        std::format(
+            R"sql(
+              INSERT INTO {0} (
+                symbol, open, close, high, low, volume, opened_at, duration_us
+              )
+              SELECT
+                symbol,
+                (array_agg(open ORDER BY opened_at ASC))[1],
+                (array_agg(close ORDER BY opened_at DESC))[1],
+                max(high),
+                min(low),
+                sum(volume),
+                date_bin(INTERVAL '{2} seconds', opened_at, TIMESTAMP 'epoch')
+                  AS start,
+                sum(duration_us)
+              FROM {1}
+              GROUP BY symbol, start)sql",
+            rollup.table,
+            rollup.source_table,
+            duration_cast<std::chrono::seconds>(rollup.length).count()));
+  }
+}
+
+/**
+ * Rebuilds the rolled up candles containing any of the candles in
+ * `candles_staging` from the candles they are rolled up from.
+ */
+void update_staged_rollups(PGconn& conn) {
+  for (const db_internal::candle_rollup& rollup : db_internal::CANDLE_ROLLUPS) {
+    execute(
+        conn,
+        std::format(
+            R"sql(
+              INSERT INTO {0} (
+                symbol, open, close, high, low, volume, opened_at, duration_us
+              )
+              SELECT
+                source.symbol,
+                (array_agg(source.open ORDER BY source.opened_at ASC))[1],
+                (array_agg(source.close ORDER BY source.opened_at DESC))[1],
+                max(source.high),
+                min(source.low),
+                sum(source.volume),
+                touched.start,
+                sum(source.duration_us)
+              FROM (
+                SELECT DISTINCT
+                  symbol,
+                  date_bin(
+                    INTERVAL '{2} seconds', opened_at, TIMESTAMP 'epoch'
+                  ) AS start
+                FROM candles_staging
+              ) AS touched
+              JOIN {1} AS source
+                ON source.symbol = touched.symbol
+                AND source.opened_at >= touched.start
+                AND source.opened_at < touched.start + INTERVAL '{2} seconds'
+              GROUP BY source.symbol, touched.start
+              ON CONFLICT (symbol, opened_at) DO UPDATE SET
+                open = EXCLUDED.open,
+                close = EXCLUDED.close,
+                high = EXCLUDED.high,
+                low = EXCLUDED.low,
+                volume = EXCLUDED.volume,
+                duration_us = EXCLUDED.duration_us)sql",
+            rollup.table,
+            rollup.source_table,
+            duration_cast<std::chrono::seconds>(rollup.length).count()));
+  }
+}
+
+// MARK: Partitions
+
+/**
+ * Replaces a table with one partitioned by time, indexing its time column
+ * with BRIN. Existing rows move to the default partition.
+ */
+void partition_by_time(PGconn& conn, const partitioned_table& table) {
+  LOG(INFO) << "Partitioning " << table.table << " by " << table.time_column;
+  in_transaction(conn, [&]() {
+    execute(
+        conn,
+        std::format(
+            R"sql(
+              ALTER TABLE {0} RENAME TO {0}_unpartitioned;
+              ALTER TABLE {0}_unpartitioned
+                RENAME CONSTRAINT {0}_pkey TO {0}_unpartitioned_pkey;
+              CREATE TABLE {0} (LIKE {0}_unpartitioned INCLUDING DEFAULTS)
+                PARTITION BY RANGE ({1});
+              ALTER TABLE {0} ADD PRIMARY KEY (symbol, {1});
+              CREATE INDEX {0}_{1}_brin ON {0} USING brin ({1});
+              CREATE TABLE {0}_default PARTITION OF {0} DEFAULT;
+              INSERT INTO {0} SELECT * FROM {0}_unpartitioned;
+              DROP TABLE {0}_unpartitioned;)sql",
+            table.table,
+            table.time_column));
+  });
+}
+
+/** Returns the start of the partition of `table` which holds `time`. */
+std::chrono::sys_days
+partition_start(const partitioned_table& table, system_clock::time_point time) {
+  std::chrono::sys_days day = std::chrono::floor<std::chrono::days>(time);
+  std::chrono::days offset = day.time_since_epoch() % table.span;
+  if (offset < std::chrono::days::zero()) offset += table.span;
+  return day - offset;
+}
+
+/**
+ * Creates the partitions of `table` holding `from` through `to` which do not
+ * exist yet, moving their rows out of the default partition.
+ */
+void create_partitions(
+    PGconn& conn,
+    const partitioned_table& table,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  for (std::chrono::sys_days start = partition_start(table, from); start <= to;
+       start += table.span) {
+    std::string name = std::format("{}_p{:%Y%m%d}", table.table, start);
+    bool exists;
+    execute_read(
+        conn,
+        std::format("SELECT to_regclass('{}') IS NOT NULL", name),
+        exists);
+    if (exists) continue;
+
+    LOG(INFO) << "Creating partition " << name;
+    in_transaction(conn, [&]() {
+      execute(
+          conn,
+          std::format(
+              R"sql(
+                CREATE TABLE {0} (LIKE {1} INCLUDING DEFAULTS);
+                WITH moved AS (
+                  DELETE FROM {1}_default
+                  WHERE {2} >= TIMESTAMP '{3:%F}' AND {2} < TIMESTAMP '{4:%F}'
+                  RETURNING *
+                )
+                INSERT INTO {0} SELECT * FROM moved;
+                ALTER TABLE {1} ATTACH PARTITION {0}
+                  FOR VALUES FROM ('{3:%F}') TO ('{4:%F}');)sql",
+              name,
+              table.table,
+              table.time_column,
+              start,
+              start + table.span));
+    });
+  }
+}
+
+/**
+ * Drops the partitions of `table` which end by `cutoff`, and deletes rows
+ * before it from the default partition.
+ */
+void drop_expired_partitions(
+    PGconn& conn,
+    const partitioned_table& table,
+    std::chrono::sys_days cutoff) {
+  std::vector<std::string> expired;
+  query q{
+      &conn,
+      std::format(
+          R"sql(
+            SELECT child.relname::text
+            FROM pg_inherits
+            JOIN pg_class AS child ON child.oid = pg_inherits.inhrelid
+            WHERE pg_inherits.inhparent = '{0}'::regclass
+              AND child.relname <> '{0}_default'
+              AND to_date(right(child.relname, 8), 'YYYYMMDD') + {1}
+                <= DATE '{2:%F}')sql",
+          table.table,
+          table.span.count(),
+          cutoff)};
+  while (q.step()) q.read_all(expired.emplace_back());
+
+  for (const std::string& name : expired) {
+    LOG(INFO) << "Dropping expired partition " << name;
+    execute(conn, std::format("DROP TABLE {}", name));
+  }
+  execute(
+      conn,
+      std::format(
+          "DELETE FROM {}_default WHERE {} < TIMESTAMP '{:%F}'",
+          table.table,
+          table.time_column,
+          cutoff));
+}
+
+/**
+ * Creates the partitions for the coming `pg_partition_premake` and drops
+ * those older than `pg_partition_retention`.
+ */
+void maintain_partitions(PGconn& conn) {
+  system_clock::time_point now = system_clock::now();
+  system_clock::time_point premake_until =
+      now + to_std_chrono(absl::GetFlag(FLAGS_pg_partition_premake));
+  absl::Duration retention = absl::GetFlag(FLAGS_pg_partition_retention);
+  for (const partitioned_table& table : PARTITIONED_TABLES) {
+    create_partitions(conn, table, now, premake_until);
+    if (retention != absl::InfiniteDuration()) {
+      drop_expired_partitions(
+          conn,
+          table,
+          std::chrono::floor<std::chrono::days>(
+              now - to_std_chrono(retention)));
+    }
+  }
+}
+
+/**
+ * Logs a warning for each partitioned table missing the partition for a week
+ * from now, which means the schema upgrade has not been rerun in time.
+ *
+ * Services connect as a user which cannot create partitions, so they only
+ * warn about them.
+ */
+void check_upcoming_partitions(PGconn& conn) {
+  system_clock::time_point next_week =
+      system_clock::now() + std::chrono::days(7);
+  for (const partitioned_table& table : PARTITIONED_TABLES) {
+    std::string name = std::format(
+        "{}_p{:%Y%m%d}", table.table, partition_start(table, next_week));
+    bool exists;
+    execute_read(
+        conn,
+        std::format("SELECT to_regclass('{}') IS NOT NULL", name),
+        exists);
+    if (!exists) {
+      LOG(WARNING) << "Partition " << name << " does not exist yet. Rows "
+                   << "after it are kept in " << table.table << "_default "
+                   << "until the schema upgrade is run again.";
+    }
+  }
+}
+
 std::string escape_identifier(PGconn& conn, std::string_view identifier) {
   char* escaped =
       PQescapeIdentifier(&conn, identifier.data(), identifier.length());
@@ -398,21 +1441,372 @@ std::string escape_identifier(PGconn& conn, std::string_view identifier) {
   return result;
 }
 
+Candle read_candle(cursor& q) {
+  double open, close, high, low;
+  int64_t volume, duration_us;
+  system_clock::time_point opened_at;
+  q.read_all(open, close, high, low, volume, opened_at, duration_us);
+  Candle candle;
+  candle.set_open(open);
+  candle.set_close(close);
+  candle.set_high(high);
+  candle.set_low(low);
+  candle.set_volume(volume);
+  *candle.mutable_opened_at() = to_proto(opened_at);
+  *candle.mutable_duration() = to_proto(microseconds(duration_us));
+  return candle;
+}
+
+Market read_market_row(cursor& q, stock::Symbol symbol) {
+  double bid, ask, last;
+  int64_t bid_lots, ask_lots, last_lots;
+  system_clock::time_point emitted_at;
+  q.read_all(bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at);
+  Market market;
+  market.set_symbol(symbol);
+  market.set_bid(bid);
+  market.set_bid_lots(bid_lots);
+  market.set_ask(ask);
+  market.set_ask_lots(ask_lots);
+  market.set_last(last);
+  market.set_last_lots(last_lots);
+  *market.mutable_emitted_at() = to_proto(emitted_at);
+  return market;
+}
+
+std::generator<Market> read_market_rows(
+    connection_pool& pool,
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  cursor c{
+      pool.borrow(),
+      R"sql(
+        SELECT bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at
+        FROM market
+        WHERE symbol = $1 AND emitted_at >= $2 AND emitted_at < $3
+        ORDER BY emitted_at ASC)sql",
+      static_cast<int>(symbol),
+      from,
+      to};
+  while (c.step()) co_yield read_market_row(c, symbol);
+}
+
+/**
+ * Reads the `market` rows and `market_blocks` ticks of `symbol` in emission
+ * order, through one cursor so that the read holds a single connection.
+ */
+std::generator<Market> read_market_rows_and_blocks(
+    connection_pool& pool,
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  // The block holding `from` starts up to a minute before it. Blocks sort by
+  // their start, ahead of the rows emitted during their minute.
+  cursor c{
+      pool.borrow(),
+      R"sql(
+        SELECT NULL::BYTEA AS ticks,
+               bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at
+        FROM market
+        WHERE symbol = $1 AND emitted_at >= $2 AND emitted_at < $3
+        UNION ALL
+        SELECT ticks, NULL, NULL, NULL, NULL, NULL, NULL, minute_start
+        FROM market_blocks
+        WHERE symbol = $1
+          AND minute_start > $2 - INTERVAL '1 minute'
+          AND minute_start < $3
+        ORDER BY emitted_at ASC)sql",
+      static_cast<int>(symbol),
+      from,
+      to};
+  // Ticks of the latest block, which may interleave with the rows after it.
+  std::deque<Market> pending;
+  while (c.step()) {
+    std::optional<std::string> ticks;
+    std::optional<double> bid, ask, last;
+    std::optional<int64_t> bid_lots, ask_lots, last_lots;
+    system_clock::time_point emitted_at;
+    c.read_all(
+        ticks, bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at);
+    if (ticks) {
+      // Earlier blocks only hold ticks from before this one's minute.
+      for (; !pending.empty(); pending.pop_front()) {
+        co_yield std::move(pending.front());
+      }
+      db_internal::market_block block =
+          db_internal::decode_market_block(symbol, emitted_at, *ticks);
+      for (Market& tick : block.ticks) {
+        system_clock::time_point tick_at = to_std_chrono(tick.emitted_at());
+        if (tick_at >= from && tick_at < to) pending.push_back(std::move(tick));
+      }
+      continue;
+    }
+    // Rows come before block ticks emitted at the same time.
+    while (!pending.empty() &&
+           to_std_chrono(pending.front().emitted_at()) < emitted_at) {
+      co_yield std::move(pending.front());
+      pending.pop_front();
+    }
+    Market market;
+    market.set_symbol(symbol);
+    market.set_bid(*bid);
+    market.set_bid_lots(*bid_lots);
+    market.set_ask(*ask);
+    market.set_ask_lots(*ask_lots);
+    market.set_last(*last);
+    market.set_last_lots(*last_lots);
+    *market.mutable_emitted_at() = to_proto(emitted_at);
+    co_yield std::move(market);
+  }
+  for (; !pending.empty(); pending.pop_front()) {
+    co_yield std::move(pending.front());
+  }
+}
+
+/**
+ * Merges the ticks of `block` into its `market_blocks` row. Must run within a
+ * transaction, which holds the block's advisory lock until it is rewritten.
+ *
+ * The lock is taken whether or not the row exists yet, so concurrent first
+ * saves of a block cannot overwrite one another.
+ */
+void save_market_block(
+    connection_pool::lease& lease, db_internal::market_block block) {
+  query& lock = lease.prepared("market_block_lock");
+  lock.bind_all(
+      static_cast<int>(block.symbol),
+      static_cast<int>(
+          duration_cast<std::chrono::minutes>(
+              block.minute_start.time_since_epoch())
+              .count()));
+  lock.execute();
+
+  query& select = lease.prepared("market_block_select");
+  select.bind_all(static_cast<int>(block.symbol), block.minute_start);
+  if (select.step()) {
+    std::string ticks;
+    select.read_all(ticks);
+    db_internal::market_block saved = db_internal::decode_market_block(
+        block.symbol, block.minute_start, ticks);
+    db_internal::merge_market_blocks(saved, block);
+    block = std::move(saved);
+  }
+  query& upsert = lease.prepared("market_block_upsert");
+  upsert.bind_all(
+      static_cast<int>(block.symbol),
+      block.minute_start,
+      bytes{db_internal::encode_market_block(block)});
+  upsert.execute();
+}
+
+/** Merges the ticks into the `market_blocks` rows of their minutes. */
+void save_market_blocks(
+    connection_pool::lease& lease, std::span<const Market> markets) {
+  for (db_internal::market_block& block :
+       db_internal::group_market_blocks(markets)) {
+    save_market_block(lease, std::move(block));
+  }
+}
+
+/**
+ * Buffers market ticks saved one at a time and packs them into their
+ * `market_blocks` rows, so that each block is rewritten once per flush rather
+ * than once per tick.
+ *
+ * Buffered ticks are flushed every `pg_market_block_flush_interval`, or as soon
+ * as a tick starts a later minute of a symbol than one already buffered. The
+ * futures returned by `save` resolve once their block has been written. Ticks
+ * still buffered on destruction are written before the destructor returns.
+ *
+ * This class is internally synchronized.
+ */
+class market_block_saver {
+public:
+  explicit market_block_saver(connection_pool& pool)
+      : _pool{pool},
+        _interval{
+            to_std_chrono(absl::GetFlag(FLAGS_pg_market_block_flush_interval))} {
+    _flusher = std::jthread([this](std::stop_token stop) { _run(stop); });
+  }
+
+  ~market_block_saver() {
+    _flusher.request_stop();
+    _flusher.join();
+  }
+
+  market_block_saver(const market_block_saver&) = delete;
+  market_block_saver& operator=(const market_block_saver&) = delete;
+
+  std::future<void> save(const Market& market) {
+    std::vector<db_internal::market_block> grouped =
+        db_internal::group_market_blocks({&market, 1});
+    db_internal::market_block& block = grouped.front();
+    std::future<void> done;
+    bool minute_closed;
+    {
+      std::lock_guard lock{_mutex};
+      auto [it, inserted] =
+          _blocks.try_emplace({block.symbol, block.minute_start});
+      if (inserted) {
+        // Blocks are ordered by symbol and then minute, so an earlier block of
+        // the same symbol sits right before a new one.
+        if (it != _blocks.begin() &&
+            std::prev(it)->first.first == block.symbol) {
+          _minute_closed = true;
+        }
+        it->second.block = std::move(block);
+      } else {
+        db_internal::merge_market_blocks(it->second.block, block);
+      }
+      done = it->second.done.emplace_back().get_future();
+      minute_closed = _minute_closed;
+    }
+    if (minute_closed) _buffered.notify_one();
+    return done;
+  }
+
+private:
+  struct buffered_block {
+    db_internal::market_block block;
+    std::vector<std::promise<void>> done;
+  };
+  using block_key = std::pair<stock::Symbol, system_clock::time_point>;
+
+  void _run(std::stop_token stop) {
+    std::map<block_key, buffered_block> blocks;
+    while (true) {
+      {
+        std::unique_lock lock{_mutex};
+        // Once stopped, buffered ticks are still written before exiting.
+        if (!_buffered.wait(lock, stop, [&]() { return !_blocks.empty(); })) {
+          return;
+        }
+        _buffered.wait_for(
+            lock, stop, _interval, [&]() { return _minute_closed; });
+        blocks.swap(_blocks);
+        _minute_closed = false;
+      }
+      _flush(blocks);
+      blocks.clear();
+    }
+  }
+
+  void _flush(std::map<block_key, buffered_block>& blocks) {
+    std::optional<connection_pool::lease> lease;
+    try {
+      lease.emplace(_pool.borrow());
+    } catch (...) {
+      for (auto& [key, buffered] : blocks) {
+        for (std::promise<void>& done : buffered.done) {
+          done.set_exception(std::current_exception());
+        }
+      }
+      return;
+    }
+    for (auto& [key, buffered] : blocks) {
+      try {
+        in_transaction(lease->conn(), [&]() {
+          save_market_block(*lease, std::move(buffered.block));
+        });
+        for (std::promise<void>& done : buffered.done) done.set_value();
+      } catch (...) {
+        for (std::promise<void>& done : buffered.done) {
+          done.set_exception(std::current_exception());
+        }
+      }
+    }
+  }
+
+  connection_pool& _pool;
+  const microseconds _interval;
+
+  std::mutex _mutex;
+  std::condition_variable_any _buffered;
+  std::map<block_key, buffered_block> _blocks;
+  bool _minute_closed = false;
+  std::jthread _flusher;
+};
+
+class block_reader : public candle_block_reader {
+public:
+  block_reader(
+      connection_pool::lease lease,
+      stock::Symbol symbol,
+      system_clock::time_point from,
+      system_clock::time_point to)
+      : _cursor{
+            std::move(lease),
+            R"sql(
+              SELECT open, close, high, low, volume, opened_at, duration_us
+              FROM candles
+              WHERE symbol = $1 AND opened_at >= $2 AND opened_at < $3
+              ORDER BY opened_at ASC)sql",
+            static_cast<int>(symbol),
+            from,
+            to} {}
+
+  std::size_t read(candle_block& block, std::size_t max_rows) override {
+    block.clear();
+    block.reserve(max_rows);
+    while (block.size() < max_rows && _cursor.step()) {
+      double open, close, high, low;
+      int64_t volume, duration_us;
+      system_clock::time_point opened_at;
+      _cursor.read_all(open, close, high, low, volume, opened_at, duration_us);
+      block.open.push_back(open);
+      block.close.push_back(close);
+      block.high.push_back(high);
+      block.low.push_back(low);
+      block.volume.push_back(volume);
+      block.opened_at.push_back(opened_at);
+      block.duration.push_back(microseconds(duration_us));
+    }
+    return block.size();
+  }
+
+private:
+  cursor _cursor;
+};
+
 } // namespace
 
 // MARK: Postgres Database
 
 struct postgres_database::implementation {
-  PGconn* conn;
+  std::unique_ptr<connection_pool> pool;
+  // Dedicated to pipelined saves, since a connection in pipeline mode cannot
+  // run the synchronous queries used everywhere else.
+  PGconn* pipeline_conn;
   security_client* security;
-  std::map<std::string, std::unique_ptr<query>> prepared_queries;
+  std::map<std::string, std::unique_ptr<query>> pipelined_queries;
+  std::unique_ptr<pipeline> saves;
+  // Only set when market ticks are packed into blocks.
+  std::unique_ptr<market_block_saver> market_block_saves;
   std::string dbname;
+  bool market_blocks;
+
+  template <typename... Args>
+  std::future<void> send_save(const std::string& key, const Args&... args) {
+    const query& statement = *pipelined_queries.at(key);
+    return saves->send(statement, args...);
+  }
+
+  template <typename... Args>
+  void send_save_part(
+      std::shared_ptr<joined_promise> done,
+      const std::string& key,
+      const Args&... args) {
+    const query& statement = *pipelined_queries.at(key);
+    saves->send_part(std::move(done), statement, args...);
+  }
 };
 
 postgres_database::postgres_database(
     security_client& security, postgres_options options)
     : _implementation{std::make_unique<implementation>()} {
   _implementation->security = &security;
+  _implementation->market_blocks = absl::GetFlag(FLAGS_db_market_blocks);
   std::string connection_parameters = std::format(
       "host={} port={} dbname={} user={} password={} sslmode={}",
       options.host,
@@ -421,61 +1815,70 @@ postgres_database::postgres_database(
       options.user,
       options.password,
       options.sslmode);
-  _implementation->conn = PQconnectdb(connection_parameters.c_str());
   _implementation->dbname = options.dbname;
 
-  try {
-    check_pgconn_err(*_implementation->conn);
-    LOG(INFO) << "Postgres connection established. SSL in use: "
-              << (PQsslInUse(_implementation->conn) ? "yes" : "no");
-  } catch (...) {
-    if (_implementation->conn) {
-      PQfinish(_implementation->conn);
-      _implementation->conn = nullptr;
-    }
-    std::rethrow_exception(std::current_exception());
-  }
+  _implementation->pool =
+      std::make_unique<connection_pool>(connection_parameters);
+  LOG(INFO) << "Postgres connection established. SSL in use: "
+            << (PQsslInUse(&_implementation->pool->borrow().conn()) ? "yes"
+                                                                     : "no");
+  _implementation->pipeline_conn = connect(connection_parameters);
 }
 
 postgres_database::~postgres_database() {
-  if (_implementation && _implementation->conn) {
-    PQfinish(_implementation->conn);
-  }
+  // Finish queued saves before closing their connections.
+  _implementation->market_block_saves.reset();
+  _implementation->saves.reset();
+  PQfinish(_implementation->pipeline_conn);
 }
 
 std::future<void>
 postgres_database::upgrade_schema(std::string_view app_db_user) {
   std::promise<void> p;
   try {
-    int version = get_schema_version(*_implementation->conn);
+    connection_pool::lease lease = _implementation->pool->borrow();
+    PGconn& conn = lease.conn();
+    int version = get_schema_version(conn);
     int expected_version = db_internal::get_schema_version();
     if (version <= 0) {
-      full_schema_install(*_implementation->conn);
+      full_schema_install(conn);
+      for (const partitioned_table& table : PARTITIONED_TABLES) {
+        partition_by_time(conn, table);
+      }
     } else if (version != expected_version) {
       LOG(INFO) << "Upgrading schema from version " << version << " to "
                 << expected_version;
       for (std::string_view statement :
            db_internal::get_schema_update(version)) {
-        execute(*_implementation->conn, std::string{statement});
+        execute(conn, std::string{statement});
+      }
+      if (version < db_internal::CANDLE_ROLLUPS_VERSION) {
+        backfill_rollups(conn);
+      }
+      if (version < PARTITIONED_TABLES_VERSION) {
+        for (const partitioned_table& table : PARTITIONED_TABLES) {
+          partition_by_time(conn, table);
+        }
       }
     }
+    maintain_partitions(conn);
 
     if (!app_db_user.empty()) {
       std::string escaped_user =
-          escape_identifier(*_implementation->conn, app_db_user);
+          escape_identifier(conn, app_db_user);
       execute(
-          *_implementation->conn,
+          conn,
           std::format(
               R"sql(GRANT CONNECT ON DATABASE {} TO {})sql",
               escape_identifier(
-                  *_implementation->conn, _implementation->dbname),
+                  conn, _implementation->dbname),
               escaped_user));
       execute(
-          *_implementation->conn,
+          conn,
           std::format(
               R"sql(GRANT USAGE ON SCHEMA public TO {})sql", escaped_user));
       execute(
-          *_implementation->conn,
+          conn,
           std::format(
               R"sql(
                 GRANT SELECT, INSERT, UPDATE, DELETE
@@ -484,7 +1887,7 @@ postgres_database::upgrade_schema(std::string_view app_db_user) {
                 TO {})sql",
               escaped_user));
       execute(
-          *_implementation->conn,
+          conn,
           std::format(
               R"sql(
                 GRANT USAGE, SELECT
@@ -503,14 +1906,18 @@ postgres_database::upgrade_schema(std::string_view app_db_user) {
 std::future<void> postgres_database::check_schema_version() {
   std::promise<void> p;
   try {
-    int db_version = get_schema_version(*_implementation->conn);
-    int expected_version = db_internal::get_schema_version();
-    if (db_version != expected_version) {
-      throw std::runtime_error(
-          std::format(
-              "Expected schema version {}, found {}",
-              expected_version,
-              db_version));
+    {
+      connection_pool::lease lease = _implementation->pool->borrow();
+      int db_version = get_schema_version(lease.conn());
+      int expected_version = db_internal::get_schema_version();
+      if (db_version != expected_version) {
+        throw std::runtime_error(
+            std::format(
+                "Expected schema version {}, found {}",
+                expected_version,
+                db_version));
+      }
+      check_upcoming_partitions(lease.conn());
     }
 
     _prepare_queries().get();
@@ -522,7 +1929,7 @@ std::future<void> postgres_database::check_schema_version() {
 std::future<void> postgres_database::_prepare_queries() {
   std::promise<void> p;
   try {
-    _implementation->prepared_queries.emplace(
+    _implementation->pipelined_queries.emplace(
         "candle_insert",
         query::prepare<
             int,
@@ -533,7 +1940,7 @@ std::future<void> postgres_database::_prepare_queries() {
             int64_t,
             system_clock::time_point,
             int64_t>(
-            *_implementation->conn,
+            *_implementation->pipeline_conn,
             R"sql(
               INSERT INTO candles (
                 symbol, open, close, high, low, volume, opened_at, duration_us
@@ -546,7 +1953,7 @@ std::future<void> postgres_database::_prepare_queries() {
                 volume = EXCLUDED.volume,
                 duration_us = EXCLUDED.duration_us)sql"));
 
-    _implementation->prepared_queries.emplace(
+    _implementation->pipelined_queries.emplace(
         "market_insert",
         query::prepare<
             int,
@@ -557,7 +1964,7 @@ std::future<void> postgres_database::_prepare_queries() {
             double,
             int64_t,
             system_clock::time_point>(
-            *_implementation->conn,
+            *_implementation->pipeline_conn,
             R"sql(
               INSERT INTO market (
                 symbol, bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at
@@ -570,28 +1977,7 @@ std::future<void> postgres_database::_prepare_queries() {
                 last = EXCLUDED.last,
                 last_lots = EXCLUDED.last_lots)sql"));
 
-    _implementation->prepared_queries.emplace(
-        "candle_select", query::prepare<int>(*_implementation->conn, R"sql(
-          SELECT open, close, high, low, volume, opened_at, duration_us
-          FROM candles
-          WHERE symbol = $1
-          ORDER BY opened_at ASC)sql"));
-
-    _implementation->prepared_queries.emplace(
-        "market_select", query::prepare<int>(*_implementation->conn, R"sql(
-          SELECT bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at
-          FROM market
-          WHERE symbol = $1
-          ORDER BY emitted_at ASC)sql"));
-
-    _implementation->prepared_queries.emplace(
-        "trade_select", query::prepare<int>(*_implementation->conn, R"sql(
-          SELECT executed_at, action, price, quantity, confidence, dry_run
-          FROM trades
-          WHERE symbol = $1
-          ORDER BY executed_at DESC)sql"));
-
-    _implementation->prepared_queries.emplace(
+    _implementation->pipelined_queries.emplace(
         "trade_insert",
         query::prepare<
             int,
@@ -601,56 +1987,158 @@ std::future<void> postgres_database::_prepare_queries() {
             int64_t,
             double,
             bool>(
-            *_implementation->conn,
+            *_implementation->pipeline_conn,
             R"sql(
               INSERT INTO trades (
                 symbol, executed_at, action, price, quantity, confidence, dry_run
               ) VALUES ($1, $2, $3, $4, $5, $6, $7))sql"));
 
-    _implementation->prepared_queries.emplace(
-        "save_refresh_token",
-        query::prepare<std::string_view, bytes>(
-            *_implementation->conn,
-            R"sql(
-              INSERT INTO auth_tokens (
-                service_name, refresh_token, notice_token, updated_at
-              ) VALUES ($1, $2, NULL, CURRENT_TIMESTAMP)
-              ON CONFLICT (service_name) DO UPDATE SET
-                refresh_token = EXCLUDED.refresh_token,
-                notice_token = EXCLUDED.notice_token,
-                updated_at = EXCLUDED.updated_at)sql"));
-
-    _implementation->prepared_queries.emplace(
-        "get_auth_token",
-        query::prepare<std::string_view>(
-            *_implementation->conn,
-            R"sql(
-              SELECT
-                service_name,
-                refresh_token,
-                notice_token,
-                last_notified_at,
-                updated_at,
-                expires_at
-              FROM auth_tokens
-              WHERE service_name = $1)sql"));
-
-    _implementation->prepared_queries.emplace(
-        "save_notice_token",
-        query::prepare<std::string_view, std::string_view>(
-            *_implementation->conn,
-            R"sql(
-              INSERT INTO auth_tokens (
-                service_name,
-                refresh_token,
-                notice_token,
-                last_notified_at,
-                updated_at
-              ) VALUES ($1, '', $2, CURRENT_TIMESTAMP, CURRENT_TIMESTAMP)
-              ON CONFLICT (service_name) DO UPDATE SET
-                notice_token = EXCLUDED.notice_token,
-                last_notified_at = EXCLUDED.last_notified_at,
-                updated_at = EXCLUDED.updated_at)sql"));
+    // Rebuilds the rolled up candle opened at $2 and ending before $3 from the
+    // candles within it. Keyed by the rollup table.
+    for (const db_internal::candle_rollup& rollup :
+         db_internal::CANDLE_ROLLUPS) {
+      _implementation->pipelined_queries.emplace(
+          rollup.table,
+          query::prepare<
+              int,
+              system_clock::time_point,
+              system_clock::time_point>(
+              *_implementation->pipeline_conn,
+              std::format(
+                  R"sql(
+                    INSERT INTO {0} (
+                      symbol,
+                      open,
+                      close,
+                      high,
+                      low,
+                      volume,
+                      opened_at,
+                      duration_us
+                    )
+                    SELECT
+                      symbol,
+                      (array_agg(open ORDER BY opened_at ASC))[1],
+                      (array_agg(close ORDER BY opened_at DESC))[1],
+                      max(high),
+                      min(low),
+                      sum(volume),
+                      $2,
+                      sum(duration_us)
+                    FROM {1}
+                    WHERE symbol = $1 AND opened_at >= $2 AND opened_at < $3
+                    GROUP BY symbol
+                    ON CONFLICT (symbol, opened_at) DO UPDATE SET
+                      open = EXCLUDED.open,
+                      close = EXCLUDED.close,
+                      high = EXCLUDED.high,
+                      low = EXCLUDED.low,
+                      volume = EXCLUDED.volume,
+                      duration_us = EXCLUDED.duration_us)sql",
+                  rollup.table,
+                  rollup.source_table)));
+    }
+
+    // Statements must be prepared before the connection enters pipeline mode.
+    _implementation->saves =
+        std::make_unique<pipeline>(*_implementation->pipeline_conn);
+
+    _implementation->pool->set_setup([](pooled_connection& connection) {
+      PGconn& conn = *connection.conn;
+      // Bulk saves copy into session-local staging tables and then upsert
+      // from them, since COPY itself cannot resolve conflicts. Each staged row
+      // keeps its position in the batch so the last of any duplicates wins.
+      execute(conn, R"sql(
+        CREATE TEMP TABLE IF NOT EXISTS candles_staging (
+          LIKE candles, position BIGINT NOT NULL
+        ) ON COMMIT DELETE ROWS)sql");
+      execute(conn, R"sql(
+        CREATE TEMP TABLE IF NOT EXISTS market_staging (
+          LIKE market, position BIGINT NOT NULL
+        ) ON COMMIT DELETE ROWS)sql");
+
+      connection.prepared_queries.emplace(
+          "market_block_lock",
+          query::prepare<int, int>(
+              conn, "SELECT pg_advisory_xact_lock($1, $2)"));
+
+      connection.prepared_queries.emplace(
+          "market_block_select",
+          query::prepare<int, system_clock::time_point>(
+              conn,
+              R"sql(
+                SELECT ticks FROM market_blocks
+                WHERE symbol = $1 AND minute_start = $2)sql"));
+
+      connection.prepared_queries.emplace(
+          "market_block_upsert",
+          query::prepare<int, system_clock::time_point, bytes>(
+              conn,
+              R"sql(
+                INSERT INTO market_blocks (symbol, minute_start, ticks)
+                VALUES ($1, $2, $3)
+                ON CONFLICT (symbol, minute_start) DO UPDATE SET
+                  ticks = EXCLUDED.ticks)sql"));
+
+      connection.prepared_queries.emplace(
+          "trade_select", query::prepare<int>(conn, R"sql(
+            SELECT executed_at, action, price, quantity, confidence, dry_run
+            FROM trades
+            WHERE symbol = $1
+            ORDER BY executed_at DESC)sql"));
+
+      connection.prepared_queries.emplace(
+          "save_refresh_token",
+          query::prepare<std::string_view, bytes>(
+              conn,
+              R"sql(
+                INSERT INTO auth_tokens (
+                  service_name, refresh_token, notice_token, updated_at
+                ) VALUES ($1, $2, NULL, CURRENT_TIMESTAMP)
+                ON CONFLICT (service_name) DO UPDATE SET
+                  refresh_token = EXCLUDED.refresh_token,
+                  notice_token = EXCLUDED.notice_token,
+                  updated_at = EXCLUDED.updated_at)sql"));
+
+      connection.prepared_queries.emplace(
+          "get_auth_token",
+          query::prepare<std::string_view>(
+              conn,
+              R"sql(
+                SELECT
+                  service_name,
+                  refresh_token,
+                  notice_token,
+                  last_notified_at,
+                  updated_at,
+                  expires_at
+                FROM auth_tokens
+                WHERE service_name = $1)sql"));
+
+      connection.prepared_queries.emplace(
+          "save_notice_token",
+          query::prepare<std::string_view, std::string_view>(
+              conn,
+              R"sql(
+                INSERT INTO auth_tokens (
+                  service_name,
+                  refresh_token,
+                  notice_token,
+                  last_notified_at,
+                  updated_at
+                ) VALUES ($1, '', $2, CURRENT_TIMESTAMP, CURRENT_TIMESTAMP)
+                ON CONFLICT (service_name) DO UPDATE SET
+                  notice_token = EXCLUDED.notice_token,
+                  last_notified_at = EXCLUDED.last_notified_at,
+                  updated_at = EXCLUDED.updated_at)sql"));
+    });
+    // Set up one connection now so that any errors in the setup surface here.
+    _implementation->pool->borrow();
+    if (_implementation->market_blocks &&
+        !_implementation->market_block_saves) {
+      _implementation->market_block_saves =
+          std::make_unique<market_block_saver>(*_implementation->pool);
+    }
     p.set_value();
   } catch (...) { p.set_exception(std::current_exception()); }
   return p.get_future();
@@ -658,29 +2146,56 @@ std::future<void> postgres_database::_prepare_queries() {
 
 std::future<void>
 postgres_database::save(stock::Symbol symbol, const Candle& candle) {
-  std::promise<void> p;
   try {
-    query& q = *_implementation->prepared_queries.at("candle_insert");
-    q.bind_all(
+    system_clock::time_point opened_at = to_std_chrono(candle.opened_at());
+    // Completed once the insert and every rollup have their results.
+    auto done = std::make_shared<joined_promise>(
+        1 + db_internal::CANDLE_ROLLUPS.size());
+    std::future<void> saved = done->get_future();
+    _implementation->send_save_part(
+        done,
+        "candle_insert",
         static_cast<int>(symbol),
         candle.open(),
         candle.close(),
         candle.high(),
         candle.low(),
         candle.volume(),
-        to_std_chrono(candle.opened_at()),
+        opened_at,
         duration_cast<microseconds>(to_std_chrono(candle.duration())).count());
-    while (q.step());
-    p.set_value();
-  } catch (...) { p.set_exception(std::current_exception()); }
-  return p.get_future();
+    // Pipelined statements run in order, so each rollup sees the candles
+    // saved before it.
+    for (const db_internal::candle_rollup& rollup :
+         db_internal::CANDLE_ROLLUPS) {
+      system_clock::time_point start =
+          db_internal::rollup_start(opened_at, rollup.length);
+      _implementation->send_save_part(
+          done,
+          std::string{rollup.table},
+          static_cast<int>(symbol),
+          start,
+          start + rollup.length);
+    }
+    return saved;
+  } catch (...) {
+    std::promise<void> p;
+    p.set_exception(std::current_exception());
+    return p.get_future();
+  }
 }
 
 std::future<void> postgres_database::save(const Market& market) {
-  std::promise<void> p;
   try {
-    query& q = *_implementation->prepared_queries.at("market_insert");
-    q.bind_all(
+    // Merging into a block reads it first, which a pipelined save cannot do.
+    if (_implementation->market_blocks) {
+      if (!_implementation->market_block_saves) {
+        throw std::runtime_error(
+            "Market blocks cannot be saved before the schema is checked.");
+      }
+      return _implementation->market_block_saves->save(market);
+    }
+    return _implementation->send_save(
+        "market_insert",
         static_cast<int>(market.symbol()),
         market.bid(),
         market.bid_lots(),
@@ -689,20 +2204,140 @@ std::future<void> postgres_database::save(const Market& market) {
         market.last(),
         market.last_lots(),
         to_std_chrono(market.emitted_at()));
-    while (q.step());
+  } catch (...) {
+    std::promise<void> p;
+    p.set_exception(std::current_exception());
+    return p.get_future();
+  }
+}
+
+std::future<void> postgres_database::save_batch(
+    stock::Symbol symbol, std::span<const Candle> candles) {
+  std::promise<void> p;
+  try {
+    connection_pool::lease lease = _implementation->pool->borrow();
+    PGconn& conn = lease.conn();
+    in_transaction(conn, [&]() {
+      copy_writer copy{conn, R"sql(
+        COPY candles_staging (
+          symbol,
+          open,
+          close,
+          high,
+          low,
+          volume,
+          opened_at,
+          duration_us,
+          position
+        ) FROM STDIN (FORMAT binary))sql"};
+      int64_t position = 0;
+      for (const Candle& candle : candles) {
+        copy.write_row(
+            static_cast<int32_t>(symbol),
+            candle.open(),
+            candle.close(),
+            candle.high(),
+            candle.low(),
+            candle.volume(),
+            to_std_chrono(candle.opened_at()),
+            static_cast<int64_t>(
+                duration_cast<microseconds>(to_std_chrono(candle.duration()))
+                    .count()),
+            position++);
+      }
+      copy.finish();
+
+      // Duplicates within one batch keep the last of the rows, as if each had
+      // been saved in turn.
+      execute(conn, R"sql(
+        INSERT INTO candles (
+          symbol, open, close, high, low, volume, opened_at, duration_us
+        )
+        SELECT DISTINCT ON (symbol, opened_at)
+          symbol, open, close, high, low, volume, opened_at, duration_us
+        FROM candles_staging
+        ORDER BY symbol, opened_at, position DESC
+        ON CONFLICT (symbol, opened_at) DO UPDATE SET
+          open = EXCLUDED.open,
+          close = EXCLUDED.close,
+          high = EXCLUDED.high,
+          low = EXCLUDED.low,
+          volume = EXCLUDED.volume,
+          duration_us = EXCLUDED.duration_us)sql");
+      update_staged_rollups(conn);
+    });
     p.set_value();
   } catch (...) { p.set_exception(std::current_exception()); }
-
   return p.get_future();
 }
 
 std::future<void>
-postgres_database::save_trade(const trading::TradeRecord& trade) {
+postgres_database::save_batch(std::span<const Market> markets) {
   std::promise<void> p;
+  try {
+    connection_pool::lease lease = _implementation->pool->borrow();
+    PGconn& conn = lease.conn();
+    in_transaction(conn, [&]() {
+      if (_implementation->market_blocks) {
+        save_market_blocks(lease, markets);
+        return;
+      }
+
+      copy_writer copy{conn, R"sql(
+        COPY market_staging (
+          symbol,
+          bid,
+          bid_lots,
+          ask,
+          ask_lots,
+          last,
+          last_lots,
+          emitted_at,
+          position
+        ) FROM STDIN (FORMAT binary))sql"};
+      int64_t position = 0;
+      for (const Market& market : markets) {
+        copy.write_row(
+            static_cast<int32_t>(market.symbol()),
+            market.bid(),
+            market.bid_lots(),
+            market.ask(),
+            market.ask_lots(),
+            market.last(),
+            market.last_lots(),
+            to_std_chrono(market.emitted_at()),
+            position++);
+      }
+      copy.finish();
+
+      // Duplicates within one batch keep the last of the rows, as if each had
+      // been saved in turn.
+      execute(conn, R"sql(
+        INSERT INTO market (
+          symbol, bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at
+        )
+        SELECT DISTINCT ON (symbol, emitted_at)
+          symbol, bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at
+        FROM market_staging
+        ORDER BY symbol, emitted_at, position DESC
+        ON CONFLICT (symbol, emitted_at) DO UPDATE SET
+          bid = EXCLUDED.bid,
+          bid_lots = EXCLUDED.bid_lots,
+          ask = EXCLUDED.ask,
+          ask_lots = EXCLUDED.ask_lots,
+          last = EXCLUDED.last,
+          last_lots = EXCLUDED.last_lots)sql");
+    });
+    p.set_value();
+  } catch (...) { p.set_exception(std::current_exception()); }
+  return p.get_future();
+}
 
+std::future<void>
+postgres_database::save_trade(const trading::TradeRecord& trade) {
   try {
-    query& q = *_implementation->prepared_queries.at("trade_insert");
-    q.bind_all(
+    return _implementation->send_save(
+        "trade_insert",
         static_cast<int>(trade.symbol()),
         to_std_chrono(trade.executed_at()),
         static_cast<int>(trade.action()),
@@ -710,18 +2345,19 @@ postgres_database::save_trade(const trading::TradeRecord& trade) {
         trade.quantity(),
         trade.confidence(),
         trade.dry_run());
-    while (q.step());
-    p.set_value();
-  } catch (...) { p.set_exception(std::current_exception()); }
-
-  return p.get_future();
+  } catch (...) {
+    std::promise<void> p;
+    p.set_exception(std::current_exception());
+    return p.get_future();
+  }
 }
 
 std::future<void> postgres_database::save_refresh_token(
     std::string_view service_name, std::string_view token) {
   std::promise<void> p;
   try {
-    query& q = *_implementation->prepared_queries.at("save_refresh_token");
+    connection_pool::lease lease = _implementation->pool->borrow();
+    query& q = lease.prepared("save_refresh_token");
     q.bind_all(
         service_name,
         bytes{_implementation->security->encrypt(
@@ -733,49 +2369,81 @@ std::future<void> postgres_database::save_refresh_token(
 }
 
 std::generator<Candle> postgres_database::read_candles(stock::Symbol symbol) {
-  query& q = *_implementation->prepared_queries.at("candle_select");
-  q.bind_all(symbol);
-  while (q.step()) {
-    double open, close, high, low;
-    int64_t volume, duration_us;
-    system_clock::time_point opened_at;
-    q.read_all(open, close, high, low, volume, opened_at, duration_us);
-    Candle candle;
-    candle.set_open(open);
-    candle.set_close(close);
-    candle.set_high(high);
-    candle.set_low(low);
-    candle.set_volume(volume);
-    *candle.mutable_opened_at() = to_proto(opened_at);
-    *candle.mutable_duration() = to_proto(microseconds(duration_us));
-    co_yield std::move(candle);
-  }
+  cursor c{
+      _implementation->pool->borrow(),
+      R"sql(
+        SELECT open, close, high, low, volume, opened_at, duration_us
+        FROM candles
+        WHERE symbol = $1
+        ORDER BY opened_at ASC)sql",
+      static_cast<int>(symbol)};
+  while (c.step()) co_yield read_candle(c);
+}
+
+std::generator<Candle> postgres_database::read_candles(
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  cursor c{
+      _implementation->pool->borrow(),
+      R"sql(
+        SELECT open, close, high, low, volume, opened_at, duration_us
+        FROM candles
+        WHERE symbol = $1 AND opened_at >= $2 AND opened_at < $3
+        ORDER BY opened_at ASC)sql",
+      static_cast<int>(symbol),
+      from,
+      to};
+  while (c.step()) co_yield read_candle(c);
+}
+
+std::generator<Candle> postgres_database::read_candles(
+    stock::Symbol symbol,
+    candle_resolution resolution,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  cursor c{
+      _implementation->pool->borrow(),
+      std::format(
+          R"sql(
+            SELECT open, close, high, low, volume, opened_at, duration_us
+            FROM {}
+            WHERE symbol = $1 AND opened_at >= $2 AND opened_at < $3
+            ORDER BY opened_at ASC)sql",
+          db_internal::candle_table(resolution)),
+      static_cast<int>(symbol),
+      from,
+      to};
+  while (c.step()) co_yield read_candle(c);
+}
+
+std::unique_ptr<candle_block_reader> postgres_database::read_candle_blocks(
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  return std::make_unique<block_reader>(
+      _implementation->pool->borrow(), symbol, from, to);
 }
 
 std::generator<Market> postgres_database::read_market(stock::Symbol symbol) {
-  query& q = *_implementation->prepared_queries.at("market_select");
-  q.bind_all(symbol);
-  while (q.step()) {
-    double bid, ask, last;
-    int64_t bid_lots, ask_lots, last_lots;
-    system_clock::time_point emitted_at;
-    q.read_all(bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at);
-    Market market;
-    market.set_symbol(symbol);
-    market.set_bid(bid);
-    market.set_bid_lots(bid_lots);
-    market.set_ask(ask);
-    market.set_ask_lots(ask_lots);
-    market.set_last(last);
-    market.set_last_lots(last_lots);
-    *market.mutable_emitted_at() = to_proto(emitted_at);
-    co_yield std::move(market);
+  return read_market(
+      symbol, system_clock::time_point::min(), system_clock::time_point::max());
+}
+
+std::generator<Market> postgres_database::read_market(
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  if (!_implementation->market_blocks) {
+    return read_market_rows(*_implementation->pool, symbol, from, to);
   }
+  return read_market_rows_and_blocks(*_implementation->pool, symbol, from, to);
 }
 
 std::generator<trading::TradeRecord>
 postgres_database::read_trades(stock::Symbol symbol) {
-  query& q = *_implementation->prepared_queries.at("trade_select");
+  connection_pool::lease lease = _implementation->pool->borrow();
+  query& q = lease.prepared("trade_select");
   q.bind_all(symbol);
   while (q.step()) {
     system_clock::time_point executed_at;
@@ -800,7 +2468,8 @@ std::future<std::optional<storage::auth_token>>
 postgres_database::get_auth_token(std::string_view service_name) {
   std::promise<std::optional<storage::auth_token>> p;
   try {
-    query& q = *_implementation->prepared_queries.at("get_auth_token");
+    connection_pool::lease lease = _implementation->pool->borrow();
+    query& q = lease.prepared("get_auth_token");
     q.bind_all(service_name);
     if (!q.step()) {
       p.set_value(std::nullopt);
@@ -825,7 +2494,8 @@ std::future<void> postgres_database::save_notice_token(
     std::string_view service_name, std::string_view notice_token) {
   std::promise<void> p;
   try {
-    query& q = *_implementation->prepared_queries.at("save_notice_token");
+    connection_pool::lease lease = _implementation->pool->borrow();
+    query& q = lease.prepared("save_notice_token");
     q.bind_all(service_name, notice_token);
     while (q.step());
     p.set_value();
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <chrono>
 #include <future>
 #include <generator>
 #include <memory>
+#include <span>
 #include <string_view>
 
 #include "data/candle.pb.h"
@@ -33,12 +35,32 @@ public:
 
   std::future<void> save(stock::Symbol symbol, const Candle& candle) override;
   std::future<void> save(const Market& market) override;
+  std::future<void>
+  save_batch(stock::Symbol symbol, std::span<const Candle> candles) override;
+  std::future<void> save_batch(std::span<const Market> markets) override;
   std::future<void> save_trade(const trading::TradeRecord& trade) override;
   std::future<void> save_refresh_token(
       std::string_view service_name, std::string_view token) override;
 
   std::generator<Candle> read_candles(stock::Symbol symbol) override;
   std::generator<Market> read_market(stock::Symbol symbol) override;
+  std::generator<Candle> read_candles(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
+  std::generator<Candle> read_candles(
+      stock::Symbol symbol,
+      candle_resolution resolution,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
+  std::generator<Market> read_market(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
+  std::unique_ptr<candle_block_reader> read_candle_blocks(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
   std::generator<trading::TradeRecord>
   read_trades(stock::Symbol symbol) override;
 
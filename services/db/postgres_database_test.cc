@@ -2,14 +2,20 @@
 
 #include <chrono>
 #include <format>
+#include <future>
+#include <generator>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "absl/flags/declare.h"
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/random/random.h"
+#include "absl/time/time.h"
 #include "data/candle.pb.h"
+#include "data/market.pb.h"
 #include "data/stock.pb.h"
 #include "data/trade.pb.h"
 #include "google/protobuf/util/time_util.h"
@@ -25,17 +31,28 @@ ABSL_FLAG(std::string, pg_port, "5432", "Port for Postgres.");
 ABSL_FLAG(std::string, pg_user, "postgres", "User for Postgres.");
 ABSL_FLAG(std::string, pg_password, "password", "Password for Postgres.");
 ABSL_FLAG(std::string, pg_database, "howling", "Database for Postgres.");
+ABSL_DECLARE_FLAG(int, pg_fetch_batch_rows);
+ABSL_DECLARE_FLAG(int, pg_pool_size);
+ABSL_DECLARE_FLAG(absl::Duration, pg_pool_borrow_timeout);
+ABSL_DECLARE_FLAG(absl::Duration, pg_partition_retention);
 
 namespace howling {
 namespace {
 
 using ::testing::_;
+using ::testing::ElementsAre;
 using ::testing::IsSupersetOf;
 using ::testing::Return;
+using ::testing::StartsWith;
 
 class PostgresDatabaseTest : public DatabaseTest {
 protected:
   void SetUp() override {
+    _db = make_database();
+    DatabaseTest::SetUp();
+  }
+
+  std::unique_ptr<postgres_database> make_database() {
     postgres_options options{
         .host = absl::GetFlag(FLAGS_pg_host),
         .port = absl::GetFlag(FLAGS_pg_port),
@@ -43,8 +60,7 @@ protected:
         .password = absl::GetFlag(FLAGS_pg_password),
         .dbname = absl::GetFlag(FLAGS_pg_database),
         .sslmode = "disable"};
-    _db = std::make_unique<postgres_database>(_mock_security, options);
-    DatabaseTest::SetUp();
+    return std::make_unique<postgres_database>(_mock_security, options);
   }
 
   database& db() override { return *_db; }
@@ -59,8 +75,16 @@ protected:
         absl::GetFlag(FLAGS_pg_password));
     PGconn* conn = PQconnectdb(conninfo.c_str());
     if (PQstatus(conn) == CONNECTION_OK) {
-      PGresult* res =
-          PQexec(conn, "TRUNCATE candles, market, trades, auth_tokens");
+      PGresult* res = PQexec(conn, R"sql(
+        TRUNCATE
+          candles,
+          candles_5m,
+          candles_1h,
+          candles_1d,
+          market,
+          market_blocks,
+          trades,
+          auth_tokens)sql");
       PQclear(res);
     }
     PQfinish(conn);
@@ -140,6 +164,205 @@ TEST_F(PostgresDatabaseTest, SavedRefreshTokenIsEncryptedAtRest) {
   PQfinish(conn);
 }
 
+TEST_F(PostgresDatabaseTest, ManySavesInFlightAreAllWritten) {
+  db().upgrade_schema("").get();
+  std::vector<std::future<void>> saves;
+  for (int i = 0; i < 500; ++i) {
+    Market market;
+    market.set_symbol(stock::NVDA);
+    market.set_last(i);
+    market.mutable_emitted_at()->set_seconds(i);
+    saves.push_back(db().save(market));
+  }
+  for (std::future<void>& save : saves) EXPECT_NO_THROW(save.get());
+
+  int expected_last = 0;
+  for (const Market& market : db().read_market(stock::NVDA)) {
+    EXPECT_EQ(market.last(), expected_last++);
+  }
+  EXPECT_EQ(expected_last, 500);
+}
+
+TEST_F(PostgresDatabaseTest, ReadsHistoryInSeveralBatches) {
+  absl::SetFlag(&FLAGS_pg_fetch_batch_rows, 2);
+  db().upgrade_schema("").get();
+  for (int i = 0; i < 5; ++i) {
+    Candle candle;
+    candle.set_close(i);
+    candle.mutable_opened_at()->set_seconds(60 * i);
+    db().save(stock::NVDA, candle).get();
+  }
+
+  int expected_close = 0;
+  for (const Candle& candle : db().read_candles(stock::NVDA)) {
+    EXPECT_EQ(candle.close(), expected_close++);
+  }
+  EXPECT_EQ(expected_close, 5);
+  absl::SetFlag(&FLAGS_pg_fetch_batch_rows, 10000);
+}
+
+TEST_F(PostgresDatabaseTest, ConcurrentBatchSavesAreAllWritten) {
+  db().upgrade_schema("").get();
+  std::vector<std::future<void>> writers;
+  for (int writer = 0; writer < 8; ++writer) {
+    writers.push_back(std::async(std::launch::async, [this, writer]() {
+      std::vector<Candle> candles(100);
+      for (int i = 0; i < 100; ++i) {
+        candles[i].mutable_opened_at()->set_seconds(60 * (writer * 100 + i));
+      }
+      db().save_batch(stock::NVDA, candles).get();
+    }));
+  }
+  for (std::future<void>& writer : writers) EXPECT_NO_THROW(writer.get());
+
+  int count = 0;
+  for (const Candle& candle : db().read_candles(stock::NVDA)) ++count;
+  EXPECT_EQ(count, 800);
+}
+
+TEST_F(PostgresDatabaseTest, NestedReadsEachHoldAConnection) {
+  absl::SetFlag(&FLAGS_pg_pool_size, 2);
+  _db = make_database();
+  absl::SetFlag(&FLAGS_pg_pool_size, 16);
+  db().upgrade_schema("").get();
+  Candle candle;
+  db().save(stock::NVDA, candle).get();
+  db().save(stock::AMD, candle).get();
+
+  // Each symbol's read holds a connection until the merge finishes.
+  int count = 0;
+  for (const symbol_candle& found : db().read_merged_candles(
+           {stock::NVDA, stock::AMD},
+           std::chrono::system_clock::time_point{},
+           std::chrono::system_clock::time_point{std::chrono::hours(1)})) {
+    ++count;
+  }
+  EXPECT_EQ(count, 2);
+}
+
+TEST_F(PostgresDatabaseTest, BorrowersWaitForAReturnedConnection) {
+  absl::SetFlag(&FLAGS_pg_pool_size, 1);
+  absl::SetFlag(&FLAGS_pg_pool_borrow_timeout, absl::Milliseconds(100));
+  _db = make_database();
+  absl::SetFlag(&FLAGS_pg_pool_size, 16);
+  absl::SetFlag(&FLAGS_pg_pool_borrow_timeout, absl::Seconds(30));
+  db().upgrade_schema("").get();
+  db().save(stock::NVDA, Candle::default_instance()).get();
+
+  {
+    // The unfinished read keeps the only connection lent out.
+    std::generator<Candle> candles = db().read_candles(stock::NVDA);
+    ASSERT_NE(candles.begin(), candles.end());
+    EXPECT_THROW(db().get_auth_token("schwab").get(), std::runtime_error);
+  }
+  EXPECT_NO_THROW(db().get_auth_token("schwab").get());
+}
+
+TEST_F(PostgresDatabaseTest, StoresMarketInMinuteBlocks) {
+  db().upgrade_schema("").get();
+  auto make_market = [](int seconds, double last) {
+    Market market;
+    market.set_symbol(stock::NVDA);
+    market.set_last(last);
+    market.mutable_emitted_at()->set_seconds(seconds);
+    return market;
+  };
+  // Saved as a row before switching to blocks.
+  save_market(make_market(30, 3));
+
+  absl::SetFlag(&FLAGS_db_market_blocks, true);
+  _db = make_database();
+  absl::SetFlag(&FLAGS_db_market_blocks, false);
+  db().check_schema_version().get();
+  save_market(make_market(10, 0));
+  save_batch({make_market(70, 4), make_market(20, 2), make_market(10, 1)});
+
+  std::vector<double> lasts;
+  for (const Market& market : read_market(stock::NVDA)) {
+    lasts.push_back(market.last());
+  }
+  EXPECT_THAT(lasts, ElementsAre(1, 2, 3, 4));
+
+  lasts.clear();
+  for (const Market& market : db().read_market(
+           stock::NVDA,
+           std::chrono::system_clock::time_point{std::chrono::seconds(15)},
+           std::chrono::system_clock::time_point{std::chrono::seconds(70)})) {
+    lasts.push_back(market.last());
+  }
+  EXPECT_THAT(lasts, ElementsAre(2, 3));
+}
+
+TEST_F(PostgresDatabaseTest, ConcurrentFirstSavesOfABlockAreAllKept) {
+  db().upgrade_schema("").get();
+  absl::SetFlag(&FLAGS_db_market_blocks, true);
+  _db = make_database();
+  absl::SetFlag(&FLAGS_db_market_blocks, false);
+  db().check_schema_version().get();
+
+  // Every writer saves a different tick of the same, not yet saved, minute.
+  std::vector<std::future<void>> writers;
+  for (int writer = 0; writer < 8; ++writer) {
+    writers.push_back(std::async(std::launch::async, [this, writer]() {
+      Market market;
+      market.set_symbol(stock::NVDA);
+      market.set_last(writer);
+      market.mutable_emitted_at()->set_seconds(writer);
+      db().save_batch({&market, 1}).get();
+    }));
+  }
+  for (std::future<void>& writer : writers) EXPECT_NO_THROW(writer.get());
+
+  std::vector<double> lasts;
+  for (const Market& market : read_market(stock::NVDA)) {
+    lasts.push_back(market.last());
+  }
+  EXPECT_THAT(lasts, ElementsAre(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+TEST_F(PostgresDatabaseTest, PartitionsMarketByDay) {
+  db().upgrade_schema("").get();
+  Market recent;
+  recent.set_symbol(stock::NVDA);
+  *recent.mutable_emitted_at() = to_proto(std::chrono::system_clock::now());
+  save_market(recent);
+  // Older than any partition.
+  Market old;
+  old.set_symbol(stock::NVDA);
+  old.mutable_emitted_at()->set_seconds(60);
+  save_market(old);
+
+  std::string conninfo = std::format(
+      "host={} port={} dbname={} user={} password={} sslmode=disable",
+      absl::GetFlag(FLAGS_pg_host),
+      absl::GetFlag(FLAGS_pg_port),
+      absl::GetFlag(FLAGS_pg_database),
+      absl::GetFlag(FLAGS_pg_user),
+      absl::GetFlag(FLAGS_pg_password));
+  PGconn* conn = PQconnectdb(conninfo.c_str());
+  ASSERT_EQ(PQstatus(conn), CONNECTION_OK) << PQerrorMessage(conn);
+
+  PGresult* res = PQexec(
+      conn, "SELECT tableoid::regclass::text FROM market ORDER BY emitted_at");
+  ASSERT_EQ(PQresultStatus(res), PGRES_TUPLES_OK) << PQerrorMessage(conn);
+  ASSERT_EQ(PQntuples(res), 2);
+  EXPECT_EQ(std::string{PQgetvalue(res, 0, 0)}, "market_default");
+  EXPECT_THAT(std::string{PQgetvalue(res, 1, 0)}, StartsWith("market_p"));
+  PQclear(res);
+
+  // Upgrading again applies the retention.
+  absl::SetFlag(&FLAGS_pg_partition_retention, absl::Hours(24));
+  db().upgrade_schema("").get();
+  absl::SetFlag(&FLAGS_pg_partition_retention, absl::InfiniteDuration());
+
+  res = PQexec(conn, "SELECT count(*) FROM market");
+  ASSERT_EQ(PQresultStatus(res), PGRES_TUPLES_OK) << PQerrorMessage(conn);
+  EXPECT_EQ(std::string{PQgetvalue(res, 0, 0)}, "1");
+
+  PQclear(res);
+  PQfinish(conn);
+}
+
 DATABASE_TEST(PostgresDatabaseTest);
 
 } // namespace
@@ -2,12 +2,17 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "absl/flags/flag.h"
 #include "absl/log/log.h"
 #include "services/database.h"
+#include "services/db/archive.h"
+#include "services/db/archived_database.h"
+#include "services/db/environment.h"
 #include "services/db/postgres_database.h"
 #include "services/db/sqlite_database.h"
+#include "services/db/write_behind_database.h"
 #include "services/registry/register_service.h"
 #include "services/security.h"
 
@@ -37,6 +42,13 @@ ABSL_FLAG(
     pg_enable_encryption,
     false,
     "Enable encryption for the Postgres connection.");
+ABSL_FLAG(
+    bool,
+    db_write_behind,
+    false,
+    "Queue candle, market, and trade saves for a background writer instead of "
+    "writing them on the calling thread. Reads made before a queued save has "
+    "been written do not see it.");
 
 namespace howling {
 namespace {
@@ -104,6 +116,14 @@ void register_database_client() {
         LOG(INFO) << "Initializing database connection.";
         auto db = database_client_factory(security);
         db->check_schema_version().get();
+        if (absl::GetFlag(FLAGS_db_write_behind)) {
+          db = std::make_unique<write_behind_database>(std::move(db));
+        }
+        if (std::string archive_dir = absl::GetFlag(FLAGS_db_archive_dir);
+            !archive_dir.empty()) {
+          db = std::make_unique<archived_database>(
+              std::move(db), market_archive{archive_dir});
+        }
         return db;
       });
 }
@@ -26,6 +26,42 @@ CREATE TABLE candles (
   PRIMARY KEY (symbol, opened_at)
 );
 
+CREATE TABLE candles_5m (
+  symbol      INT NOT NULL,
+  open        DOUBLE PRECISION NOT NULL,
+  close       DOUBLE PRECISION NOT NULL,
+  high        DOUBLE PRECISION NOT NULL,
+  low         DOUBLE PRECISION NOT NULL,
+  volume      BIGINT NOT NULL,
+  opened_at   TIMESTAMP NOT NULL,
+  duration_us BIGINT NOT NULL,
+  PRIMARY KEY (symbol, opened_at)
+);
+
+CREATE TABLE candles_1h (
+  symbol      INT NOT NULL,
+  open        DOUBLE PRECISION NOT NULL,
+  close       DOUBLE PRECISION NOT NULL,
+  high        DOUBLE PRECISION NOT NULL,
+  low         DOUBLE PRECISION NOT NULL,
+  volume      BIGINT NOT NULL,
+  opened_at   TIMESTAMP NOT NULL,
+  duration_us BIGINT NOT NULL,
+  PRIMARY KEY (symbol, opened_at)
+);
+
+CREATE TABLE candles_1d (
+  symbol      INT NOT NULL,
+  open        DOUBLE PRECISION NOT NULL,
+  close       DOUBLE PRECISION NOT NULL,
+  high        DOUBLE PRECISION NOT NULL,
+  low         DOUBLE PRECISION NOT NULL,
+  volume      BIGINT NOT NULL,
+  opened_at   TIMESTAMP NOT NULL,
+  duration_us BIGINT NOT NULL,
+  PRIMARY KEY (symbol, opened_at)
+);
+
 CREATE TABLE market (
   symbol      INT NOT NULL,
   bid         DOUBLE PRECISION NOT NULL,
@@ -38,6 +74,13 @@ CREATE TABLE market (
   PRIMARY KEY (symbol, emitted_at)
 );
 
+CREATE TABLE market_blocks (
+  symbol       INT NOT NULL,
+  minute_start TIMESTAMP NOT NULL,
+  ticks        BYTEA NOT NULL,
+  PRIMARY KEY (symbol, minute_start)
+);
+
 CREATE TABLE trades (
   symbol      INT NOT NULL,
   executed_at TIMESTAMP NOT NULL,
@@ -53,4 +96,4 @@ ON trades (symbol, executed_at DESC);
 
 -- VERSION INSERT
 INSERT INTO howling_version (v, updater_id, update_started_at, updated_at)
-VALUES (4, NULL, NULL, CURRENT_TIMESTAMP);
+VALUES (8, NULL, NULL, CURRENT_TIMESTAMP);
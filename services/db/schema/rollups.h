@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <string_view>
+
+#include "services/database.h"
+
+namespace howling::db_internal {
+
+// Schema version which added the rollup tables. Databases upgraded from an
+// earlier version fill them from the candles already saved.
+inline constexpr int CANDLE_ROLLUPS_VERSION = 6;
+
+/**
+ * A table of candles rolled up from the candles of the next shorter
+ * resolution.
+ *
+ * Each rolled up candle starts on a multiple of `length` since the Unix epoch.
+ */
+struct candle_rollup {
+  candle_resolution resolution;
+  std::string_view table;
+  std::string_view source_table;
+  std::chrono::microseconds length;
+};
+
+// Ordered so that every rollup comes after the rollup it is built from.
+inline constexpr std::array<candle_rollup, 3> CANDLE_ROLLUPS{{
+    {.resolution = candle_resolution::FIVE_MINUTES,
+     .table = "candles_5m",
+     .source_table = "candles",
+     .length = std::chrono::minutes(5)},
+    {.resolution = candle_resolution::ONE_HOUR,
+     .table = "candles_1h",
+     .source_table = "candles_5m",
+     .length = std::chrono::hours(1)},
+    {.resolution = candle_resolution::ONE_DAY,
+     .table = "candles_1d",
+     .source_table = "candles_1h",
+     .length = std::chrono::days(1)},
+}};
+
+/** Returns the table holding candles of the given resolution. */
+constexpr std::string_view candle_table(candle_resolution resolution) {
+  for (const candle_rollup& rollup : CANDLE_ROLLUPS) {
+    if (rollup.resolution == resolution) return rollup.table;
+  }
+  return "candles";
+}
+
+/** Returns the start of the rolled up candle which contains `time`. */
+inline std::chrono::system_clock::time_point rollup_start(
+    std::chrono::system_clock::time_point time,
+    std::chrono::microseconds length) {
+  std::chrono::microseconds since_epoch =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          time.time_since_epoch());
+  return std::chrono::system_clock::time_point{
+      since_epoch - (since_epoch % length + length) % length};
+}
+
+} // namespace howling::db_internal
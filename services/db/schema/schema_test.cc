@@ -65,7 +65,15 @@ TEST(GetFullSchema, InsertsVersion) {
 
 TEST(GetFullSchema, CreatesAllExpectedTables) {
   const std::unordered_set<std::string> expected_tables{
-      "howling_version", "auth_tokens", "candles", "market", "trades"};
+      "howling_version",
+      "auth_tokens",
+      "candles",
+      "candles_5m",
+      "candles_1h",
+      "candles_1d",
+      "market",
+      "market_blocks",
+      "trades"};
   std::unordered_set<std::string> missing_tables = expected_tables;
   std::regex table_regex{R"re(CREATE TABLE (\w+))re"};
   for (std::string_view command : get_full_schema()) {
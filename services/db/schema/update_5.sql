@@ -0,0 +1,3 @@
+-- SQLite timestamps become integer microseconds since the epoch. The SQLite
+-- database rewrites its existing rows while upgrading. Postgres is unchanged.
+UPDATE howling_version SET v = 5, updated_at = CURRENT_TIMESTAMP;
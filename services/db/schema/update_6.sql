@@ -0,0 +1,37 @@
+CREATE TABLE candles_5m (
+  symbol      INT NOT NULL,
+  open        DOUBLE PRECISION NOT NULL,
+  close       DOUBLE PRECISION NOT NULL,
+  high        DOUBLE PRECISION NOT NULL,
+  low         DOUBLE PRECISION NOT NULL,
+  volume      BIGINT NOT NULL,
+  opened_at   TIMESTAMP NOT NULL,
+  duration_us BIGINT NOT NULL,
+  PRIMARY KEY (symbol, opened_at)
+);
+
+CREATE TABLE candles_1h (
+  symbol      INT NOT NULL,
+  open        DOUBLE PRECISION NOT NULL,
+  close       DOUBLE PRECISION NOT NULL,
+  high        DOUBLE PRECISION NOT NULL,
+  low         DOUBLE PRECISION NOT NULL,
+  volume      BIGINT NOT NULL,
+  opened_at   TIMESTAMP NOT NULL,
+  duration_us BIGINT NOT NULL,
+  PRIMARY KEY (symbol, opened_at)
+);
+
+CREATE TABLE candles_1d (
+  symbol      INT NOT NULL,
+  open        DOUBLE PRECISION NOT NULL,
+  close       DOUBLE PRECISION NOT NULL,
+  high        DOUBLE PRECISION NOT NULL,
+  low         DOUBLE PRECISION NOT NULL,
+  volume      BIGINT NOT NULL,
+  opened_at   TIMESTAMP NOT NULL,
+  duration_us BIGINT NOT NULL,
+  PRIMARY KEY (symbol, opened_at)
+);
+
+UPDATE howling_version SET v = 6, updated_at = CURRENT_TIMESTAMP;
@@ -0,0 +1,10 @@
+-- Market ticks packed into one row per symbol and minute. Written instead of
+-- `market` rows when `db_market_blocks` is set.
+CREATE TABLE market_blocks (
+  symbol       INT NOT NULL,
+  minute_start TIMESTAMP NOT NULL,
+  ticks        BYTEA NOT NULL,
+  PRIMARY KEY (symbol, minute_start)
+);
+
+UPDATE howling_version SET v = 7, updated_at = CURRENT_TIMESTAMP;
@@ -0,0 +1,3 @@
+-- Postgres partitions candles, market, and market_blocks by time while
+-- upgrading, since SQLite has no table partitioning. SQLite is unchanged.
+UPDATE howling_version SET v = 8, updated_at = CURRENT_TIMESTAMP;
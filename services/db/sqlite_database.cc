@@ -1,31 +1,42 @@
 #include "services/db/sqlite_database.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <chrono>
 #include <cstddef>
 #include <exception>
+#include <format>
 #include <future>
 #include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
 #include <source_location>
+#include <span>
+#include <stop_token>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/log/log.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
 #include "data/candle.pb.h"
 #include "data/stock.pb.h"
 #include "google/protobuf/util/time_util.h"
 #include "services/db/environment.h"
+#include "services/db/market_block.h"
 #include "services/db/schema/auth_token.h"
+#include "services/db/schema/rollups.h"
 #include "services/db/schema/schema.h"
 #include "sqlite3.h"
-#include "strings/format.h"
-#include "strings/parse.h"
 #include "time/conversion.h"
 
 ABSL_FLAG(
@@ -33,12 +44,33 @@ ABSL_FLAG(
     sqlite_db_path,
     "howling.db",
     "Path to the SQLite database file.");
+ABSL_FLAG(
+    int,
+    sqlite_commit_batch_rows,
+    1000,
+    "Number of queued rows which triggers an immediate SQLite commit.");
+ABSL_FLAG(
+    absl::Duration,
+    sqlite_commit_interval,
+    absl::Milliseconds(20),
+    "Maximum time a queued row waits before its SQLite batch is committed.");
 
 namespace howling {
 namespace {
 
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
 using std::chrono::system_clock;
 
+// Binary data, which is stored as a BLOB rather than as text.
+struct blob {
+  std::string value;
+};
+
+// Schema version from which timestamps are stored as integer microseconds
+// since the Unix epoch instead of as text.
+constexpr int EPOCH_TIMESTAMPS_VERSION = 5;
+
 void check_sqlite_err(
     int code, sqlite3* db = nullptr, std::source_location = {}) {
   // TODO: Figure out what to do with source loc. Possibly log error?
@@ -62,6 +94,36 @@ void check_sqlite_err(int code, sqlite3& db, std::source_location loc = {}) {
   check_sqlite_err(code, &db, std::move(loc));
 }
 
+/**
+ * Returns the path to open for `path`. The reader and writer connections must
+ * share one database, so each `:memory:` database becomes a uniquely named
+ * in-memory database with a shared cache.
+ */
+std::string connection_path(std::string path) {
+  if (path != ":memory:") return path;
+  static std::atomic<int> next_memory_id = 0;
+  return std::format(
+      "file:howling-memory-{}?mode=memory&cache=shared", next_memory_id++);
+}
+
+sqlite3* open_connection(const std::string& path) {
+  sqlite3* db = nullptr;
+  try {
+    check_sqlite_err(
+        sqlite3_open_v2(
+            path.c_str(),
+            &db,
+            SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI,
+            /*zVfs=*/nullptr),
+        db);
+    check_sqlite_err(sqlite3_busy_timeout(db, /*ms=*/5000), db);
+  } catch (...) {
+    sqlite3_close_v2(db);
+    throw;
+  }
+  return db;
+}
+
 class query {
 private:
   struct single_use_t {};
@@ -96,6 +158,16 @@ public:
     if (_statement) sqlite3_finalize(_statement);
   }
 
+  query(const query&) = delete;
+  query& operator=(const query&) = delete;
+
+  /** Resets the statement and its bindings so it can be executed again. */
+  void reset() {
+    // The result of the previous step has already been reported by `step`.
+    sqlite3_reset(_statement);
+    check_sqlite_err(sqlite3_clear_bindings(_statement), _db);
+  }
+
   template <typename T>
   void bind(int index, T&& val) {
     _bind(index, std::forward<T>(val));
@@ -178,8 +250,22 @@ private:
         _db);
   }
 
+  void _bind(int index, const blob& data) {
+    check_sqlite_err(
+        sqlite3_bind_blob64(
+            _statement,
+            index,
+            data.value.data(),
+            data.value.size(),
+            SQLITE_TRANSIENT),
+        _db);
+  }
+
   void _bind(int index, system_clock::time_point time) {
-    _bind(index, to_string(time));
+    _bind(
+        index,
+        static_cast<int64_t>(
+            duration_cast<microseconds>(time.time_since_epoch()).count()));
   }
 
   // MARK: Read
@@ -235,10 +321,21 @@ private:
     str.assign(str_view);
   }
 
+  void _read_column(int index, blob& data) {
+    if (sqlite3_column_type(_statement, index) != SQLITE_BLOB) {
+      throw std::runtime_error(
+          "Attempted to read non-blob column into a blob.");
+    }
+    // Empty blobs have a null data pointer.
+    const void* bytes = sqlite3_column_blob(_statement, index);
+    int size = sqlite3_column_bytes(_statement, index);
+    data.value.assign(static_cast<const char*>(bytes), bytes ? size : 0);
+  }
+
   void _read_column(int index, system_clock::time_point& time) {
-    std::string_view time_str;
-    _read_column(index, time_str);
-    time = parse_timepoint(time_str);
+    int64_t epoch_us;
+    _read_column(index, epoch_us);
+    time = system_clock::time_point{microseconds{epoch_us}};
   }
 
   template <typename T>
@@ -278,6 +375,223 @@ void execute_read(
   execute_read(q, std::forward<Outputs>(outputs)...);
 }
 
+void insert_candle(query& q, stock::Symbol symbol, const Candle& candle) {
+  q.reset();
+  q.bind_all(
+      static_cast<int>(symbol),
+      candle.open(),
+      candle.close(),
+      candle.high(),
+      candle.low(),
+      candle.volume(),
+      to_std_chrono(candle.opened_at()),
+      duration_cast<microseconds>(to_std_chrono(candle.duration())).count());
+  while (q.step());
+}
+
+// Rebuilds the rolled up candle opened at ?2 and ending before ?3 from the
+// candles within it.
+constexpr std::string_view UPDATE_ROLLUP_QUERY = R"sql(
+  INSERT OR REPLACE INTO {0} (
+    symbol, open, close, high, low, volume, opened_at, duration_us
+  )
+  SELECT
+    symbol,
+    (
+      SELECT open FROM {1}
+      WHERE symbol = ?1 AND opened_at >= ?2 AND opened_at < ?3
+      ORDER BY opened_at ASC LIMIT 1
+    ),
+    (
+      SELECT close FROM {1}
+      WHERE symbol = ?1 AND opened_at >= ?2 AND opened_at < ?3
+      ORDER BY opened_at DESC LIMIT 1
+    ),
+    max(high), min(low), sum(volume), ?2, sum(duration_us)
+  FROM {1}
+  WHERE symbol = ?1 AND opened_at >= ?2 AND opened_at < ?3
+  GROUP BY symbol)sql";
+
+/**
+ * Rebuilds every rolled up candle containing one of `opened_at`, using the
+ * `UPDATE_ROLLUP_QUERY` of each rollup in order.
+ */
+void update_rollups(
+    std::span<const std::unique_ptr<query>> rollup_queries,
+    stock::Symbol symbol,
+    std::span<const system_clock::time_point> opened_at) {
+  for (std::size_t i = 0; i < db_internal::CANDLE_ROLLUPS.size(); ++i) {
+    microseconds length = db_internal::CANDLE_ROLLUPS[i].length;
+    std::set<system_clock::time_point> starts;
+    for (system_clock::time_point time : opened_at) {
+      starts.insert(db_internal::rollup_start(time, length));
+    }
+    query& q = *rollup_queries[i];
+    for (system_clock::time_point start : starts) {
+      q.reset();
+      q.bind_all(static_cast<int>(symbol), start, start + length);
+      while (q.step());
+    }
+  }
+}
+
+void insert_market(query& q, const Market& market) {
+  q.reset();
+  q.bind_all(
+      static_cast<int>(market.symbol()),
+      market.bid(),
+      market.bid_lots(),
+      market.ask(),
+      market.ask_lots(),
+      market.last(),
+      market.last_lots(),
+      to_std_chrono(market.emitted_at()));
+  while (q.step());
+}
+
+/**
+ * Merges the ticks of `block` into its `market_blocks` row, reading the row
+ * with `select` and writing it back with `upsert`.
+ */
+void save_market_block(
+    query& select, query& upsert, db_internal::market_block block) {
+  select.reset();
+  select.bind_all(static_cast<int>(block.symbol), block.minute_start);
+  if (select.step()) {
+    db_internal::market_block saved = db_internal::decode_market_block(
+        block.symbol, block.minute_start, select.read<blob>(0).value);
+    db_internal::merge_market_blocks(saved, block);
+    block = std::move(saved);
+  }
+  upsert.reset();
+  upsert.bind_all(
+      static_cast<int>(block.symbol),
+      block.minute_start,
+      blob{db_internal::encode_market_block(block)});
+  while (upsert.step());
+}
+
+Candle read_candle(query& q) {
+  double open, close, high, low;
+  int64_t volume, duration_us;
+  system_clock::time_point opened_at;
+  q.read_all(open, close, high, low, volume, opened_at, duration_us);
+  Candle candle;
+  candle.set_open(open);
+  candle.set_close(close);
+  candle.set_high(high);
+  candle.set_low(low);
+  candle.set_volume(volume);
+  *candle.mutable_opened_at() = to_proto(opened_at);
+  *candle.mutable_duration() = to_proto(std::chrono::microseconds(duration_us));
+  return candle;
+}
+
+Market read_market_row(query& q, stock::Symbol symbol) {
+  double bid, ask, last;
+  int64_t bid_lots, ask_lots, last_lots;
+  system_clock::time_point emitted_at;
+  q.read_all(bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at);
+  Market market;
+  market.set_symbol(symbol);
+  market.set_bid(bid);
+  market.set_bid_lots(bid_lots);
+  market.set_ask(ask);
+  market.set_ask_lots(ask_lots);
+  market.set_last(last);
+  market.set_last_lots(last_lots);
+  *market.mutable_emitted_at() = to_proto(emitted_at);
+  return market;
+}
+
+std::generator<Market> read_market_rows(
+    sqlite3& db,
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  // Bounded by the (symbol, emitted_at) primary key.
+  query q{db, query::single_use, R"sql(
+    SELECT bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at
+    FROM market
+    WHERE symbol = ?1 AND emitted_at >= ?2 AND emitted_at < ?3
+    ORDER BY emitted_at ASC
+  )sql"};
+  q.bind_all(symbol, from, to);
+  while (q.step()) co_yield read_market_row(q, symbol);
+}
+
+std::generator<Market> read_market_blocks(
+    sqlite3& db,
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  // The block holding `from` starts up to a minute before it.
+  query q{db, query::single_use, R"sql(
+    SELECT minute_start, ticks
+    FROM market_blocks
+    WHERE symbol = ?1 AND minute_start > ?2 - 60000000 AND minute_start < ?3
+    ORDER BY minute_start ASC
+  )sql"};
+  q.bind_all(symbol, from, to);
+  while (q.step()) {
+    system_clock::time_point minute_start;
+    blob ticks;
+    q.read_all(minute_start, ticks);
+    db_internal::market_block block =
+        db_internal::decode_market_block(symbol, minute_start, ticks.value);
+    for (Market& tick : block.ticks) {
+      system_clock::time_point emitted_at = to_std_chrono(tick.emitted_at());
+      if (emitted_at >= from && emitted_at < to) co_yield std::move(tick);
+    }
+  }
+}
+
+class block_reader : public candle_block_reader {
+public:
+  block_reader(
+      sqlite3& db,
+      stock::Symbol symbol,
+      system_clock::time_point from,
+      system_clock::time_point to)
+      : _query{db, query::single_use, R"sql(
+          SELECT open, close, high, low, volume, opened_at, duration_us
+          FROM candles
+          WHERE symbol = ?1 AND opened_at >= ?2 AND opened_at < ?3
+          ORDER BY opened_at ASC
+        )sql"} {
+    _query.bind_all(symbol, from, to);
+  }
+
+  std::size_t read(candle_block& block, std::size_t max_rows) override {
+    block.clear();
+    // Stepping a finished statement would run it again from the start.
+    if (_done) return 0;
+    block.reserve(max_rows);
+    while (block.size() < max_rows) {
+      if (!_query.step()) {
+        _done = true;
+        break;
+      }
+      double open, close, high, low;
+      int64_t volume, duration_us;
+      system_clock::time_point opened_at;
+      _query.read_all(open, close, high, low, volume, opened_at, duration_us);
+      block.open.push_back(open);
+      block.close.push_back(close);
+      block.high.push_back(high);
+      block.low.push_back(low);
+      block.volume.push_back(volume);
+      block.opened_at.push_back(opened_at);
+      block.duration.push_back(std::chrono::microseconds(duration_us));
+    }
+    return block.size();
+  }
+
+private:
+  query _query;
+  bool _done = false;
+};
+
 void full_schema_install(sqlite3& db) {
   LOG(INFO) << "Performing full DB installation.";
   for (std::string_view statement : db_internal::get_full_schema()) {
@@ -285,6 +599,98 @@ void full_schema_install(sqlite3& db) {
   }
 }
 
+/**
+ * Rewrites the text timestamps in `table.column` as integer microseconds since
+ * the epoch.
+ *
+ * The column keeps its declared `TIMESTAMP` type. Its NUMERIC affinity already
+ * stores integers natively, so no table needs rebuilding.
+ */
+void migrate_to_epoch_timestamp(
+    sqlite3& db, std::string_view table, std::string_view column) {
+  // Text timestamps look like `YYYY-MM-DD HH:MM:SS.fffffffff`, so any
+  // fractional seconds start at the 21st character.
+  execute(
+      db,
+      std::format(
+          R"sql(
+            UPDATE {0} SET {1} =
+              unixepoch({1}) * 1000000 +
+              CAST(substr(substr({1}, 21) || '000000', 1, 6) AS INTEGER)
+            WHERE typeof({1}) = 'text'
+          )sql",
+          table,
+          column));
+}
+
+/**
+ * Rewrites timestamps saved as text before `EPOCH_TIMESTAMPS_VERSION` as
+ * integer microseconds since the epoch.
+ */
+void migrate_to_epoch_timestamps(sqlite3& db) {
+  constexpr std::pair<std::string_view, std::string_view> COLUMNS[] = {
+      {"howling_version", "update_started_at"},
+      {"auth_tokens", "last_notified_at"},
+      {"auth_tokens", "updated_at"},
+      {"auth_tokens", "expires_at"},
+      {"candles", "opened_at"},
+      {"market", "emitted_at"},
+      {"trades", "executed_at"}};
+  for (auto [table, column] : COLUMNS) {
+    migrate_to_epoch_timestamp(db, table, column);
+  }
+}
+
+/**
+ * Converts the `howling_version.updated_at` set by the schema files.
+ *
+ * The schema files are shared with Postgres, whose `TIMESTAMP` columns cannot
+ * hold integers, so they set it to `CURRENT_TIMESTAMP` text on every install
+ * and upgrade.
+ */
+void migrate_version_timestamp(sqlite3& db) {
+  migrate_to_epoch_timestamp(db, "howling_version", "updated_at");
+}
+
+/** Fills the rollup tables from the candles saved before they existed. */
+void backfill_rollups(sqlite3& db) {
+  for (const db_internal::candle_rollup& rollup : db_internal::CANDLE_ROLLUPS) {
+    execute(
+        db,
+        std::format(
+            R"sql(
+              INSERT OR REPLACE INTO {0} (
+                symbol, open, close, high, low, volume, opened_at, duration_us
+              )
+              SELECT DISTINCT
+                symbol,
+                first_value(open) OVER bucket,
+                last_value(close) OVER bucket,
+                max(high) OVER bucket,
+                min(low) OVER bucket,
+                sum(volume) OVER bucket,
+                start,
+                sum(duration_us) OVER bucket
+              FROM (SELECT *, opened_at - opened_at % {2} AS start FROM {1})
+              WINDOW bucket AS (
+                PARTITION BY symbol, start
+                ORDER BY opened_at
+                ROWS BETWEEN UNBOUNDED PRECEDING AND UNBOUNDED FOLLOWING
+              )
+            )sql",
+            rollup.table,
+            rollup.source_table,
+            rollup.length.count()));
+  }
+}
+
+/** The ticks of one market block saved within a batch. */
+struct batched_block {
+  db_internal::market_block block;
+  // The saves with ticks in the block.
+  std::vector<std::promise<void>*> saves;
+};
+
 int get_schema_version(sqlite3& db) {
   LOG(INFO) << "Checking for howling_version table existence.";
   int has_version_table = 0;
@@ -315,41 +721,144 @@ int get_schema_version(sqlite3& db) {
 
 // TODO: Configure the sqlite logging system to use absl LOG.
 
+struct sqlite_database::prepared_statements {
+  explicit prepared_statements(sqlite3& db)
+      : begin{db, "BEGIN"},
+        commit{db, "COMMIT"},
+        savepoint{db, "SAVEPOINT pending_write"},
+        release{db, "RELEASE pending_write"},
+        insert_candle{db, R"sql(
+          INSERT OR REPLACE INTO candles (
+            symbol, open, close, high, low, volume, opened_at, duration_us
+          ) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8))sql"},
+        insert_market{db, R"sql(
+          INSERT OR REPLACE INTO market (
+            symbol, bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at
+          ) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8))sql"},
+        select_market_block{db, R"sql(
+          SELECT ticks FROM market_blocks
+          WHERE symbol = ?1 AND minute_start = ?2)sql"},
+        upsert_market_block{db, R"sql(
+          INSERT OR REPLACE INTO market_blocks (symbol, minute_start, ticks)
+          VALUES (?1, ?2, ?3))sql"},
+        insert_trade{db, R"sql(
+          INSERT INTO trades (
+            symbol, executed_at, action, price, quantity, confidence, dry_run
+          ) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7))sql"},
+        upsert_refresh_token{db, R"sql(
+          INSERT INTO auth_tokens (
+            service_name, refresh_token, notice_token, updated_at
+          ) VALUES (?1, ?2, NULL, unixepoch() * 1000000)
+          ON CONFLICT (service_name) DO UPDATE SET
+            refresh_token = EXCLUDED.refresh_token,
+            notice_token = EXCLUDED.notice_token,
+            updated_at = EXCLUDED.updated_at)sql"},
+        upsert_notice_token{db, R"sql(
+          INSERT INTO auth_tokens (
+            service_name,
+            refresh_token,
+            notice_token,
+            last_notified_at,
+            updated_at
+          ) VALUES (?1, '', ?2, unixepoch() * 1000000, unixepoch() * 1000000)
+          ON CONFLICT (service_name) DO UPDATE SET
+            notice_token = EXCLUDED.notice_token,
+            last_notified_at = EXCLUDED.last_notified_at,
+            updated_at = EXCLUDED.updated_at)sql"} {
+    for (const db_internal::candle_rollup& rollup :
+         db_internal::CANDLE_ROLLUPS) {
+      update_rollups.push_back(
+          std::make_unique<query>(
+              db,
+              std::format(
+                  UPDATE_ROLLUP_QUERY, rollup.table, rollup.source_table)));
+    }
+  }
+
+  query begin;
+  query commit;
+  query savepoint;
+  query release;
+  query insert_candle;
+  query insert_market;
+  query select_market_block;
+  query upsert_market_block;
+  query insert_trade;
+  query upsert_refresh_token;
+  query upsert_notice_token;
+  // One per rollup, in the order of `db_internal::CANDLE_ROLLUPS`.
+  std::vector<std::unique_ptr<query>> update_rollups;
+};
+
 sqlite_database::sqlite_database(security_client& security)
-    : _security{security} {
+    : _security{security},
+      _market_blocks{absl::GetFlag(FLAGS_db_market_blocks)} {
+  std::string path = connection_path(absl::GetFlag(FLAGS_sqlite_db_path));
   try {
-    _check(sqlite3_open(absl::GetFlag(FLAGS_sqlite_db_path).c_str(), &_db));
+    _writer_db = open_connection(path);
+    // In-memory databases cannot use WAL and keep their `memory` journal.
+    std::string journal_mode;
+    execute_read(*_writer_db, "PRAGMA journal_mode = WAL", journal_mode);
+    // With WAL, NORMAL only syncs at checkpoints and is still corruption safe.
+    execute(*_writer_db, "PRAGMA synchronous = NORMAL");
+
+    _db = open_connection(path);
+    // Connections to a shared cache lock tables against each other instead of
+    // waiting on the busy timeout, so reads there skip the writer's locks and
+    // see uncommitted saves. Other databases ignore this.
+    execute(*_db, "PRAGMA read_uncommitted = 1");
   } catch (...) {
-    if (_db) {
-      sqlite3_close_v2(_db);
-      _db = nullptr;
-    }
-    std::rethrow_exception(std::current_exception());
+    sqlite3_close_v2(_db);
+    _db = nullptr;
+    sqlite3_close_v2(_writer_db);
+    _writer_db = nullptr;
+    throw;
   }
+  _writer = std::jthread([this](std::stop_token stop) { _write_loop(stop); });
 }
 
 sqlite_database::~sqlite_database() {
+  if (_writer.joinable()) {
+    _writer.request_stop();
+    _writer.join();
+  }
+  _statements.reset();
+  if (_writer_db) sqlite3_close_v2(_writer_db);
   if (_db) sqlite3_close_v2(_db);
 }
 
 std::future<void> sqlite_database::upgrade_schema(std::string_view) {
-  std::promise<void> p;
-  try {
-    int version = get_schema_version(*_db);
+  // Runs on the writer connection between batches, so the migration's
+  // transaction never mixes with queued saves.
+  return _enqueue_exclusive([](sqlite3& db) {
+    int version = get_schema_version(db);
     int expected_version = db_internal::get_schema_version();
     if (version <= 0) {
-      full_schema_install(*_db);
+      full_schema_install(db);
+      migrate_version_timestamp(db);
     } else if (version != expected_version) {
       LOG(INFO) << "Upgrading schema from version " << version << " to "
                 << expected_version;
-      for (std::string_view statement :
-           db_internal::get_schema_update(version)) {
-        execute(*_db, statement);
+      execute(db, "BEGIN");
+      try {
+        for (std::string_view statement :
+             db_internal::get_schema_update(version)) {
+          execute(db, statement);
+        }
+        if (version < EPOCH_TIMESTAMPS_VERSION) {
+          migrate_to_epoch_timestamps(db);
+        }
+        if (version < db_internal::CANDLE_ROLLUPS_VERSION) {
+          backfill_rollups(db);
+        }
+        migrate_version_timestamp(db);
+        execute(db, "COMMIT");
+      } catch (...) {
+        execute(db, "ROLLBACK");
+        throw;
       }
     }
-    p.set_value();
-  } catch (...) { p.set_exception(std::current_exception()); }
-  return p.get_future();
+  });
 }
 
 std::future<void> sqlite_database::check_schema_version() {
@@ -371,63 +880,55 @@ std::future<void> sqlite_database::check_schema_version() {
 
 std::future<void>
 sqlite_database::save(stock::Symbol symbol, const Candle& candle) {
-  std::promise<void> p;
-  using std::chrono::duration_cast;
-  using std::chrono::microseconds;
-  try {
-    // TODO: Save insert query and re-use.
-    query q{*_db, query::single_use, R"sql(
-    INSERT OR REPLACE INTO candles (
-      symbol, open, close, high, low, volume, opened_at, duration_us
-    ) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8))sql"};
-    q.bind_all(
-        static_cast<int>(symbol),
-        candle.open(),
-        candle.close(),
-        candle.high(),
-        candle.low(),
-        candle.volume(),
-        to_std_chrono(candle.opened_at()),
-        duration_cast<microseconds>(to_std_chrono(candle.duration())).count());
-    while (q.step());
-    p.set_value();
-  } catch (...) { p.set_exception(std::current_exception()); }
-  return p.get_future();
+  return _enqueue([symbol, candle](prepared_statements& statements) {
+    insert_candle(statements.insert_candle, symbol, candle);
+    system_clock::time_point opened_at = to_std_chrono(candle.opened_at());
+    update_rollups(statements.update_rollups, symbol, {&opened_at, 1});
+  });
 }
 
 std::future<void> sqlite_database::save(const Market& market) {
-  std::promise<void> p;
-  try {
-    // TODO: Save insert query and re-use.
-    query q{*_db, query::single_use, R"sql(
-    INSERT OR REPLACE INTO market (
-      symbol, bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at
-    ) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8))sql"};
-    q.bind_all(
-        static_cast<int>(market.symbol()),
-        market.bid(),
-        market.bid_lots(),
-        market.ask(),
-        market.ask_lots(),
-        market.last(),
-        market.last_lots(),
-        to_std_chrono(market.emitted_at()));
-    while (q.step());
-    p.set_value();
-  } catch (...) { p.set_exception(std::current_exception()); }
+  if (_market_blocks) return _enqueue_block_ticks({market});
+  return _enqueue([market](prepared_statements& statements) {
+    insert_market(statements.insert_market, market);
+  });
+}
 
-  return p.get_future();
+std::future<void> sqlite_database::save_batch(
+    stock::Symbol symbol, std::span<const Candle> candles) {
+  // The writer commits the whole batch in one transaction.
+  return _enqueue(
+      [symbol, candles = std::vector<Candle>(candles.begin(), candles.end())](
+          prepared_statements& statements) {
+        std::vector<system_clock::time_point> opened_at;
+        opened_at.reserve(candles.size());
+        for (const Candle& candle : candles) {
+          insert_candle(statements.insert_candle, symbol, candle);
+          opened_at.push_back(to_std_chrono(candle.opened_at()));
+        }
+        update_rollups(statements.update_rollups, symbol, opened_at);
+      });
+}
+
+std::future<void> sqlite_database::save_batch(std::span<const Market> markets) {
+  if (_market_blocks) {
+    return _enqueue_block_ticks(
+        std::vector<Market>(markets.begin(), markets.end()));
+  }
+  return _enqueue(
+      [markets = std::vector<Market>(markets.begin(), markets.end())](
+          prepared_statements& statements) {
+        for (const Market& market : markets) {
+          insert_market(statements.insert_market, market);
+        }
+      });
 }
 
 std::future<void>
 sqlite_database::save_trade(const trading::TradeRecord& trade) {
-  std::promise<void> p;
-
-  try {
-    query q{*_db, query::single_use, R"sql(
-      INSERT INTO trades (
-        symbol, executed_at, action, price, quantity, confidence, dry_run
-      ) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7))sql"};
+  return _enqueue([trade](prepared_statements& statements) {
+    query& q = statements.insert_trade;
+    q.reset();
     q.bind_all(
         static_cast<int>(trade.symbol()),
         to_std_chrono(trade.executed_at()),
@@ -437,31 +938,30 @@ sqlite_database::save_trade(const trading::TradeRecord& trade) {
         trade.confidence(),
         trade.dry_run() ? 1 : 0);
     while (q.step());
-    p.set_value();
-  } catch (...) { p.set_exception(std::current_exception()); }
-
-  return p.get_future();
+  });
 }
 
 std::future<void> sqlite_database::save_refresh_token(
     std::string_view service_name, std::string_view token) {
-  std::promise<void> p;
+  std::string encrypted_token;
   try {
-    query q{*_db, query::single_use, R"sql(
-      INSERT INTO auth_tokens (
-        service_name, refresh_token, notice_token, updated_at
-      ) VALUES (?1, ?2, NULL, CURRENT_TIMESTAMP)
-      ON CONFLICT (service_name) DO UPDATE SET
-        refresh_token = EXCLUDED.refresh_token,
-        notice_token = EXCLUDED.notice_token,
-        updated_at = EXCLUDED.updated_at)sql"};
-    q.bind_all(
-        service_name,
-        _security.encrypt(absl::GetFlag(FLAGS_db_encryption_key_name), token));
-    while (q.step());
-    p.set_value();
-  } catch (...) { p.set_exception(std::current_exception()); }
-  return p.get_future();
+    encrypted_token =
+        _security.encrypt(absl::GetFlag(FLAGS_db_encryption_key_name), token);
+  } catch (...) {
+    std::promise<void> p;
+    p.set_exception(std::current_exception());
+    return p.get_future();
+  }
+  return _enqueue(
+      [service_name = std::string{service_name},
+       encrypted_token =
+           std::move(encrypted_token)](prepared_statements& statements) {
+        query& q = statements.upsert_refresh_token;
+        q.reset();
+        q.bind_all(
+            std::string_view{service_name}, std::string_view{encrypted_token});
+        while (q.step());
+      });
 }
 
 std::generator<Candle> sqlite_database::read_candles(stock::Symbol symbol) {
@@ -472,48 +972,63 @@ std::generator<Candle> sqlite_database::read_candles(stock::Symbol symbol) {
     ORDER BY opened_at ASC
   )sql"};
   q.bind_all(symbol);
-  while (q.step()) {
-    double open, close, high, low;
-    int64_t volume, duration_us;
-    system_clock::time_point opened_at;
-    q.read_all(open, close, high, low, volume, opened_at, duration_us);
-    Candle candle;
-    candle.set_open(open);
-    candle.set_close(close);
-    candle.set_high(high);
-    candle.set_low(low);
-    candle.set_volume(volume);
-    *candle.mutable_opened_at() = to_proto(opened_at);
-    *candle.mutable_duration() =
-        to_proto(std::chrono::microseconds(duration_us));
-    co_yield std::move(candle);
-  }
+  while (q.step()) co_yield read_candle(q);
 }
 
-std::generator<Market> sqlite_database::read_market(stock::Symbol symbol) {
+std::generator<Candle> sqlite_database::read_candles(
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  // Bounded by the (symbol, opened_at) primary key.
   query q{*_db, query::single_use, R"sql(
-    SELECT bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at
-    FROM market
-    WHERE symbol = ?1
-    ORDER BY emitted_at ASC
+    SELECT open, close, high, low, volume, opened_at, duration_us
+    FROM candles
+    WHERE symbol = ?1 AND opened_at >= ?2 AND opened_at < ?3
+    ORDER BY opened_at ASC
   )sql"};
-  q.bind_all(symbol);
-  while (q.step()) {
-    double bid, ask, last;
-    int64_t bid_lots, ask_lots, last_lots;
-    system_clock::time_point emitted_at;
-    q.read_all(bid, bid_lots, ask, ask_lots, last, last_lots, emitted_at);
-    Market market;
-    market.set_symbol(symbol);
-    market.set_bid(bid);
-    market.set_bid_lots(bid_lots);
-    market.set_ask(ask);
-    market.set_ask_lots(ask_lots);
-    market.set_last(last);
-    market.set_last_lots(last_lots);
-    *market.mutable_emitted_at() = to_proto(emitted_at);
-    co_yield std::move(market);
-  }
+  q.bind_all(symbol, from, to);
+  while (q.step()) co_yield read_candle(q);
+}
+
+std::generator<Candle> sqlite_database::read_candles(
+    stock::Symbol symbol,
+    candle_resolution resolution,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  query q{
+      *_db,
+      query::single_use,
+      std::format(
+          R"sql(
+            SELECT open, close, high, low, volume, opened_at, duration_us
+            FROM {}
+            WHERE symbol = ?1 AND opened_at >= ?2 AND opened_at < ?3
+            ORDER BY opened_at ASC
+          )sql",
+          db_internal::candle_table(resolution))};
+  q.bind_all(symbol, from, to);
+  while (q.step()) co_yield read_candle(q);
+}
+
+std::unique_ptr<candle_block_reader> sqlite_database::read_candle_blocks(
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  return std::make_unique<block_reader>(*_db, symbol, from, to);
+}
+
+std::generator<Market> sqlite_database::read_market(stock::Symbol symbol) {
+  return read_market(
+      symbol, system_clock::time_point::min(), system_clock::time_point::max());
+}
+
+std::generator<Market> sqlite_database::read_market(
+    stock::Symbol symbol,
+    system_clock::time_point from,
+    system_clock::time_point to) {
+  return db_internal::merge_market_ticks(
+      read_market_rows(*_db, symbol, from, to),
+      read_market_blocks(*_db, symbol, from, to));
 }
 
 std::generator<trading::TradeRecord>
@@ -579,25 +1094,185 @@ sqlite_database::get_auth_token(std::string_view service_name) {
 
 std::future<void> sqlite_database::save_notice_token(
     std::string_view service_name, std::string_view notice_token) {
-  std::promise<void> p;
-  try {
-    query q{*_db, query::single_use, R"sql(
-      INSERT INTO auth_tokens (
-        service_name, refresh_token, notice_token, last_notified_at, updated_at
-      ) VALUES (?1, '', ?2, CURRENT_TIMESTAMP, CURRENT_TIMESTAMP)
-      ON CONFLICT (service_name) DO UPDATE SET
-        notice_token = EXCLUDED.notice_token,
-        last_notified_at = EXCLUDED.last_notified_at,
-        updated_at = EXCLUDED.updated_at)sql"};
-    q.bind_all(service_name, notice_token);
-    while (q.step());
-    p.set_value();
-  } catch (...) { p.set_exception(std::current_exception()); }
-  return p.get_future();
+  return _enqueue(
+      [service_name = std::string{service_name},
+       notice_token =
+           std::string{notice_token}](prepared_statements& statements) {
+        query& q = statements.upsert_notice_token;
+        q.reset();
+        q.bind_all(
+            std::string_view{service_name}, std::string_view{notice_token});
+        while (q.step());
+      });
+}
+
+// MARK: Writer
+
+std::future<void> sqlite_database::_enqueue(write_function write) {
+  return _push({.write = std::move(write)});
+}
+
+std::future<void>
+sqlite_database::_enqueue_exclusive(exclusive_write_function write) {
+  return _push({.exclusive_write = std::move(write)});
 }
 
-void sqlite_database::_check(int code, std::source_location loc) {
-  check_sqlite_err(code, _db, std::move(loc));
+std::future<void>
+sqlite_database::_enqueue_block_ticks(std::vector<Market> ticks) {
+  return _push({.block_ticks = std::move(ticks)});
+}
+
+std::future<void> sqlite_database::_push(pending_write pending) {
+  std::future<void> done = pending.done.get_future();
+  {
+    std::lock_guard lock{_writes_mutex};
+    _writes.push_back(std::move(pending));
+  }
+  _writes_ready.notify_one();
+  return done;
+}
+
+void sqlite_database::_write_loop(std::stop_token stop) {
+  std::size_t batch_rows = static_cast<std::size_t>(
+      std::max(1, absl::GetFlag(FLAGS_sqlite_commit_batch_rows)));
+  std::chrono::microseconds interval =
+      to_std_chrono(absl::GetFlag(FLAGS_sqlite_commit_interval));
+
+  std::vector<pending_write> batch;
+  while (true) {
+    {
+      std::unique_lock lock{_writes_mutex};
+      // Once stopped, queued writes are still flushed before exiting.
+      if (!_writes_ready.wait(lock, stop, [&]() { return !_writes.empty(); })) {
+        return;
+      }
+      _writes_ready.wait_until(
+          lock, stop, std::chrono::steady_clock::now() + interval, [&]() {
+            return _writes.size() >= batch_rows;
+          });
+      batch.swap(_writes);
+    }
+
+    // Exclusive writes run alone, after the saves queued before them commit.
+    std::span<pending_write> pending{batch};
+    while (!pending.empty()) {
+      auto exclusive = std::ranges::find_if(
+          pending, [](const pending_write& write) {
+            return static_cast<bool>(write.exclusive_write);
+          });
+      std::size_t batched = exclusive - pending.begin();
+      _commit(pending.first(batched));
+      if (exclusive == pending.end()) break;
+      try {
+        exclusive->exclusive_write(*_writer_db);
+        exclusive->done.set_value();
+      } catch (...) {
+        exclusive->done.set_exception(std::current_exception());
+      }
+      pending = pending.subspan(batched + 1);
+    }
+    batch.clear();
+  }
+}
+
+void sqlite_database::_commit(std::span<pending_write> batch) {
+  if (batch.empty()) return;
+  try {
+    if (!_statements) {
+      _statements = std::make_unique<prepared_statements>(*_writer_db);
+    }
+    _statements->begin.reset();
+    _statements->begin.step();
+  } catch (...) {
+    for (pending_write& pending : batch) {
+      pending.done.set_exception(std::current_exception());
+    }
+    return;
+  }
+
+  // A row which fails to write is rolled back to its savepoint and only fails
+  // its own save.
+  auto in_savepoint = [&](auto&& write) {
+    try {
+      _statements->savepoint.reset();
+      _statements->savepoint.step();
+      write();
+      _statements->release.reset();
+      _statements->release.step();
+    } catch (...) {
+      sqlite3_exec(
+          _writer_db,
+          "ROLLBACK TO pending_write; RELEASE pending_write",
+          nullptr,
+          nullptr,
+          nullptr);
+      throw;
+    }
+  };
+  std::vector<std::promise<void>*> written;
+  written.reserve(batch.size());
+  // Market ticks are merged by block across the batch and written last, so
+  // each block is written once however many of its ticks were saved.
+  std::map<std::pair<stock::Symbol, system_clock::time_point>, batched_block>
+      blocks;
+  for (pending_write& pending : batch) {
+    if (pending.block_ticks) {
+      for (db_internal::market_block& block :
+           db_internal::group_market_blocks(*pending.block_ticks)) {
+        auto [it, inserted] =
+            blocks.try_emplace({block.symbol, block.minute_start});
+        if (inserted) {
+          it->second.block = std::move(block);
+        } else {
+          db_internal::merge_market_blocks(it->second.block, block);
+        }
+        it->second.saves.push_back(&pending.done);
+      }
+      continue;
+    }
+    try {
+      in_savepoint([&]() { pending.write(*_statements); });
+      written.push_back(&pending.done);
+    } catch (...) { pending.done.set_exception(std::current_exception()); }
+  }
+
+  // A block which fails to write fails every save with ticks in it.
+  std::map<std::promise<void>*, std::exception_ptr> failed_saves;
+  for (auto& [key, batched] : blocks) {
+    try {
+      in_savepoint([&]() {
+        save_market_block(
+            _statements->select_market_block,
+            _statements->upsert_market_block,
+            std::move(batched.block));
+      });
+    } catch (...) {
+      for (std::promise<void>* done : batched.saves) {
+        failed_saves.emplace(done, std::current_exception());
+      }
+    }
+  }
+  for (pending_write& pending : batch) {
+    if (!pending.block_ticks) continue;
+    auto failed = failed_saves.find(&pending.done);
+    if (failed == failed_saves.end()) {
+      written.push_back(&pending.done);
+    } else {
+      pending.done.set_exception(failed->second);
+    }
+  }
+
+  try {
+    _statements->commit.reset();
+    _statements->commit.step();
+  } catch (...) {
+    std::exception_ptr error = std::current_exception();
+    LOG(ERROR) << "Failed to commit " << written.size() << " SQLite rows.";
+    sqlite3_exec(_writer_db, "ROLLBACK", nullptr, nullptr, nullptr);
+    for (std::promise<void>* done : written) done->set_exception(error);
+    return;
+  }
+  for (std::promise<void>* done : written) done->set_value();
 }
 
 } // namespace howling
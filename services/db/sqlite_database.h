@@ -1,10 +1,18 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <future>
 #include <generator>
 #include <memory>
-#include <source_location>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
 #include <string_view>
+#include <thread>
+#include <vector>
 
 #include "data/candle.pb.h"
 #include "data/market.pb.h"
@@ -16,6 +24,30 @@
 
 namespace howling {
 
+/**
+ * @brief SQLite implementation of the database service.
+ *
+ * Every write, including schema upgrades and auth tokens, is made by a
+ * background thread on a connection of its own. It groups saves into one
+ * transaction per `sqlite_commit_batch_rows` rows or `sqlite_commit_interval`,
+ * whichever comes first, using statements prepared once per connection. Each
+ * save runs in its own savepoint, so one which fails is rolled back without
+ * affecting the rest of its batch. The futures returned by those saves resolve
+ * once their transaction commits. Reads use a separate connection and only see
+ * committed batches. The database is opened in WAL mode so readers are not
+ * blocked while a batch is written.
+ *
+ * In-memory databases are the exception. They cannot use WAL, and share one
+ * cache between the connections, so reads there skip the writer's locks and
+ * can see saves from a batch which is still open, including saves which are
+ * later rolled back.
+ *
+ * With `db_market_blocks` set, market updates are packed into one
+ * `market_blocks` row per symbol and minute instead of one `market` row each.
+ * The updates of a batch are merged by block first, so each block is written
+ * once per batch rather than once per update. Market reads return the updates
+ * stored either way.
+ */
 class sqlite_database : public database {
 public:
   sqlite_database(security_client& security);
@@ -26,12 +58,32 @@ public:
 
   std::future<void> save(stock::Symbol symbol, const Candle& candle) override;
   std::future<void> save(const Market& market) override;
+  std::future<void>
+  save_batch(stock::Symbol symbol, std::span<const Candle> candles) override;
+  std::future<void> save_batch(std::span<const Market> markets) override;
   std::future<void> save_trade(const trading::TradeRecord& trade) override;
   std::future<void> save_refresh_token(
       std::string_view service_name, std::string_view token) override;
 
   std::generator<Candle> read_candles(stock::Symbol symbol) override;
   std::generator<Market> read_market(stock::Symbol symbol) override;
+  std::generator<Candle> read_candles(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
+  std::generator<Candle> read_candles(
+      stock::Symbol symbol,
+      candle_resolution resolution,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
+  std::generator<Market> read_market(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
+  std::unique_ptr<candle_block_reader> read_candle_blocks(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
   std::generator<trading::TradeRecord>
   read_trades(stock::Symbol symbol) override;
 
@@ -41,10 +93,39 @@ public:
       std::string_view service_name, std::string_view notice_token) override;
 
 private:
-  void _check(int code, std::source_location loc = {});
+  struct prepared_statements;
+  using write_function = std::function<void(prepared_statements&)>;
+  using exclusive_write_function = std::function<void(sqlite3&)>;
+  struct pending_write {
+    write_function write;
+    // Set instead of `write` for writes which manage their own transaction.
+    exclusive_write_function exclusive_write;
+    // Set instead of `write` for market updates packed into blocks, which are
+    // written after the rest of their batch.
+    std::optional<std::vector<Market>> block_ticks;
+    std::promise<void> done;
+  };
 
+  std::future<void> _enqueue(write_function write);
+  std::future<void> _enqueue_exclusive(exclusive_write_function write);
+  std::future<void> _enqueue_block_ticks(std::vector<Market> ticks);
+  std::future<void> _push(pending_write pending);
+  void _write_loop(std::stop_token stop);
+  void _commit(std::span<pending_write> batch);
+
+  // Only used for reads.
   sqlite3* _db = nullptr;
   security_client& _security;
+  const bool _market_blocks;
+
+  // Only used by the writer thread.
+  sqlite3* _writer_db = nullptr;
+  std::unique_ptr<prepared_statements> _statements;
+
+  std::mutex _writes_mutex;
+  std::condition_variable_any _writes_ready;
+  std::vector<pending_write> _writes;
+  std::jthread _writer;
 };
 
 } // namespace howling
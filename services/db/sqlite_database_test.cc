@@ -1,15 +1,24 @@
 #include "services/db/sqlite_database.h"
 
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <future>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "absl/flags/declare.h"
 #include "absl/flags/flag.h"
 #include "absl/random/random.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
 #include "data/candle.pb.h"
+#include "data/market.pb.h"
 #include "data/stock.pb.h"
 #include "data/trade.pb.h"
 #include "google/protobuf/util/time_util.h"
@@ -21,12 +30,16 @@
 #include "gtest/gtest.h"
 
 ABSL_DECLARE_FLAG(std::string, sqlite_db_path);
+ABSL_DECLARE_FLAG(int, sqlite_commit_batch_rows);
+ABSL_DECLARE_FLAG(absl::Duration, sqlite_commit_interval);
 
 namespace howling {
 namespace {
 
 using ::testing::_;
+using ::testing::ElementsAre;
 using ::testing::IsSupersetOf;
+using ::testing::Pair;
 using ::testing::Return;
 
 class SqliteDatabaseTest : public DatabaseTest {
@@ -45,6 +58,8 @@ protected:
     if (sqlite3_open(path.c_str(), &db) == SQLITE_OK) {
       sqlite3_exec(db, "DELETE FROM candles", nullptr, nullptr, nullptr);
       sqlite3_exec(db, "DELETE FROM market", nullptr, nullptr, nullptr);
+      sqlite3_exec(
+          db, "DELETE FROM market_blocks", nullptr, nullptr, nullptr);
       sqlite3_exec(db, "DELETE FROM trades", nullptr, nullptr, nullptr);
       sqlite3_exec(db, "DELETE FROM auth_tokens", nullptr, nullptr, nullptr);
     }
@@ -126,6 +141,357 @@ TEST_F(SqliteDatabaseTest, SavedRefreshTokenIsEncryptedAtRest) {
   sqlite3_close_v2(raw_db);
 }
 
+TEST_F(SqliteDatabaseTest, EnablesWriteAheadLogging) {
+  std::string path = absl::StrCat(testing::TempDir(), "/wal_mode.db");
+  std::remove(path.c_str());
+  absl::SetFlag(&FLAGS_sqlite_db_path, path);
+  _db = std::make_unique<sqlite_database>(_mock_security);
+
+  sqlite3* raw_db;
+  ASSERT_EQ(sqlite3_open(path.c_str(), &raw_db), SQLITE_OK);
+  sqlite3_stmt* stmt;
+  ASSERT_EQ(
+      sqlite3_prepare_v2(raw_db, "PRAGMA journal_mode", -1, &stmt, nullptr),
+      SQLITE_OK);
+  ASSERT_EQ(sqlite3_step(stmt), SQLITE_ROW);
+  EXPECT_EQ(
+      std::string_view{
+          reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))},
+      "wal");
+
+  sqlite3_finalize(stmt);
+  sqlite3_close_v2(raw_db);
+}
+
+TEST_F(SqliteDatabaseTest, UpgradeConvertsTextTimestampsToEpoch) {
+  constexpr std::string_view SHARED_MEMORY_DB_PATH =
+      "file:text_timestamps?mode=memory&cache=shared";
+  absl::SetFlag(&FLAGS_sqlite_db_path, std::string{SHARED_MEMORY_DB_PATH});
+  _db = std::make_unique<sqlite_database>(_mock_security);
+  upgrade_schema();
+
+  // Rewind to version 4, which stored timestamps as text. Symbol 1 is NVDA.
+  sqlite3* raw_db;
+  ASSERT_EQ(sqlite3_open(SHARED_MEMORY_DB_PATH.data(), &raw_db), SQLITE_OK);
+  ASSERT_EQ(
+      sqlite3_exec(
+          raw_db,
+          R"sql(
+            DROP TABLE candles_5m;
+            DROP TABLE candles_1h;
+            DROP TABLE candles_1d;
+            DROP TABLE market_blocks;
+            UPDATE howling_version SET v = 4;
+            INSERT INTO candles (
+              symbol, open, close, high, low, volume, opened_at, duration_us
+            ) VALUES
+              (1, 0, 1, 0, 0, 0, '1970-01-01 00:01:00.250000000', 0),
+              (1, 0, 2, 0, 0, 0, '2024-03-05 12:34:56', 0);
+          )sql",
+          nullptr,
+          nullptr,
+          nullptr),
+      SQLITE_OK);
+
+  upgrade_schema();
+
+  std::vector<int64_t> opened_at_us;
+  for (const Candle& candle : read_candles(stock::NVDA)) {
+    opened_at_us.push_back(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            to_std_chrono(candle.opened_at()).time_since_epoch())
+            .count());
+  }
+  EXPECT_THAT(opened_at_us, ElementsAre(60'250'000, 1'709'642'096'000'000));
+
+  sqlite3_stmt* stmt;
+  ASSERT_EQ(
+      sqlite3_prepare_v2(
+          raw_db,
+          R"sql(
+            SELECT
+              (SELECT count(*) FROM candles
+               WHERE typeof(opened_at) != 'integer') +
+              (SELECT count(*) FROM howling_version
+               WHERE typeof(updated_at) != 'integer')
+          )sql",
+          -1,
+          &stmt,
+          nullptr),
+      SQLITE_OK);
+  ASSERT_EQ(sqlite3_step(stmt), SQLITE_ROW);
+  EXPECT_EQ(sqlite3_column_int(stmt, 0), 0);
+  sqlite3_finalize(stmt);
+  sqlite3_close_v2(raw_db);
+}
+
+TEST_F(SqliteDatabaseTest, InstallStoresVersionTimestampAsEpoch) {
+  constexpr std::string_view SHARED_MEMORY_DB_PATH =
+      "file:version_timestamp?mode=memory&cache=shared";
+  absl::SetFlag(&FLAGS_sqlite_db_path, std::string{SHARED_MEMORY_DB_PATH});
+  _db = std::make_unique<sqlite_database>(_mock_security);
+  upgrade_schema();
+
+  sqlite3* raw_db;
+  ASSERT_EQ(sqlite3_open(SHARED_MEMORY_DB_PATH.data(), &raw_db), SQLITE_OK);
+  sqlite3_stmt* stmt;
+  ASSERT_EQ(
+      sqlite3_prepare_v2(
+          raw_db,
+          "SELECT typeof(updated_at), updated_at FROM howling_version",
+          -1,
+          &stmt,
+          nullptr),
+      SQLITE_OK);
+  ASSERT_EQ(sqlite3_step(stmt), SQLITE_ROW);
+  EXPECT_EQ(
+      std::string_view{
+          reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))},
+      "integer");
+  // Installed some time after 2024.
+  EXPECT_GT(sqlite3_column_int64(stmt, 1), 1'704'067'200'000'000);
+  sqlite3_finalize(stmt);
+  sqlite3_close_v2(raw_db);
+}
+
+TEST_F(SqliteDatabaseTest, UpgradeBackfillsRollups) {
+  constexpr std::string_view SHARED_MEMORY_DB_PATH =
+      "file:backfill_rollups?mode=memory&cache=shared";
+  absl::SetFlag(&FLAGS_sqlite_db_path, std::string{SHARED_MEMORY_DB_PATH});
+  _db = std::make_unique<sqlite_database>(_mock_security);
+  upgrade_schema();
+
+  // Rewind to version 5, which had no rollup tables.
+  sqlite3* raw_db;
+  ASSERT_EQ(sqlite3_open(SHARED_MEMORY_DB_PATH.data(), &raw_db), SQLITE_OK);
+  ASSERT_EQ(
+      sqlite3_exec(
+          raw_db,
+          R"sql(
+            DROP TABLE candles_5m;
+            DROP TABLE candles_1h;
+            DROP TABLE candles_1d;
+            DROP TABLE market_blocks;
+            UPDATE howling_version SET v = 5;
+            INSERT INTO candles (
+              symbol, open, close, high, low, volume, opened_at, duration_us
+            ) VALUES
+              (1, 1, 2, 5, 0, 10, 0, 60000000),
+              (1, 2, 3, 4, 1, 10, 60000000, 60000000),
+              (1, 3, 4, 6, 2, 10, 3600000000, 60000000);
+          )sql",
+          nullptr,
+          nullptr,
+          nullptr),
+      SQLITE_OK);
+  sqlite3_close_v2(raw_db);
+
+  upgrade_schema();
+
+  std::vector<std::pair<double, double>> open_close;
+  for (const Candle& candle : db().read_candles(
+           stock::NVDA,
+           candle_resolution::FIVE_MINUTES,
+           std::chrono::system_clock::time_point{},
+           std::chrono::system_clock::time_point{std::chrono::days(1)})) {
+    open_close.emplace_back(candle.open(), candle.close());
+  }
+  EXPECT_THAT(open_close, ElementsAre(Pair(1.0, 3.0), Pair(3.0, 4.0)));
+
+  int days = 0;
+  for (const Candle& candle : db().read_candles(
+           stock::NVDA,
+           candle_resolution::ONE_DAY,
+           std::chrono::system_clock::time_point{},
+           std::chrono::system_clock::time_point{std::chrono::days(1)})) {
+    ++days;
+    EXPECT_EQ(candle.high(), 6.0);
+    EXPECT_EQ(candle.volume(), 30);
+  }
+  EXPECT_EQ(days, 1);
+}
+
+TEST_F(SqliteDatabaseTest, StoresMarketInMinuteBlocks) {
+  constexpr std::string_view SHARED_MEMORY_DB_PATH =
+      "file:market_blocks?mode=memory&cache=shared";
+  absl::SetFlag(&FLAGS_sqlite_db_path, std::string{SHARED_MEMORY_DB_PATH});
+  _db = std::make_unique<sqlite_database>(_mock_security);
+  upgrade_schema();
+  auto make_market = [](int seconds, double last) {
+    Market market;
+    market.set_symbol(stock::NVDA);
+    market.set_last(last);
+    market.mutable_emitted_at()->set_seconds(seconds);
+    return market;
+  };
+  // Saved as a row before switching to blocks.
+  save_market(make_market(30, 3));
+
+  absl::SetFlag(&FLAGS_db_market_blocks, true);
+  _db = std::make_unique<sqlite_database>(_mock_security);
+  absl::SetFlag(&FLAGS_db_market_blocks, false);
+  save_market(make_market(10, 0));
+  save_batch({make_market(70, 4), make_market(20, 2), make_market(10, 1)});
+
+  std::vector<double> lasts;
+  for (const Market& market : read_market(stock::NVDA)) {
+    lasts.push_back(market.last());
+  }
+  EXPECT_THAT(lasts, ElementsAre(1, 2, 3, 4));
+
+  lasts.clear();
+  for (const Market& market : db().read_market(
+           stock::NVDA,
+           std::chrono::system_clock::time_point{std::chrono::seconds(15)},
+           std::chrono::system_clock::time_point{std::chrono::seconds(70)})) {
+    lasts.push_back(market.last());
+  }
+  EXPECT_THAT(lasts, ElementsAre(2, 3));
+
+  sqlite3* raw_db;
+  ASSERT_EQ(sqlite3_open(SHARED_MEMORY_DB_PATH.data(), &raw_db), SQLITE_OK);
+  sqlite3_stmt* stmt;
+  ASSERT_EQ(
+      sqlite3_prepare_v2(
+          raw_db,
+          R"sql(
+            SELECT
+              (SELECT count(*) FROM market),
+              (SELECT count(*) FROM market_blocks)
+          )sql",
+          -1,
+          &stmt,
+          nullptr),
+      SQLITE_OK);
+  ASSERT_EQ(sqlite3_step(stmt), SQLITE_ROW);
+  EXPECT_EQ(sqlite3_column_int(stmt, 0), 1);
+  EXPECT_EQ(sqlite3_column_int(stmt, 1), 2);
+  sqlite3_finalize(stmt);
+  sqlite3_close_v2(raw_db);
+}
+
+TEST_F(SqliteDatabaseTest, WritesEachMarketBlockOncePerBatch) {
+  constexpr std::string_view SHARED_MEMORY_DB_PATH =
+      "file:block_writes?mode=memory&cache=shared";
+  absl::SetFlag(&FLAGS_sqlite_db_path, std::string{SHARED_MEMORY_DB_PATH});
+  _db = std::make_unique<sqlite_database>(_mock_security);
+  upgrade_schema();
+
+  sqlite3* raw_db;
+  ASSERT_EQ(sqlite3_open(SHARED_MEMORY_DB_PATH.data(), &raw_db), SQLITE_OK);
+  ASSERT_EQ(
+      sqlite3_exec(
+          raw_db,
+          R"sql(
+            CREATE TABLE block_writes (minute_start INTEGER);
+            CREATE TRIGGER count_block_writes AFTER INSERT ON market_blocks
+            BEGIN
+              INSERT INTO block_writes VALUES (NEW.minute_start);
+            END;
+          )sql",
+          nullptr,
+          nullptr,
+          nullptr),
+      SQLITE_OK);
+
+  // Every tick is queued before the batch commits.
+  absl::SetFlag(&FLAGS_db_market_blocks, true);
+  absl::SetFlag(&FLAGS_sqlite_commit_batch_rows, 100);
+  absl::SetFlag(&FLAGS_sqlite_commit_interval, absl::Seconds(10));
+  _db = std::make_unique<sqlite_database>(_mock_security);
+  absl::SetFlag(&FLAGS_db_market_blocks, false);
+  absl::SetFlag(&FLAGS_sqlite_commit_batch_rows, 1000);
+  absl::SetFlag(&FLAGS_sqlite_commit_interval, absl::Milliseconds(20));
+  std::vector<std::future<void>> saves;
+  for (int i = 0; i < 100; ++i) {
+    Market market;
+    market.set_symbol(stock::NVDA);
+    market.set_last(i);
+    market.mutable_emitted_at()->set_nanos(i * 1000);
+    saves.push_back(_db->save(market));
+  }
+  for (std::future<void>& save : saves) EXPECT_NO_THROW(save.get());
+
+  int count = 0;
+  for (const Market& market : read_market(stock::NVDA)) {
+    EXPECT_EQ(market.last(), count++);
+  }
+  EXPECT_EQ(count, 100);
+
+  sqlite3_stmt* stmt;
+  ASSERT_EQ(
+      sqlite3_prepare_v2(
+          raw_db, "SELECT count(*) FROM block_writes", -1, &stmt, nullptr),
+      SQLITE_OK);
+  ASSERT_EQ(sqlite3_step(stmt), SQLITE_ROW);
+  EXPECT_EQ(sqlite3_column_int(stmt, 0), 1);
+  sqlite3_finalize(stmt);
+  sqlite3_close_v2(raw_db);
+}
+
+TEST_F(SqliteDatabaseTest, CommitsQueuedSavesTogether) {
+  upgrade_schema();
+  std::vector<std::future<void>> saves;
+  for (int i = 0; i < 100; ++i) {
+    Candle candle;
+    candle.mutable_opened_at()->set_seconds(i * 60);
+    candle.mutable_duration()->set_seconds(60);
+    saves.push_back(_db->save(stock::NVDA, candle));
+  }
+  for (std::future<void>& save : saves) EXPECT_NO_THROW(save.get());
+
+  int count = 0;
+  for (const Candle& candle : read_candles(stock::NVDA)) ++count;
+  EXPECT_EQ(count, 100);
+}
+
+TEST_F(SqliteDatabaseTest, SaveFailsWithoutSchema) {
+  EXPECT_THROW(
+      _db->save(stock::NVDA, Candle::default_instance()).get(),
+      std::runtime_error);
+
+  // The writer recovers once the schema is installed.
+  upgrade_schema();
+  EXPECT_NO_THROW(save_candle(stock::NVDA, Candle::default_instance()));
+}
+
+TEST_F(SqliteDatabaseTest, RollsBackOnlyTheFailedSave) {
+  constexpr std::string_view SHARED_MEMORY_DB_PATH =
+      "file:failed_save?mode=memory&cache=shared";
+  absl::SetFlag(&FLAGS_sqlite_db_path, std::string{SHARED_MEMORY_DB_PATH});
+  _db = std::make_unique<sqlite_database>(_mock_security);
+  upgrade_schema();
+  save_candle(stock::NVDA, Candle::default_instance());
+
+  // Candles still save, but updating their daily rollup now fails.
+  sqlite3* raw_db;
+  ASSERT_EQ(sqlite3_open(SHARED_MEMORY_DB_PATH.data(), &raw_db), SQLITE_OK);
+  ASSERT_EQ(
+      sqlite3_exec(
+          raw_db, "DROP TABLE candles_1d", nullptr, nullptr, nullptr),
+      SQLITE_OK);
+  sqlite3_close_v2(raw_db);
+
+  std::vector<Candle> candles(3);
+  for (int i = 0; i < 3; ++i) {
+    candles[i].mutable_opened_at()->set_seconds((i + 1) * 60);
+    candles[i].mutable_duration()->set_seconds(60);
+  }
+  trading::TradeRecord trade;
+  trade.set_symbol(stock::NVDA);
+  std::future<void> failed = _db->save_batch(stock::NVDA, candles);
+  std::future<void> saved = _db->save_trade(trade);
+  EXPECT_THROW(failed.get(), std::runtime_error);
+  EXPECT_NO_THROW(saved.get());
+
+  int count = 0;
+  for (const Candle& candle : read_candles(stock::NVDA)) ++count;
+  EXPECT_EQ(count, 1);
+  count = 0;
+  for (const trading::TradeRecord& trade : read_trades(stock::NVDA)) ++count;
+  EXPECT_EQ(count, 1);
+}
+
 DATABASE_TEST(SqliteDatabaseTest);
 
 } // namespace
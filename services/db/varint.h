@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <format>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace howling::db_internal {
+
+/** Maps signed values to unsigned ones, keeping small magnitudes small. */
+inline uint64_t zigzag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+      static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+/** Subtracts without overflowing, wrapping back when added again. */
+inline int64_t wrapping_delta(int64_t value, int64_t previous) {
+  return static_cast<int64_t>(
+      static_cast<uint64_t>(value) - static_cast<uint64_t>(previous));
+}
+
+inline int64_t wrapping_sum(int64_t previous, uint64_t delta) {
+  return static_cast<int64_t>(static_cast<uint64_t>(previous) + delta);
+}
+
+/** Appends `value` in 7 bit groups, least significant first. */
+inline void append_varint(std::string& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+/** Appends the low `bytes` bytes of `value`, least significant first. */
+inline void append_fixed(std::string& out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+/**
+ * Reads the values appended above, checking that each one is complete.
+ *
+ * Errors name the data being read with `name`, such as "Archive".
+ */
+class byte_cursor {
+public:
+  byte_cursor(std::string_view data, std::string_view name)
+      : _data{data}, _name{name} {}
+
+  bool done() const { return _data.empty(); }
+
+  uint8_t read_byte() {
+    if (_data.empty()) {
+      throw std::runtime_error(std::format("{} is truncated.", _name));
+    }
+    uint8_t byte = static_cast<uint8_t>(_data.front());
+    _data.remove_prefix(1);
+    return byte;
+  }
+
+  uint64_t read_varint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t byte = read_byte();
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return value;
+    }
+    throw std::runtime_error(std::format("{} varint is too long.", _name));
+  }
+
+  uint64_t read_fixed(int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+      value |= static_cast<uint64_t>(read_byte()) << (8 * i);
+    }
+    return value;
+  }
+
+private:
+  std::string_view _data;
+  std::string_view _name;
+};
+
+} // namespace howling::db_internal
@@ -0,0 +1,233 @@
+#include "services/db/write_behind_database.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <generator>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "data/candle.pb.h"
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+#include "data/trade.pb.h"
+#include "services/database.h"
+#include "services/db/schema/auth_token.h"
+
+ABSL_FLAG(
+    int,
+    db_write_queue_capacity,
+    65536,
+    "Maximum number of saves waiting to be written before saving blocks.");
+ABSL_FLAG(
+    int,
+    db_write_batch_rows,
+    1000,
+    "Maximum number of queued saves handed to the database at once.");
+
+namespace howling {
+namespace {
+
+std::future<void> failed_future(std::exception_ptr error) {
+  std::promise<void> p;
+  p.set_exception(std::move(error));
+  return p.get_future();
+}
+
+} // namespace
+
+write_behind_database::write_behind_database(std::unique_ptr<database> db)
+    : _db{std::move(db)},
+      _capacity{static_cast<std::size_t>(
+          std::max(1, absl::GetFlag(FLAGS_db_write_queue_capacity)))},
+      _batch_rows{static_cast<std::size_t>(
+          std::max(1, absl::GetFlag(FLAGS_db_write_batch_rows)))} {
+  _writer = std::jthread([this](std::stop_token stop) { _write_loop(stop); });
+}
+
+write_behind_database::~write_behind_database() {
+  _writer.request_stop();
+  _writer.join();
+}
+
+// MARK: Forwarded
+
+std::future<void>
+write_behind_database::upgrade_schema(std::string_view app_db_user) {
+  return _db->upgrade_schema(app_db_user);
+}
+
+std::future<void> write_behind_database::check_schema_version() {
+  return _db->check_schema_version();
+}
+
+std::future<void> write_behind_database::save_refresh_token(
+    std::string_view service_name, std::string_view token) {
+  return _db->save_refresh_token(service_name, token);
+}
+
+std::generator<Candle>
+write_behind_database::read_candles(stock::Symbol symbol) {
+  return _db->read_candles(symbol);
+}
+
+std::generator<Market>
+write_behind_database::read_market(stock::Symbol symbol) {
+  return _db->read_market(symbol);
+}
+
+std::generator<Candle> write_behind_database::read_candles(
+    stock::Symbol symbol,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to) {
+  return _db->read_candles(symbol, from, to);
+}
+
+std::generator<Candle> write_behind_database::read_candles(
+    stock::Symbol symbol,
+    candle_resolution resolution,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to) {
+  return _db->read_candles(symbol, resolution, from, to);
+}
+
+std::generator<Market> write_behind_database::read_market(
+    stock::Symbol symbol,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to) {
+  return _db->read_market(symbol, from, to);
+}
+
+std::unique_ptr<candle_block_reader>
+write_behind_database::read_candle_blocks(
+    stock::Symbol symbol,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to) {
+  return _db->read_candle_blocks(symbol, from, to);
+}
+
+std::generator<trading::TradeRecord>
+write_behind_database::read_trades(stock::Symbol symbol) {
+  return _db->read_trades(symbol);
+}
+
+std::future<std::optional<storage::auth_token>>
+write_behind_database::get_auth_token(std::string_view service_name) {
+  return _db->get_auth_token(service_name);
+}
+
+std::future<void> write_behind_database::save_notice_token(
+    std::string_view service_name, std::string_view notice_token) {
+  return _db->save_notice_token(service_name, notice_token);
+}
+
+// MARK: Queued
+
+std::future<void>
+write_behind_database::save(stock::Symbol symbol, const Candle& candle) {
+  return _enqueue(candle_row{.symbol = symbol, .candle = candle});
+}
+
+std::future<void> write_behind_database::save(const Market& market) {
+  return _enqueue(market);
+}
+
+std::future<void>
+write_behind_database::save_trade(const trading::TradeRecord& trade) {
+  return _enqueue(trade);
+}
+
+std::future<void> write_behind_database::save_batch(
+    stock::Symbol symbol, std::span<const Candle> candles) {
+  return _enqueue(
+      candle_batch{
+          .symbol = symbol,
+          .candles = std::vector<Candle>(candles.begin(), candles.end())});
+}
+
+std::future<void>
+write_behind_database::save_batch(std::span<const Market> markets) {
+  return _enqueue(std::vector<Market>(markets.begin(), markets.end()));
+}
+
+std::future<void> write_behind_database::_enqueue(row data) {
+  pending_save pending{.data = std::move(data)};
+  std::future<void> done = pending.done.get_future();
+  {
+    std::unique_lock lock{_mutex};
+    _space_available.wait(lock, [&]() { return _queue.size() < _capacity; });
+    _queue.push_back(std::move(pending));
+  }
+  _rows_queued.notify_one();
+  return done;
+}
+
+void write_behind_database::_write_loop(std::stop_token stop) {
+  std::vector<pending_save> batch;
+  while (true) {
+    {
+      std::unique_lock lock{_mutex};
+      // Once stopped, queued saves are still written before exiting.
+      if (!_rows_queued.wait(lock, stop, [&]() { return !_queue.empty(); })) {
+        return;
+      }
+      auto batch_end = _queue.begin() + std::min(_queue.size(), _batch_rows);
+      batch.assign(
+          std::make_move_iterator(_queue.begin()),
+          std::make_move_iterator(batch_end));
+      _queue.erase(_queue.begin(), batch_end);
+    }
+    _space_available.notify_all();
+    _write(batch);
+    batch.clear();
+  }
+}
+
+void write_behind_database::_write(std::vector<pending_save>& batch) {
+  // Hand the whole batch over before waiting on any of it so databases which
+  // write asynchronously can group the rows together.
+  std::vector<std::future<void>> saves;
+  saves.reserve(batch.size());
+  for (const pending_save& pending : batch) {
+    try {
+      saves.push_back(_save(pending.data));
+    } catch (...) { saves.push_back(failed_future(std::current_exception())); }
+  }
+
+  for (std::size_t i = 0; i < batch.size(); ++i) {
+    try {
+      saves[i].get();
+      batch[i].done.set_value();
+    } catch (...) { batch[i].done.set_exception(std::current_exception()); }
+  }
+}
+
+std::future<void> write_behind_database::_save(const row& data) {
+  if (const candle_row* candle = std::get_if<candle_row>(&data)) {
+    return _db->save(candle->symbol, candle->candle);
+  }
+  if (const Market* market = std::get_if<Market>(&data)) {
+    return _db->save(*market);
+  }
+  if (const candle_batch* batch = std::get_if<candle_batch>(&data)) {
+    return _db->save_batch(batch->symbol, batch->candles);
+  }
+  if (const auto* markets = std::get_if<std::vector<Market>>(&data)) {
+    return _db->save_batch(*markets);
+  }
+  return _db->save_trade(std::get<trading::TradeRecord>(data));
+}
+
+} // namespace howling
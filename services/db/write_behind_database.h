@@ -0,0 +1,126 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <generator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string_view>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "data/candle.pb.h"
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+#include "data/trade.pb.h"
+#include "services/database.h"
+#include "services/db/schema/auth_token.h"
+
+namespace howling {
+
+/**
+ * @brief Wraps a database so that candle, market, and trade saves do not wait
+ * on it.
+ *
+ * Saves are queued and handed to the wrapped database by a dedicated writer
+ * thread, in the order they were made and in batches of up to
+ * `db_write_batch_rows` saves. The returned futures resolve once the wrapped
+ * database has finished the save. Once `db_write_queue_capacity` saves are
+ * queued, further saves block until the writer catches up. A `save_batch` call
+ * counts as a single save.
+ *
+ * Every other operation is forwarded directly to the wrapped database, so a
+ * read only sees a save once its future has resolved. Callers which need to
+ * read their own writes must wait on the save first. Saves still queued on
+ * destruction are written before the destructor returns.
+ *
+ * This class is internally synchronized.
+ */
+class write_behind_database : public database {
+public:
+  explicit write_behind_database(std::unique_ptr<database> db);
+  ~write_behind_database();
+
+  std::future<void> upgrade_schema(std::string_view app_db_user) override;
+  std::future<void> check_schema_version() override;
+
+  std::future<void> save(stock::Symbol symbol, const Candle& candle) override;
+  std::future<void> save(const Market& market) override;
+  std::future<void>
+  save_batch(stock::Symbol symbol, std::span<const Candle> candles) override;
+  std::future<void> save_batch(std::span<const Market> markets) override;
+  std::future<void> save_trade(const trading::TradeRecord& trade) override;
+  std::future<void> save_refresh_token(
+      std::string_view service_name, std::string_view token) override;
+
+  std::generator<Candle> read_candles(stock::Symbol symbol) override;
+  std::generator<Market> read_market(stock::Symbol symbol) override;
+  std::generator<Candle> read_candles(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
+  std::generator<Candle> read_candles(
+      stock::Symbol symbol,
+      candle_resolution resolution,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
+  std::generator<Market> read_market(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
+  std::unique_ptr<candle_block_reader> read_candle_blocks(
+      stock::Symbol symbol,
+      std::chrono::system_clock::time_point from,
+      std::chrono::system_clock::time_point to) override;
+  std::generator<trading::TradeRecord>
+  read_trades(stock::Symbol symbol) override;
+
+  std::future<std::optional<storage::auth_token>>
+  get_auth_token(std::string_view service_name) override;
+  std::future<void> save_notice_token(
+      std::string_view service_name, std::string_view notice_token) override;
+
+private:
+  struct candle_row {
+    stock::Symbol symbol;
+    Candle candle;
+  };
+  struct candle_batch {
+    stock::Symbol symbol;
+    std::vector<Candle> candles;
+  };
+  using row = std::variant<
+      candle_row,
+      Market,
+      trading::TradeRecord,
+      candle_batch,
+      std::vector<Market>>;
+  struct pending_save {
+    row data;
+    std::promise<void> done;
+  };
+
+  std::future<void> _enqueue(row data);
+  void _write_loop(std::stop_token stop);
+  void _write(std::vector<pending_save>& batch);
+  std::future<void> _save(const row& data);
+
+  std::unique_ptr<database> _db;
+  const std::size_t _capacity;
+  const std::size_t _batch_rows;
+
+  std::mutex _mutex;
+  std::condition_variable_any _rows_queued;
+  std::condition_variable _space_available;
+  std::deque<pending_save> _queue;
+  std::jthread _writer;
+};
+
+} // namespace howling
@@ -0,0 +1,139 @@
+#include "services/db/write_behind_database.h"
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
+#include "data/candle.pb.h"
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+#include "data/trade.pb.h"
+#include "services/db/database_test_interface.h"
+#include "services/db/sqlite_database.h"
+#include "services/mock_database.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+ABSL_DECLARE_FLAG(std::string, sqlite_db_path);
+ABSL_DECLARE_FLAG(int, db_write_queue_capacity);
+
+namespace howling {
+namespace {
+
+using ::std::chrono::milliseconds;
+using ::testing::_;
+using ::testing::ElementsAre;
+using ::testing::Invoke;
+using ::testing::Return;
+
+std::future<void> ready_future() {
+  std::promise<void> p;
+  p.set_value();
+  return p.get_future();
+}
+
+Market make_market(stock::Symbol symbol, double last) {
+  Market market;
+  market.set_symbol(symbol);
+  market.set_last(last);
+  return market;
+}
+
+class WriteBehindDatabaseTest : public DatabaseTest {
+protected:
+  void SetUp() override {
+    absl::SetFlag(&FLAGS_sqlite_db_path, ":memory:");
+    _db = std::make_unique<write_behind_database>(
+        std::make_unique<sqlite_database>(_mock_security));
+    DatabaseTest::SetUp();
+  }
+
+  database& db() override { return *_db; }
+
+  // Every test uses a fresh in-memory database.
+  void clear_database() override {}
+
+  std::unique_ptr<write_behind_database> _db;
+};
+
+DATABASE_TEST(WriteBehindDatabaseTest);
+
+TEST(WriteBehindDatabase, SavesInOrder) {
+  auto inner = std::make_unique<mock_database>();
+  std::vector<double> saved;
+  EXPECT_CALL(*inner, save(testing::An<const Market&>()))
+      .WillRepeatedly(Invoke([&](const Market& market) {
+        saved.push_back(market.last());
+        return ready_future();
+      }));
+
+  write_behind_database db{std::move(inner)};
+  std::vector<std::future<void>> saves;
+  for (int i = 0; i < 5; ++i) {
+    saves.push_back(db.save(make_market(stock::NVDA, i)));
+  }
+  for (std::future<void>& save : saves) save.get();
+
+  EXPECT_THAT(saved, ElementsAre(0, 1, 2, 3, 4));
+}
+
+TEST(WriteBehindDatabase, ForwardsSaveErrors) {
+  auto inner = std::make_unique<mock_database>();
+  EXPECT_CALL(*inner, save_trade(_))
+      .WillOnce(Invoke([](const trading::TradeRecord&) -> std::future<void> {
+        throw std::runtime_error("disk full");
+      }))
+      .WillOnce(Invoke([](const trading::TradeRecord&) {
+        std::promise<void> p;
+        p.set_exception(
+            std::make_exception_ptr(std::runtime_error("constraint")));
+        return p.get_future();
+      }))
+      .WillOnce(Return(ready_future()));
+
+  write_behind_database db{std::move(inner)};
+  std::future<void> thrown = db.save_trade(trading::TradeRecord{});
+  std::future<void> failed = db.save_trade(trading::TradeRecord{});
+  std::future<void> saved = db.save_trade(trading::TradeRecord{});
+
+  EXPECT_THROW(thrown.get(), std::runtime_error);
+  EXPECT_THROW(failed.get(), std::runtime_error);
+  EXPECT_NO_THROW(saved.get());
+}
+
+TEST(WriteBehindDatabase, BlocksSavesWhenQueueIsFull) {
+  absl::SetFlag(&FLAGS_db_write_queue_capacity, 1);
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+
+  auto inner = std::make_unique<mock_database>();
+  EXPECT_CALL(*inner, save(testing::An<const Market&>()))
+      .WillRepeatedly(Invoke([&](const Market&) {
+        released.wait();
+        return ready_future();
+      }));
+
+  auto db = std::make_unique<write_behind_database>(std::move(inner));
+  absl::SetFlag(&FLAGS_db_write_queue_capacity, 65536);
+
+  // The first save occupies the writer and the second fills the queue.
+  std::future<void> first = db->save(make_market(stock::NVDA, 1));
+  std::future<void> second = db->save(make_market(stock::NVDA, 2));
+  std::future<std::future<void>> third = std::async(
+      std::launch::async,
+      [&]() { return db->save(make_market(stock::NVDA, 3)); });
+  EXPECT_EQ(third.wait_for(milliseconds(50)), std::future_status::timeout);
+
+  release.set_value();
+  EXPECT_NO_THROW(third.get().get());
+  EXPECT_NO_THROW(second.get());
+  EXPECT_NO_THROW(first.get());
+}
+
+} // namespace
+} // namespace howling
@@ -1,7 +1,11 @@
 #include "services/market_watch.h"
 
+#include <algorithm>
 #include <chrono>
-#include <ranges>
+#include <cstddef>
+#include <future>
+#include <queue>
+#include <span>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -22,32 +26,84 @@ ABSL_FLAG(
 namespace howling {
 namespace {
 
-std::vector<std::pair<stock::Symbol, Candle>>
+using symbol_candle = std::pair<stock::Symbol, Candle>;
+
+bool opened_before(const symbol_candle& a, const symbol_candle& b) {
+  // Intermediate variables needed for std::tie.
+  auto a_seconds = a.second.opened_at().seconds();
+  auto a_nanos = a.second.opened_at().nanos();
+  auto a_symbol = a.first;
+  auto b_seconds = b.second.opened_at().seconds();
+  auto b_nanos = b.second.opened_at().nanos();
+  auto b_symbol = b.first;
+  return (
+      std::tie(a_seconds, a_nanos, a_symbol) <
+      std::tie(b_seconds, b_nanos, b_symbol));
+}
+
+std::vector<symbol_candle> fetch_symbol_history(
+    stock::Symbol symbol, std::chrono::system_clock::time_point now) {
+  schwab::api_connection conn;
+  std::vector<symbol_candle> candles;
+  for (Candle& candle : conn.get_history(symbol, {.end_date = now})) {
+    candles.push_back(std::make_pair(symbol, std::move(candle)));
+  }
+  // Schwab returns candles in chronological order, but the merge below depends
+  // on it so double check.
+  if (!std::ranges::is_sorted(candles, opened_before)) {
+    std::ranges::sort(candles, opened_before);
+  }
+  return candles;
+}
+
+/**
+ * @brief Merges the individually sorted series into one sorted series.
+ */
+std::vector<symbol_candle>
+merge_series(std::vector<std::vector<symbol_candle>> series) {
+  using cursor = std::pair<std::size_t, std::size_t>; // (series, index)
+  auto cursor_after = [&](const cursor& a, const cursor& b) {
+    return opened_before(series[b.first][b.second], series[a.first][a.second]);
+  };
+  std::priority_queue<cursor, std::vector<cursor>, decltype(cursor_after)>
+      heads{cursor_after};
+
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < series.size(); ++i) {
+    total += series[i].size();
+    if (!series[i].empty()) heads.push({i, 0});
+  }
+
+  std::vector<symbol_candle> merged;
+  merged.reserve(total);
+  while (!heads.empty()) {
+    auto [i, j] = heads.top();
+    heads.pop();
+    merged.push_back(std::move(series[i][j]));
+    if (j + 1 < series[i].size()) heads.push({i, j + 1});
+  }
+  return merged;
+}
+
+std::vector<symbol_candle>
 prefetch_history(std::span<const stock::Symbol> symbols) {
   auto now = std::chrono::system_clock::now();
-  schwab::api_connection conn;
-  std::vector<std::pair<stock::Symbol, Candle>> all_candles;
+
+  // Each symbol is requested and parsed on its own thread over a pooled
+  // connection, so the prefetch takes as long as the slowest symbol.
+  std::vector<std::future<std::vector<symbol_candle>>> pending;
+  pending.reserve(symbols.size());
   for (stock::Symbol symbol : symbols) {
-    for (Candle& candle : conn.get_history(symbol, {.end_date = now})) {
-      all_candles.push_back(std::make_pair(symbol, std::move(candle)));
-    }
+    pending.push_back(
+        std::async(std::launch::async, fetch_symbol_history, symbol, now));
+  }
+
+  std::vector<std::vector<symbol_candle>> series;
+  series.reserve(pending.size());
+  for (std::future<std::vector<symbol_candle>>& result : pending) {
+    series.push_back(result.get());
   }
-  std::ranges::sort(
-      all_candles,
-      [](const std::pair<stock::Symbol, Candle>& a,
-         const std::pair<stock::Symbol, Candle>& b) {
-        // Intermediate variables needed for std::tie.
-        auto a_seconds = a.second.opened_at().seconds();
-        auto a_nanos = a.second.opened_at().nanos();
-        auto a_symbol = a.first;
-        auto b_seconds = b.second.opened_at().seconds();
-        auto b_nanos = b.second.opened_at().nanos();
-        auto b_symbol = b.first;
-        return (
-            std::tie(a_seconds, a_nanos, a_symbol) <
-            std::tie(b_seconds, b_nanos, b_symbol));
-      });
-  return all_candles;
+  return merge_series(std::move(series));
 }
 
 } // namespace
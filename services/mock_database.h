@@ -1,8 +1,11 @@
 #pragma once
 
+#include <chrono>
 #include <future>
 #include <generator>
+#include <memory>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 
@@ -27,6 +30,16 @@ public:
       (stock::Symbol symbol, const Candle& candle),
       (override));
   MOCK_METHOD(std::future<void>, save, (const Market& market), (override));
+  MOCK_METHOD(
+      std::future<void>,
+      save_batch,
+      (stock::Symbol symbol, std::span<const Candle> candles),
+      (override));
+  MOCK_METHOD(
+      std::future<void>,
+      save_batch,
+      (std::span<const Market> markets),
+      (override));
   MOCK_METHOD(
       std::future<void>,
       save_trade,
@@ -42,6 +55,35 @@ public:
       std::generator<Candle>, read_candles, (stock::Symbol symbol), (override));
   MOCK_METHOD(
       std::generator<Market>, read_market, (stock::Symbol symbol), (override));
+  MOCK_METHOD(
+      std::generator<Candle>,
+      read_candles,
+      (stock::Symbol symbol,
+       std::chrono::system_clock::time_point from,
+       std::chrono::system_clock::time_point to),
+      (override));
+  MOCK_METHOD(
+      std::generator<Market>,
+      read_market,
+      (stock::Symbol symbol,
+       std::chrono::system_clock::time_point from,
+       std::chrono::system_clock::time_point to),
+      (override));
+  MOCK_METHOD(
+      std::generator<Candle>,
+      read_candles,
+      (stock::Symbol symbol,
+       candle_resolution resolution,
+       std::chrono::system_clock::time_point from,
+       std::chrono::system_clock::time_point to),
+      (override));
+  MOCK_METHOD(
+      std::unique_ptr<candle_block_reader>,
+      read_candle_blocks,
+      (stock::Symbol symbol,
+       std::chrono::system_clock::time_point from,
+       std::chrono::system_clock::time_point to),
+      (override));
   MOCK_METHOD(
       std::generator<trading::TradeRecord>,
       read_trades,
@@ -6,6 +6,7 @@
 #include <memory>
 #include <ratio>
 #include <stdexcept>
+#include <string>
 #include <string_view>
 #include <thread>
 
@@ -16,7 +17,7 @@
 #include "boost/beast/http.hpp"
 #include "boost/url/parse.hpp"
 #include "boost/url/url.hpp"
-#include "net/connect.h"
+#include "net/connection_pool.h"
 #include "net/request.h"
 #include "net/url.h"
 #include "services/security/certificate_bundle.h"
@@ -48,9 +49,12 @@ using ::std::chrono::steady_clock;
 constexpr double BACKOFF_EXP = 1.2;
 constexpr steady_clock::duration MAX_DELAY = milliseconds{10000};
 
-net::url make_bao_url() {
+net::url make_bao_url(std::string_view target) {
   urls::url url = urls::parse_uri(absl::GetFlag(FLAGS_bao_address)).value();
-  net::url bao_url{.service = url.port(), .host = url.host()};
+  net::url bao_url{
+      .service = url.port(),
+      .host = url.host(),
+      .target = std::string{target}};
   if (bao_url.service.empty()) {
     bao_url.service = url.scheme() == "https" ? "443" : "80";
   }
@@ -58,18 +62,16 @@ net::url make_bao_url() {
 }
 
 http::response<http::string_body> get_bao(std::string_view target) {
-  net::url bao_url = make_bao_url();
   // TODO: #106 - Check the url scheme and use a secure connection if it is
   // https.
-  auto conn = net::make_insecure_connection(bao_url);
-  return net::get(*conn, bao_url.host, target);
+  return net::get_insecure(
+      net::connection_pool::get_instance(), make_bao_url(target));
 }
 
 http::response<http::string_body>
 post_bao(std::string_view target, const Json::Value& body) {
-  net::url bao_url = make_bao_url();
-  auto conn = net::make_insecure_connection(bao_url);
-  return net::post(*conn, bao_url.host, target, body);
+  return net::post_insecure(
+      net::connection_pool::get_instance(), make_bao_url(target), body);
 }
 
 void check_response(
@@ -64,6 +64,8 @@ void handle_request(Stream& stream, std::string* last_request_body) {
         "\"}}");
   }
 
+  // The connection is shut down after every response.
+  res.keep_alive(false);
   res.prepare_payload();
   http::write(stream, res, ec);
   if (ec) return;
@@ -0,0 +1,297 @@
+#include "trading/backtest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "containers/parallel_for.h"
+#include "containers/vector.h"
+#include "data/aggregate.h"
+#include "data/analyzer.h"
+#include "data/candle.pb.h"
+#include "data/stock.pb.h"
+#include "time/conversion.h"
+#include "trading/metrics.h"
+#include "trading/trading_state.h"
+
+namespace howling {
+namespace {
+
+using ::std::chrono::system_clock;
+using ::std::chrono::year_month;
+using ::std::chrono::year_month_day;
+
+year_month get_month(system_clock::time_point time) {
+  year_month_day date{std::chrono::floor<std::chrono::days>(time)};
+  return date.year() / date.month();
+}
+
+} // namespace
+
+backtester::backtester(
+    vector<std::unique_ptr<analyzer>> analyzers,
+    stock::Symbol symbol,
+    double initial_funds,
+    const aggregation_options& aggregation)
+    : _symbol{symbol},
+      _state{
+          .market = {{symbol, aggregations{.options = aggregation}}},
+          .available_stocks = vector<stock::Symbol>{{symbol}},
+          .initial_funds = initial_funds,
+          .available_funds = initial_funds} {
+  _accounts.reserve(analyzers.size());
+  for (std::unique_ptr<analyzer>& anal : analyzers) {
+    _accounts.push_back(
+        {.anal = std::move(anal), .available_funds = initial_funds});
+  }
+}
+
+backtester::backtester(
+    std::unique_ptr<analyzer> anal,
+    stock::Symbol symbol,
+    double initial_funds,
+    const aggregation_options& aggregation)
+    : backtester(
+          [&]() {
+            vector<std::unique_ptr<analyzer>> analyzers;
+            analyzers.push_back(std::move(anal));
+            return analyzers;
+          }(),
+          symbol,
+          initial_funds,
+          aggregation) {}
+
+vector<metrics> backtester::run_day(const backtest_day& day) {
+  vector<metrics> day_metrics;
+  day_metrics.reserve(_accounts.size());
+  for (const account& a : _accounts) {
+    day_metrics.push_back(
+        {.name = day.name, .initial_funds = a.available_funds});
+  }
+  if (day.candles.empty()) return day_metrics;
+
+  year_month month = get_month(to_std_chrono(day.candles.front().opened_at()));
+  if (_accounts.front().months.empty() || month != _month) {
+    for (account& a : _accounts) {
+      if (!a.months.empty()) a.months.back().assets_value = _positions_value(a);
+      a.months.push_back(
+          {.name = std::format("{:%B %Y}", month / 1),
+           .initial_funds = a.available_funds});
+    }
+    _month = month;
+  }
+
+  for (const Candle& candle : day.candles) {
+    _state.time_now =
+        to_std_chrono(candle.opened_at()) + to_std_chrono(candle.duration());
+    add_next_minute(_state.market[_symbol], candle);
+
+    for (std::size_t i = 0; i < _accounts.size(); ++i) {
+      account& a = _accounts[i];
+      metrics& m = day_metrics[i];
+      _swap_account(a);
+      decision d = a.anal->analyze(_symbol, _state);
+      vector<trading_state::position>& positions = _state.positions[_symbol];
+      if (d.act == action::BUY) {
+        _state.available_funds -= candle.close();
+        positions.push_back(
+            {.symbol = _symbol, .price = candle.close(), .quantity = 1});
+      } else if (d.act == action::SELL && !positions.empty()) {
+        for (const trading_state::position& p : positions) {
+          ++m.sales;
+          double delta = candle.close() - p.price;
+          m.deltas.push_back(delta);
+          if (p.price < candle.close()) ++m.profitable_sales;
+          _state.available_funds += candle.close() * p.quantity;
+        }
+        positions.clear();
+      }
+      _swap_account(a);
+    }
+  }
+  for (std::size_t i = 0; i < _accounts.size(); ++i) {
+    account& a = _accounts[i];
+    day_metrics[i].available_funds = a.available_funds;
+    day_metrics[i].assets_value = _positions_value(a);
+    add_metrics(a.months.back(), day_metrics[i]);
+  }
+  return day_metrics;
+}
+
+metrics backtester::totals(std::size_t index) const {
+  const account& a = _accounts[index];
+  metrics totals{.name = "Total", .initial_funds = _state.initial_funds};
+  for (const metrics& m : a.months) add_metrics(totals, m);
+  totals.available_funds = a.available_funds;
+  totals.assets_value = _positions_value(a);
+  return totals;
+}
+
+void backtester::_swap_account(account& a) {
+  std::swap(_state.positions, a.positions);
+  std::swap(_state.available_funds, a.available_funds);
+}
+
+double backtester::_positions_value(const account& a) const {
+  double total = 0;
+  for (const auto& [symbol, positions] : a.positions) {
+    if (positions.empty()) continue;
+    double price = _state.market.at(symbol).one_minute(-1).candle.close();
+    for (const trading_state::position& p : positions) {
+      total += p.quantity * price;
+    }
+  }
+  return total;
+}
+
+// MARK: portfolio_backtester
+
+portfolio_backtester::portfolio_backtester(
+    vector<stock::Symbol> symbols,
+    vector<std::unique_ptr<analyzer>> analyzers,
+    double initial_funds,
+    const aggregation_options& aggregation,
+    std::size_t threads)
+    : _state{
+          .available_stocks = symbols,
+          .initial_funds = initial_funds,
+          .available_funds = initial_funds},
+      // No more threads than stocks can be busy within a minute.
+      _pool{std::min(threads, symbols.size())} {
+  if (symbols.size() != analyzers.size()) {
+    throw std::runtime_error("Portfolio needs one analyzer for each stock.");
+  }
+  // Every stock's entries are made up front, so the maps are never changed
+  // while stocks are analyzed in parallel.
+  _stocks.reserve(symbols.size());
+  for (std::size_t i = 0; i < symbols.size(); ++i) {
+    stock::Symbol symbol = symbols[i];
+    auto [market, inserted] =
+        _state.market.try_emplace(symbol, aggregations{.options = aggregation});
+    if (!inserted) {
+      throw std::runtime_error(
+          absl::StrCat(
+              "Portfolio lists ", stock::Symbol_Name(symbol), " twice."));
+    }
+    _stocks.push_back(
+        {.symbol = symbol,
+         .anal = std::move(analyzers[i]),
+         .market = &market->second,
+         .positions = &_state.positions[symbol],
+         .totals = {.name = stock::Symbol_Name(symbol)}});
+  }
+}
+
+metrics portfolio_backtester::run_day(const portfolio_day& day) {
+  metrics day_metrics{
+      .name = day.name, .initial_funds = _state.available_funds};
+  // Index of the next candle to replay for each stock.
+  vector<std::size_t> next(_stocks.size(), 0);
+  // Stocks with a candle opened at the current minute, in symbol order.
+  vector<std::size_t> minute;
+  vector<decision> decisions(_stocks.size(), NO_ACTION);
+  bool first_minute = true;
+
+  while (true) {
+    minute.clear();
+    system_clock::time_point opened_at = system_clock::time_point::max();
+    for (std::size_t i = 0; i < _stocks.size(); ++i) {
+      if (next[i] == day.candles[i].size()) continue;
+      system_clock::time_point t =
+          to_std_chrono(day.candles[i][next[i]].opened_at());
+      if (t < opened_at) {
+        opened_at = t;
+        minute.clear();
+      }
+      if (t == opened_at) minute.push_back(i);
+    }
+    if (minute.empty()) break;
+
+    if (first_minute) {
+      _start_month(get_month(opened_at));
+      first_minute = false;
+    }
+    const Candle& lead = day.candles[minute.front()][next[minute.front()]];
+    _state.time_now = opened_at + to_std_chrono(lead.duration());
+
+    _pool.for_each(minute.size(), [&](std::size_t j) {
+      std::size_t i = minute[j];
+      stock_state& stock = _stocks[i];
+      add_next_minute(*stock.market, day.candles[i][next[i]]);
+      decisions[i] = stock.anal->analyze(stock.symbol, _state);
+    });
+    for (std::size_t i : minute) {
+      _trade(_stocks[i], day.candles[i][next[i]], decisions[i], day_metrics);
+      ++next[i];
+    }
+  }
+  if (first_minute) return day_metrics;
+
+  day_metrics.available_funds = _state.available_funds;
+  day_metrics.assets_value = _state.total_positions_value();
+  add_metrics(_months.back(), day_metrics);
+  return day_metrics;
+}
+
+metrics portfolio_backtester::totals() const {
+  metrics totals{.name = "Total", .initial_funds = _state.initial_funds};
+  for (const metrics& m : _months) add_metrics(totals, m);
+  totals.available_funds = _state.available_funds;
+  totals.assets_value = _state.total_positions_value();
+  return totals;
+}
+
+metrics portfolio_backtester::stock_totals(std::size_t index) const {
+  const stock_state& stock = _stocks[index];
+  metrics totals = stock.totals;
+  for (const trading_state::position& p : *stock.positions) {
+    totals.assets_value +=
+        p.quantity * stock.market->one_minute(-1).candle.close();
+  }
+  return totals;
+}
+
+void portfolio_backtester::_start_month(year_month month) {
+  if (!_months.empty() && month == _month) return;
+  if (!_months.empty()) {
+    _months.back().assets_value = _state.total_positions_value();
+  }
+  _months.push_back(
+      {.name = std::format("{:%B %Y}", month / 1),
+       .initial_funds = _state.available_funds});
+  _month = month;
+}
+
+void portfolio_backtester::_trade(
+    stock_state& stock,
+    const Candle& candle,
+    const decision& d,
+    metrics& day_metrics) {
+  if (d.act == action::BUY) {
+    if (_state.available_funds < candle.close()) return;
+    _state.available_funds -= candle.close();
+    stock.totals.available_funds -= candle.close();
+    stock.positions->push_back(
+        {.symbol = stock.symbol, .price = candle.close(), .quantity = 1});
+  } else if (d.act == action::SELL && !stock.positions->empty()) {
+    for (const trading_state::position& p : *stock.positions) {
+      double delta = candle.close() - p.price;
+      double proceeds = candle.close() * p.quantity;
+      for (metrics* m : {&day_metrics, &stock.totals}) {
+        ++m->sales;
+        m->deltas.push_back(delta);
+        if (p.price < candle.close()) ++m->profitable_sales;
+      }
+      _state.available_funds += proceeds;
+      stock.totals.available_funds += proceeds;
+    }
+    stock.positions->clear();
+  }
+}
+
+} // namespace howling
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "containers/parallel_for.h"
+#include "containers/vector.h"
+#include "data/aggregate.h"
+#include "data/analyzer.h"
+#include "data/candle.pb.h"
+#include "data/stock.pb.h"
+#include "trading/metrics.h"
+#include "trading/trading_state.h"
+
+namespace howling {
+
+/**
+ * One trading day of minute candles to backtest against.
+ */
+struct backtest_day {
+  // Date of the day, formatted as YYYY-MM-DD.
+  std::string name;
+  vector<Candle> candles;
+};
+
+/**
+ * One trading day of minute candles for every stock of a portfolio.
+ */
+struct portfolio_day {
+  // Date of the day, formatted as YYYY-MM-DD.
+  std::string name;
+  // Candles of each stock, in the order of the portfolio's symbols. Stocks
+  // without any trading that day have none.
+  vector<vector<Candle>> candles;
+};
+
+/**
+ * Simulates trading a single stock on the decisions of one or more analyzers,
+ * one day at a time.
+ *
+ * Market aggregations are built once per candle and shared by every analyzer,
+ * while each analyzer trades its own account with separate funds and
+ * positions. Each BUY decision buys one share at the candle's close and each
+ * SELL decision sells every held share at the candle's close.
+ */
+class backtester {
+public:
+  backtester(
+      vector<std::unique_ptr<analyzer>> analyzers,
+      stock::Symbol symbol,
+      double initial_funds,
+      const aggregation_options& aggregation);
+  backtester(
+      std::unique_ptr<analyzer> anal,
+      stock::Symbol symbol,
+      double initial_funds,
+      const aggregation_options& aggregation);
+
+  /** @brief Number of analyzers, each trading its own account. */
+  std::size_t size() const { return _accounts.size(); }
+
+  /**
+   * @brief Trades through every candle of `day`, which must follow the days
+   * run before it.
+   *
+   * @return The metrics of just this day for each analyzer, in order.
+   */
+  vector<metrics> run_day(const backtest_day& day);
+
+  /** @brief Metrics for each calendar month run so far by one analyzer. */
+  const vector<metrics>& months(std::size_t index = 0) const {
+    return _accounts[index].months;
+  }
+
+  /**
+   * @brief Metrics over every day run so far by one analyzer, with held
+   * positions valued at their latest price.
+   */
+  metrics totals(std::size_t index = 0) const;
+
+private:
+  struct account {
+    std::unique_ptr<analyzer> anal;
+    std::unordered_map<stock::Symbol, vector<trading_state::position>>
+        positions;
+    double available_funds;
+    vector<metrics> months;
+  };
+
+  // Exchanges the funds and positions of the shared state with `a`'s.
+  void _swap_account(account& a);
+  double _positions_value(const account& a) const;
+
+  stock::Symbol _symbol;
+  // Holds the shared market aggregations. An account's funds and positions
+  // are swapped in while its analyzer runs.
+  trading_state _state;
+  vector<account> _accounts;
+  std::chrono::year_month _month;
+};
+
+/**
+ * Simulates trading several stocks from one account with shared funds, one day
+ * at a time.
+ *
+ * The candles of every stock are replayed merged by time. Within each minute,
+ * the stocks' aggregations and analyses are independent of each other and run
+ * in parallel, so analyzers must only read the market of the stock they are
+ * asked about. The decisions are then applied in symbol order before the next
+ * minute, so results do not depend on the number of threads. Each BUY decision
+ * buys one share at the candle's close if the funds allow, and each SELL
+ * decision sells every held share of the stock at the candle's close.
+ */
+class portfolio_backtester {
+public:
+  /**
+   * @param analyzers One analyzer for each of `symbols`, in the same order.
+   * @param threads Number of threads to analyze stocks on, at least 1.
+   */
+  portfolio_backtester(
+      vector<stock::Symbol> symbols,
+      vector<std::unique_ptr<analyzer>> analyzers,
+      double initial_funds,
+      const aggregation_options& aggregation,
+      std::size_t threads);
+
+  /**
+   * @brief Trades through every candle of `day`, which must follow the days
+   * run before it.
+   *
+   * @return The metrics of just this day for the whole portfolio.
+   */
+  metrics run_day(const portfolio_day& day);
+
+  /** @brief Metrics for each calendar month run so far. */
+  const vector<metrics>& months() const { return _months; }
+
+  /**
+   * @brief Metrics over every day run so far, with held positions valued at
+   * their latest price.
+   */
+  metrics totals() const;
+
+  /**
+   * @brief Metrics over every day run so far for one stock, in the order of
+   * the portfolio's symbols.
+   *
+   * Starts without funds, so the available funds are the net of the stock's
+   * sales and purchases.
+   */
+  metrics stock_totals(std::size_t index) const;
+
+private:
+  struct stock_state {
+    stock::Symbol symbol;
+    std::unique_ptr<analyzer> anal;
+    aggregations* market;
+    vector<trading_state::position>* positions;
+    metrics totals;
+  };
+
+  // Starts metrics for `month` unless it is the current one.
+  void _start_month(std::chrono::year_month month);
+  // Applies one decision to the account, recording sales in `day_metrics`.
+  void _trade(
+      stock_state& stock,
+      const Candle& candle,
+      const decision& d,
+      metrics& day_metrics);
+
+  trading_state _state;
+  vector<stock_state> _stocks;
+  parallel_pool _pool;
+  vector<metrics> _months;
+  std::chrono::year_month _month;
+};
+
+} // namespace howling
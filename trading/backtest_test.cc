@@ -0,0 +1,399 @@
+#include "trading/backtest.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "containers/vector.h"
+#include "data/aggregate.h"
+#include "data/analyzer.h"
+#include "data/candle.pb.h"
+#include "data/stock.pb.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "time/conversion.h"
+#include "trading/metrics.h"
+#include "trading/trading_state.h"
+
+namespace howling {
+namespace {
+
+using ::std::chrono::minutes;
+using ::std::chrono::sys_days;
+using ::std::chrono::year_month_day;
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::SizeIs;
+
+constexpr year_month_day JANUARY_2{
+    std::chrono::year{2025}, std::chrono::January, std::chrono::day{2}};
+constexpr year_month_day JANUARY_3{
+    std::chrono::year{2025}, std::chrono::January, std::chrono::day{3}};
+constexpr year_month_day FEBRUARY_3{
+    std::chrono::year{2025}, std::chrono::February, std::chrono::day{3}};
+
+/** Makes one minute candles closing at `closes`, starting at 14:30 UTC. */
+vector<Candle> make_candles(year_month_day date, vector<double> closes) {
+  vector<Candle> candles;
+  for (std::size_t i = 0; i < closes.size(); ++i) {
+    Candle candle;
+    candle.set_open(closes[i]);
+    candle.set_close(closes[i]);
+    candle.set_high(closes[i]);
+    candle.set_low(closes[i]);
+    candle.set_volume(100);
+    *candle.mutable_opened_at() = to_proto(
+        sys_days{date} + std::chrono::hours(14) + minutes(30 + i));
+    *candle.mutable_duration() = to_proto(minutes(1));
+    candles.push_back(std::move(candle));
+  }
+  return candles;
+}
+
+backtest_day make_day(year_month_day date, vector<double> closes) {
+  return {
+      .name = std::format("{:%F}", sys_days{date}),
+      .candles = make_candles(date, std::move(closes))};
+}
+
+/** Makes the decisions it is given in order, then holds. */
+class scripted_analyzer : public analyzer {
+public:
+  explicit scripted_analyzer(vector<action> actions)
+      : _actions{std::move(actions)} {}
+
+  decision analyze(stock::Symbol, const trading_state&) override {
+    if (_next == _actions.size()) return {.act = action::HOLD};
+    return {.act = _actions[_next++], .confidence = 1};
+  }
+
+private:
+  vector<action> _actions;
+  std::size_t _next = 0;
+};
+
+std::unique_ptr<analyzer> script(vector<action> actions) {
+  return std::make_unique<scripted_analyzer>(std::move(actions));
+}
+
+/**
+ * Buys while the close is below `buy_below` and fewer than three shares are
+ * held, and sells once it is above `sell_above`. Its decisions depend on its
+ * own account, so they change if accounts are mixed up.
+ */
+class threshold_analyzer : public analyzer {
+public:
+  threshold_analyzer(double buy_below, double sell_above)
+      : _buy_below{buy_below}, _sell_above{sell_above} {}
+
+  decision analyze(stock::Symbol symbol, const trading_state& state) override {
+    double close = state.market.at(symbol).one_minute(-1).candle.close();
+    if (close > _sell_above && can_sell(symbol, state)) {
+      return {.act = action::SELL, .confidence = 1};
+    }
+    auto held = state.positions.find(symbol);
+    if (close < _buy_below && state.available_funds >= close &&
+        (held == state.positions.end() || held->second.size() < 3)) {
+      return {.act = action::BUY, .confidence = 1};
+    }
+    return {.act = action::HOLD};
+  }
+
+private:
+  double _buy_below;
+  double _sell_above;
+};
+
+/** Makes 30 minutes of prices swinging a few dollars around 100. */
+backtest_day make_swinging_day(year_month_day date, double phase) {
+  vector<double> closes;
+  for (int i = 0; i < 30; ++i) {
+    double price = 100 + 3 * std::sin(phase + i / 3.0);
+    closes.push_back(std::round(price * 100) / 100);
+  }
+  return make_day(date, std::move(closes));
+}
+
+void expect_same_metrics(const metrics& actual, const metrics& expected) {
+  EXPECT_EQ(actual.name, expected.name);
+  EXPECT_EQ(actual.initial_funds, expected.initial_funds);
+  EXPECT_EQ(actual.available_funds, expected.available_funds);
+  EXPECT_EQ(actual.assets_value, expected.assets_value);
+  EXPECT_EQ(actual.sales, expected.sales);
+  EXPECT_EQ(actual.profitable_sales, expected.profitable_sales);
+  EXPECT_EQ(actual.deltas, expected.deltas);
+}
+
+constexpr action BUY = action::BUY;
+constexpr action SELL = action::SELL;
+constexpr action HOLD = action::HOLD;
+
+TEST(Backtester, TradesAtEachClose) {
+  backtester tester{
+      script({BUY, BUY, SELL}), stock::NVDA, 1000, aggregation_options{}};
+
+  vector<metrics> day =
+      tester.run_day(make_day(JANUARY_2, {100, 101, 105}));
+
+  ASSERT_THAT(day, SizeIs(1));
+  EXPECT_EQ(day[0].name, "2025-01-02");
+  EXPECT_EQ(day[0].initial_funds, 1000);
+  EXPECT_EQ(day[0].available_funds, 1000 - 100 - 101 + 2 * 105);
+  EXPECT_EQ(day[0].assets_value, 0);
+  EXPECT_EQ(day[0].sales, 2);
+  EXPECT_EQ(day[0].profitable_sales, 2);
+  EXPECT_THAT(day[0].deltas, ElementsAre(5, 4));
+}
+
+TEST(Backtester, IgnoresSellsWithoutPositions) {
+  backtester tester{script({SELL, HOLD}), stock::NVDA, 1000, {}};
+
+  vector<metrics> day = tester.run_day(make_day(JANUARY_2, {100, 101}));
+
+  EXPECT_EQ(day[0].available_funds, 1000);
+  EXPECT_EQ(day[0].sales, 0);
+  EXPECT_THAT(day[0].deltas, IsEmpty());
+}
+
+TEST(Backtester, ValuesHeldPositionsAtLatestClose) {
+  backtester tester{script({BUY, HOLD}), stock::NVDA, 1000, {}};
+
+  vector<metrics> day = tester.run_day(make_day(JANUARY_2, {100, 110}));
+
+  EXPECT_EQ(day[0].available_funds, 900);
+  EXPECT_EQ(day[0].assets_value, 110);
+  metrics totals = tester.totals();
+  EXPECT_EQ(totals.initial_funds, 1000);
+  EXPECT_EQ(totals.available_funds, 900);
+  EXPECT_EQ(totals.assets_value, 110);
+}
+
+TEST(Backtester, SkipsEmptyDays) {
+  backtester tester{script({BUY}), stock::NVDA, 1000, {}};
+
+  vector<metrics> day = tester.run_day({.name = "2025-01-02"});
+
+  ASSERT_THAT(day, SizeIs(1));
+  EXPECT_EQ(day[0].initial_funds, 1000);
+  EXPECT_THAT(tester.months(), IsEmpty());
+}
+
+TEST(Backtester, GroupsDaysByMonth) {
+  backtester tester{
+      script({BUY, SELL, BUY, SELL, BUY, HOLD}), stock::NVDA, 1000, {}};
+
+  tester.run_day(make_day(JANUARY_2, {100, 102}));
+  tester.run_day(make_day(JANUARY_3, {100, 99}));
+  tester.run_day(make_day(FEBRUARY_3, {100, 104}));
+
+  ASSERT_THAT(tester.months(), SizeIs(2));
+  EXPECT_EQ(tester.months()[0].name, "January 2025");
+  EXPECT_EQ(tester.months()[0].sales, 2);
+  EXPECT_EQ(tester.months()[0].profitable_sales, 1);
+  EXPECT_EQ(tester.months()[0].available_funds, 1001);
+  EXPECT_EQ(tester.months()[1].name, "February 2025");
+  EXPECT_EQ(tester.months()[1].initial_funds, 1001);
+  EXPECT_EQ(tester.months()[1].sales, 0);
+
+  metrics totals = tester.totals();
+  EXPECT_EQ(totals.sales, 2);
+  EXPECT_EQ(totals.available_funds, 901);
+  EXPECT_EQ(totals.assets_value, 104);
+}
+
+TEST(Backtester, SharedPassMatchesSeparateBacktests) {
+  const vector<std::pair<double, double>> thresholds{
+      {99, 101}, {100, 102.5}, {97.5, 99}, {101.5, 102}};
+  vector<std::unique_ptr<analyzer>> analyzers;
+  vector<std::unique_ptr<backtester>> separate;
+  for (const auto& [buy_below, sell_above] : thresholds) {
+    analyzers.push_back(
+        std::make_unique<threshold_analyzer>(buy_below, sell_above));
+    separate.push_back(std::make_unique<backtester>(
+        std::make_unique<threshold_analyzer>(buy_below, sell_above),
+        stock::NVDA,
+        500,
+        aggregation_options{}));
+  }
+  backtester shared{std::move(analyzers), stock::NVDA, 500, {}};
+  ASSERT_EQ(shared.size(), thresholds.size());
+
+  for (const backtest_day& day :
+       {make_swinging_day(JANUARY_2, 0),
+        make_swinging_day(JANUARY_3, 2),
+        make_swinging_day(FEBRUARY_3, 4)}) {
+    vector<metrics> shared_day = shared.run_day(day);
+    for (std::size_t i = 0; i < separate.size(); ++i) {
+      expect_same_metrics(shared_day[i], separate[i]->run_day(day).front());
+    }
+  }
+
+  for (std::size_t i = 0; i < separate.size(); ++i) {
+    SCOPED_TRACE(i);
+    EXPECT_GT(separate[i]->totals().sales, 0);
+    expect_same_metrics(shared.totals(i), separate[i]->totals());
+    ASSERT_EQ(shared.months(i).size(), separate[i]->months().size());
+    for (std::size_t month = 0; month < shared.months(i).size(); ++month) {
+      expect_same_metrics(
+          shared.months(i)[month], separate[i]->months()[month]);
+    }
+  }
+}
+
+// MARK: portfolio_backtester
+
+portfolio_day make_portfolio_day(
+    year_month_day date, vector<vector<double>> closes) {
+  portfolio_day day{.name = std::format("{:%F}", sys_days{date})};
+  for (vector<double>& stock_closes : closes) {
+    day.candles.push_back(make_candles(date, std::move(stock_closes)));
+  }
+  return day;
+}
+
+vector<std::unique_ptr<analyzer>>
+scripts(vector<action> first, vector<action> second) {
+  vector<std::unique_ptr<analyzer>> analyzers;
+  analyzers.push_back(script(std::move(first)));
+  analyzers.push_back(script(std::move(second)));
+  return analyzers;
+}
+
+TEST(PortfolioBacktester, TradesFromSharedFunds) {
+  portfolio_backtester tester{
+      {stock::NVDA, stock::AAPL},
+      scripts({BUY, HOLD, SELL}, {BUY, BUY, HOLD}),
+      1000,
+      aggregation_options{},
+      /*threads=*/2};
+
+  metrics day = tester.run_day(
+      make_portfolio_day(JANUARY_2, {{100, 101, 110}, {200, 210, 220}}));
+
+  EXPECT_EQ(day.initial_funds, 1000);
+  EXPECT_EQ(day.available_funds, 1000 - 100 - 200 - 210 + 110);
+  EXPECT_EQ(day.assets_value, 2 * 220);
+  EXPECT_EQ(day.sales, 1);
+  EXPECT_THAT(day.deltas, ElementsAre(10));
+
+  metrics nvda = tester.stock_totals(0);
+  EXPECT_EQ(nvda.name, "NVDA");
+  EXPECT_EQ(nvda.available_funds, 10);
+  EXPECT_EQ(nvda.assets_value, 0);
+  EXPECT_EQ(nvda.sales, 1);
+  metrics aapl = tester.stock_totals(1);
+  EXPECT_EQ(aapl.name, "AAPL");
+  EXPECT_EQ(aapl.available_funds, -410);
+  EXPECT_EQ(aapl.assets_value, 440);
+  EXPECT_EQ(aapl.sales, 0);
+
+  metrics totals = tester.totals();
+  EXPECT_EQ(totals.available_funds, 600);
+  EXPECT_EQ(totals.assets_value, 440);
+}
+
+TEST(PortfolioBacktester, RefusesBuysBeyondFunds) {
+  portfolio_backtester tester{
+      {stock::NVDA, stock::AAPL},
+      scripts({BUY, BUY}, {BUY, BUY}),
+      150,
+      {},
+      /*threads=*/2};
+
+  // Within a minute, decisions are applied in symbol order, so NVDA buys
+  // first and AAPL is refused what is left.
+  metrics day = tester.run_day(
+      make_portfolio_day(JANUARY_2, {{100, 100}, {100, 100}}));
+
+  EXPECT_EQ(day.available_funds, 50);
+  EXPECT_EQ(day.assets_value, 100);
+  EXPECT_EQ(tester.stock_totals(0).available_funds, -100);
+  EXPECT_EQ(tester.stock_totals(0).assets_value, 100);
+  EXPECT_EQ(tester.stock_totals(1).available_funds, 0);
+  EXPECT_EQ(tester.stock_totals(1).assets_value, 0);
+}
+
+TEST(PortfolioBacktester, RunsStocksWithoutCandles) {
+  portfolio_backtester tester{
+      {stock::NVDA, stock::AAPL},
+      scripts({BUY}, {BUY}),
+      1000,
+      {},
+      /*threads=*/2};
+
+  metrics day = tester.run_day(make_portfolio_day(JANUARY_2, {{100}, {}}));
+
+  EXPECT_EQ(day.available_funds, 900);
+  EXPECT_EQ(tester.stock_totals(1).available_funds, 0);
+}
+
+TEST(PortfolioBacktester, RejectsMismatchedAnalyzers) {
+  EXPECT_THROW(
+      portfolio_backtester(
+          {stock::NVDA, stock::AAPL, stock::AMD},
+          scripts({}, {}),
+          1000,
+          {},
+          /*threads=*/1),
+      std::runtime_error);
+  EXPECT_THROW(
+      portfolio_backtester(
+          {stock::NVDA, stock::NVDA}, scripts({}, {}), 1000, {}, 1),
+      std::runtime_error);
+}
+
+TEST(PortfolioBacktester, ResultsDoNotDependOnThreads) {
+  const vector<stock::Symbol> symbols{
+      stock::NVDA, stock::AAPL, stock::AMD, stock::MU, stock::RIVN};
+  auto run = [&](std::size_t threads) {
+    vector<std::unique_ptr<analyzer>> analyzers;
+    for (std::size_t i = 0; i < symbols.size(); ++i) {
+      analyzers.push_back(
+          std::make_unique<threshold_analyzer>(99.5 + 0.5 * i, 101 + 0.5 * i));
+    }
+    // Little enough that the stocks compete for funds.
+    auto tester = std::make_unique<portfolio_backtester>(
+        symbols, std::move(analyzers), 700, aggregation_options{}, threads);
+    vector<metrics> days;
+    double phase = 0;
+    for (year_month_day date : {JANUARY_2, JANUARY_3, FEBRUARY_3}) {
+      vector<vector<double>> closes;
+      for (std::size_t i = 0; i < symbols.size(); ++i) {
+        closes.push_back({});
+        for (const Candle& candle :
+             make_swinging_day(date, phase + i).candles) {
+          closes.back().push_back(candle.close());
+        }
+      }
+      days.push_back(tester->run_day(make_portfolio_day(date, closes)));
+      phase += 2;
+    }
+    return std::pair{std::move(tester), std::move(days)};
+  };
+
+  auto [serial, serial_days] = run(1);
+  auto [parallel, parallel_days] = run(symbols.size());
+
+  EXPECT_GT(serial->totals().sales, 0);
+  ASSERT_EQ(parallel_days.size(), serial_days.size());
+  for (std::size_t i = 0; i < serial_days.size(); ++i) {
+    expect_same_metrics(parallel_days[i], serial_days[i]);
+  }
+  expect_same_metrics(parallel->totals(), serial->totals());
+  for (std::size_t i = 0; i < symbols.size(); ++i) {
+    SCOPED_TRACE(i);
+    expect_same_metrics(parallel->stock_totals(i), serial->stock_totals(i));
+  }
+  ASSERT_EQ(parallel->months().size(), serial->months().size());
+  for (std::size_t i = 0; i < serial->months().size(); ++i) {
+    expect_same_metrics(parallel->months()[i], serial->months()[i]);
+  }
+}
+
+} // namespace
+} // namespace howling
@@ -1,14 +1,27 @@
 #include "trading/executor.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/flags/flag.h"
+#include "absl/log/log.h"
 #include "data/market.pb.h"
 #include "data/stock.pb.h"
+#include "data/trade.pb.h"
 #include "environment/configuration.h"
+#include "time/conversion.h"
 #include "trading/metrics.h"
+#include "trading/order_broker.h"
+#include "trading/order_broker_impl.h"
+#include "trading/order_gateway.h"
+
 ABSL_FLAG(
     double,
     max_fund_use,
@@ -58,42 +71,68 @@ int get_buy_quantity(const trading_state& state, double price) {
 
 } // namespace
 
-executor::executor(trading_state& state) : _state{state} {
+executor::executor(trading_state& state, trade_callback on_trade)
+    : _state{state}, _on_trade{std::move(on_trade)} {
   check_real_money_flag();
+  if (absl::GetFlag(FLAGS_use_real_money)) {
+    _gateway = std::make_unique<order_gateway>(
+        std::make_unique<order_broker_impl>(),
+        [this](const order_gateway::order_update& update) {
+          _on_order_update(update);
+        });
+  }
 }
 
+executor::executor(
+    trading_state& state,
+    std::unique_ptr<order_broker> broker,
+    trade_callback on_trade)
+    : _state{state}, _on_trade{std::move(on_trade)},
+      _gateway{std::make_unique<order_gateway>(
+          std::move(broker),
+          [this](const order_gateway::order_update& update) {
+            _on_order_update(update);
+          })} {}
+
 std::optional<trading_state::position>
-executor::buy(stock::Symbol symbol, metrics& m) {
+executor::buy(stock::Symbol symbol, double confidence, metrics& m) {
   auto market_itr = _market.find(symbol);
   if (market_itr == _market.end()) return std::nullopt;
+  if (_orders_in_flight.contains(symbol)) return std::nullopt;
 
   double share_price = market_itr->second.ask();
   int buy_quantity = get_buy_quantity(_state, share_price);
   if (buy_quantity == 0) return std::nullopt;
 
-  if (!absl::GetFlag(FLAGS_use_real_money)) {
+  if (!_gateway) {
     _state.positions[symbol].push_back(
         {.symbol = symbol, .price = share_price, .quantity = buy_quantity});
     _state.available_funds -= share_price * buy_quantity;
+    _record_trade(symbol, trading::BUY, share_price, buy_quantity, confidence);
     return _state.positions[symbol].back();
   }
-  std::cerr << "Buying with real money is not implemented.";
-  std::exit(1); // Not implemented.
 
   // TODO: Inject a TRAILING_STOP as well.
-  // TODO: Adjust available funds.
-
-  _conn.place_buy(
+  uint64_t order_id = _gateway->submit(
+      trading::BUY,
       {.account_id = _state.account_id,
        .symbol = symbol,
        .price = share_price,
        .quantity = buy_quantity});
+  double reserved = share_price * buy_quantity;
+  _pending_orders[order_id] = {
+      .reserved_funds = reserved, .confidence = confidence};
+  _state.available_funds -= reserved;
+  _orders_in_flight[symbol] = order_id;
+  return trading_state::position{
+      .symbol = symbol, .price = share_price, .quantity = buy_quantity};
 }
 
 std::optional<trading_state::position>
-executor::sell(stock::Symbol symbol, metrics& m) {
+executor::sell(stock::Symbol symbol, double confidence, metrics& m) {
   auto market_itr = _market.find(symbol);
   if (market_itr == _market.end()) return std::nullopt;
+  if (_orders_in_flight.contains(symbol)) return std::nullopt;
 
   double share_price = market_itr->second.bid();
   int sell_quantity = 0;
@@ -104,20 +143,26 @@ executor::sell(stock::Symbol symbol, metrics& m) {
   }
   if (sell_quantity == 0) return std::nullopt;
 
-  if (!absl::GetFlag(FLAGS_use_real_money)) {
+  if (!_gateway) {
     _state.positions[symbol].clear();
     _state.available_funds += share_price * sell_quantity;
+    _record_trade(
+        symbol, trading::SELL, share_price, sell_quantity, confidence);
     return trading_state::position{
         .symbol = symbol, .price = share_price, .quantity = sell_quantity};
   }
-  std::cerr << "Selling with real money is not implemented.";
-  std::exit(1); // Not implemented.
 
-  _conn.place_sell(
+  // Positions are only closed once the broker reports the fill.
+  uint64_t order_id = _gateway->submit(
+      trading::SELL,
       {.account_id = _state.account_id,
        .symbol = symbol,
        .price = share_price,
        .quantity = sell_quantity});
+  _pending_orders[order_id] = {.confidence = confidence};
+  _orders_in_flight[symbol] = order_id;
+  return trading_state::position{
+      .symbol = symbol, .price = share_price, .quantity = sell_quantity};
 }
 
 void executor::update_market(const Market& market) {
@@ -138,4 +183,91 @@ void executor::update_market(const Market& market) {
   *cached.mutable_emitted_at() = market.emitted_at();
 }
 
+void executor::apply_order_updates() {
+  std::vector<order_gateway::order_update> updates;
+  {
+    std::lock_guard lock{_updates_mutex};
+    updates.swap(_updates);
+  }
+  for (const order_gateway::order_update& update : updates) {
+    _apply_order_update(update);
+  }
+}
+
+void executor::_on_order_update(const order_gateway::order_update& update) {
+  // Called from the gateway's threads. Only completed orders change the
+  // trading state, and they are applied later on the decision thread.
+  if (!update.is_terminal()) return;
+  std::lock_guard lock{_updates_mutex};
+  _updates.push_back(update);
+}
+
+void executor::_apply_order_update(const order_gateway::order_update& update) {
+  _orders_in_flight.erase(update.symbol);
+  if (update.state == order_gateway::order_state::REJECTED) {
+    LOG(WARNING) << trading::Action_Name(update.action) << " order for "
+                 << stock::Symbol_Name(update.symbol) << " closed with "
+                 << update.filled_quantity << " of " << update.quantity
+                 << " shares filled.";
+  }
+
+  pending_order pending;
+  auto pending_itr = _pending_orders.find(update.order_id);
+  if (pending_itr != _pending_orders.end()) {
+    pending = pending_itr->second;
+    _pending_orders.erase(pending_itr);
+  }
+  // The reserve is replaced by the cost of whatever was actually filled.
+  _state.available_funds += pending.reserved_funds;
+  if (update.filled_quantity == 0) return;
+  _record_trade(
+      update.symbol,
+      update.action,
+      update.fill_price,
+      update.filled_quantity,
+      pending.confidence);
+
+  if (update.action == trading::BUY) {
+    _state.positions[update.symbol].push_back(
+        {.symbol = update.symbol,
+         .price = update.fill_price,
+         .quantity = update.filled_quantity});
+    _state.available_funds -= update.fill_price * update.filled_quantity;
+  } else if (update.action == trading::SELL) {
+    // Sells close the oldest positions first.
+    vector<trading_state::position>& held = _state.positions[update.symbol];
+    int64_t remaining = update.filled_quantity;
+    auto position_itr = held.begin();
+    while (remaining > 0 && position_itr != held.end()) {
+      int64_t closed = std::min(remaining, position_itr->quantity);
+      position_itr->quantity -= closed;
+      remaining -= closed;
+      if (position_itr->quantity == 0) {
+        position_itr = held.erase(position_itr);
+      } else {
+        ++position_itr;
+      }
+    }
+    _state.available_funds += update.fill_price * update.filled_quantity;
+  }
+}
+
+void executor::_record_trade(
+    stock::Symbol symbol,
+    trading::Action action,
+    double price,
+    int64_t quantity,
+    double confidence) {
+  if (!_on_trade) return;
+  trading::TradeRecord record;
+  record.set_symbol(symbol);
+  *record.mutable_executed_at() = to_proto(std::chrono::system_clock::now());
+  record.set_action(action);
+  record.set_price(price);
+  record.set_quantity(quantity);
+  record.set_confidence(confidence);
+  record.set_dry_run(!_gateway);
+  _on_trade(record);
+}
+
 } // namespace howling
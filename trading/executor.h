@@ -1,30 +1,91 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <unordered_map>
+#include <vector>
 
-#include "api/schwab.h"
 #include "data/market.pb.h"
 #include "data/stock.pb.h"
+#include "data/trade.pb.h"
 #include "trading/metrics.h"
+#include "trading/order_broker.h"
+#include "trading/order_gateway.h"
 #include "trading/trading_state.h"
 
 namespace howling {
 
 class executor {
 public:
-  explicit executor(trading_state& state);
+  /** @brief Called with every trade once it has been executed. */
+  using trade_callback = std::function<void(const trading::TradeRecord&)>;
 
-  std::optional<trading_state::position> buy(stock::Symbol symbol, metrics& m);
-  std::optional<trading_state::position> sell(stock::Symbol symbol, metrics& m);
+  /**
+   * @brief Trades through Schwab with `--use_real_money`, and otherwise only
+   * simulates trades against the trading state.
+   */
+  executor(trading_state& state, trade_callback on_trade);
+
+  /** @brief Trades with real money through `broker`. */
+  executor(
+      trading_state& state,
+      std::unique_ptr<order_broker> broker,
+      trade_callback on_trade);
+
+  std::optional<trading_state::position>
+  buy(stock::Symbol symbol, double confidence, metrics& m);
+  std::optional<trading_state::position>
+  sell(stock::Symbol symbol, double confidence, metrics& m);
 
   void update_market(const Market& market);
 
+  /**
+   * @brief Applies broker fills and rejections to the trading state.
+   *
+   * With real money, `buy` and `sell` only queue orders with the broker and
+   * return the intended position. Funds for a buy are reserved until its order
+   * completes, and no further orders are placed for a symbol while one is in
+   * flight. Trades are reported once their orders complete, at the price and
+   * quantity actually filled. Must be called on the same thread as `buy` and
+   * `sell`.
+   */
+  void apply_order_updates();
+
+  /** @brief True while an order for the symbol awaits completion. */
+  bool has_order_in_flight(stock::Symbol symbol) const {
+    return _orders_in_flight.contains(symbol);
+  }
+
 private:
+  struct pending_order {
+    // Funds set aside for a buy order.
+    double reserved_funds = 0;
+    double confidence = 0;
+  };
+
+  void _on_order_update(const order_gateway::order_update& update);
+  void _apply_order_update(const order_gateway::order_update& update);
+  void _record_trade(
+      stock::Symbol symbol,
+      trading::Action action,
+      double price,
+      int64_t quantity,
+      double confidence);
+
   trading_state& _state;
-  schwab::api_connection _conn;
+  trade_callback _on_trade;
   std::unordered_map<stock::Symbol, Market> _market;
+
+  // Orders in flight, by gateway order id.
+  std::unordered_map<uint64_t, pending_order> _pending_orders;
+  std::unordered_map<stock::Symbol, uint64_t> _orders_in_flight;
+
+  std::mutex _updates_mutex;
+  std::vector<order_gateway::order_update> _updates;
+  std::unique_ptr<order_gateway> _gateway;
 };
 
 } // namespace howling
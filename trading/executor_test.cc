@@ -0,0 +1,219 @@
+#include "trading/executor.h"
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
+#include "absl/time/time.h"
+#include "api/schwab.h"
+#include "data/market.pb.h"
+#include "data/stock.pb.h"
+#include "data/trade.pb.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "trading/metrics.h"
+#include "trading/mock_order_broker.h"
+#include "trading/trading_state.h"
+
+ABSL_DECLARE_FLAG(absl::Duration, order_poll_interval);
+
+namespace howling {
+namespace {
+
+using ::testing::IsEmpty;
+using ::testing::NiceMock;
+using ::testing::Return;
+using ::testing::Throw;
+
+class ExecutorTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    absl::SetFlag(&FLAGS_order_poll_interval, absl::Milliseconds(1));
+    auto broker = std::make_unique<NiceMock<mock_order_broker>>();
+    _broker = broker.get();
+    ON_CALL(*_broker, submit_order).WillByDefault(Return("broker-1"));
+    _executor = std::make_unique<executor>(
+        _state,
+        std::move(broker),
+        [this](const trading::TradeRecord& trade) {
+          _trades.push_back(trade);
+        });
+
+    Market market;
+    market.set_symbol(stock::NVDA);
+    market.set_bid(101);
+    market.set_bid_lots(1);
+    market.set_ask(100);
+    market.set_ask_lots(1);
+    _executor->update_market(market);
+  }
+
+  void TearDown() override { _executor.reset(); }
+
+  void fill_with(const schwab::api_connection::order_status& status) {
+    EXPECT_CALL(*_broker, get_order_status).WillOnce(Return(status));
+  }
+
+  /** @brief Applies order updates until the NVDA order has completed. */
+  void wait_for_order() {
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (_executor->has_order_in_flight(stock::NVDA) &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      _executor->apply_order_updates();
+    }
+    ASSERT_FALSE(_executor->has_order_in_flight(stock::NVDA));
+  }
+
+  trading_state _state{
+      .available_stocks = {stock::NVDA},
+      .account_id = "account",
+      .initial_funds = 10'000,
+      .available_funds = 10'000};
+  metrics _metrics;
+  std::vector<trading::TradeRecord> _trades;
+  mock_order_broker* _broker;
+  std::unique_ptr<executor> _executor;
+};
+
+TEST_F(ExecutorTest, ReservesFundsWhileBuyIsInFlight) {
+  fill_with(
+      {.status = "FILLED", .filled_quantity = 10, .average_fill_price = 100});
+
+  std::optional<trading_state::position> buy =
+      _executor->buy(stock::NVDA, 0.8, _metrics);
+  ASSERT_TRUE(buy);
+  EXPECT_EQ(buy->quantity, 10);
+  EXPECT_EQ(buy->price, 100);
+  EXPECT_EQ(_state.available_funds, 9'000);
+  EXPECT_THAT(_state.positions[stock::NVDA], IsEmpty());
+  EXPECT_TRUE(_executor->has_order_in_flight(stock::NVDA));
+  EXPECT_THAT(_trades, IsEmpty());
+
+  // No second order is placed while the first is in flight.
+  EXPECT_FALSE(_executor->buy(stock::NVDA, 0.8, _metrics));
+  wait_for_order();
+}
+
+TEST_F(ExecutorTest, RecordsBuyAtFillPrice) {
+  fill_with(
+      {.status = "FILLED", .filled_quantity = 10, .average_fill_price = 99.5});
+
+  _executor->buy(stock::NVDA, 0.8, _metrics);
+  wait_for_order();
+
+  EXPECT_EQ(_state.available_funds, 10'000 - 995);
+  ASSERT_EQ(_state.positions[stock::NVDA].size(), 1);
+  EXPECT_EQ(_state.positions[stock::NVDA][0].price, 99.5);
+  EXPECT_EQ(_state.positions[stock::NVDA][0].quantity, 10);
+
+  ASSERT_EQ(_trades.size(), 1);
+  EXPECT_EQ(_trades[0].symbol(), stock::NVDA);
+  EXPECT_EQ(_trades[0].action(), trading::BUY);
+  EXPECT_EQ(_trades[0].price(), 99.5);
+  EXPECT_EQ(_trades[0].quantity(), 10);
+  EXPECT_EQ(_trades[0].confidence(), 0.8);
+  EXPECT_FALSE(_trades[0].dry_run());
+}
+
+TEST_F(ExecutorTest, RecordsPartiallyFilledBuy) {
+  fill_with(
+      {.status = "CANCELED", .filled_quantity = 4, .average_fill_price = 100});
+
+  _executor->buy(stock::NVDA, 0.8, _metrics);
+  wait_for_order();
+
+  EXPECT_EQ(_state.available_funds, 9'600);
+  ASSERT_EQ(_state.positions[stock::NVDA].size(), 1);
+  EXPECT_EQ(_state.positions[stock::NVDA][0].quantity, 4);
+  ASSERT_EQ(_trades.size(), 1);
+  EXPECT_EQ(_trades[0].quantity(), 4);
+}
+
+TEST_F(ExecutorTest, RefundsRejectedBuy) {
+  fill_with({.status = "REJECTED"});
+
+  _executor->buy(stock::NVDA, 0.8, _metrics);
+  wait_for_order();
+
+  EXPECT_EQ(_state.available_funds, 10'000);
+  EXPECT_THAT(_state.positions[stock::NVDA], IsEmpty());
+  EXPECT_THAT(_trades, IsEmpty());
+}
+
+TEST_F(ExecutorTest, RefundsBuyWhichFailsToSend) {
+  EXPECT_CALL(*_broker, submit_order)
+      .WillOnce(Throw(std::runtime_error("Bad response.")));
+
+  _executor->buy(stock::NVDA, 0.8, _metrics);
+  wait_for_order();
+
+  EXPECT_EQ(_state.available_funds, 10'000);
+  EXPECT_THAT(_state.positions[stock::NVDA], IsEmpty());
+  EXPECT_THAT(_trades, IsEmpty());
+}
+
+TEST_F(ExecutorTest, SellClosesOldestPositionsFirst) {
+  _state.positions[stock::NVDA].push_back(
+      {.symbol = stock::NVDA, .price = 90, .quantity = 5});
+  _state.positions[stock::NVDA].push_back(
+      {.symbol = stock::NVDA, .price = 95, .quantity = 5});
+  fill_with(
+      {.status = "CANCELED", .filled_quantity = 7, .average_fill_price = 101});
+
+  std::optional<trading_state::position> sell =
+      _executor->sell(stock::NVDA, 0.6, _metrics);
+  ASSERT_TRUE(sell);
+  EXPECT_EQ(sell->quantity, 10);
+  // Positions are held until the fill is reported.
+  EXPECT_EQ(_state.positions[stock::NVDA].size(), 2);
+  wait_for_order();
+
+  ASSERT_EQ(_state.positions[stock::NVDA].size(), 1);
+  EXPECT_EQ(_state.positions[stock::NVDA][0].price, 95);
+  EXPECT_EQ(_state.positions[stock::NVDA][0].quantity, 3);
+  EXPECT_EQ(_state.available_funds, 10'000 + 707);
+
+  ASSERT_EQ(_trades.size(), 1);
+  EXPECT_EQ(_trades[0].action(), trading::SELL);
+  EXPECT_EQ(_trades[0].price(), 101);
+  EXPECT_EQ(_trades[0].quantity(), 7);
+  EXPECT_EQ(_trades[0].confidence(), 0.6);
+}
+
+TEST(Executor, SimulatesTradesWithoutRealMoney) {
+  trading_state state{
+      .available_stocks = {stock::NVDA},
+      .initial_funds = 10'000,
+      .available_funds = 10'000};
+  std::vector<trading::TradeRecord> trades;
+  executor e{state, [&](const trading::TradeRecord& trade) {
+               trades.push_back(trade);
+             }};
+  Market market;
+  market.set_symbol(stock::NVDA);
+  market.set_ask(100);
+  market.set_ask_lots(1);
+  e.update_market(market);
+
+  metrics m;
+  ASSERT_TRUE(e.buy(stock::NVDA, 0.8, m));
+  EXPECT_EQ(state.available_funds, 9'000);
+  EXPECT_EQ(state.positions[stock::NVDA].size(), 1);
+  EXPECT_FALSE(e.has_order_in_flight(stock::NVDA));
+
+  ASSERT_EQ(trades.size(), 1);
+  EXPECT_EQ(trades[0].price(), 100);
+  EXPECT_EQ(trades[0].quantity(), 10);
+  EXPECT_TRUE(trades[0].dry_run());
+}
+
+} // namespace
+} // namespace howling
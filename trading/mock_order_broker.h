@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "api/schwab.h"
+#include "data/trade.pb.h"
+#include "gmock/gmock.h"
+#include "trading/order_broker.h"
+
+namespace howling {
+
+class mock_order_broker : public order_broker {
+public:
+  MOCK_METHOD(
+      schwab::api_connection::prepared_order,
+      prepare_order,
+      (trading::Action action,
+       const schwab::api_connection::order_parameters& params),
+      (override));
+  MOCK_METHOD(
+      std::string,
+      submit_order,
+      (const schwab::api_connection::prepared_order& order),
+      (override));
+  MOCK_METHOD(
+      schwab::api_connection::order_status,
+      get_order_status,
+      (std::string_view account_id, std::string_view order_id),
+      (override));
+};
+
+} // namespace howling
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "api/schwab.h"
+#include "data/trade.pb.h"
+
+namespace howling {
+
+/**
+ * @brief The broker's order API as used by the `order_gateway`.
+ *
+ * Methods other than `prepare_order` are called from the gateway's threads and
+ * may block on the network.
+ */
+class order_broker {
+public:
+  virtual ~order_broker() = default;
+
+  /**
+   * @brief Serializes an order ahead of its submission.
+   *
+   * @param action Either `trading::BUY` or `trading::SELL`.
+   */
+  virtual schwab::api_connection::prepared_order prepare_order(
+      trading::Action action,
+      const schwab::api_connection::order_parameters& params) = 0;
+
+  /**
+   * @brief Sends a prepared order to the broker.
+   *
+   * @return The broker's id for the newly created order.
+   */
+  virtual std::string
+  submit_order(const schwab::api_connection::prepared_order& order) = 0;
+
+  /** @brief Fetches the current state of an order previously submitted. */
+  virtual schwab::api_connection::order_status get_order_status(
+      std::string_view account_id, std::string_view order_id) = 0;
+};
+
+} // namespace howling
@@ -0,0 +1,37 @@
+#include "trading/order_broker_impl.h"
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "absl/strings/str_cat.h"
+#include "api/schwab.h"
+#include "data/trade.pb.h"
+
+namespace howling {
+
+schwab::api_connection::prepared_order order_broker_impl::prepare_order(
+    trading::Action action,
+    const schwab::api_connection::order_parameters& params) {
+  if (action == trading::BUY) {
+    return schwab::api_connection::prepare_buy(params);
+  }
+  if (action == trading::SELL) {
+    return schwab::api_connection::prepare_sell(params);
+  }
+  throw std::invalid_argument(
+      absl::StrCat(
+          "Cannot prepare order with action ", trading::Action_Name(action)));
+}
+
+std::string order_broker_impl::submit_order(
+    const schwab::api_connection::prepared_order& order) {
+  return _api.submit_order(order);
+}
+
+schwab::api_connection::order_status order_broker_impl::get_order_status(
+    std::string_view account_id, std::string_view order_id) {
+  return _api.get_order_status(account_id, order_id);
+}
+
+} // namespace howling
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "api/schwab.h"
+#include "data/trade.pb.h"
+#include "trading/order_broker.h"
+
+namespace howling {
+
+class order_broker_impl : public order_broker {
+public:
+  schwab::api_connection::prepared_order prepare_order(
+      trading::Action action,
+      const schwab::api_connection::order_parameters& params) override;
+  std::string
+  submit_order(const schwab::api_connection::prepared_order& order) override;
+  schwab::api_connection::order_status get_order_status(
+      std::string_view account_id, std::string_view order_id) override;
+
+private:
+  schwab::api_connection _api;
+};
+
+} // namespace howling
@@ -0,0 +1,224 @@
+#include "trading/order_gateway.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "api/schwab.h"
+#include "data/stock.pb.h"
+#include "data/trade.pb.h"
+#include "time/conversion.h"
+#include "trading/order_broker.h"
+
+ABSL_FLAG(
+    int,
+    order_submit_threads,
+    2,
+    "Number of threads sending queued orders to the broker.");
+ABSL_FLAG(
+    absl::Duration,
+    order_poll_interval,
+    absl::Seconds(1),
+    "How often to poll the broker for the status of working orders.");
+
+namespace howling {
+namespace {
+
+bool is_closed_unfilled(std::string_view status) {
+  return status == "CANCELED" || status == "REJECTED" ||
+      status == "EXPIRED" || status == "REPLACED";
+}
+
+} // namespace
+
+order_gateway::order_gateway(
+    std::unique_ptr<order_broker> broker, update_callback on_update)
+    : _broker{std::move(broker)}, _on_update{std::move(on_update)} {
+  int threads = std::max(1, absl::GetFlag(FLAGS_order_submit_threads));
+  for (int i = 0; i < threads; ++i) {
+    _submitters.emplace_back(
+        [this](std::stop_token stop) { _submit_orders(stop); });
+  }
+  _poller = std::jthread([this](std::stop_token stop) { _poll_orders(stop); });
+}
+
+order_gateway::~order_gateway() {
+  for (std::jthread& submitter : _submitters) submitter.request_stop();
+  _poller.request_stop();
+  for (std::jthread& submitter : _submitters) submitter.join();
+  _poller.join();
+
+  if (!_queue.empty()) {
+    LOG(WARNING) << "Dropping " << _queue.size() << " unsent orders.";
+  }
+}
+
+uint64_t order_gateway::submit(
+    trading::Action action,
+    const schwab::api_connection::order_parameters& params) {
+  if (action != trading::BUY && action != trading::SELL) {
+    throw std::invalid_argument(
+        absl::StrCat(
+            "Cannot submit order with action ",
+            trading::Action_Name(action)));
+  }
+  schwab::api_connection::prepared_order prepared =
+      _broker->prepare_order(action, params);
+
+  uint64_t order_id;
+  {
+    std::lock_guard lock{_mutex};
+    order_id = _next_order_id++;
+    _orders.emplace(
+        order_id,
+        tracked_order{
+            .update =
+                {.order_id = order_id,
+                 .symbol = params.symbol,
+                 .action = action,
+                 .state = order_state::PENDING,
+                 .quantity = params.quantity},
+            .prepared = std::move(prepared)});
+    _queue.push_back(order_id);
+  }
+  _queued.notify_one();
+  return order_id;
+}
+
+std::size_t order_gateway::in_flight_count() const {
+  std::lock_guard lock{_mutex};
+  return _orders.size();
+}
+
+void order_gateway::_submit_orders(std::stop_token stop) {
+  while (true) {
+    order_update update;
+    schwab::api_connection::prepared_order prepared;
+    {
+      std::unique_lock lock{_mutex};
+      if (!_queued.wait(lock, stop, [&]() { return !_queue.empty(); })) {
+        return;
+      }
+      tracked_order& order = _orders.at(_queue.front());
+      _queue.pop_front();
+      order.update.state = order_state::OPEN;
+      update = order.update;
+      prepared = order.prepared;
+    }
+    _on_update(update);
+
+    try {
+      update.broker_order_id = _broker->submit_order(prepared);
+      update.state = order_state::ACKNOWLEDGED;
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "Failed to submit " << trading::Action_Name(update.action)
+                 << " order for " << stock::Symbol_Name(update.symbol) << ": "
+                 << e.what();
+      update.state = order_state::REJECTED;
+    }
+
+    if (update.is_terminal()) {
+      {
+        std::lock_guard lock{_mutex};
+        _orders.erase(update.order_id);
+      }
+      _on_update(update);
+      continue;
+    }
+    // Reported before the poller can see the order, so that the poller's
+    // updates always follow this one.
+    _on_update(update);
+    {
+      std::lock_guard lock{_mutex};
+      _orders.at(update.order_id).update = update;
+    }
+    _acknowledged.notify_one();
+  }
+}
+
+void order_gateway::_poll_orders(std::stop_token stop) {
+  std::chrono::microseconds interval =
+      to_std_chrono(absl::GetFlag(FLAGS_order_poll_interval));
+  auto has_acknowledged = [&]() {
+    return std::ranges::any_of(_orders, [](const auto& entry) {
+      return entry.second.update.state == order_state::ACKNOWLEDGED;
+    });
+  };
+
+  while (true) {
+    std::vector<uint64_t> order_ids;
+    {
+      std::unique_lock lock{_mutex};
+      if (!_acknowledged.wait(lock, stop, has_acknowledged)) return;
+      for (const auto& [order_id, order] : _orders) {
+        if (order.update.state == order_state::ACKNOWLEDGED) {
+          order_ids.push_back(order_id);
+        }
+      }
+    }
+
+    for (uint64_t order_id : order_ids) {
+      try {
+        _poll_order(order_id);
+      } catch (const std::exception& e) {
+        LOG(ERROR) << "Failed to poll order " << order_id << ": " << e.what();
+      }
+    }
+
+    std::unique_lock lock{_mutex};
+    _acknowledged.wait_for(lock, stop, interval, []() { return false; });
+    if (stop.stop_requested()) return;
+  }
+}
+
+void order_gateway::_poll_order(uint64_t order_id) {
+  std::string account_id;
+  std::string broker_order_id;
+  {
+    std::lock_guard lock{_mutex};
+    const tracked_order& order = _orders.at(order_id);
+    account_id = order.prepared.account_id;
+    broker_order_id = order.update.broker_order_id;
+  }
+
+  // Only this thread changes acknowledged orders, so the order cannot have
+  // been removed while the status was being fetched.
+  schwab::api_connection::order_status status =
+      _broker->get_order_status(account_id, broker_order_id);
+
+  order_update update;
+  {
+    std::lock_guard lock{_mutex};
+    order_update& tracked = _orders.at(order_id).update;
+    bool changed = status.filled_quantity != tracked.filled_quantity;
+    tracked.filled_quantity = status.filled_quantity;
+    tracked.fill_price = status.average_fill_price;
+    if (status.status == "FILLED") {
+      tracked.state = order_state::FILLED;
+      changed = true;
+    } else if (is_closed_unfilled(status.status)) {
+      tracked.state = order_state::REJECTED;
+      changed = true;
+    }
+    if (!changed) return;
+
+    update = tracked;
+    if (update.is_terminal()) _orders.erase(order_id);
+  }
+  _on_update(update);
+}
+
+} // namespace howling
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "api/schwab.h"
+#include "data/stock.pb.h"
+#include "data/trade.pb.h"
+#include "trading/order_broker.h"
+
+namespace howling {
+
+/**
+ * @brief Submits orders to the broker off of the caller's thread.
+ *
+ * Orders are serialized when they are submitted and queued for a pool of
+ * workers which send them to the broker. Acknowledged orders are
+ * then polled until they reach a terminal state. Every state change is
+ * reported through the update callback, in order for each order. The callback
+ * is invoked from the gateway's threads and must not block.
+ *
+ * Orders still queued when the gateway is destroyed are dropped.
+ *
+ * This class is internally synchronized.
+ */
+class order_gateway {
+public:
+  enum class order_state {
+    // Queued but not yet sent to the broker.
+    PENDING,
+    // Being sent to the broker.
+    OPEN,
+    // Accepted by the broker and working.
+    ACKNOWLEDGED,
+    // Completely filled. Terminal.
+    FILLED,
+    // Rejected, canceled, or expired by the broker, or failed to send. May
+    // have been partially filled. Terminal.
+    REJECTED,
+  };
+
+  struct order_update {
+    // Id assigned by the gateway when the order was submitted.
+    uint64_t order_id;
+    stock::Symbol symbol;
+    trading::Action action;
+    order_state state;
+    int64_t quantity;
+    int64_t filled_quantity = 0;
+    double fill_price = 0;
+    // Id assigned by the broker once the order has been acknowledged.
+    std::string broker_order_id;
+
+    bool is_terminal() const {
+      return state == order_state::FILLED || state == order_state::REJECTED;
+    }
+  };
+
+  using update_callback = std::function<void(const order_update&)>;
+
+  order_gateway(
+      std::unique_ptr<order_broker> broker, update_callback on_update);
+  ~order_gateway();
+
+  order_gateway(const order_gateway&) = delete;
+  order_gateway& operator=(const order_gateway&) = delete;
+
+  /**
+   * @brief Queues an order for submission without waiting on the broker.
+   *
+   * @param action Either `trading::BUY` or `trading::SELL`.
+   *
+   * @return The gateway's id for the order, matching `order_update::order_id`.
+   */
+  uint64_t submit(
+      trading::Action action,
+      const schwab::api_connection::order_parameters& params);
+
+  /** @brief Number of orders which have not yet reached a terminal state. */
+  std::size_t in_flight_count() const;
+
+private:
+  struct tracked_order {
+    order_update update;
+    schwab::api_connection::prepared_order prepared;
+  };
+
+  void _submit_orders(std::stop_token stop);
+  void _poll_orders(std::stop_token stop);
+  void _poll_order(uint64_t order_id);
+
+  std::unique_ptr<order_broker> _broker;
+  update_callback _on_update;
+
+  mutable std::mutex _mutex;
+  std::condition_variable_any _queued;
+  std::condition_variable_any _acknowledged;
+  std::deque<uint64_t> _queue;
+  std::unordered_map<uint64_t, tracked_order> _orders;
+  uint64_t _next_order_id = 1;
+
+  // Declared last so they are stopped before the state they use is destroyed.
+  std::vector<std::jthread> _submitters;
+  std::jthread _poller;
+};
+
+} // namespace howling
@@ -0,0 +1,211 @@
+#include "trading/order_gateway.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
+#include "absl/time/time.h"
+#include "api/schwab.h"
+#include "data/stock.pb.h"
+#include "data/trade.pb.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "trading/mock_order_broker.h"
+
+ABSL_DECLARE_FLAG(absl::Duration, order_poll_interval);
+
+namespace howling {
+namespace {
+
+using ::testing::_;
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::NiceMock;
+using ::testing::Return;
+using ::testing::Throw;
+
+using order_state = order_gateway::order_state;
+using order_update = order_gateway::order_update;
+
+constexpr schwab::api_connection::order_parameters TEN_SHARES{
+    .account_id = "account",
+    .symbol = stock::NVDA,
+    .price = 100,
+    .quantity = 10};
+
+/** Collects the updates reported by a gateway from its threads. */
+class update_log {
+public:
+  order_gateway::update_callback callback() {
+    return [this](const order_update& update) {
+      {
+        std::lock_guard lock{_mutex};
+        _updates.push_back(update);
+      }
+      _updated.notify_all();
+    };
+  }
+
+  /** @brief Waits for `order_id` to complete and returns every update. */
+  std::vector<order_update> wait_for_completion(uint64_t order_id) {
+    std::unique_lock lock{_mutex};
+    _updated.wait_for(lock, std::chrono::seconds(5), [&]() {
+      for (const order_update& update : _updates) {
+        if (update.order_id == order_id && update.is_terminal()) return true;
+      }
+      return false;
+    });
+    return _updates;
+  }
+
+private:
+  std::mutex _mutex;
+  std::condition_variable _updated;
+  std::vector<order_update> _updates;
+};
+
+class OrderGatewayTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    absl::SetFlag(&FLAGS_order_poll_interval, absl::Milliseconds(1));
+    auto broker = std::make_unique<NiceMock<mock_order_broker>>();
+    _broker = broker.get();
+    ON_CALL(*_broker, prepare_order)
+        .WillByDefault(Return(
+            schwab::api_connection::prepared_order{
+                .account_id = "account", .body = "{}"}));
+    _gateway =
+        std::make_unique<order_gateway>(std::move(broker), _log.callback());
+  }
+
+  void TearDown() override { _gateway.reset(); }
+
+  update_log _log;
+  mock_order_broker* _broker;
+  std::unique_ptr<order_gateway> _gateway;
+};
+
+auto has_state(order_state state) {
+  return Field(&order_update::state, state);
+}
+
+TEST_F(OrderGatewayTest, ReportsFilledOrder) {
+  EXPECT_CALL(*_broker, prepare_order(trading::BUY, _));
+  EXPECT_CALL(*_broker, submit_order).WillOnce(Return("broker-1"));
+  EXPECT_CALL(*_broker, get_order_status("account", "broker-1"))
+      .WillOnce(
+          Return(
+              schwab::api_connection::order_status{
+                  .status = "FILLED",
+                  .filled_quantity = 10,
+                  .average_fill_price = 99.5}));
+
+  uint64_t order_id = _gateway->submit(trading::BUY, TEN_SHARES);
+  std::vector<order_update> updates = _log.wait_for_completion(order_id);
+
+  EXPECT_THAT(
+      updates,
+      ElementsAre(
+          has_state(order_state::OPEN),
+          has_state(order_state::ACKNOWLEDGED),
+          has_state(order_state::FILLED)));
+  EXPECT_EQ(updates[1].broker_order_id, "broker-1");
+  EXPECT_EQ(updates[2].filled_quantity, 10);
+  EXPECT_EQ(updates[2].fill_price, 99.5);
+  EXPECT_EQ(_gateway->in_flight_count(), 0);
+}
+
+TEST_F(OrderGatewayTest, ReportsPartialFills) {
+  EXPECT_CALL(*_broker, submit_order).WillOnce(Return("broker-1"));
+  EXPECT_CALL(*_broker, get_order_status)
+      .WillOnce(
+          Return(
+              schwab::api_connection::order_status{
+                  .status = "WORKING",
+                  .filled_quantity = 4,
+                  .average_fill_price = 100}))
+      .WillOnce(
+          Return(
+              schwab::api_connection::order_status{
+                  .status = "WORKING",
+                  .filled_quantity = 4,
+                  .average_fill_price = 100}))
+      .WillOnce(
+          Return(
+              schwab::api_connection::order_status{
+                  .status = "FILLED",
+                  .filled_quantity = 10,
+                  .average_fill_price = 101}));
+
+  uint64_t order_id = _gateway->submit(trading::BUY, TEN_SHARES);
+  std::vector<order_update> updates = _log.wait_for_completion(order_id);
+
+  // Unchanged statuses are not reported again.
+  ASSERT_THAT(
+      updates,
+      ElementsAre(
+          has_state(order_state::OPEN),
+          has_state(order_state::ACKNOWLEDGED),
+          has_state(order_state::ACKNOWLEDGED),
+          has_state(order_state::FILLED)));
+  EXPECT_EQ(updates[2].filled_quantity, 4);
+  EXPECT_EQ(updates[2].fill_price, 100);
+  EXPECT_EQ(updates[3].filled_quantity, 10);
+  EXPECT_EQ(updates[3].fill_price, 101);
+}
+
+TEST_F(OrderGatewayTest, ReportsRejectedOrder) {
+  EXPECT_CALL(*_broker, submit_order).WillOnce(Return("broker-1"));
+  EXPECT_CALL(*_broker, get_order_status)
+      .WillOnce(
+          Return(
+              schwab::api_connection::order_status{
+                  .status = "CANCELED",
+                  .filled_quantity = 3,
+                  .average_fill_price = 100}));
+
+  uint64_t order_id = _gateway->submit(trading::SELL, TEN_SHARES);
+  std::vector<order_update> updates = _log.wait_for_completion(order_id);
+
+  ASSERT_THAT(
+      updates,
+      ElementsAre(
+          has_state(order_state::OPEN),
+          has_state(order_state::ACKNOWLEDGED),
+          has_state(order_state::REJECTED)));
+  EXPECT_EQ(updates[2].action, trading::SELL);
+  EXPECT_EQ(updates[2].filled_quantity, 3);
+  EXPECT_EQ(_gateway->in_flight_count(), 0);
+}
+
+TEST_F(OrderGatewayTest, RejectsOrdersWhichFailToSend) {
+  EXPECT_CALL(*_broker, submit_order)
+      .WillOnce(Throw(std::runtime_error("Bad response.")));
+  EXPECT_CALL(*_broker, get_order_status).Times(0);
+
+  uint64_t order_id = _gateway->submit(trading::BUY, TEN_SHARES);
+  std::vector<order_update> updates = _log.wait_for_completion(order_id);
+
+  EXPECT_THAT(
+      updates,
+      ElementsAre(
+          has_state(order_state::OPEN), has_state(order_state::REJECTED)));
+  EXPECT_EQ(_gateway->in_flight_count(), 0);
+}
+
+TEST_F(OrderGatewayTest, RefusesOtherActions) {
+  EXPECT_CALL(*_broker, prepare_order).Times(0);
+  EXPECT_THROW(
+      _gateway->submit(trading::ACTION_UNSPECIFIED, TEN_SHARES),
+      std::invalid_argument);
+  EXPECT_EQ(_gateway->in_flight_count(), 0);
+}
+
+} // namespace
+} // namespace howling
@@ -0,0 +1,77 @@
+#include "trading/sweep.h"
+
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "containers/vector.h"
+#include "data/load_analyzer.h"
+#include "trading/metrics.h"
+
+namespace howling {
+
+vector<sweep_dimension> parse_sweep(std::string_view grid) {
+  vector<sweep_dimension> dimensions;
+  for (absl::string_view part : absl::StrSplit(grid, ';', absl::SkipEmpty())) {
+    std::pair<absl::string_view, absl::string_view> name_values =
+        absl::StrSplit(part, absl::MaxSplits('=', 1));
+    sweep_dimension dimension{.name = std::string{name_values.first}};
+    for (absl::string_view value :
+         absl::StrSplit(name_values.second, ',', absl::SkipEmpty())) {
+      dimension.values.emplace_back(value);
+    }
+    if (dimension.name.empty() || dimension.values.empty()) {
+      throw std::runtime_error(
+          absl::StrCat("Sweep dimension needs a name and values: ", part));
+    }
+    if (dimension.name != "analyzer") {
+      // Fails on unknown options or invalid values before anything is run.
+      analyzer_options options;
+      for (const std::string& value : dimension.values) {
+        set_analyzer_option(options, dimension.name, value);
+      }
+    }
+    dimensions.push_back(std::move(dimension));
+  }
+  return dimensions;
+}
+
+vector<vector<sweep_setting>>
+expand_sweep(const vector<sweep_dimension>& dimensions) {
+  vector<vector<sweep_setting>> configurations{{}};
+  for (const sweep_dimension& dimension : dimensions) {
+    vector<vector<sweep_setting>> expanded;
+    expanded.reserve(configurations.size() * dimension.values.size());
+    for (const vector<sweep_setting>& configuration : configurations) {
+      for (const std::string& value : dimension.values) {
+        expanded.push_back(configuration);
+        expanded.back().push_back({.name = dimension.name, .value = value});
+      }
+    }
+    configurations = std::move(expanded);
+  }
+  return configurations;
+}
+
+double rank_value(const metrics& m, std::string_view rank_by) {
+  if (rank_by == "profit") {
+    return m.available_funds + m.assets_value - m.initial_funds;
+  }
+  if (rank_by == "win_rate") {
+    if (m.sales == 0) return 0.0;
+    return static_cast<double>(m.profitable_sales) / m.sales;
+  }
+  if (rank_by == "sales") return m.sales;
+  if (rank_by == "mean_delta") {
+    if (m.deltas.empty()) return 0.0;
+    return std::accumulate(m.deltas.begin(), m.deltas.end(), 0.0) /
+        m.deltas.size();
+  }
+  throw std::runtime_error(absl::StrCat("Unknown sweep metric: ", rank_by));
+}
+
+} // namespace howling
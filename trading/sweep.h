@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "containers/vector.h"
+#include "trading/metrics.h"
+
+namespace howling {
+
+/** One parameter of a sweep configuration and the value it takes. */
+struct sweep_setting {
+  std::string name;
+  std::string value;
+};
+
+/** One parameter of a sweep grid and every value it is swept over. */
+struct sweep_dimension {
+  std::string name;
+  vector<std::string> values;
+};
+
+/**
+ * @brief Parses a parameter grid such as
+ * "analyzer=macd,macd5;profit_minimum=0.05,0.1".
+ *
+ * Names are "analyzer" or any analyzer or aggregation flag, and each option
+ * value is checked as it would be when set.
+ *
+ * @throws std::runtime_error if a dimension has no name or values, or names an
+ * unknown option or gives it an invalid value.
+ */
+vector<sweep_dimension> parse_sweep(std::string_view grid);
+
+/**
+ * @brief Lists every combination of one value from each dimension.
+ *
+ * Settings are in the order of the dimensions, and the last dimension varies
+ * fastest.
+ */
+vector<vector<sweep_setting>>
+expand_sweep(const vector<sweep_dimension>& dimensions);
+
+/**
+ * @brief Returns the value of `m` to rank sweep results by, higher being
+ * better.
+ *
+ * @param rank_by One of "profit", "win_rate", "sales" or "mean_delta".
+ *
+ * @throws std::runtime_error if `rank_by` is not a known metric.
+ */
+double rank_value(const metrics& m, std::string_view rank_by);
+
+} // namespace howling
@@ -0,0 +1,111 @@
+#include "trading/sweep.h"
+
+#include <stdexcept>
+#include <string>
+
+#include "containers/vector.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "trading/metrics.h"
+
+namespace howling {
+namespace {
+
+using ::testing::AllOf;
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::IsEmpty;
+
+auto is_setting(const std::string& name, const std::string& value) {
+  return AllOf(
+      Field(&sweep_setting::name, name), Field(&sweep_setting::value, value));
+}
+
+auto is_dimension(const std::string& name, auto values_matcher) {
+  return AllOf(
+      Field(&sweep_dimension::name, name),
+      Field(&sweep_dimension::values, values_matcher));
+}
+
+TEST(ParseSweep, ParsesEveryDimension) {
+  EXPECT_THAT(
+      parse_sweep("analyzer=macd,macd5;profit_minimum=0.05,0.1;"),
+      ElementsAre(
+          is_dimension("analyzer", ElementsAre("macd", "macd5")),
+          is_dimension("profit_minimum", ElementsAre("0.05", "0.1"))));
+}
+
+TEST(ParseSweep, EmptyGridHasNoDimensions) {
+  EXPECT_THAT(parse_sweep(""), IsEmpty());
+}
+
+TEST(ParseSweep, RejectsDimensionsWithoutNameOrValues) {
+  EXPECT_THROW(parse_sweep("profit_minimum="), std::runtime_error);
+  EXPECT_THROW(parse_sweep("=0.05"), std::runtime_error);
+  EXPECT_THROW(parse_sweep("analyzer"), std::runtime_error);
+}
+
+TEST(ParseSweep, RejectsUnknownOptions) {
+  EXPECT_THROW(parse_sweep("not_an_option=1"), std::runtime_error);
+}
+
+TEST(ParseSweep, RejectsInvalidValues) {
+  EXPECT_THROW(parse_sweep("profit_minimum=0.05,cheap"), std::runtime_error);
+}
+
+TEST(ExpandSweep, ListsEveryCombination) {
+  vector<sweep_dimension> dimensions{
+      {.name = "analyzer", .values = {"macd", "macd5"}},
+      {.name = "profit_minimum", .values = {"0.05", "0.1", "0.2"}}};
+
+  vector<vector<sweep_setting>> configurations = expand_sweep(dimensions);
+
+  ASSERT_EQ(configurations.size(), 6);
+  EXPECT_THAT(
+      configurations[0],
+      ElementsAre(
+          is_setting("analyzer", "macd"),
+          is_setting("profit_minimum", "0.05")));
+  EXPECT_THAT(
+      configurations[2],
+      ElementsAre(
+          is_setting("analyzer", "macd"), is_setting("profit_minimum", "0.2")));
+  EXPECT_THAT(
+      configurations[5],
+      ElementsAre(
+          is_setting("analyzer", "macd5"),
+          is_setting("profit_minimum", "0.2")));
+}
+
+TEST(ExpandSweep, NoDimensionsIsOneEmptyConfiguration) {
+  EXPECT_THAT(expand_sweep({}), ElementsAre(IsEmpty()));
+}
+
+TEST(RankValue, RanksByEachMetric) {
+  metrics m{
+      .initial_funds = 1000,
+      .available_funds = 900,
+      .assets_value = 150,
+      .sales = 4,
+      .profitable_sales = 3,
+      .deltas = {1, 2, 3, -2}};
+
+  EXPECT_EQ(rank_value(m, "profit"), 50);
+  EXPECT_EQ(rank_value(m, "win_rate"), 0.75);
+  EXPECT_EQ(rank_value(m, "sales"), 4);
+  EXPECT_EQ(rank_value(m, "mean_delta"), 1);
+}
+
+TEST(RankValue, RanksNoSalesAsZero) {
+  metrics m{.initial_funds = 1000, .available_funds = 1000};
+
+  EXPECT_EQ(rank_value(m, "win_rate"), 0);
+  EXPECT_EQ(rank_value(m, "mean_delta"), 0);
+}
+
+TEST(RankValue, RejectsUnknownMetrics) {
+  EXPECT_THROW(rank_value({}, "sharpe"), std::runtime_error);
+}
+
+} // namespace
+} // namespace howling